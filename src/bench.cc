@@ -0,0 +1,387 @@
+// jive5ab-bench: measure throughput of the data processing steps
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+//
+// Builds small processing chains out of the existing steps:
+//
+//      framepatterngenerator -> step(s) under test -> bitbucket
+//
+// for a number of data formats and runs each of them flat out (no
+// realtime pacing) for a fixed amount of time. The chain is throttled by
+// its slowest step so the amount of data the generator managed to push
+// out is the throughput of the chain. The 'source' case (generator
+// straight into the bitbucket) gives the ceiling for all other cases.
+//
+// Results are written to stdout as a JSON array, one object per
+// (format, chain) combination, such that successive runs can be
+// compared by a script.
+#include <chain.h>
+#include <runtime.h>
+#include <threadfns.h>
+#include <tthreadfns.h>
+#include <headersearch.h>
+#include <splitstuff.h>
+#include <constraints.h>
+#include <mk5command.h>
+#include <mk5command/in2netsupport.h>
+#include <evlbidebug.h>
+#include <ezexcept.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <new>
+#include <exception>
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+using namespace std;
+
+DECLARE_EZEXCEPT(benchexception)
+DEFINE_EZEXCEPT(benchexception)
+
+
+// Count all heap allocations made through operator new. The chains
+// allocate in all of their threads so the counter must be atomic.
+// The replacements must not be inlined: the compiler would see free()
+// being called on what came out of operator new.
+static volatile uint64_t  nAlloc = 0;
+
+// Dynamic exception specifications are deprecated in C++11
+#if __cplusplus >= 201103L
+#define BENCH_THROW_BAD_ALLOC
+#else
+#define BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+__attribute__((noinline)) void* operator new(size_t n) BENCH_THROW_BAD_ALLOC {
+    void*  p;
+
+    __sync_fetch_and_add(&nAlloc, 1);
+    if( (p=::malloc(n ? n : 1))==0 )
+        throw std::bad_alloc();
+    return p;
+}
+__attribute__((noinline)) void* operator new[](size_t n) BENCH_THROW_BAD_ALLOC {
+    return ::operator new(n);
+}
+__attribute__((noinline)) void operator delete(void* p) throw() {
+    ::free(p);
+}
+__attribute__((noinline)) void operator delete[](void* p) throw() {
+    ::free(p);
+}
+
+
+// The formats to test. Set via the 'magic mode' strings so
+// we don't need play_rate/clock_set. The splitter, if not empty,
+// is used for the "split+reframe" chain; "8bitx4" only chops the 32-bit
+// words into bytes so it fits any of these.
+struct format_case {
+    const char*  mode;
+    const char*  splitter;
+};
+
+static const format_case  formats[] = {
+    { "MKIV1_1-512-16-2",     "8bitx4" },
+    { "VLBA1_1-128-8-2",      "8bitx4" },
+    { "Mark5B-512-16-2",      "8bitx4" },
+    { "VDIF_8000-512-16-2",   "8bitx4" },
+    { "VDIFL_8000-512-16-2",  "8bitx4" },
+    { "VDIFC_8000-512-16-2",  ""       },
+    { "VDIFLC_8000-512-16-2", ""       }
+};
+
+// The chains we know how to build
+enum chain_type {
+    source, framing, timecheck, reframe, split_reframe
+};
+static const char* const chain_names[] = {
+    "source", "framer", "timechecker", "reframe_to_vdif", "split+reframe_to_vdif"
+};
+
+
+struct result_type {
+    string      mode;
+    string      step;
+    string      error;
+    string      format;
+    unsigned    framesize;
+    double      seconds;
+    uint64_t    bytes;
+    uint64_t    allocs;
+
+    result_type(const string& m, const string& s):
+        mode( m ), step( s ), framesize( 0 ), seconds( 0.0 ), bytes( 0 ), allocs( 0 )
+    {}
+};
+
+static string json_escape(const string& s) {
+    string  rv;
+
+    for(string::const_iterator p=s.begin(); p!=s.end(); p++) {
+        if( *p=='"' || *p=='\\' )
+            rv.push_back( '\\' );
+        if( (unsigned char)*p<0x20 )
+            rv.push_back( ' ' );
+        else
+            rv.push_back( *p );
+    }
+    return rv;
+}
+
+static ostream& operator<<(ostream& os, const result_type& r) {
+    os << "{\"mode\": \"" << r.mode << "\", \"chain\": \"" << r.step << "\"";
+    if( !r.error.empty() )
+        return os << ", \"error\": \"" << json_escape(r.error) << "\"}";
+
+    const double   frames  = (r.framesize ? (double)(r.bytes/r.framesize) : 0.0);
+    char           buf[512];
+
+    ::snprintf(buf, sizeof(buf),
+               ", \"format\": \"%s\", \"framesize\": %u, \"seconds\": %.3f, \"bytes\": %llu"
+               ", \"frames\": %.0f, \"GB/s\": %.4f, \"frames/s\": %.1f, \"ns/frame\": %.1f"
+               ", \"allocations\": %llu, \"allocations/frame\": %.3f}",
+               r.format.c_str(), r.framesize, r.seconds, (unsigned long long)r.bytes,
+               frames, ((double)r.bytes/r.seconds)/1.0e9, frames/r.seconds,
+               (frames>0 ? (r.seconds*1.0e9)/frames : 0.0),
+               (unsigned long long)r.allocs, (frames>0 ? (double)r.allocs/frames : 0.0));
+    return os << buf;
+}
+
+
+static double now( void ) {
+    struct timespec  ts;
+
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec/1.0e9;
+}
+
+static void sleep_for(double s) {
+    struct timespec  ts;
+
+    ts.tv_sec  = (time_t)s;
+    ts.tv_nsec = (long)((s - (double)ts.tv_sec) * 1.0e9);
+    while( ::nanosleep(&ts, &ts)==-1 && errno==EINTR ) {}
+}
+
+// Use the command interpreter to set the mode, as a user would
+static void set_mode(runtime& rte, const string& mode) {
+    const mk5commandmap_type&          cmdmap( make_generic_commandmap() );
+    mk5commandmap_type::const_iterator cmdptr = cmdmap.find( "mode" );
+    vector<string>                     args;
+
+    EZASSERT2(cmdptr!=cmdmap.end(), benchexception, EZINFO("no 'mode' command?!"));
+    args.push_back( "mode" );
+    args.push_back( mode );
+
+    const string  reply( cmdptr->second(false, args, rte) );
+    EZASSERT2(reply.find("= 0")!=string::npos, benchexception, EZINFO(reply));
+}
+
+// Reframe to VDIF what comes out of the previous step, described by 'hdr'
+static void add_reframer(chain& c, const headersearch_type& hdr, unsigned int qdepth) {
+    reframe_args  ra(0, hdr.trackbitrate, hdr.payloadsize, size_is_hint(8000, hdr.payloadsize),
+                     2, 2, is_complex(hdr.frameformat));
+
+    c.add(&reframe_to_vdif, qdepth, ra);
+    c.add(&bitbucket<tagged<miniblocklist_type> >);
+}
+
+static result_type run_case(runtime& rte, const format_case& fc, chain_type ct,
+                            double warmup, double duration) {
+    const unsigned int  qdepth = 32;
+    result_type         rv( fc.mode, chain_names[ct] );
+
+    try {
+        // the framefilter gets a pointer to this so it must outlive the chain
+        framefilterargs_type  ffargs;
+        chain                 c;
+        fillpatargs           fpargs( &rte );
+
+        set_mode(rte, fc.mode);
+
+        const headersearch_type dataformat(rte.trackformat(), rte.ntrack(),
+                                           rte.trackbitrate(), rte.vdifframesize());
+        EZASSERT2(dataformat.valid(), benchexception, EZINFO("mode did not yield a valid data format"));
+
+        ostringstream  fmt;
+        fmt << dataformat.frameformat;
+        rv.format    = fmt.str();
+        rv.framesize = dataformat.framesize;
+
+        rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
+        rte.statistics.clear();
+
+        fpargs.run      = true;
+        fpargs.realtime = false;
+
+        const chain::stepid  fillstep = c.add(&framepatterngenerator, qdepth, fpargs);
+
+        switch( ct ) {
+            case source:
+                c.add(&bitbucket<block>);
+                break;
+            case framing:
+                c.add(&framer<frame>, qdepth, framerargs(dataformat, &rte));
+                c.add(&bitbucket<frame>);
+                break;
+            case timecheck:
+                c.add(&framer<frame>, qdepth, framerargs(dataformat, &rte));
+                c.add(&timechecker, dataformat);
+                break;
+            case reframe:
+                c.add(&framer<tagged<frame> >, qdepth, framerargs(dataformat, &rte));
+                c.add(&header_stripper, qdepth, dataformat);
+                add_reframer(c, dataformat, qdepth);
+                break;
+            case split_reframe: {
+                functionmap_type::const_iterator  sf = functionmap.find( fc.splitter );
+
+                // The plain C++ splitters carry a "-t" suffix
+                if( sf==functionmap.end() )
+                    sf = functionmap.find( string(fc.splitter) + "-t" );
+                EZASSERT2(sf!=functionmap.end(), benchexception, EZINFO("splitter '" << fc.splitter << "' not found"));
+
+                splitterargs             splitargs(&rte, sf->second, dataformat);
+                const headersearch_type& outhdr( splitargs.outputhdr );
+
+                // As in spill2net: only let frames through starting at
+                // an integer multiple of the output VDIF frame length
+                ffargs.naccumulate = splitargs.naccumulate;
+                ffargs.framelength = (8 * size_is_hint(8000, outhdr.payloadsize)) / (outhdr.ntrack * outhdr.trackbitrate);
+
+                c.add(&framer<framebatch>, qdepth, framerargs(dataformat, &rte));
+                c.add(&medianfilter, 4);
+                c.add(&framefilter, 4, &ffargs);
+                c.add(&coalescing_splitter, qdepth, splitargs);
+                add_reframer(c, outhdr, qdepth);
+                break;
+            }
+        }
+
+        c.run();
+        sleep_for(warmup);
+
+        const uint64_t  b0 = (uint64_t)rte.statistics.counter(fillstep);
+        const uint64_t  a0 = nAlloc;
+        const double    t0 = now();
+
+        sleep_for(duration);
+
+        const uint64_t  b1 = (uint64_t)rte.statistics.counter(fillstep);
+        const uint64_t  a1 = nAlloc;
+        const double    t1 = now();
+
+        c.stop();
+
+        rv.seconds = t1 - t0;
+        rv.bytes   = b1 - b0;
+        rv.allocs  = a1 - a0;
+    }
+    catch( const std::exception& e ) {
+        rv.error = e.what();
+    }
+    catch( ... ) {
+        rv.error = "unknown exception";
+    }
+    return rv;
+}
+
+
+void Usage( const char* progname ) {
+    cout << "Usage: " << progname << " [-h] [-d <seconds>] [-w <seconds>] [-f <mode>] [-c <chain>] [-m <level>]" << endl
+         << "   measure throughput of jive5ab processing chains, print results as JSON" << endl
+         << "   -d <seconds>  measure each chain for this long (default 2.0)" << endl
+         << "   -w <seconds>  let each chain warm up for this long before measuring (default 0.5)" << endl
+         << "   -f <mode>     only run formats whose mode string contains <mode>" << endl
+         << "   -c <chain>    only run chains named <chain>:" << endl
+         << "                 ";
+    for(unsigned int i=0; i<sizeof(chain_names)/sizeof(chain_names[0]); i++)
+        cout << " " << chain_names[i];
+    cout << endl
+         << "   -m <level>    message level (default -1, i.e. quiet)" << endl;
+}
+
+int main(int argc, char** argv) {
+    int      option;
+    double   duration = 2.0, warmup = 0.5;
+    string   fmtfilter, chainfilter;
+
+    dbglev_fn( -1 );
+
+    while( (option=::getopt(argc, argv, "hd:w:f:c:m:"))>=0 ) {
+        switch( option ) {
+            case 'd':
+                duration = ::strtod(optarg, 0);
+                break;
+            case 'w':
+                warmup = ::strtod(optarg, 0);
+                break;
+            case 'f':
+                fmtfilter = optarg;
+                break;
+            case 'c':
+                chainfilter = optarg;
+                break;
+            case 'm':
+                dbglev_fn( (int)::strtol(optarg, 0, 0) );
+                break;
+            case 'h':
+                Usage( argv[0] );
+                return 0;
+            default:
+                Usage( argv[0] );
+                return 1;
+        }
+    }
+    if( duration<=0.0 || warmup<0.0 ) {
+        cerr << argv[0] << ": durations must be positive" << endl;
+        return 1;
+    }
+
+    // Default runtime, no hardware
+    runtime   rte;
+    bool      first = true;
+
+    cout << "[" << endl;
+    for(unsigned int f=0; f<sizeof(formats)/sizeof(formats[0]); f++) {
+        if( !fmtfilter.empty() && string(formats[f].mode).find(fmtfilter)==string::npos )
+            continue;
+        for(unsigned int c=0; c<sizeof(chain_names)/sizeof(chain_names[0]); c++) {
+            const chain_type  ct = (chain_type)c;
+
+            if( !chainfilter.empty() && chainfilter!=chain_names[c] )
+                continue;
+            if( ct==split_reframe && *formats[f].splitter=='\0' )
+                continue;
+            cout << (first ? "  " : ", ") << run_case(rte, formats[f], ct, warmup, duration) << endl << flush;
+            first = false;
+        }
+    }
+    cout << "]" << endl;
+    return 0;
+}
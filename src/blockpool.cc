@@ -25,6 +25,9 @@
 #include <string.h>
 #include <limits.h>   // For UINT_MAX d'oh
 #include <unistd.h>   // for usleep(3)
+#include <pthreadcall.h>
+#include <algorithm>
+#include <map>
 
 
 // If we NOT in C++11 happyland we do things the old (Intel x86 asm) way
@@ -168,35 +171,39 @@ pool_type::pool_type(unsigned int bs, unsigned int nb):
 
 // return empty/default block if none available here
 block pool_type::get( void ) {
-    // do we have a free blocks?
-    unsigned int    previous_next = next_alloc;
-    refcount_type*  c = 0;
-    unsigned char*  m = 0;
+    blockslot_type  slot;
 
-    // keep on cycling until we hit either a free block
-    // or the previous "last_alloc" again, then we give up
-    do {
-        // this one available?
+    return (reserve(&slot, 1)==1) ? make_block(slot, block_size) : block();
+}
+
+unsigned int pool_type::reserve(blockslot_type* slots, unsigned int n) {
+    unsigned int  got = 0;
+
+    // cycle through the pool once, starting where we left off, until we
+    // have enough blocks
+    for(unsigned int i=0; i<nblock && got<n; i++, next_alloc=CIRCNEXT(next_alloc, nblock)) {
+        refcount_type*  c = &use_cnt[next_alloc];
+
+        // this one available? Only then do the (expensive) atomic
+        // operation to claim it
+        if( *c!=0 )
+            continue;
 #if __cplusplus >= 201103L
         refcount_type::value_type   nul{ 0 };
-        if( use_cnt[next_alloc].compare_exchange_strong(nul, 1) ) {
+        if( !c->compare_exchange_strong(nul, 1) )
 #else
-        if( ::atomic_try_set(&use_cnt[next_alloc], 1, 0) ) {
+        if( !::atomic_try_set(c, 1, 0) )
 #endif
-            c = &use_cnt[next_alloc];
-            m = &memory[next_alloc*block_size];
-        }
-        next_alloc = CIRCNEXT(next_alloc, nblock);
-    } while( !c && next_alloc!=previous_next );
-    // if we were succesfull in allocat0ring a block ...
-#if 0
-    if( c&&m ) {
-        DEBUG(3, "pool[" << (void*)this << "]: allocated block @" << (void*)m << ", cnt @" << (void*)c << " [" << block_size << "]" << endl);
-    } else {
-        DEBUG(3, "pool[" << (void*)this << "]: no free block of size " << block_size << endl);
+            continue;
+        slots[got].use_cnt = c;
+        slots[got].memory  = &memory[next_alloc*block_size];
+        got++;
     }
-#endif
-    return ((c && m)?block(m, block_size, c):block());
+    return got;
+}
+
+block pool_type::make_block(const blockslot_type& slot, unsigned int bs) {
+    return block(slot.memory, bs, slot.use_cnt);
 }
 
 void pool_type::show_usecnt( void ) const {
@@ -237,55 +244,272 @@ pool_type::~pool_type() {
 #endif
 }
 
+//////////////////////////////////////////////////////////////
+//  per thread magazines
+//////////////////////////////////////////////////////////////
+
+// Blocks reserved for one thread. Only the owner takes blocks from it but
+// a thread that finds no free blocks in the pools may take them from the
+// magazines of other threads, hence the mutex. The owner never has to
+// wait for it for long; the others only try to lock it.
+struct blockpool_type::magazine_type {
+    unsigned int      n;
+    uint64_t          nGet;
+    uint64_t          nHit;
+    blockslot_type*   slots;
+    pthread_mutex_t   mutex;
+
+    magazine_type(unsigned int sz):
+        n( 0 ), nGet( 0 ), nHit( 0 ),
+        slots( new blockslot_type[sz] )
+    {
+        PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+    }
+
+    // Unreserve the blocks that were not handed out
+    void unreserve( void ) {
+        for(unsigned int i=0; i<n; i++)
+            *slots[i].use_cnt = 0;
+        n = 0;
+    }
+
+    ~magazine_type() {
+        delete [] slots;
+        ::pthread_mutex_destroy(&mutex);
+    }
+
+    private:
+        magazine_type();
+        magazine_type(const magazine_type&);
+        const magazine_type& operator=(const magazine_type&);
+};
+
+// Each thread has a small table pointing at the magazines it was given.
+// Blockpools are identified by serial number, which is never reused, such
+// that an entry for a blockpool that was deleted can never match again.
+// The blockpools that exist are in a registry such that a thread's
+// magazines can be given back when the thread exits.
+namespace {
+    struct threadmagazines_type {
+        static const unsigned int  nentry = 8;
+
+        uint64_t                        serial[nentry];
+        blockpool_type::magazine_type*  magazine[nentry];
+
+        threadmagazines_type() {
+            for(unsigned int i=0; i<nentry; i++) {
+                serial[i]   = 0;
+                magazine[i] = 0;
+            }
+        }
+    };
+    typedef std::map<uint64_t, blockpool_type*>  registry_type;
+
+    pthread_key_t     threadmagazines_key;
+    pthread_once_t    threadmagazines_once = PTHREAD_ONCE_INIT;
+    pthread_mutex_t   registry_lock        = PTHREAD_MUTEX_INITIALIZER;
+    uint64_t          last_serial          = 0;
+    registry_type     registry;
+
+    // the thread exits: its magazines go back to their blockpools
+    void delete_threadmagazines(void* ptr) {
+        threadmagazines_type*  tm = (threadmagazines_type*)ptr;
+
+        for(unsigned int i=0; i<threadmagazines_type::nentry; i++)
+            if( tm->magazine[i] )
+                blockpool_type::release_magazine(tm->serial[i], tm->magazine[i]);
+        delete tm;
+    }
+    void make_threadmagazines_key( void ) {
+        PTHREAD_CALL( ::pthread_key_create(&threadmagazines_key, &delete_threadmagazines) );
+    }
+
+    uint64_t register_blockpool(blockpool_type* bp) {
+        mutex_locker  locker( registry_lock );
+        registry.insert( std::make_pair(++last_serial, bp) );
+        return last_serial;
+    }
+}
+
+blockpool_type::stats_type::stats_type():
+    nGet( 0 ), nHit( 0 ), nRefill( 0 ), nPool( 0 )
+{}
+
 // blockpool preallocates memory in pools of
 // size nblock_p_chunk blocks of bs bytes
 //
 // It starts with one pool and adds more
-// as necessary
+// as necessary. A magazine holds at most a quarter of a pool such that
+// threads sharing a blockpool don't lock up all blocks between them.
 blockpool_type::blockpool_type(unsigned int bs, unsigned int nb):
-    blocksize(bs), nblock_p_pool(nb)
+    blocksize(bs), nblock_p_pool(nb), serial( 0 ),
+    magsize( std::max(std::min(nb/4, 16u), 1u) ), nRefill( 0 ),
+    nGetReleased( 0 ), nHitReleased( 0 )
 {
     EZASSERT2(blocksize>0 && nblock_p_pool>0, blockpool_error, 
               EZINFO("both blocksize (" << blocksize << ") and nblock_p_pool (" <<
                      nblock_p_pool << ") must be >0") );
+    PTHREAD_CALL( ::pthread_once(&threadmagazines_once, &make_threadmagazines_key) );
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
     // start with one pool
     curpool = pools.insert(pools.end(), new pool_type(blocksize, nblock_p_pool));
+    // only now we're sure to be destroyed at some point
+    serial  = register_blockpool(this);
 }
 
 // get  a fresh block
 block blockpool_type::get( void ) {
     // oh dear. someone wants a block
-    block                rv;
-    pool_pointer_pointer oldcurpool = curpool;
+    magazine_type*  mag = this_threads_magazine();
+    mutex_locker    locker( mag->mutex );
+
+    if( mag->n==0 )
+        refill( mag );
+    else
+        mag->nHit++;
+    mag->nGet++;
+    return pool_type::make_block(mag->slots[--mag->n], blocksize);
+}
+
+blockpool_type::magazine_type* blockpool_type::this_threads_magazine( void ) {
+    threadmagazines_type*  tm = (threadmagazines_type*)::pthread_getspecific(threadmagazines_key);
+
+    if( tm==0 ) {
+        tm = new threadmagazines_type();
+        PTHREAD_CALL( ::pthread_setspecific(threadmagazines_key, tm) );
+    }
+
+    const unsigned int  idx = (unsigned int)(serial % threadmagazines_type::nentry);
+
+    if( tm->serial[idx]==serial )
+        return tm->magazine[idx];
+
+    // The entry is used for another blockpool; that one gets its magazine
+    // back because this thread can't find it anymore
+    if( tm->magazine[idx] )
+        release_magazine(tm->serial[idx], tm->magazine[idx]);
+
+    magazine_type*   mag = new magazine_type(magsize);
+    mutex_locker     locker( mutex );
+
+    magazines.push_back( mag );
+    tm->serial[idx]   = serial;
+    tm->magazine[idx] = mag;
+    return mag;
+}
+
+// Fill up the (empty) magazine halfway from the pools. If there are no
+// free blocks at all, take blocks from the other threads' magazines, and
+// only if that fails add a pool
+void blockpool_type::refill(magazine_type* mag) {
+    mutex_locker          locker( mutex );
+    pool_pointer_pointer  oldcurpool = curpool;
+    const unsigned int    n = (magsize + 1)/2;
 
     // first: loop over all pools we manage to see if someone
-    // has a free blocks
+    // has free blocks
     do {
-        if( !((rv=(*curpool)->get()).empty()) )
+        if( (mag->n+=(*curpool)->reserve(mag->slots+mag->n, n-mag->n))==n )
             break;
         curpool++;
         if( curpool==pools.end() )
             curpool=pools.begin();
     } while( curpool!=oldcurpool );
 
-    // if the 'rv' block is still invalid,
-    // we went round the block w/o finding a free block
-    // in the pool
-    if( rv.empty() ) {
+    // if we still have nothing, we went round the block w/o finding a
+    // free block in the pools
+    if( mag->n==0 )
+        mag->n = steal(mag, n);
+    if( mag->n==0 ) {
         // I guess it's safe to assume allocation from a freshly created
         // pool should always succeed ...
         curpool = pools.insert(pools.end(), new pool_type(blocksize, nblock_p_pool));
-        rv      = (*curpool)->get();
+        mag->n  = (*curpool)->reserve(mag->slots, n);
+        EZASSERT2(mag->n>0, blockpool_error, EZINFO("no free block in freshly allocated pool?!"));
+    }
+    nRefill++;
+}
+
+// Move up to n blocks from other magazines into (empty) 'mag'. Must be
+// called with the blockpool's mutex held. Magazines whose owner is busy
+// with them are skipped: the owner may be waiting for our mutex
+unsigned int blockpool_type::steal(magazine_type* mag, unsigned int n) {
+    unsigned int  got = 0;
+
+    for(magazine_list::iterator m=magazines.begin(); got<n && m!=magazines.end(); m++) {
+        if( *m==mag || ::pthread_mutex_trylock(&(*m)->mutex)!=0 )
+            continue;
+        while( got<n && (*m)->n>0 )
+            mag->slots[got++] = (*m)->slots[--(*m)->n];
+        PTHREAD_CALL( ::pthread_mutex_unlock(&(*m)->mutex) );
     }
+    return got;
+}
+
+// Give the magazine's blocks back and forget about it
+void blockpool_type::release(magazine_type* mag) {
+    mutex_locker  locker( mutex );
+
+    magazines.remove( mag );
+    PTHREAD_CALL( ::pthread_mutex_lock(&mag->mutex) );
+    mag->unreserve();
+    nGetReleased += mag->nGet;
+    nHitReleased += mag->nHit;
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mag->mutex) );
+    delete mag;
+}
+
+void blockpool_type::release_magazine(uint64_t s, magazine_type* mag) {
+    mutex_locker             locker( registry_lock );
+    registry_type::iterator  p = registry.find( s );
+
+    // if the blockpool is gone, it took its magazines with it
+    if( p!=registry.end() )
+        p->second->release( mag );
+}
+
+blockpool_type::stats_type blockpool_type::get_stats( void ) const {
+    stats_type    rv;
+    mutex_locker  locker( mutex );
+
+    rv.nGet = nGetReleased;
+    rv.nHit = nHitReleased;
+    for(magazine_list::const_iterator m=magazines.begin(); m!=magazines.end(); m++) {
+        rv.nGet += (*m)->nGet;
+        rv.nHit += (*m)->nHit;
+    }
+    rv.nRefill = nRefill;
+    rv.nPool   = (unsigned int)pools.size();
     return rv;
 }
 
 void blockpool_type::show_usecnt( void ) const {
+    const stats_type  st = get_stats();
+
+    cout << "blockpool_type[" << (void const*)this << " (" << blocksize << ")]/ "
+         << st.nGet << " get, " << st.nHit << " from magazine, " << st.nRefill << " refill, "
+         << st.nPool << " pool" << endl;
     for(const_pool_pointer_pointer p=pools.begin(); p!=pools.end(); p++)
         (*p)->show_usecnt();
 }
 
 blockpool_type::~blockpool_type() {
+    // From now on threads that exit leave our magazines alone
+    {
+        mutex_locker  locker( registry_lock );
+        registry.erase( serial );
+    }
+
+    const stats_type  st = get_stats();
+
+    DEBUG(4, "blockpool_type[" << blocksize << "]: " << st.nGet << " get, " << st.nHit << " from magazine, "
+             << st.nRefill << " refill, " << st.nPool << " pool" << endl);
+    // Blocks still in the magazines were never handed out
+    for(magazine_list::iterator m=magazines.begin(); m!=magazines.end(); m++) {
+        (*m)->unreserve();
+        delete (*m);
+    }
     for(pool_pointer_pointer p=pools.begin(); p!=pools.end(); p++)
         delete (*p);
+    ::pthread_mutex_destroy(&mutex);
 }
@@ -21,12 +21,20 @@
 #define JIVE5A_BLOCKPOOL_H
 #include <list>
 #include <block.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <ezexcept.h>
 
 DECLARE_EZEXCEPT(pool_error)
 DECLARE_EZEXCEPT(blockpool_error)
 
 
+// a reserved but not yet handed out block in a pool
+struct blockslot_type {
+    refcount_type*  use_cnt;
+    unsigned char*  memory;
+};
+
 // a single pool consists of both memory
 // and an array of counters
 struct pool_type {
@@ -42,8 +50,14 @@ struct pool_type {
         // return empty/default block if none available here
         block get( void );
 
+        // reserve up to n free blocks, returns how many. The blocks are
+        // marked in use; turn them into a block using make_block()
+        unsigned int reserve(blockslot_type* slots, unsigned int n);
+
         void show_usecnt( void ) const;
 
+        static block make_block(const blockslot_type& slot, unsigned int bs);
+
         ~pool_type();
 
     private:
@@ -65,8 +79,25 @@ struct pool_type {
 //
 // It starts with one pool and adds more
 // as necessary
+//
+// Each thread calling get() has its own magazine of blocks that were
+// reserved in the pools in one sweep; get() hands them out under the
+// magazine's own, practically uncontended, mutex and only when the
+// magazine is empty the pools are searched (under the pool lock) for
+// free blocks.
 struct blockpool_type {
     public:
+        struct stats_type {
+            uint64_t      nGet;      // blocks handed out
+            uint64_t      nHit;      // of which straight from a magazine
+            uint64_t      nRefill;   // magazine refills
+            unsigned int  nPool;     // pools allocated
+
+            stats_type();
+        };
+        // per thread reserved blocks
+        struct magazine_type;
+
         // create a poolmanager which will create more pools when
         // they seem to run out of reusable block
         // The pools that are created do their allocation
@@ -76,6 +107,13 @@ struct blockpool_type {
         // get  a fresh block
         block get( void );
 
+        stats_type get_stats( void ) const;
+
+        // Give the blocks in 'mag' back to the blockpool with serial
+        // number 'serial' - if it still exists - and delete 'mag'.
+        // Used when a thread exits or no longer keeps track of 'mag'
+        static void release_magazine(uint64_t serial, magazine_type* mag);
+
         void show_usecnt( void ) const;
 
         ~blockpool_type();
@@ -84,12 +122,32 @@ struct blockpool_type {
         typedef std::list<pool_type*>     pool_list;
         typedef pool_list::iterator       pool_pointer_pointer;
         typedef pool_list::const_iterator const_pool_pointer_pointer;
+        typedef std::list<magazine_type*> magazine_list;
 
         // the pool's properties
         pool_list             pools;
         const unsigned int    blocksize;
         const unsigned int    nblock_p_pool;
         pool_pointer_pointer  curpool;
+
+        // the magazines that were handed out to threads
+        uint64_t                 serial;
+        const unsigned int       magsize;
+        magazine_list            magazines;
+        uint64_t                 nRefill;
+        // counts of magazines that were released
+        uint64_t                 nGetReleased;
+        uint64_t                 nHitReleased;
+        mutable pthread_mutex_t  mutex;
+
+        magazine_type* this_threads_magazine( void );
+        void           refill(magazine_type* mag);
+        unsigned int   steal(magazine_type* mag, unsigned int n);
+        void           release(magazine_type* mag);
+
+        // do not support copy/assignment
+        blockpool_type(const blockpool_type&);
+        const blockpool_type& operator=(const blockpool_type&);
 };
 
 #endif
@@ -21,6 +21,7 @@
 #define EVLBI5A_QUEUE_H
 
 #include <queue>
+#include <vector>
 #include <iostream>
 #include <time.h>
 #include <errno.h>
@@ -231,7 +232,7 @@ class bqueue {
         //   If there is no room, will return push_overflow.
         //   Otherwise, the element is put onto the queueu
         //   and push_success is returned.
-        bool try_push( const Element& b ) {
+        push_result_type try_push( const Element& b ) {
             push_result_type ret;
             // first things first ...
             FASTPTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
@@ -257,6 +258,45 @@ class bqueue {
             return ret;
         }
 
+        // push_n(): push all elements of 'v' in order, as push() would
+        //           do for each of them, but taking the mutex and
+        //           signalling the poppers only once for as many
+        //           elements as there is room for.
+        //           Returns false if the queue was disabled before all
+        //           elements were pushed.
+        bool push_n( const std::vector<Element>& v ) {
+            bool                                      did_push = true;
+            typename std::vector<Element>::const_iterator  cur = v.begin();
+
+            FASTPTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+            nPush++;
+
+            while( cur!=v.end() ) {
+                // wait until we can push at least one OR the queue is disabled
+                while( enable_push && queue.size()>=capacity )
+                    FASTPTHREAD_CALL( ::pthread_cond_wait(&condition_push, &mutex) );
+
+                if( (did_push=enable_push)==false )
+                    break;
+                // push as many as will fit
+                unsigned int  n = 0;
+                for( ; cur!=v.end() && queue.size()<capacity; cur++, n++)
+                    queue.push( *cur );
+                // Now there may be more than one element for the poppers
+                if( nPop ) {
+                    if( n>1 ) {
+                        FASTPTHREAD_CALL( ::pthread_cond_broadcast(&condition_pop) );
+                    } else {
+                        FASTPTHREAD_CALL( ::pthread_cond_signal(&condition_pop) );
+                    }
+                }
+            }
+            nPush--;
+            FASTPTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+
+            return did_push;
+        }
+
         // pop(): Wait indefinitely for something to be present
         //        in the queue or a queue-cancellation.
         //        If the queue already was disabled or there is already
@@ -315,6 +355,47 @@ class bqueue {
             return did_pop;
         }
 
+        // pop_n(): as pop() but moves up to 'n' elements, whatever is
+        //          available after the wait, into 'v' (which is cleared
+        //          first) in one go.
+        //          Returns false, with 'v' empty, if the queue was disabled.
+        bool pop_n( std::vector<Element>& v, capacity_type n ) {
+            bool did_pop;
+
+            v.clear();
+            FASTPTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+
+            nPop++;
+
+            while( enable_pop && queue.empty() )
+                FASTPTHREAD_CALL( ::pthread_cond_wait(&condition_pop, &mutex) );
+
+            if( (did_pop=enable_pop)==true ) {
+                for( ; n && !queue.empty(); n--) {
+                    v.push_back( queue.front() );
+                    queue.pop();
+                }
+            }
+            // delayed disable, see pop()
+            if( !enable_push && queue.empty() )
+                enable_pop = false;
+
+            nPop--;
+
+            // We may have made room for more than one pusher
+            if( nPush && did_pop ) {
+                if( v.size()>1 ) {
+                    FASTPTHREAD_CALL( ::pthread_cond_broadcast(&condition_push) );
+                } else {
+                    FASTPTHREAD_CALL( ::pthread_cond_signal(&condition_push) );
+                }
+            }
+            if( nPop && !enable_pop )
+                FASTPTHREAD_CALL( ::pthread_cond_broadcast(&condition_pop) );
+            FASTPTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+            return did_pop;
+        }
+
         // pop(): Wait until specified time for something to be present
         //        in the queue or a queue-cancellation.
         //        If the queue already was disabled or there is already
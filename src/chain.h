@@ -248,6 +248,11 @@ struct inq_type {
         return qptr->pop(e, absolute_time);
     }
 
+    // pops whatever is available, at most 'n' elements
+    bool pop_n(std::vector<Element>& v, unsigned int n) {
+        return qptr->pop_n(v, n);
+    }
+
 //    private:
         inq_type(bqueue<Element>* q): qptr(q) {}
 
@@ -263,6 +268,16 @@ struct outq_type {
         return qptr->push(e);
     }
 
+    // never blocks; push_overflow if the queue is full
+    push_result_type try_push(const Element& e) {
+        return qptr->try_push(e);
+    }
+
+    // pushes all of 'v', in order
+    bool push_n(const std::vector<Element>& v) {
+        return qptr->push_n(v);
+    }
+
     //private:
         outq_type(bqueue<Element>* q): qptr(q) {}
 
@@ -0,0 +1,245 @@
+// implementation of the command worker pool
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <cmdpool.h>
+#include <mk5_exception.h>
+#include <stringutil.h>
+#include <carrayutil.h>
+#include <pthreadcall.h>
+#include <dosyscall.h>
+#include <evlbidebug.h>
+#include <threadutil.h>
+
+#include <algorithm>
+#include <exception>
+
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+#define QRY(q)  ((q?"?":"="))
+
+DEFINE_EZEXCEPT(cmdpoolexception)
+
+
+bool parse_command(const string& cmd, bool& qry, vector<string>& args, string& reply) {
+    string::size_type  posn;
+
+    if( cmd.empty() )
+        return false;
+
+    // find out if it was a query or not
+    if( (posn=cmd.find_first_of("?="))==string::npos ) {
+        reply += ("!syntax = 7 : Not a command or query;");
+        return false;
+    }
+    const string  keyword( ::tolower(cmd.substr(0, posn)) );
+
+    if( keyword.empty() ) {
+        reply += "!syntax = 7 : No keyword given ;";
+        return false;
+    }
+    qry  = (cmd[posn]=='?');
+
+    // now get the arguments, if any
+    // (split everything after '?' or '=' at ':'s and each
+    // element is an argument)
+    args = ::split(cmd.substr(posn+1), ':');
+    // stick the keyword in at the first position
+    args.insert(args.begin(), keyword);
+    return true;
+}
+
+string exception_reply(const string& keyword, bool qry) {
+    try {
+        throw;
+    }
+    catch( const Error_Code_6_Exception& e) {
+        return string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
+    }
+    catch( const Error_Code_8_Exception& e) {
+        return string("!")+keyword+" " + QRY(qry) + " 8 : " + e.what() + ";";
+    }
+    catch( const cmdexception& e ) {
+        return string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
+    }
+    catch( const exception& e ) {
+        return string("!")+keyword+" " + QRY(qry) + " 4 : " + e.what() + ";";
+    }
+    catch( ... ) {
+        return string("!")+keyword+" " + QRY(qry) + " 4 : unknown exception ;";
+    }
+}
+
+string execute_command(const mk5commandmap_type& mk5cmds, bool qry, vector<string>& args, runtime& rte) {
+    string                             reply;
+    const string                       keyword( args[0] );
+    mk5commandmap_type::const_iterator cmdptr = mk5cmds.find( keyword );
+
+    if( cmdptr==mk5cmds.end() )
+        return string("!")+keyword+((qry)?('?'):('='))+" 7 : ENOSYS - not implemented ;";
+
+    try {
+        reply = cmdptr->second(qry, args, rte);
+    }
+    catch( ... ) {
+        reply = exception_reply(keyword, qry);
+    }
+    // do the protect=off bookkeeping. Under the lock because a fast
+    // query may execute whilst a worker is busy on the same runtime
+    RTEEXEC(rte, rte.protected_count = max(rte.protected_count, 1u) - 1);
+    return reply;
+}
+
+bool is_slow_command(const string& keyword) {
+    static const string  slow_commands[] = {
+        "scan_check", "file_check", "data_check", "track_check",
+        "scan_set", "dir_info", "set_disks", "mount", "unmount",
+        "bank_set", "fill_report"
+    };
+    return find_element(keyword, slow_commands);
+}
+
+bool is_busy_query(const string& keyword) {
+    static const string  busy_queries[] = {
+        "evlbi"
+    };
+    return find_element(keyword, busy_queries);
+}
+
+
+cmdjob_type::cmdjob_type(int f, bool c, bool e, const commands_type& cmds):
+    fd( f ), crlf( c ), echo( e ), commands( cmds ), next( 0 ),
+    rteptr( 0 ), mk5cmds( 0 )
+{}
+
+
+cmdpool_type::cmdpool_type(unsigned int nthread) {
+    donepipe[0] = donepipe[1] = -1;
+
+    if( nthread==0 )
+        return;
+
+    // At any one time there is at most one job per runtime in the queue
+    // but we don't want the main thread to block on push() so allow for
+    // plenty
+    todo.resize_enable( 1024 );
+
+    ASSERT_ZERO( ::pipe(donepipe) );
+    // Once we know the pipe is there, make sure it don't leak to children
+    for(unsigned int i=0; i<2; i++)
+        ASSERT_COND( ::fcntl(donepipe[i], F_SETFD, FD_CLOEXEC)!=-1 );
+
+    for(unsigned int i=0; i<nthread; i++) {
+        pthread_t  tid;
+
+        PTHREAD2_CALL( ::pthread_create(&tid, 0, &cmdpool_type::worker, (void*)this),
+                       this->cleanup(); );
+        threads.push_back( tid );
+    }
+    DEBUG(2, "cmdpool: started " << threads.size() << " command execution threads" << endl);
+}
+
+bool cmdpool_type::enabled( void ) const {
+    return !threads.empty();
+}
+
+int cmdpool_type::donefd( void ) const {
+    return donepipe[0];
+}
+
+void cmdpool_type::submit(cmdjob_type* job) {
+    EZASSERT2(this->enabled() && job->rteptr && job->mk5cmds, cmdpoolexception,
+              EZINFO("submitting job for fd#" << job->fd << " to disabled pool or runtime not set"));
+    EZASSERT2(todo.push(job), cmdpoolexception, EZINFO("failed to queue job for fd#" << job->fd));
+}
+
+cmdjob_type* cmdpool_type::completed( void ) {
+    cmdjob_type*  job;
+
+    // Writes of less than PIPE_BUF bytes are atomic so we always read
+    // complete pointers
+    ASSERT_COND( ::read(donepipe[0], &job, sizeof(job))==sizeof(job) );
+    return job;
+}
+
+cmdpool_type::~cmdpool_type() {
+    this->cleanup();
+}
+
+void cmdpool_type::cleanup( void ) {
+    // Jobs still queued are dropped, the ones being executed
+    // are allowed to finish
+    todo.disable();
+    for(threads_type::iterator tidptr=threads.begin(); tidptr!=threads.end(); tidptr++)
+        ::pthread_join(*tidptr, 0);
+    threads.clear();
+
+    // Any jobs that were completed but not yet collected?
+    if( donepipe[0]!=-1 ) {
+        int           flags = ::fcntl(donepipe[0], F_GETFL);
+        cmdjob_type*  job;
+
+        if( flags!=-1 && ::fcntl(donepipe[0], F_SETFL, flags|O_NONBLOCK)!=-1 )
+            while( ::read(donepipe[0], &job, sizeof(job))==sizeof(job) )
+                delete job;
+    }
+    for(unsigned int i=0; i<2; i++)
+        if( donepipe[i]!=-1 )
+            ::close( donepipe[i] );
+    donepipe[0] = donepipe[1] = -1;
+}
+
+void* cmdpool_type::worker(void* self) {
+    cmdpool_type*  pool = (cmdpool_type*)self;
+    cmdjob_type*   job;
+
+    // The main thread has made sure that no-one else is executing commands
+    // on this job's runtime, apart from fast queries
+    while( pool->todo.pop(job) ) {
+        // the first command was already announced by the main thread
+        const cmdjob_type::commands_type::size_type  first = job->next;
+
+        for( ; job->next<job->commands.size(); job->next++ ) {
+            bool            qry;
+            vector<string>  args;
+            const string&   cmd( job->commands[job->next] );
+
+            if( cmd.empty() )
+                continue;
+            // These alter the main thread's administration so must be
+            // done over there. Leave 'next' pointing at it.
+            if( ::parse_command(cmd, qry, args, job->reply) && (args[0]=="runtime" || args[0]=="echo") )
+                break;
+            if( job->next!=first )
+                DEBUG((job->echo?2:10000), "Processing command '" << cmd << "'" << endl);
+            if( args.empty() )
+                continue;
+            job->reply += ::execute_command(*job->mk5cmds, qry, args, *job->rteptr);
+        }
+        if( ::write(pool->donepipe[1], &job, sizeof(job))!=sizeof(job) ) {
+            // Don't delete the job; the main thread still holds references to it
+            DEBUG(-1, "cmdpool: failed to return job for fd#" << job->fd << " - " << evlbi5a::strerror(errno) << endl);
+        }
+    }
+    return (void*)0;
+}
@@ -0,0 +1,126 @@
+// execute control-connection commands on a pool of worker threads
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_CMDPOOL_H
+#define JIVE5A_CMDPOOL_H
+
+#include <mk5command.h>
+#include <runtime.h>
+#include <bqueue.h>
+#include <ezexcept.h>
+
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+DECLARE_EZEXCEPT(cmdpoolexception)
+
+// Split the VSI/S command "keyword[?=]arg1:arg2:..." into
+// query-or-command and arguments; args[0] will be the (lowercased)
+// keyword. Returns false if 'cmd' was empty or syntactically wrong; in
+// the latter case the error is appended to 'reply'
+bool parse_command(const std::string& cmd, bool& qry,
+                   std::vector<std::string>& args, std::string& reply);
+
+// Look up args[0] in 'mk5cmds' and execute it on 'rte'. Always returns
+// a formatted reply; exceptions are translated into VSI/S error codes.
+// Also does the protect=off bookkeeping.
+std::string execute_command(const mk5commandmap_type& mk5cmds, bool qry,
+                            std::vector<std::string>& args, runtime& rte);
+
+// Only to be called from inside a catch(...) block: rethrows the
+// exception being handled and translates it into a VSI/S error reply
+std::string exception_reply(const std::string& keyword, bool qry);
+
+// Commands that may take seconds or longer to complete, e.g. because they
+// go through (large) recordings or mount disks. These are the ones that
+// get executed by the pool in stead of by the main thread.
+bool is_slow_command(const std::string& keyword);
+
+// Queries that may be executed by the main thread whilst a slow command
+// is executing on the same runtime. "evlbi?" only reads the statistics
+// whilst holding the runtime's lock; all other commands and queries are
+// queued behind the slow one, e.g. "set_disks=" replaces the mountpoints
+// that "rtime?" would be iterating over and "status?" reads the transfer
+// mode and asks the StreamStor for the bank status that "bank_set=" may
+// be changing.
+// Note that slow commands on different runtimes may execute at the same
+// time so any state they share must be locked.
+bool is_busy_query(const std::string& keyword);
+
+
+// All that is needed to (continue to) process one line of commands
+// received over a control connection. 'next' is the index of the first
+// command not yet executed; all the replies so far are gathered in 'reply'.
+// The dispatcher fills in the runtime related fields before handing the
+// job to the pool.
+struct cmdjob_type {
+    typedef std::vector<std::string>  commands_type;
+
+    int                       fd;
+    bool                      crlf;
+    bool                      echo;
+    std::string               reply;
+    commands_type             commands;
+    commands_type::size_type  next;
+
+    std::string               rtname;
+    runtime*                  rteptr;
+    const mk5commandmap_type* mk5cmds;
+
+    cmdjob_type(int f, bool c, bool e, const commands_type& cmds);
+};
+
+
+// A number of threads executing cmdjob_type's. A worker executes the
+// commands of a job until all are done or it finds one that the main
+// thread must handle itself ("runtime", "echo"). It then writes the
+// address of the job into a pipe: the main loop should poll donefd() and
+// pick up the job using completed().
+// With zero threads the pool is disabled; donefd() returns -1.
+class cmdpool_type {
+    public:
+        cmdpool_type(unsigned int nthread);
+
+        bool          enabled( void ) const;
+        int           donefd( void ) const;
+
+        void          submit(cmdjob_type* job);
+        cmdjob_type*  completed( void );
+
+        // waits for the workers to finish their current job
+        ~cmdpool_type();
+
+    private:
+        typedef std::vector<pthread_t>  threads_type;
+
+        int                   donepipe[2];
+        threads_type          threads;
+        bqueue<cmdjob_type*>  todo;
+
+        void         cleanup( void );
+        static void* worker(void* self);
+
+        // no copy or assignment
+        cmdpool_type(cmdpool_type const&);
+        cmdpool_type const& operator=(cmdpool_type const&);
+};
+
+#endif
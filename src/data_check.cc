@@ -15,6 +15,7 @@
 #include <vector>
 #include <algorithm>
 #include <cstdlib> // for abs
+#include <cstring> // for memcmp
 #include <cmath>
 #include <set>
 #include <time.h>
@@ -85,11 +86,30 @@ std::ostream& operator<<( std::ostream& os, data_check_type const& d ) {
                          << "b #" << d.frame_number;
 }
 
-// assumes data has the proper encoding (nrz-m or not)
-bool check_data_format(const unsigned char* data, size_t len, unsigned int track,
+// check_data_format() looks for frames of one specific format. It gets at
+// the data through one of these: it must be able to locate the format's
+// syncword and hand out the (if necessary NRZ-M decoded) header bytes
+struct frame_source_type {
+    // amount of bytes available
+    virtual size_t len( void ) const = 0;
+    // offset of the first syncword at or after 'from' that lies
+    // completely within the data; false if there is none
+    virtual bool find_syncword(size_t from, size_t& pos) = 0;
+    // 'n' bytes of data starting at 'offset'. Only valid until the next
+    // call.
+    virtual const unsigned char* bytes(size_t offset, size_t n) = 0;
+
+    virtual ~frame_source_type() {}
+};
+
+bool check_data_format(frame_source_type& src, unsigned int track,
                        const headersearch_type& format, bool strict, bool verbose,
                        data_check_type& data_type);
 
+static bool is_straight_through(format_type fmt) {
+    return (fmt==fmt_mark4_st || fmt==fmt_vlba_st);
+}
+
 countedpointer< vector<uint32_t> > generate_nrzm(const unsigned char* data, size_t len) {
     countedpointer< vector<uint32_t> > nrzm_data (new vector<uint32_t>(len / sizeof(uint32_t)));
     uint32_t const*              data_pointer = (uint32_t const*)data;
@@ -102,6 +122,202 @@ countedpointer< vector<uint32_t> > generate_nrzm(const unsigned char* data, size
     return nrzm_data;
 }
 
+// The data is in memory and already has the proper encoding (nrz-m or
+// not); search for the syncword using Boyer-Moore
+struct memory_source_type:
+    public frame_source_type
+{
+    memory_source_type(const unsigned char* d, size_t l, const headersearch_type& format):
+        data( d ), length( l ), syncwordsearch( format.syncword, format.syncwordsize )
+    {}
+
+    virtual size_t len( void ) const {
+        return length;
+    }
+    virtual bool find_syncword(size_t from, size_t& pos) {
+        const unsigned char* sw = syncwordsearch(data + from, (unsigned int)(length - from));
+        if( sw )
+            pos = (size_t)(sw - data);
+        return sw!=0;
+    }
+    virtual const unsigned char* bytes(size_t offset, size_t) {
+        return data + offset;
+    }
+
+    const unsigned char* const  data;
+    const size_t                length;
+    boyer_moore                 syncwordsearch;
+};
+
+// find_data_format() tries a few dozen formats on the same data. Rather
+// than searching the data for each format's syncword over and over again
+// (after NRZ-M decoding all of it for the straight-through formats)
+// the syncword candidates are collected in one pass over the data:
+//   * the mark4/vlba syncwords are (ntrack x 4) bytes of 0xff so keep the
+//     runs of 0xff bytes, one such list for the raw and one for the NRZ-M
+//     decoded data
+//   * the Mark5B syncword 0xABADDEED is only four bytes so keep its
+//     positions
+// Only the headers of straight-through candidates get NRZ-M decoded, and
+// only when they are looked at.
+class syncword_index_type {
+    public:
+        syncword_index_type(const unsigned char* d, size_t l):
+            data( d ), length( l ), nrzm_length( l - l%sizeof(uint32_t) )
+        {
+            size_t  ffstart = 0, nrzmstart = 0;
+
+            for(size_t i=0; i<length; i++) {
+                if( data[i]!=0xff ) {
+                    if( i-ffstart>=min_run )
+                        ff_runs.push_back( run_type(ffstart, i) );
+                    ffstart = i + 1;
+                }
+                if( data[i]==mark5b_syncword[0] && i+sizeof(mark5b_syncword)<=length &&
+                    ::memcmp(data+i, mark5b_syncword, sizeof(mark5b_syncword))==0 )
+                    m5b_sync.push_back( i );
+                if( i<nrzm_length && nrzm(i)!=0xff ) {
+                    if( i-nrzmstart>=min_run )
+                        ff_runs_nrzm.push_back( run_type(nrzmstart, i) );
+                    nrzmstart = i + 1;
+                }
+            }
+            if( length-ffstart>=min_run )
+                ff_runs.push_back( run_type(ffstart, length) );
+            if( nrzm_length>nrzmstart && nrzm_length-nrzmstart>=min_run )
+                ff_runs_nrzm.push_back( run_type(nrzmstart, nrzm_length) );
+        }
+
+        size_t len(bool st) const {
+            return (st ? nrzm_length : length);
+        }
+
+        // Quick test if the syncword of a format could be present at all
+        bool may_contain(format_type fmt, unsigned int ntrack) const {
+            if( fmt==fmt_mark5b )
+                return !m5b_sync.empty();
+            if( is_straight_through(fmt) )
+                return longest(ff_runs_nrzm)>=min_run;
+            if( fmt==fmt_mark4 || fmt==fmt_vlba )
+                return longest(ff_runs)>=4*ntrack;
+            return true;
+        }
+
+        // Equivalent to Boyer-Moore searching for the syncword of 'format'
+        // in [from, len(st))
+        bool find_syncword(const headersearch_type& format, size_t from, size_t& pos) {
+            const bool                 st  = is_straight_through(format.frameformat);
+            const size_t               n   = format.syncwordsize;
+            const size_t               end = len(st);
+            const unsigned char* const sw  = format.syncword;
+            size_t                     nff = 0;
+
+            while( nff<n && sw[nff]==0xff )
+                nff++;
+
+            if( nff==0 ) {
+                EZASSERT2(st==false && n==sizeof(mark5b_syncword) && ::memcmp(sw, mark5b_syncword, n)==0,
+                          data_check_except, EZINFO("no syncword index for format " << format));
+                vector<size_t>::const_iterator  p = std::lower_bound(m5b_sync.begin(), m5b_sync.end(), from);
+
+                if( p==m5b_sync.end() )
+                    return false;
+                pos = *p;
+                return true;
+            }
+            EZASSERT2(nff>=min_run, data_check_except, EZINFO("syncword of " << format << " too short for index"));
+
+            const runlist_type&  runs( st ? ff_runs_nrzm : ff_runs );
+
+            for(runlist_type::const_iterator r=runs.begin(); r!=runs.end(); r++) {
+                if( r->second-r->first<nff || r->second<from+nff )
+                    continue;
+                if( nff==n ) {
+                    // all 0xff: the first position in the run will do
+                    // (and later runs would only be further away)
+                    pos = std::max(r->first, from);
+                    return pos+n<=end;
+                }
+                // the syncword continues with a non-0xff byte so it
+                // can only start nff bytes before the end of the run
+                const size_t  p = r->second - nff;
+
+                if( p<from )
+                    continue;
+                if( p+n>end )
+                    return false;
+                const unsigned char*  rest = bytes(st, p+nff, n-nff);
+                if( ::memcmp(rest, sw+nff, n-nff)==0 ) {
+                    pos = p;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        const unsigned char* bytes(bool st, size_t offset, size_t n) {
+            if( !st )
+                return data + offset;
+            scratch.resize( n );
+            for(size_t i=0; i<n; i++)
+                scratch[i] = nrzm(offset + i);
+            return &scratch[0];
+        }
+
+    private:
+        typedef std::pair<size_t, size_t>  run_type; // [start, end)
+        typedef std::vector<run_type>      runlist_type;
+
+        // shortest syncword made of 0xff's is 8 tracks' worth
+        static const size_t          min_run = 8 * 4;
+        static const unsigned char   mark5b_syncword[4];
+
+        const unsigned char* const  data;
+        const size_t                length;
+        // the NRZ-M decoded data only covers whole 32-bit words
+        const size_t                nrzm_length;
+        runlist_type                ff_runs;
+        runlist_type                ff_runs_nrzm;
+        vector<size_t>              m5b_sync;
+        vector<unsigned char>       scratch;
+
+        static size_t longest(const runlist_type& runs) {
+            size_t  rv = 0;
+            for(runlist_type::const_iterator r=runs.begin(); r!=runs.end(); r++)
+                rv = std::max(rv, r->second - r->first);
+            return rv;
+        }
+
+        // Byte i of the NRZ-M decoded data (see generate_nrzm())
+        unsigned char nrzm(size_t i) const {
+            return (i<sizeof(uint32_t)) ? data[i] : (unsigned char)(data[i] ^ data[i-sizeof(uint32_t)]);
+        }
+};
+// 0xABADDEED, little endian
+const unsigned char syncword_index_type::mark5b_syncword[4] = {0xed, 0xde, 0xad, 0xab};
+
+struct indexed_source_type:
+    public frame_source_type
+{
+    indexed_source_type(syncword_index_type& idx, const headersearch_type& fmt):
+        index( idx ), format( fmt ), st( is_straight_through(fmt.frameformat) )
+    {}
+
+    virtual size_t len( void ) const {
+        return index.len(st);
+    }
+    virtual bool find_syncword(size_t from, size_t& pos) {
+        return index.find_syncword(format, from, pos);
+    }
+    virtual const unsigned char* bytes(size_t offset, size_t n) {
+        return index.bytes(st, offset, n);
+    }
+
+    syncword_index_type&      index;
+    const headersearch_type&  format;
+    const bool                st;
+};
+
 struct tvg_pattern_type {
     tvg_pattern_type() {
         uint32_t current_pattern = 0xbfff4000;
@@ -138,6 +354,16 @@ struct tvg_pattern_type {
         }
 };
 
+// The formats find_data_format() tries, in this order. Only a
+// headersearch_type is created for the ones whose syncword might be in the
+// data; the headersearch_type keeps decoder state so it can't be shared
+// between calls.
+struct candidate_type {
+    format_type   format;
+    unsigned int  ntrack;
+    unsigned int  trackbitrate;
+};
+
 // search data, of size len, for a number of data formats if any is found,
 // return true and fill format, trackbitrate and ntrack with the parameters
 // describing the found format, fill byte_offset with byte position of the
@@ -153,81 +379,76 @@ struct tvg_pattern_type {
 // 3) the number of VDIF threads reported will only make sense if all VDIF threads are of the same "shape", otherwise it will be 0
 
 bool find_data_format(const unsigned char* data, size_t len, unsigned int track, bool strict, bool verbose, data_check_type& result) {
-    const headersearch_type formats[] = {
-        headersearch_type(fmt_mark4, 8, 2000000, 0),
-        headersearch_type(fmt_mark4, 8, 4000000, 0),
-        headersearch_type(fmt_mark4, 8, 8000000, 0),
-        headersearch_type(fmt_mark4, 8, 16000000, 0),
-        headersearch_type(fmt_mark4, 16, 2000000, 0),
-        headersearch_type(fmt_mark4, 16, 4000000, 0),
-        headersearch_type(fmt_mark4, 16, 8000000, 0),
-        headersearch_type(fmt_mark4, 16, 16000000, 0),
-        headersearch_type(fmt_mark4, 32, 2000000, 0),
-        headersearch_type(fmt_mark4, 32, 4000000, 0),
-        headersearch_type(fmt_mark4, 32, 8000000, 0),
-        headersearch_type(fmt_mark4, 32, 16000000, 0),
-        headersearch_type(fmt_mark4, 64, 2000000, 0),
-        headersearch_type(fmt_mark4, 64, 4000000, 0),
-        headersearch_type(fmt_mark4, 64, 8000000, 0),
-        headersearch_type(fmt_mark4, 64, 16000000, 0),
-
-        headersearch_type(fmt_mark4_st, 32, 2000000, 0),
-        headersearch_type(fmt_mark4_st, 32, 4000000, 0),
-        headersearch_type(fmt_mark4_st, 32, 8000000, 0),
-        headersearch_type(fmt_mark4_st, 32, 16000000, 0),
-
-        headersearch_type(fmt_vlba, 8, 2000000, 0),
-        headersearch_type(fmt_vlba, 8, 4000000, 0),
-        headersearch_type(fmt_vlba, 8, 8000000, 0),
-        headersearch_type(fmt_vlba, 16, 2000000, 0),
-        headersearch_type(fmt_vlba, 16, 4000000, 0),
-        headersearch_type(fmt_vlba, 16, 8000000, 0),
-        headersearch_type(fmt_vlba, 32, 2000000, 0),
-        headersearch_type(fmt_vlba, 32, 4000000, 0),
-        headersearch_type(fmt_vlba, 32, 8000000, 0),
-        headersearch_type(fmt_vlba, 64, 2000000, 0),
-        headersearch_type(fmt_vlba, 64, 4000000, 0),
-        headersearch_type(fmt_vlba, 64, 8000000, 0),
-
-        headersearch_type(fmt_vlba_st, 32, 2000000, 0),
-        headersearch_type(fmt_vlba_st, 32, 4000000, 0),
-        headersearch_type(fmt_vlba_st, 32, 8000000, 0),
+    static const candidate_type formats[] = {
+        {fmt_mark4, 8, 2000000},
+        {fmt_mark4, 8, 4000000},
+        {fmt_mark4, 8, 8000000},
+        {fmt_mark4, 8, 16000000},
+        {fmt_mark4, 16, 2000000},
+        {fmt_mark4, 16, 4000000},
+        {fmt_mark4, 16, 8000000},
+        {fmt_mark4, 16, 16000000},
+        {fmt_mark4, 32, 2000000},
+        {fmt_mark4, 32, 4000000},
+        {fmt_mark4, 32, 8000000},
+        {fmt_mark4, 32, 16000000},
+        {fmt_mark4, 64, 2000000},
+        {fmt_mark4, 64, 4000000},
+        {fmt_mark4, 64, 8000000},
+        {fmt_mark4, 64, 16000000},
+
+        {fmt_mark4_st, 32, 2000000},
+        {fmt_mark4_st, 32, 4000000},
+        {fmt_mark4_st, 32, 8000000},
+        {fmt_mark4_st, 32, 16000000},
+
+        {fmt_vlba, 8, 2000000},
+        {fmt_vlba, 8, 4000000},
+        {fmt_vlba, 8, 8000000},
+        {fmt_vlba, 16, 2000000},
+        {fmt_vlba, 16, 4000000},
+        {fmt_vlba, 16, 8000000},
+        {fmt_vlba, 32, 2000000},
+        {fmt_vlba, 32, 4000000},
+        {fmt_vlba, 32, 8000000},
+        {fmt_vlba, 64, 2000000},
+        {fmt_vlba, 64, 4000000},
+        {fmt_vlba, 64, 8000000},
+
+        {fmt_vlba_st, 32, 2000000},
+        {fmt_vlba_st, 32, 4000000},
+        {fmt_vlba_st, 32, 8000000},
 
         // for mark5b we can't see the difference between more bitstreams and a higher sample rate
         // this will return the highest number of bitstream (ie, the lowest sample rate)
-        headersearch_type(fmt_mark5b, 1, 2000000, 0),
-        headersearch_type(fmt_mark5b, 2, 2000000, 0),
-        headersearch_type(fmt_mark5b, 4, 2000000, 0),
-        headersearch_type(fmt_mark5b, 8, 2000000, 0),
-        headersearch_type(fmt_mark5b, 16, 2000000, 0),
-        headersearch_type(fmt_mark5b, 32, 2000000, 0),
-        headersearch_type(fmt_mark5b, 32, 4000000, 0),
-        headersearch_type(fmt_mark5b, 32, 8000000, 0),
-        headersearch_type(fmt_mark5b, 32, 16000000, 0),
-        headersearch_type(fmt_mark5b, 32, 32000000, 0),
-        headersearch_type(fmt_mark5b, 32, 64000000, 0)
+        {fmt_mark5b, 1, 2000000},
+        {fmt_mark5b, 2, 2000000},
+        {fmt_mark5b, 4, 2000000},
+        {fmt_mark5b, 8, 2000000},
+        {fmt_mark5b, 16, 2000000},
+        {fmt_mark5b, 32, 2000000},
+        {fmt_mark5b, 32, 4000000},
+        {fmt_mark5b, 32, 8000000},
+        {fmt_mark5b, 32, 16000000},
+        {fmt_mark5b, 32, 32000000},
+        {fmt_mark5b, 32, 64000000}
     };
 
-    // straight through data is encoded in NRZ-M, undo that encoding
-    countedpointer< vector<uint32_t> > nrzm_data = generate_nrzm(data,len);
+    // Locate all syncword candidates in one go
+    syncword_index_type  index(data, len);
 
     for (unsigned int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
-        const unsigned char* data_to_use;
-        unsigned int len_of_data;
-        if (formats[i].frameformat == fmt_mark4_st || formats[i].frameformat == fmt_vlba_st) {
-            data_to_use = (const unsigned char*)&(*nrzm_data)[0];
-            len_of_data = nrzm_data->size() * sizeof(uint32_t);
-        }
-        else {
-            data_to_use = data;
-            len_of_data = len;
-        }
+        // Don't bother if the syncword isn't there at all
+        if ( !index.may_contain(formats[i].format, formats[i].ntrack) )
+            continue;
+
+        const headersearch_type  format(formats[i].format, formats[i].ntrack, formats[i].trackbitrate, 0);
+        indexed_source_type      src(index, format);
 
-        if ( check_data_format(data_to_use, len_of_data, track, formats[i], strict, verbose,
-                               result) ) {
-            result.format       = formats[i].frameformat;
-            result.ntrack       = formats[i].ntrack;
-            result.trackbitrate = formats[i].trackbitrate;
+        if ( check_data_format(src, track, format, strict, verbose, result) ) {
+            result.format       = format.frameformat;
+            result.ntrack       = format.ntrack;
+            result.trackbitrate = format.trackbitrate;
 
             return true;
         }
@@ -240,8 +461,10 @@ bool find_data_format(const unsigned char* data, size_t len, unsigned int track,
 
     // Mark5B as generated by RDBE and Fila10G doesn't contain subsecond information
     // try this "format" last
-    if ( check_data_format(data, len, track, headersearch_type(fmt_mark5b, 32, headersearch_type::UNKNOWN_TRACKBITRATE, 0),
-                           strict, verbose, result) ) {
+    const headersearch_type  mark5b_no_subsecond(fmt_mark5b, 32, headersearch_type::UNKNOWN_TRACKBITRATE, 0);
+    indexed_source_type      src(index, mark5b_no_subsecond);
+
+    if ( check_data_format(src, track, mark5b_no_subsecond, strict, verbose, result) ) {
         result.format            = fmt_mark5b;
         result.ntrack            = 32;
         result.trackbitrate      = headersearch_type::UNKNOWN_TRACKBITRATE;
@@ -257,8 +480,9 @@ bool is_data_format(const unsigned char* data, size_t len, unsigned int track, c
     if (format.frameformat == fmt_mark4_st || format.frameformat == fmt_vlba_st) {
         // straight through data is encoded in NRZ-M, undo that encoding
         countedpointer< vector<uint32_t> > nrzm_data = generate_nrzm(data,len);
-        return check_data_format((const unsigned char*)&(*nrzm_data)[0], nrzm_data->size() * sizeof(uint32_t),
-                                 track, format, strict, verbose, data_type);
+        memory_source_type                 src((const unsigned char*)&(*nrzm_data)[0], nrzm_data->size() * sizeof(uint32_t), format);
+
+        return check_data_format(src, track, format, strict, verbose, data_type);
                                  //track, format, strict, data_type.byte_offset, data_type.time, data_type.frame_number);
     }
     else if ( is_vdif(format.frameformat) ) {
@@ -280,7 +504,9 @@ bool is_data_format(const unsigned char* data, size_t len, unsigned int track, c
         }
     }
     else {
-        return check_data_format(data, len, track, format, strict, verbose, data_type);
+        memory_source_type  src(data, len, format);
+
+        return check_data_format(src, track, format, strict, verbose, data_type);
     }
 }
 
@@ -291,10 +517,12 @@ bool might_be_dbe( const mk5b_ts& timestamp ) {
             (timestamp.SS3 == 0));
 }
 
-bool check_data_format(const unsigned char* data, size_t len, unsigned int track, const headersearch_type& format,
+bool check_data_format(frame_source_type& src, unsigned int track, const headersearch_type& format,
                        bool strict, bool verbose, data_check_type& data_type) {
 
-    boyer_moore                syncwordsearch(format.syncword, format.syncwordsize);
+    const size_t               len = src.len();
+    size_t                     sync_word;
+    bool                       found;
     unsigned int               next_position;
     headersearch::strict_type  strict_e;
 
@@ -314,10 +542,10 @@ bool check_data_format(const unsigned char* data, size_t len, unsigned int track
         strict_e |= headersearch::chk_nodebug;
 
     // search for first header
-    const unsigned char* sync_word = syncwordsearch(data, len);
+    found = src.find_syncword(0, sync_word);
 
-    while ( sync_word ) {
-        data_type.byte_offset = (unsigned int)(sync_word - data);
+    while ( found ) {
+        data_type.byte_offset = (unsigned int)sync_word;
         if (data_type.byte_offset < format.syncwordoffset) {
             next_position = data_type.byte_offset + format.syncwordsize;
         }
@@ -327,7 +555,7 @@ bool check_data_format(const unsigned char* data, size_t len, unsigned int track
                 // no full header
                 return false;
             }
-            const unsigned char* start_of_frame = data + data_type.byte_offset;
+            const unsigned char* start_of_frame = src.bytes(data_type.byte_offset, format.headersize);
             if ( format.check(start_of_frame, strict_e, track) ) {
                 try {
                     data_type.time = format.decode_timestamp(start_of_frame, strict_e, track);
@@ -341,18 +569,16 @@ bool check_data_format(const unsigned char* data, size_t len, unsigned int track
         }
         // If there are not enough bytes left to check for a syncword, there
         // can not be a syncword
-        if (next_position + format.syncwordsize < len)
-            sync_word = syncwordsearch(data + next_position, len - next_position);
-        else
-            sync_word = NULL;
+        found = (next_position + format.syncwordsize < len) &&
+                src.find_syncword(next_position, sync_word);
     }
-    if ( !sync_word ) {
+    if ( !found ) {
         return false;
     }
 
     // fill in the frame number
     if ( format.frameformat == fmt_mark5b ) {
-        const m5b_header& header = *(const m5b_header*)( data + data_type.byte_offset );
+        const m5b_header& header = *(const m5b_header*)src.bytes(data_type.byte_offset, format.headersize);
         data_type.frame_number = header.frameno;
         data_type.tvg_flag     = header.tvg;
     }
@@ -385,18 +611,19 @@ bool check_data_format(const unsigned char* data, size_t len, unsigned int track
             // 3 frames should be enough to distinguish between 1 and 2 Gbps
             frame_inc = 3;
         }
-        const mk5b_ts& timestamp = *(const mk5b_ts*)( data + data_type.byte_offset + sizeof(m5b_header) );
+        const mk5b_ts& timestamp = *(const mk5b_ts*)( src.bytes(data_type.byte_offset, format.headersize) + sizeof(m5b_header) );
         data_type.dbe_flag       = might_be_dbe(timestamp);
     }
 
     do {
         unsigned int         next_frame = data_type.byte_offset + format.framesize * frame_inc;
-        const unsigned char* frame_pointer = data + next_frame;
 
         // If header of next frame extends outside buffer ... we're done
         if ( next_frame + format.headersize >= len )
             break;
 
+        const unsigned char* frame_pointer = src.bytes(next_frame, format.headersize);
+
         // Look at frame
         try {
             if ( !strict || format.check(frame_pointer, strict_e, track) ) {
@@ -432,8 +659,8 @@ bool check_data_format(const unsigned char* data, size_t len, unsigned int track
 
                 // handle the possibility of DBE formatted data
                 // (no timestamp filled in)
-                const m5b_header& header = *(const m5b_header*)( data + next_frame );
-                const mk5b_ts&    timestamp = *(const mk5b_ts*)( data + next_frame + sizeof(m5b_header) );
+                const m5b_header& header = *(const m5b_header*)( frame_pointer );
+                const mk5b_ts&    timestamp = *(const mk5b_ts*)( frame_pointer + sizeof(m5b_header) );
 
                 // no DBE, no need to check frame numbers
                 if( !(data_type.dbe_flag && might_be_dbe(timestamp)) ) {
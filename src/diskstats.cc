@@ -0,0 +1,169 @@
+// implementation of the per mountpoint write statistics
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <diskstats.h>
+#include <mutex_locker.h>
+#include <evlbidebug.h>
+#include <sciprint.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <time.h>
+#include <pthread.h>
+
+using namespace std;
+
+
+namespace {
+    // Weight of the newest measurement in the moving averages
+    const double        alpha          = 0.25;
+    // Below this fraction of the median rate a mountpoint is a straggler ...
+    const double        straggler      = 0.5;
+    // ... for which we need this many measured mountpoints, with at least
+    // this many chunks each
+    const unsigned int  min_measured   = 3;
+    const uint64_t      min_chunks     = 2;
+    // and then it is not written to for this many seconds
+    const double        blacklist_time = 30.0;
+    // When selecting, rates within this fraction of the best are equally good
+    const double        comparable     = 0.8;
+
+    pthread_mutex_t    diskstats_mutex = PTHREAD_MUTEX_INITIALIZER;
+    diskstatsmap_type  diskstats;
+
+    double monotonic( void ) {
+        struct timespec  now;
+
+        ::clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec/1.0e9;
+    }
+
+    // Call with the mutex held
+    bool usable(const diskstats_type& ds, uint64_t chunksize, double now) {
+        return !(ds.until>now) && !(ds.freeknown && ds.freebytes<2*chunksize);
+    }
+}
+
+
+diskstats_type::diskstats_type():
+    nchunk( 0 ), nbyte( 0 ), nfail( 0 ), nblacklist( 0 ), rate( 0 ), latency( 0 ),
+    freebytes( 0 ), freeknown( false ), until( 0 )
+{}
+
+void diskstats_start(const filelist_type& mountpoints) {
+    mutex_locker  locker( diskstats_mutex );
+
+    for(filelist_type::const_iterator mp=mountpoints.begin(); mp!=mountpoints.end(); mp++) {
+        diskstats_type&  ds( diskstats[*mp] );
+
+        ds.until     = 0;
+        ds.freeknown = false;
+    }
+}
+
+void diskstats_written(const string& mp, uint64_t n, double dt, int64_t freebytes) {
+    mutex_locker     locker( diskstats_mutex );
+    diskstats_type&  ds( diskstats[mp] );
+    const double     r = n / std::max(dt, 1.0e-6);
+
+    ds.rate      = (ds.nchunk==0 ? r  : (1 - alpha) * ds.rate + alpha * r);
+    ds.latency   = (ds.nchunk==0 ? dt : (1 - alpha) * ds.latency + alpha * dt);
+    ds.nchunk++;
+    ds.nbyte    += n;
+    ds.freeknown = (freebytes>=0);
+    ds.freebytes = (ds.freeknown ? (uint64_t)freebytes : 0);
+
+    if( ds.nchunk<min_chunks )
+        return;
+
+    // Compare to the median rate of the mountpoints we know enough about
+    vector<double>  rates;
+
+    for(diskstatsmap_type::const_iterator p=diskstats.begin(); p!=diskstats.end(); p++)
+        if( p->second.nchunk>=min_chunks )
+            rates.push_back( p->second.rate );
+    if( rates.size()<min_measured )
+        return;
+
+    std::nth_element(rates.begin(), rates.begin() + rates.size()/2, rates.end());
+
+    const double  median = rates[ rates.size()/2 ];
+    const double  now    = monotonic();
+
+    if( ds.rate<straggler*median && !(ds.until>now) ) {
+        ds.until = now + blacklist_time;
+        ds.nblacklist++;
+        DEBUG(-1, "diskstats: " << mp << " writes at " << byteprint(ds.rate, "byte/s") << ", median is " <<
+                  byteprint(median, "byte/s") << "; not writing there for " << blacklist_time << "s" << endl);
+    }
+}
+
+void diskstats_failed(const string& mp) {
+    mutex_locker  locker( diskstats_mutex );
+    diskstats[mp].nfail++;
+}
+
+bool diskstats_usable(const string& mp, uint64_t chunksize) {
+    mutex_locker                       locker( diskstats_mutex );
+    diskstatsmap_type::const_iterator  p = diskstats.find(mp);
+
+    return p==diskstats.end() || usable(p->second, chunksize, monotonic());
+}
+
+filelist_type::iterator diskstats_select(filelist_type& mountpoints, uint64_t chunksize) {
+    mutex_locker             locker( diskstats_mutex );
+    const double             now = monotonic();
+    double                   best = 0;
+    bool                     unmeasured = false;
+    filelist_type::iterator  mp;
+
+    // Find the best rate amongst the usable ones. Unmeasured mountpoints
+    // are always eligible, we need to find out how good they are
+    for(mp=mountpoints.begin(); mp!=mountpoints.end(); mp++) {
+        const diskstats_type&  ds( diskstats[*mp] );
+
+        if( !usable(ds, chunksize, now) )
+            continue;
+        if( ds.nchunk==0 )
+            unmeasured = true;
+        best = std::max(best, ds.rate);
+    }
+    for(mp=mountpoints.begin(); mp!=mountpoints.end(); mp++) {
+        const diskstats_type&  ds( diskstats[*mp] );
+
+        if( !usable(ds, chunksize, now) )
+            continue;
+        if( unmeasured ? ds.nchunk==0 : ds.rate>=comparable*best )
+            break;
+    }
+    return mp;
+}
+
+diskstatsmap_type diskstats_get(double& now) {
+    mutex_locker  locker( diskstats_mutex );
+
+    now = monotonic();
+    return diskstats;
+}
+
+void diskstats_reset( void ) {
+    mutex_locker  locker( diskstats_mutex );
+    diskstats.clear();
+}
@@ -0,0 +1,77 @@
+// per mountpoint write statistics, used for selecting where to write to
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_DISKSTATS_H
+#define JIVE5A_DISKSTATS_H
+
+#include <mountpoint.h>
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+// The parallelwriter records for each chunk it wrote how long that took
+// and how much space is left on the mountpoint. From that an exponentially
+// weighted moving average of the write rate and chunk latency is kept.
+//
+// A mountpoint whose average rate drops below half of the median of all
+// mountpoints is a straggler and is not written to for a while, nor are
+// mountpoints which cannot hold two more chunks. The statistics survive
+// recordings; the blacklist and free space are reset when a new recording
+// starts.
+
+struct diskstats_type {
+    uint64_t      nchunk;        // chunks written
+    uint64_t      nbyte;         // bytes written
+    uint64_t      nfail;         // failed writes
+    unsigned int  nblacklist;    // how often it was found to be a straggler
+    double        rate;          // EWMA bytes/second, 0 = not measured yet
+    double        latency;       // EWMA seconds/chunk
+    uint64_t      freebytes;     // after the last write ...
+    bool          freeknown;     // ... if known
+    double        until;         // blacklisted until (CLOCK_MONOTONIC), 0 = not
+
+    diskstats_type();
+};
+
+typedef std::map<std::string, diskstats_type>  diskstatsmap_type;
+
+// A recording is about to start on these mountpoints
+void               diskstats_start(const filelist_type& mountpoints);
+
+// Record the result of writing a chunk of 'n' bytes in 'dt' seconds.
+// 'freebytes' < 0 means the free space could not be determined
+void               diskstats_written(const std::string& mp, uint64_t n, double dt, int64_t freebytes);
+void               diskstats_failed(const std::string& mp);
+
+// Wether the mountpoint is not blacklisted and can hold 'chunksize' more
+bool               diskstats_usable(const std::string& mp, uint64_t chunksize);
+
+// From the list of idle mountpoints select the one to write a chunk of
+// 'chunksize' bytes to: the first usable one, in list order, whose rate
+// is not significantly lower than the best one. Returns mountpoints.end()
+// if none of them is usable.
+filelist_type::iterator diskstats_select(filelist_type& mountpoints, uint64_t chunksize);
+
+// Copy of the current statistics; 'now' gets the time they refer to, for
+// checking blacklist expiry
+diskstatsmap_type  diskstats_get(double& now);
+void               diskstats_reset( void );
+
+#endif
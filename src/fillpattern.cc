@@ -0,0 +1,170 @@
+// find fill pattern in data, fast
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <fillpattern.h>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+    // The lowest bit of each byte
+    const uint64_t  lsb = 0x0101010101010101ULL;
+
+    inline uint64_t word_at(unsigned char const* p) {
+        uint64_t  w;
+        ::memcpy(&w, p, sizeof(w));
+        return w;
+    }
+
+#if defined(__SSE2__)
+    // Returns for the 64 bytes at 'p' one bit per 64 bit word, at the
+    // lowest bit of the byte in the same position as the word: set if the
+    // word matches
+    inline uint64_t match64(unsigned char const* p, __m128i const& pat) {
+        const uint64_t  m0 = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p     )), pat));
+        const uint64_t  m1 = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + 16)), pat));
+        const uint64_t  m2 = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + 32)), pat));
+        const uint64_t  m3 = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)(p + 48)), pat));
+        uint64_t        m  = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+
+        // a word matches if all its eight byte-bits are set
+        m &= (m >> 1);
+        m &= (m >> 2);
+        m &= (m >> 4);
+        return m & lsb;
+    }
+
+    inline __m128i pattern128(uint64_t pattern) {
+        return _mm_set_epi32((int)(pattern >> 32), (int)pattern, (int)(pattern >> 32), (int)pattern);
+    }
+#endif
+}
+
+
+size_t fill_span(void const* p, size_t n, uint64_t pattern) {
+    unsigned char const* const  start = (unsigned char const*)p;
+    unsigned char const*        ptr   = start;
+    unsigned char const* const  end   = start + (n - n%sizeof(uint64_t));
+
+#if defined(__SSE2__)
+    const __m128i  pat = pattern128(pattern);
+
+    for( ; (end - ptr)>=64; ptr+=64) {
+        const uint64_t  m = match64(ptr, pat);
+
+        if( m!=lsb )
+            return (ptr - start) + __builtin_ctzll(~m & lsb);
+    }
+#endif
+    for( ; ptr<end && word_at(ptr)==pattern; ptr+=sizeof(uint64_t) ) { }
+    return ptr - start;
+}
+
+size_t nonfill_span(void const* p, size_t n, uint64_t pattern) {
+    unsigned char const* const  start = (unsigned char const*)p;
+    unsigned char const*        ptr   = start;
+    unsigned char const* const  end   = start + (n - n%sizeof(uint64_t));
+
+#if defined(__SSE2__)
+    const __m128i  pat = pattern128(pattern);
+
+    for( ; (end - ptr)>=64; ptr+=64) {
+        const uint64_t  m = match64(ptr, pat);
+
+        if( m )
+            return (ptr - start) + __builtin_ctzll(m);
+    }
+#endif
+    for( ; ptr<end && word_at(ptr)!=pattern; ptr+=sizeof(uint64_t) ) { }
+    return ptr - start;
+}
+
+uint64_t fill_count(void const* p, size_t n, uint64_t pattern) {
+    unsigned char const*        ptr = (unsigned char const*)p;
+    unsigned char const* const  end = ptr + (n - n%sizeof(uint64_t));
+    uint64_t                    nword = 0;
+
+#if defined(__SSE2__)
+    const __m128i  pat = pattern128(pattern);
+
+    for( ; (end - ptr)>=64; ptr+=64)
+        nword += __builtin_popcountll( match64(ptr, pat) );
+#endif
+    for( ; ptr<end; ptr+=sizeof(uint64_t) )
+        nword += (word_at(ptr)==pattern);
+    return nword * sizeof(uint64_t);
+}
+
+
+fillrun_type::fillrun_type(uint64_t s, uint64_t e):
+    start( s ), end( e )
+{}
+
+fillmap_type::fillmap_type(uint64_t offset, uint64_t pat, size_t maxr):
+    pattern( pat ), maxrun( maxr ), nByte( 0 ), nFill( 0 ), nRun( 0 ), lastEnd( 0 ),
+    position( offset ), inrun( false )
+{}
+
+void fillmap_type::add(void const* p, size_t n) {
+    unsigned char const*  ptr  = (unsigned char const*)p;
+    size_t                left = n - n%sizeof(uint64_t);
+
+    while( left ) {
+        size_t  s;
+
+        if( inrun ) {
+            s      = fill_span(ptr, left, pattern);
+            nFill  += s;
+            lastEnd = position + s;
+            // only extend the run if it was recorded
+            if( runs.size()==nRun )
+                runs.back().end = lastEnd;
+        } else {
+            s = nonfill_span(ptr, left, pattern);
+        }
+        ptr      += s;
+        position += s;
+        left     -= s;
+        if( left==0 )
+            break;
+        // Hit the other kind of word
+        inrun = !inrun;
+        if( inrun ) {
+            if( runs.size()<maxrun && runs.size()==nRun )
+                runs.push_back( fillrun_type(position, position) );
+            nRun++;
+        }
+    }
+    // A partial word ends the stream anyway
+    if( n%sizeof(uint64_t) ) {
+        position += n%sizeof(uint64_t);
+        inrun     = false;
+    }
+    nByte += n;
+}
+
+bool fillmap_type::truncated( void ) const {
+    return runs.size()<nRun;
+}
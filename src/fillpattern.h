@@ -0,0 +1,75 @@
+// find fill pattern in data, fast
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_FILLPATTERN_H
+#define JIVE5A_FILLPATTERN_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+// The 64 bit word written in stead of data that was not received
+const uint64_t  default_fillpattern = ((uint64_t)0x11223344 << 32) + 0x11223344;
+
+// The data is looked at in 64 bit words, starting at 'p'. Compiled with
+// SSE2 these compare 64 bytes per iteration. 'p' need not be aligned;
+// trailing bytes of 'n' that don't make up a whole word are ignored.
+//
+// Number of bytes from 'p' up to the first word != 'pattern'
+size_t    fill_span(void const* p, size_t n, uint64_t pattern);
+// Number of bytes from 'p' up to the first word == 'pattern'
+size_t    nonfill_span(void const* p, size_t n, uint64_t pattern);
+// Number of bytes in words == 'pattern'
+uint64_t  fill_count(void const* p, size_t n, uint64_t pattern);
+
+
+// Byte range [start, end) of fill pattern
+struct fillrun_type {
+    uint64_t  start;
+    uint64_t  end;
+
+    fillrun_type(uint64_t s, uint64_t e);
+};
+typedef std::vector<fillrun_type>  fillrunlist_type;
+
+// Keeps track of where the fill pattern is in a stream of data that is
+// handed to add() in consecutive pieces. Runs continue across pieces. The
+// stream must be handed on in multiples of 8 bytes, except for the last
+// piece. After 'maxrun' runs only the counts are kept up to date.
+struct fillmap_type {
+    const uint64_t    pattern;
+    const size_t      maxrun;
+    uint64_t          nByte;       // seen
+    uint64_t          nFill;       // of which are fill pattern
+    uint64_t          nRun;        // total, may be > runs.size()
+    uint64_t          lastEnd;     // end of the last run, recorded or not
+    fillrunlist_type  runs;
+
+    // 'offset' is the stream position of the first byte
+    fillmap_type(uint64_t offset = 0, uint64_t pat = default_fillpattern, size_t maxr = 100000);
+
+    void      add(void const* p, size_t n);
+    bool      truncated( void ) const;
+
+    private:
+        uint64_t  position;
+        bool      inrun;
+};
+
+#endif
@@ -0,0 +1,64 @@
+// implementation of the integer frame time stamps
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <frameclock.h>
+
+using namespace std;
+
+
+frametime_type::frametime_type():
+    tv_sec( 0 ), frameno( 0 )
+{}
+
+frametime_type::frametime_type(time_t s, uint64_t fn):
+    tv_sec( s ), frameno( fn )
+{}
+
+
+frameclock_type::frameclock_type():
+    fps( 0 )
+{}
+
+frameclock_type::frameclock_type(const subsecond_type& framerate):
+    fps( (framerate.denominator()==1) ? framerate.numerator() : 0 )
+{}
+
+frameclock_type frameclock_type::from_framelength(const subsecond_type& framelength) {
+    if( framelength.numerator()==0 )
+        return frameclock_type();
+    return frameclock_type( subsecond_type(framelength.denominator(), framelength.numerator()) );
+}
+
+highrestime_type frameclock_type::to_highrestime(const frametime_type& ft) const {
+    return highrestime_type(ft.tv_sec, ft.frameno, fps);
+}
+
+bool frameclock_type::slow_to_frametime(const highrestime_type& t, frametime_type& ft) const {
+    const subsecond_type  fn( t.tv_subsecond * fps );
+
+    if( fn.denominator()!=1 )
+        return false;
+    ft.tv_sec  = t.tv_sec;
+    ft.frameno = fn.numerator();
+    return true;
+}
+
+ostream& operator<<(ostream& os, const frametime_type& ft) {
+    return os << ft.tv_sec << "s+#" << ft.frameno;
+}
@@ -0,0 +1,117 @@
+// integer time stamps for streams of frames at a fixed frame rate
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_FRAMECLOCK_H
+#define JIVE5A_FRAMECLOCK_H
+
+#include <highrestime.h>
+
+#include <iostream>
+#include <limits>
+#include <time.h>
+#include <stdint.h>
+
+// highrestime_type keeps the subsecond part as a rational number; all
+// arithmetic on it goes through gcd() to normalize the result. Within a
+// stream of frames at a fixed rate of an integer number of frames per
+// second the time stamp is just integer second + frame number, for which
+// a few integer operations suffice.
+//
+// Steps that process every frame convert the incoming frame time once,
+// then do their arithmetic on these, and only convert back to
+// highrestime_type when they need to hand a time stamp on.
+
+struct frametime_type {
+    time_t    tv_sec;
+    uint64_t  frameno;     // within tv_sec
+
+    frametime_type();
+    frametime_type(time_t s, uint64_t fn);
+};
+
+inline bool operator==(const frametime_type& l, const frametime_type& r) {
+    return l.tv_sec==r.tv_sec && l.frameno==r.frameno;
+}
+inline bool operator!=(const frametime_type& l, const frametime_type& r) {
+    return !(l==r);
+}
+inline bool operator<(const frametime_type& l, const frametime_type& r) {
+    return l.tv_sec<r.tv_sec || (l.tv_sec==r.tv_sec && l.frameno<r.frameno);
+}
+
+
+struct frameclock_type {
+    // frames per second. 0 means the clock is not valid: the frame rate
+    // was not an integer number of frames per second. Callers should
+    // then fall back to doing highrestime_type arithmetic.
+    uint64_t  fps;
+
+    frameclock_type();
+    // from a frame rate in frames per second
+    explicit frameclock_type(const subsecond_type& framerate);
+
+    // from the length of a frame in seconds
+    static frameclock_type from_framelength(const subsecond_type& framelength);
+
+    inline bool valid( void ) const {
+        return fps!=0;
+    }
+
+    // Returns false if the time stamp is not at a frame boundary of this
+    // clock, or has unknown subseconds
+    inline bool to_frametime(const highrestime_type& t, frametime_type& ft) const {
+        const uint64_t  num = t.tv_subsecond.numerator();
+        const uint64_t  den = t.tv_subsecond.denominator();
+
+        if( !valid() || t.tv_subsecond==highrestime_type::UNKNOWN_SUBSECOND )
+            return false;
+        // tv_subsecond is normalized (<1) so num<den and num*fps only
+        // overflows for silly denominators
+        if( num>std::numeric_limits<uint64_t>::max()/fps )
+            return slow_to_frametime(t, ft);
+        if( (num*fps)%den )
+            return false;
+        ft.tv_sec  = t.tv_sec;
+        ft.frameno = (num*fps)/den;
+        return true;
+    }
+
+    highrestime_type to_highrestime(const frametime_type& ft) const;
+
+    // move 'ft' on by 'n' frames
+    inline void advance(frametime_type& ft, uint64_t n = 1) const {
+        ft.frameno += n;
+        if( ft.frameno>=fps ) {
+            ft.tv_sec  += (time_t)(ft.frameno/fps);
+            ft.frameno %= fps;
+        }
+    }
+
+    // number of frames from 'from' to 'to'
+    inline int64_t nframe(const frametime_type& from, const frametime_type& to) const {
+        return (int64_t)(to.tv_sec - from.tv_sec)*(int64_t)fps + ((int64_t)to.frameno - (int64_t)from.frameno);
+    }
+
+    private:
+        bool slow_to_frametime(const highrestime_type& t, frametime_type& ft) const;
+};
+
+std::ostream& operator<<(std::ostream& os, const frametime_type& ft);
+
+#endif
@@ -3,88 +3,181 @@
 #include <mutex_locker.h>
 #include <evlbidebug.h>
 #include <set>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 
 DEFINE_EZEXCEPT(interchainexception)
 
-// global queue object used to communicate between 2 chains (written into by queue_writers, read from by queue_readers)
-struct interchain_queues_type {
-    set< bqueue<block>* > queues;
-    interchain_queues_type() {}
-    ~interchain_queues_type() {
+// global ring used to communicate between chains (written into by
+// queue_writers, read from by queue_readers)
+struct interchain_ring_type {
+    struct slot_type {
+        block         b;
+        // readers that still have to read this slot; when it drops to
+        // zero the reference is released so the writer's pool can
+        // recycle the block before it's overwritten
+        unsigned int  pending;
+
+        slot_type(): pending( 0 ) {}
+    };
+    typedef std::vector<slot_type>          slots_type;
+    typedef set<interchain_queue_type*>     queues_type;
+
+    slots_type      slots;
+    uint64_t        head;       // number of blocks stored in total
+    bool            enabled;    // a writer is running
+    unsigned int    nAttached;  // readers in the current writer session
+    unsigned int    nWait;      // readers waiting for data
+    queues_type     queues;
+
+    interchain_ring_type():
+        slots( 1024 ), head( 0 ), enabled( false ), nAttached( 0 ), nWait( 0 )
+    {}
+    ~interchain_ring_type() {
         // all registered queues should be removed at this stage, so check it
         if ( !queues.empty() ) {
             DEBUG( -1, "Error: not all interchain queues are removed at cleanup!" << endl);
-            for ( set< bqueue<block>* >::iterator i = queues.begin();
-                  i != queues.end();
-                  i++) {
-                delete *i;
-            }
         }
     }
 };
 
-static interchain_queues_type interchain;
-static pthread_rwlock_t interchain_lock = PTHREAD_RWLOCK_INITIALIZER;
-static bqueue<block>::capacity_type capacity = 1024;
+static interchain_ring_type interchain;
+static pthread_mutex_t      interchain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       interchain_cond = PTHREAD_COND_INITIALIZER;
+
+
+interchain_queue_type::interchain_queue_type():
+    cursor( 0 ), nOverrun( 0 ), attached( false ), ended( false ), popEnabled( true )
+{}
+
+interchain_queue_type::~interchain_queue_type() {}
+
+bool interchain_queue_type::pop( block& b ) {
+    mutex_locker  locker( interchain_lock );
+
+    while( true ) {
+        if( !popEnabled )
+            return false;
+        if( ended ) {
+            ended = false;
+            return false;
+        }
+        if( attached && cursor<interchain.head ) {
+            const uint64_t  nslot = interchain.slots.size();
+
+            // Did the writer lap us?
+            if( interchain.head-cursor>nslot ) {
+                nOverrun += (interchain.head - nslot - cursor);
+                cursor    = interchain.head - nslot;
+            }
+            interchain_ring_type::slot_type&  s( interchain.slots[cursor % nslot] );
+
+            b = s.b;
+            if( s.pending && --s.pending==0 )
+                s.b = block();
+            cursor++;
+            return true;
+        }
+        // Nothing (yet) for us; wait for the writer to store a block, to
+        // start or to stop
+        interchain.nWait++;
+        PTHREAD_CALL( ::pthread_cond_wait(&interchain_cond, &interchain_lock) );
+        interchain.nWait--;
+    }
+}
+
+void interchain_queue_type::enable_pop_only( void ) {
+    mutex_locker  locker( interchain_lock );
+    popEnabled = true;
+}
 
-bqueue<block>* request_interchain_queue() {
-    bqueue<block>* q = new bqueue<block>();
-    rw_write_locker locker( interchain_lock );
+void interchain_queue_type::disable_pop( void ) {
+    mutex_locker  locker( interchain_lock );
+    popEnabled = false;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&interchain_cond) );
+}
+
+uint64_t interchain_queue_type::overrun( void ) const {
+    mutex_locker  locker( interchain_lock );
+    return nOverrun;
+}
+
+
+interchain_queue_type* request_interchain_queue() {
+    interchain_queue_type* q = new interchain_queue_type();
+    mutex_locker locker( interchain_lock );
     EZASSERT2( interchain.queues.insert(q).second, interchainexception,
                EZINFO("Interchain queue is already registered?!?!") );
-    // enable the queue to receive data, so it can jump into the middle
-    // of a running transfer
-    q->resize_enable_push( capacity );
+    // if a writer is running, jump into the middle of the transfer
+    if( interchain.enabled ) {
+        q->attached = true;
+        q->cursor   = interchain.head;
+        interchain.nAttached++;
+    }
     return q;
 }
 
-void remove_interchain_queue( bqueue<block>* queue ) {
-    rw_write_locker locker( interchain_lock );
-    set< bqueue<block>* >::iterator i = interchain.queues.find(queue);
-    EZASSERT2( i != interchain.queues.end(), interchainexception, 
+void remove_interchain_queue( interchain_queue_type* queue ) {
+    mutex_locker locker( interchain_lock );
+    interchain_ring_type::queues_type::iterator i = interchain.queues.find(queue);
+    EZASSERT2( i != interchain.queues.end(), interchainexception,
                EZINFO("Failed to find queue to remove") );
+    // Blocks it did not read yet are released when they're overwritten
+    if( (*i)->attached )
+        interchain.nAttached--;
     delete *i;
     interchain.queues.erase(i);
 }
 
-bool interchain_queues_push( block& b ) {
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
-          i != interchain.queues.end();
-          i++ ) {
-        if ( !(*i)->push( b ) ) {
-            return false;
-        }
-    }
-    return true;
-}
+void interchain_queues_try_push( const block& b ) {
+    mutex_locker locker( interchain_lock );
 
-void interchain_queues_try_push( block& b ) {
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
-          i != interchain.queues.end();
-          i++ ) {
-        (*i)->try_push( b );
-    }
+    // Don't hold on to blocks nobody's going to read
+    if( !interchain.enabled || interchain.nAttached==0 )
+        return;
+
+    interchain_ring_type::slot_type&  s( interchain.slots[interchain.head % interchain.slots.size()] );
+
+    s.b       = b;
+    s.pending = interchain.nAttached;
+    interchain.head++;
+    if( interchain.nWait )
+        PTHREAD_CALL( ::pthread_cond_broadcast(&interchain_cond) );
 }
 
 void interchain_queues_disable() {
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
+    mutex_locker locker( interchain_lock );
+
+    interchain.enabled   = false;
+    interchain.nAttached = 0;
+    // Readers that were reading get told once that the writer stopped
+    for ( interchain_ring_type::queues_type::iterator i = interchain.queues.begin();
           i != interchain.queues.end();
           i++ ) {
-        (*i)->disable();
+        (*i)->ended    = (*i)->attached;
+        (*i)->attached = false;
     }
+    // release all blocks
+    interchain.slots = interchain_ring_type::slots_type( interchain.slots.size() );
+    PTHREAD_CALL( ::pthread_cond_broadcast(&interchain_cond) );
 }
 
-void interchain_queues_resize_enable_push( bqueue<block>::capacity_type newcap ) {
-    capacity = newcap;
-    rw_read_locker locker( interchain_lock );
-    for ( set< bqueue<block>* >::iterator i = interchain.queues.begin();
+void interchain_queues_resize_enable_push( unsigned int newcap ) {
+    mutex_locker locker( interchain_lock );
+
+    // Start with a fresh, empty, ring which all registered readers start
+    // reading from
+    interchain.slots     = interchain_ring_type::slots_type( std::max(newcap, 1u) );
+    interchain.enabled   = true;
+    interchain.nAttached = 0;
+    for ( interchain_ring_type::queues_type::iterator i = interchain.queues.begin();
           i != interchain.queues.end();
           i++ ) {
-        (*i)->resize_enable_push( newcap );
+        (*i)->attached = true;
+        (*i)->cursor   = interchain.head;
+        interchain.nAttached++;
     }
+    PTHREAD_CALL( ::pthread_cond_broadcast(&interchain_cond) );
 }
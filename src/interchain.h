@@ -2,22 +2,64 @@
 #define JIVE5A_INTERCHAIN_H
 
 #include <block.h>
-#include <bqueue.h>
 #include <ezexcept.h>
 
+#include <stdint.h>
+
 DECLARE_EZEXCEPT(interchainexception)
 
+// The data written by one chain (the queue_writer or queue_forker) is
+// shared with any number of reading chains (mem2net, mem2file, ...)
+// through a single ring of block references. The writer stores each block
+// once, whatever the number of readers, and never waits for them. Each
+// reader keeps its own cursor in the ring; a reader that falls more than
+// the ring size behind skips to the oldest block still present and the
+// number of blocks it missed is counted as overrun.
+//
+// Readers get a reference to the writer's block, not a copy.
+class interchain_queue_type {
+    public:
+        // Wait for the next block. Returns false if the writer stopped
+        // (after which the next pop() waits for the writer to start
+        // again) or popping was disabled
+        bool pop( block& b );
+
+        // (re)enable/disable the popping end
+        void enable_pop_only( void );
+        void disable_pop( void );
+
+        // Number of blocks this reader missed because it was too slow
+        uint64_t overrun( void ) const;
+
+    private:
+        friend interchain_queue_type* request_interchain_queue();
+        friend void remove_interchain_queue( interchain_queue_type* );
+        friend void interchain_queues_disable();
+        friend void interchain_queues_resize_enable_push( unsigned int );
+
+        uint64_t   cursor;      // next block to read
+        uint64_t   nOverrun;
+        bool       attached;    // reading from the current writer session
+        bool       ended;       // writer stopped, pop() must report it once
+        bool       popEnabled;
+
+        interchain_queue_type();
+        ~interchain_queue_type();
+
+        // Not copyable
+        interchain_queue_type( const interchain_queue_type& );
+        interchain_queue_type& operator=( const interchain_queue_type& );
+};
+
 // functions to setup queues used by thread functions to communicate data between runtimes/chains
-bqueue<block>* request_interchain_queue();
-void remove_interchain_queue( bqueue<block>* queue );
+interchain_queue_type* request_interchain_queue();
+void remove_interchain_queue( interchain_queue_type* queue );
 
-// push on all interchain queues, a blocking version and a non-blocking,
-// note that the blocking version blocks on ALL queues and returns true iff all pushes return true
-bool interchain_queues_push( block& b );
-void interchain_queues_try_push( block& b );
+// store a block for all readers; never blocks
+void interchain_queues_try_push( const block& b );
 
 // disable all interchain queues
 void interchain_queues_disable();
-// enable pushing on interchain queues
-void interchain_queues_resize_enable_push( bqueue<block>::capacity_type newcap );
+// enable pushing on interchain queues, the ring holds 'newcap' blocks
+void interchain_queues_resize_enable_push( unsigned int newcap );
 #endif
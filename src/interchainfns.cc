@@ -1,10 +1,13 @@
 #include <interchainfns.h>
 #include <interchain.h>
+#include <memring.h>
 #include <threadfns.h> // for emergency_type
 #include <sciprint.h>  // for byteprint()
 #include <iostream>
 #include <memory>
 
+#include <sys/time.h>
+
 using namespace std;
 
 
@@ -80,7 +83,10 @@ void queue_writer(inq_type<block>* inq, sync_type<queue_writer_args>* args) {
     interchain_queues_resize_enable_push( std::max(INTERCHAIN_QUEUE_SIZE / blocksize, 1u) );
     args->userdata->disable = true;
 
-    DEBUG(0, "queue_writer: starting" << endl);
+    // Also keep the most recent data in the memory ring, if configured
+    const bool  ring = memring_attach( blocksize );
+
+    DEBUG(0, "queue_writer: starting" << (ring ? " [+memory ring]" : "") << endl);
     do {
         block b;
         if ( !inq->pop(b) ) {
@@ -88,7 +94,11 @@ void queue_writer(inq_type<block>* inq, sync_type<queue_writer_args>* args) {
         }
         counter += b.iov_len;
         interchain_queues_try_push(b);
+        if( ring )
+            memring_put(b);
     } while(true);
+    if( ring )
+        memring_detach();
     DEBUG(0, "queue_writer: stopping" << endl);
 }
 
@@ -133,7 +143,7 @@ void queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* args) {
 
     // Now we are really going to read data; better have a queue then!
     // the request_interchain_queue() always succeeds or throws an exception
-    bqueue<block>* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue();
+    interchain_queue_type* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue();
 
     // Now we can indicate we're running!
     RTEEXEC(*rteptr,
@@ -234,6 +244,8 @@ void queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* args) {
         }
         nrestart++;
     }
+    if( interchain_queue->overrun() )
+        DEBUG(-1, "queue_reader v1: " << interchain_queue->overrun() << " blocks were overwritten before they could be read" << endl);
     DEBUG(0, "queue_reader v1: stopping" << endl);
     qargs->finished = true;
 }
@@ -272,7 +284,7 @@ void stupid_queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* a
 
     // Now we are really going to read data; better have a queue then!
     // the request_interchain_queue() always succeeds or throws an exception
-    bqueue<block>* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue();
+    interchain_queue_type* interchain_queue = rteptr->interchain_source_queue = request_interchain_queue();
 
     // Now we can indicate we're running!
     RTEEXEC(*rteptr,
@@ -299,6 +311,8 @@ void stupid_queue_reader(outq_type<block>* outq, sync_type<queue_reader_args>* a
             }
         }
     }
+    if( interchain_queue->overrun() )
+        DEBUG(-1, "stupid_queue_reader: " << interchain_queue->overrun() << " blocks were overwritten before they could be read" << endl);
     DEBUG(0, "stupid_queue_reader: stopping, read " << counter << " (" << byteprint((double)counter, "byte") << ")" << endl);
     qargs->finished = true;
 }
@@ -365,6 +379,109 @@ void tagged_queue_forker(inq_type< tagged<block> >* inq, outq_type< tagged<block
 
 }
 
+static double wallclock( void ) {
+    struct timeval  now;
+
+    ::gettimeofday(&now, 0);
+    return now.tv_sec + now.tv_usec/1.0e6;
+}
+
+ring_reader_args::ring_reader_args() :
+    rteptr(NULL), pool(NULL), start(0), end(0), stop(false)
+{}
+ring_reader_args::ring_reader_args(runtime* r, double s, double e) :
+    rteptr(r), pool(NULL), start(s), end(e), stop(false)
+{}
+ring_reader_args::~ring_reader_args() {
+    delete pool;
+}
+
+void ring_reader(outq_type<block>* outq, sync_type<ring_reader_args>* args) {
+    ASSERT_COND( args && args->userdata && args->userdata->rteptr );
+    ring_reader_args*  rargs  = args->userdata;
+    runtime*           rteptr = rargs->rteptr;
+
+    RTEEXEC(*rteptr, rteptr->sizes.validate());
+    const unsigned int out_blocksize = rteptr->sizes[constraints::blocksize];
+    ASSERT_COND(out_blocksize > 0);
+
+    // Fails if there is no ring, or nothing was ever captured into it
+    memring_open_reader();
+
+    const unsigned int slotsize = memring_slotsize();
+
+    // The ring's blocks are gathered into output blocks; make sure
+    // there's always room for a whole ring block
+    SYNCEXEC(args, rargs->pool = new blockpool_type(std::max(out_blocksize, slotsize), 4));
+
+    RTEEXEC(*rteptr,
+            rteptr->statistics.init(args->stepid, "RingReader", 0);
+            rteptr->transfersubmode.clr(wait_flag).set(run_flag));
+    counter_type& counter( rteptr->statistics.counter(args->stepid) );
+
+    bool         stop = false;
+    double       t;
+    uint64_t     seq   = memring_find( rargs->start );
+    uint64_t     nlost = 0;
+    unsigned int n, nbuf = 0;
+    block        outblock;
+
+    DEBUG(0, "ring_reader: starting at block #" << seq << " (head #" << memring_head() << ")" << endl);
+    while( !stop ) {
+        if( outblock.empty() ) {
+            outblock = rargs->pool->get();
+            nbuf     = 0;
+        }
+
+        const memring_get_result  r = memring_get(seq, (unsigned char*)outblock.iov_base + nbuf, n, t);
+
+        if( r==memring_ended )
+            break;
+        if( r==memring_notyet ) {
+            // Has the window closed without new data arriving?
+            if( wallclock()>rargs->end )
+                break;
+            // Sleep until the block is written or the window closes
+            stop = memring_wait(seq, rargs->end, rargs->stop);
+            continue;
+        }
+        if( r==memring_overwritten ) {
+            // Capture went faster than we could write; skip to the oldest
+            // block still there
+            const uint64_t  oldest = memring_find( 0 );
+
+            nlost += (oldest>seq ? oldest - seq : 1);
+            seq    = std::max(oldest, seq + 1);
+            continue;
+        }
+        seq++;
+        if( t>rargs->end )
+            break;
+        nbuf += n;
+
+        // If there's not enough room for another one, send it off
+        if( nbuf + slotsize>out_blocksize ) {
+            if( outq->push(outblock.sub(0, nbuf))==false )
+                break;
+            counter += nbuf;
+            outblock = block();
+            SYNCEXEC(args, stop = args->cancelled);
+        }
+    }
+    if( !outblock.empty() && nbuf && !stop && outq->push(outblock.sub(0, nbuf)) )
+        counter += nbuf;
+    memring_close_reader();
+
+    if( nlost )
+        DEBUG(-1, "ring_reader: " << nlost << " blocks were overwritten before they could be saved" << endl);
+    DEBUG(0, "ring_reader: done, " << byteprint((double)counter, "byte") << endl);
+}
+
+void cancel_ring_reader(ring_reader_args* args) {
+    ASSERT_COND( args );
+    memring_wakeup( args->stop );
+}
+
 void cancel_queue_reader(queue_reader_args* args) {
     args->set_run(false);
     // Interchain-source-queue not there is not an error anymore
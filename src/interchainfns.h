@@ -59,17 +59,35 @@ struct queue_forker_args {
     ~queue_forker_args();
 };
 
+// Read the blocks that arrived between start and end (wall clock
+// seconds) from the memory ring (see memring.h). If 'end' is in the future
+// wait for them to arrive; register cancel_ring_reader() to interrupt that.
+struct ring_reader_args {
+    runtime*        rteptr;
+    blockpool_type* pool;
+    double          start;
+    double          end;
+    bool            stop;
+
+    ring_reader_args();
+    ring_reader_args(runtime* r, double s, double e);
+
+    ~ring_reader_args();
+};
+
 void queue_writer(inq_type<block>*, sync_type<queue_writer_args>* );
 
 // two version of queue reader, the first resizes to the requested blocksize
 // the stupid version does not
 void queue_reader(outq_type<block>*, sync_type<queue_reader_args>* );
 void stupid_queue_reader(outq_type<block>*, sync_type<queue_reader_args>* );
+void ring_reader(outq_type<block>*, sync_type<ring_reader_args>* );
 
 void queue_forker(inq_type<block>*, outq_type<block>*, sync_type<queue_forker_args>*);
 void tagged_queue_forker(inq_type< tagged<block> >*, outq_type< tagged<block> >*, sync_type<queue_forker_args>*);
 
 void cancel_queue_reader(queue_reader_args*);
+void cancel_ring_reader(ring_reader_args*);
 
 // When registered as chain finalizer it will remove the
 // interchain queue from the runtime - this releases
@@ -5,6 +5,7 @@
 #include <regular_expression.h>
 #include <dosyscall.h>
 #include <mutex_locker.h>
+#include <pthreadcall.h>
 #include <directory_helper_templates.h>
 #include <mk6info.h>
 #include <ezexcept.h>
@@ -16,6 +17,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <vector>
 #include <algorithm>
 #include <string>
 #include <cstddef>
@@ -100,7 +102,7 @@ struct filechunk_type {
 
     // construct from full path name - this is for a FlexBuff chunk
     filechunk_type(string const& fnm):
-        pathToChunk( fnm ), chunkPos( 0 ), chunkFd( invalidFileDescriptor ), chunkOffset( 0 )
+        pathToChunk( fnm ), chunkPos( 0 ), chunkFd( invalidFileDescriptor ), preadFd( -1 ), chunkOffset( 0 )
     {
         // At this point we assume 'fnm' looks like
         // "/path/to/file/chunk[_dsXXXXX].012345678"
@@ -159,7 +161,7 @@ struct filechunk_type {
     // that as suffixNr - duplicate sequence numbers must come from
     // different files!
     filechunk_type(unsigned int chunk, off_t fpos, off_t sz, int fd, size_t stream_id):
-        chunkSize( sz ), chunkPos( fpos ), chunkFd( -fd ), chunkOffset( 0 ),
+        chunkSize( sz ), chunkPos( fpos ), chunkFd( -fd ), preadFd( -1 ), chunkOffset( 0 ),
         chunkNumber( chunk ), chunkSuffixNr( stream_id )
     {}
 
@@ -168,7 +170,7 @@ struct filechunk_type {
     // file chunk manages its own file descriptor.
     filechunk_type(filechunk_type const& other):
         pathToChunk( other.pathToChunk ), chunkSize( other.chunkSize ), chunkPos( other.chunkPos ), 
-        chunkFd( (other.chunkFd<0) ? other.chunkFd : invalidFileDescriptor ),
+        chunkFd( (other.chunkFd<0) ? other.chunkFd : invalidFileDescriptor ), preadFd( -1 ),
         chunkOffset( other.chunkOffset ), chunkNumber( other.chunkNumber ),
         chunkSuffixNr( other.chunkSuffixNr )
     { }
@@ -193,12 +195,33 @@ struct filechunk_type {
         return;
     }
 
+    // vbs_pread() doesn't use chunkFd because vbs_read() moves its file
+    // pointer; it opens the FlexBuff chunk once for all its reads
+    int open_pread( void ) const {
+        if( chunkFd<0 )
+            return -chunkFd;
+        if( preadFd<0 ) {
+            preadFd = ::open(pathToChunk.c_str(), O_RDONLY);
+            DEBUG(5, "filechunk_type:open_pread[" << pathToChunk << "] fd#" << preadFd << " " << evlbi5a::strerror(errno) << endl);
+        }
+        return preadFd;
+    }
+
+    void close_pread( void ) const {
+        if( preadFd>=0 ) {
+            ::close( preadFd );
+            DEBUG(5, "filechunk_type:close_pread[" << pathToChunk << "] fd#" << preadFd << endl);
+            preadFd = -1;
+        }
+    }
+
     ~filechunk_type() {
         // don't leak file descriptors
         if( chunkFd>=0 && chunkFd!=invalidFileDescriptor ) {
             ::close( chunkFd );
             DEBUG(5, "filechunk_type:~filechunk_type[" << pathToChunk << "] close fd#" << chunkFd << endl);
         }
+        close_pread();
     }
 
     // Note: declare chunkOffset as mutable such that we can later, after
@@ -212,6 +235,7 @@ struct filechunk_type {
     off_t                  chunkSize;
     off_t                  chunkPos;
     mutable int            chunkFd;
+    mutable int            preadFd;
     mutable off_t          chunkOffset;
     unsigned int           chunkNumber;
     size_t                 chunkSuffixNr;
@@ -302,10 +326,16 @@ struct isMountpoint {
 //
 // ////////////////////////////////////////////////////////
 struct openfile_type {
+    typedef std::vector<filechunks_type::const_iterator>  chunkindex_type;
+
     off_t                           filePointer;
     off_t                           fileSize;
     filechunks_type                 fileChunks;
     filechunks_type::iterator       chunkPtr;
+    // the chunks in order of chunkOffset, for a binary search
+    chunkindex_type                 chunkIndex;
+    // serializes opening the chunks' pread file descriptors
+    mutable pthread_mutex_t         preadLock;
 
     // A fake Mk6/VBS scan - emulates /dev/null ...
     // albeit with a maximum size
@@ -313,6 +343,7 @@ struct openfile_type {
         filePointer( 0 ), fileSize( maxsize )
     {
         chunkPtr = fileChunks.begin();
+        PTHREAD_CALL( ::pthread_mutex_init(&preadLock, 0) );
     }
 
     // No default c'tor!
@@ -331,6 +362,8 @@ struct openfile_type {
             suffixes.insert( chunkPtr->chunkSuffixNr );
         }
         chunkPtr = fileChunks.begin();
+        make_index();
+        PTHREAD_CALL( ::pthread_mutex_init(&preadLock, 0) );
         DEBUG(2, "openfile_type: found " << fileSize << " bytes in " << fileChunks.size() << " chunks, " <<
                  (((double)fileChunks.size())/((double)fileChunks.rbegin()->chunkNumber+1))*100.0/(double)suffixes.size() << "%" << endl);
     }
@@ -340,15 +373,49 @@ struct openfile_type {
     openfile_type(openfile_type const& other):
         filePointer( 0 ), fileSize( other.fileSize ),
         fileChunks( other.fileChunks ), chunkPtr( fileChunks.begin() )
-    {}
+    {
+        make_index();
+        PTHREAD_CALL( ::pthread_mutex_init(&preadLock, 0) );
+    }
+
+    // The chunk that holds byte 'offset' of the recording, fileChunks.end()
+    // if there isn't one
+    filechunks_type::const_iterator find_chunk(off_t offset) const {
+        chunkindex_type::const_iterator  p = std::upper_bound(chunkIndex.begin(), chunkIndex.end(), offset, offset_before());
+
+        // p is the first chunk starting after offset
+        if( p==chunkIndex.begin() )
+            return fileChunks.end();
+        --p;
+        return (offset<(*p)->chunkOffset+(*p)->chunkSize) ? *p : fileChunks.end();
+    }
 
     ~openfile_type() {
         // unobserve all chunks
-        for( chunkPtr=fileChunks.begin(); chunkPtr!=fileChunks.end(); chunkPtr++)
+        for( chunkPtr=fileChunks.begin(); chunkPtr!=fileChunks.end(); chunkPtr++) {
             chunkPtr->close_chunk();
+            chunkPtr->close_pread();
+        }
+        ::pthread_mutex_destroy(&preadLock);
     }
     private:
+        struct offset_before {
+            bool operator()(off_t offset, filechunks_type::const_iterator chunk) const {
+                return offset<chunk->chunkOffset;
+            }
+        };
+
+        // The set is sorted by chunk number, which is the order in which
+        // the chunkOffsets were assigned
+        void make_index( void ) {
+            chunkIndex.clear();
+            chunkIndex.reserve( fileChunks.size() );
+            for(filechunks_type::const_iterator p=fileChunks.begin(); p!=fileChunks.end(); p++)
+                chunkIndex.push_back( p );
+        }
+
         openfile_type();
+        const openfile_type& operator=(const openfile_type&);
 };
 
 typedef map<int, openfile_type>         openedfiles_type;
@@ -639,6 +706,85 @@ ssize_t vbs_read(int fd, void* buf, size_t count) {
     return (ssize_t)(count-nr);
 }
 
+//////////////////////////////////////////////////
+//
+//  ssize_t vbs_pread(int fd, void* buf, size_t count, off_t offset)
+//
+//  read bytes from a previously opened recording
+//  at a given offset. Does not touch the file pointer
+//  nor vbs_read()'s file descriptors so it may be
+//  called concurrently. FlexBuff chunks are opened
+//  once, closed by vbs_close()
+//
+//////////////////////////////////////////////////
+
+ssize_t vbs_pread(int fd, void* buf, size_t count, off_t offset) {
+    // we need read-only access to the int -> openfile_type mapping
+    rw_read_locker             lockert( openedFilesLock );
+    unsigned char*             bufc = (unsigned char*)buf;
+    openedfiles_type::iterator fptr = openedFiles.find(fd) ;
+
+    if( fptr==openedFiles.end() ) {
+        errno = EBADF;
+        return -1;
+    }
+    if( buf==0 ) {
+        errno = EFAULT;
+        return -1;
+    }
+    if( offset<0 ) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t                   nr = count;
+    openfile_type const&     of = fptr->second;
+    filechunks_type const&   chunks = of.fileChunks;
+
+    // The null recording
+    if( chunks.size()==0 ) {
+        size_t  nread = std::min( count, static_cast<size_t>( (offset < of.fileSize) ? (of.fileSize - offset) : 0) );
+        ::memset(buf, 0x0, nread);
+        return (ssize_t)nread;
+    }
+
+    // Find the chunk containing 'offset'
+    filechunks_type::const_iterator chunk = of.find_chunk( offset );
+
+    while( nr && chunk!=chunks.end() ) {
+        const off_t  n2r = min((off_t)nr, chunk->chunkOffset+chunk->chunkSize - offset);
+        ssize_t      actualread;
+
+        if( n2r<=0 ) {
+            chunk++;
+            continue;
+        }
+
+        // Mark6 chunks share the file's descriptor, FlexBuff chunks are
+        // opened on first use
+        int   realfd;
+        {
+            mutex_locker  locker( of.preadLock );
+            realfd = chunk->open_pread();
+        }
+
+        if( realfd<0 ) {
+            DEBUG(-1, "vbs_pread: failed to open " << chunk->pathToChunk << " - " << evlbi5a::strerror(errno) << endl);
+            break;
+        }
+        actualread = ::pread(realfd, bufc, (size_t)n2r, offset - chunk->chunkOffset + chunk->chunkPos);
+        if( actualread<=0 ) {
+            if( actualread<0 )
+                DEBUG(-1, "vbs_pread: read fails - " << evlbi5a::strerror(errno) << " reading from " << chunk->pathToChunk << endl);
+            break;
+        }
+        bufc   += actualread;
+        nr     -= actualread;
+        offset += actualread;
+    }
+    return (ssize_t)(count-nr);
+}
+
 //////////////////////////////////////////////////
 //
 //  int vbs_lseek(int fd, off_t offset, int whence)
@@ -982,71 +1128,291 @@ void scanMk6Recording(string const& recname, direntries_type const& mountpoints,
     }
 }
 
+////////////////////////////////////////
+//
+//  Mark6 file layout cache
+//
+//  Scanning a multi-TB Mark6 file for its
+//  write block headers takes a while so
+//  the outcome is kept per file. Reopening
+//  an unmodified file needs no I/O; if the
+//  file only grew (still recording) the
+//  scan resumes where it left off.
+//
+/////////////////////////////////////////
+
+struct mk6block_type {
+    unsigned int  blockNumber;
+    off_t         blockPos;
+    off_t         blockSize;
+
+    mk6block_type(unsigned int bn, off_t pos, off_t sz):
+        blockNumber( bn ), blockPos( pos ), blockSize( sz )
+    {}
+};
+typedef std::vector<mk6block_type>  mk6blocks_type;
+
+struct mk6layout_type {
+    dev_t           fileDev;
+    ino_t           fileIno;
+    off_t           fileSize;
+    time_t          fileMtime;
+    off_t           nextHeader;   // where scanning resumes if the file grew
+    unsigned int    lastUsed;
+    mk6blocks_type  blocks;
+
+    mk6layout_type():
+        fileDev( 0 ), fileIno( 0 ), fileSize( 0 ), fileMtime( 0 ), nextHeader( 0 ), lastUsed( 0 )
+    {}
+};
+typedef std::map<string, mk6layout_type>    mk6layoutcache_type;
+
+// Don't let the cache grow without bounds: ~24 bytes per block means
+// this is O(100MB)
+static const size_t         mk6layoutcacheMaxBlocks = 4*1024*1024;
+static mk6layoutcache_type  mk6layoutcache;
+static size_t               mk6layoutcacheBlocks = 0;
+static unsigned int         mk6layoutcacheClock  = 0;
+static pthread_mutex_t      mk6layoutcacheMutex  = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns true if the (part of the) layout in the cache is usable for the
+// file, the caller then only has to scan from layout.nextHeader onwards
+bool getMk6Layout(string const& file, struct stat const& fst, mk6layout_type& layout) {
+    mutex_locker                  locker( mk6layoutcacheMutex );
+    mk6layoutcache_type::iterator p = mk6layoutcache.find( file );
+
+    if( p==mk6layoutcache.end() )
+        return false;
+
+    mk6layout_type&  cached( p->second );
+
+    // Same file, not shrunk, and if the size didn't change, neither must
+    // the modification time
+    if( cached.fileDev!=fst.st_dev || cached.fileIno!=fst.st_ino || cached.fileSize>fst.st_size ||
+        (cached.fileSize==fst.st_size && cached.fileMtime!=fst.st_mtime) ) {
+        mk6layoutcacheBlocks -= cached.blocks.size();
+        mk6layoutcache.erase( p );
+        return false;
+    }
+    cached.lastUsed = ++mk6layoutcacheClock;
+    layout          = cached;
+    return true;
+}
+
+void putMk6Layout(string const& file, mk6layout_type const& layout) {
+    mutex_locker                  locker( mk6layoutcacheMutex );
+    mk6layoutcache_type::iterator p = mk6layoutcache.find( file );
+
+    if( p!=mk6layoutcache.end() ) {
+        mk6layoutcacheBlocks -= p->second.blocks.size();
+        mk6layoutcache.erase( p );
+    }
+    if( layout.blocks.size()>mk6layoutcacheMaxBlocks )
+        return;
+
+    // Evict least recently used files until this one fits
+    while( mk6layoutcacheBlocks+layout.blocks.size()>mk6layoutcacheMaxBlocks ) {
+        mk6layoutcache_type::iterator lru = mk6layoutcache.begin();
+
+        for(p=mk6layoutcache.begin(); p!=mk6layoutcache.end(); p++)
+            if( p->second.lastUsed<lru->second.lastUsed )
+                lru = p;
+        mk6layoutcacheBlocks -= lru->second.blocks.size();
+        mk6layoutcache.erase( lru );
+    }
+    p = mk6layoutcache.insert( make_pair(file, layout) ).first;
+    p->second.lastUsed    = ++mk6layoutcacheClock;
+    mk6layoutcacheBlocks += layout.blocks.size();
+}
+
+
+////////////////////////////////////////
+//
+//  Read Mark6 write block headers.
+//
+//  Headers of small blocks come out of
+//  one large read covering many blocks,
+//  which at worst runs at sequential disk
+//  speed. For large blocks only the
+//  header itself is read, with one
+//  pread(2) in stead of read(2) + lseek(2)
+//  and without the kernel reading ahead
+//  data we're going to skip anyway.
+//
+/////////////////////////////////////////
+
+struct mk6headerreader_type {
+    static const size_t       bufSize = 8*1024*1024;
+    // Large blocks: number of headers to ask the kernel for in advance
+    static const unsigned int nAhead  = 32;
+
+    mk6headerreader_type(int fd):
+        fileDes( fd ), bufPos( 0 ), bufLen( 0 ), lastPos( -1 ), randomAccess( false ),
+        adviseStride( 0 ), adviseEnd( 0 )
+    {}
+
+    // Copy the header at 'pos' into 'hdr', false if there isn't a complete one
+    bool read(off_t pos, void* hdr, size_t sz) {
+        const off_t  stride = (lastPos<0 ? 0 : pos - lastPos);
+
+        lastPos = pos;
+        if( !(pos>=bufPos && (off_t)(pos+sz)<=(off_t)(bufPos+bufLen)) ) {
+            if( stride<=0 || stride>(off_t)(bufSize/4) ) {
+#ifdef POSIX_FADV_RANDOM
+                if( stride>0 && !randomAccess ) {
+                    ::posix_fadvise(fileDes, 0, 0, POSIX_FADV_RANDOM);
+                    randomAccess = true;
+                }
+#endif
+                if( stride>0 )
+                    read_ahead(pos, stride, sz);
+                return ::pread(fileDes, hdr, sz, pos)==(ssize_t)sz;
+            }
+            if( buffer.empty() )
+                buffer.resize( bufSize );
+            ssize_t  n = ::pread(fileDes, &buffer[0], bufSize, pos);
+
+            bufPos = pos;
+            bufLen = (n<0 ? 0 : (size_t)n);
+            if( bufLen<sz )
+                return false;
+        }
+        ::memcpy(hdr, &buffer[pos - bufPos], sz);
+        return true;
+    }
+
+    // Mark6 write blocks are mostly of equal size so the next headers are
+    // probably at pos + n * stride. Have the kernel read those in the
+    // background such that many header reads are in flight at any time,
+    // not just the one we wait for. A wrong guess costs a page read.
+    void read_ahead(off_t pos, off_t stride, size_t sz) {
+#ifdef POSIX_FADV_WILLNEED
+        if( stride!=adviseStride || adviseEnd<pos ) {
+            adviseStride = stride;
+            adviseEnd    = pos;
+        }
+        while( adviseEnd<pos + (off_t)nAhead*stride ) {
+            adviseEnd += stride;
+            ::posix_fadvise(fileDes, adviseEnd, (off_t)sz, POSIX_FADV_WILLNEED);
+        }
+#endif
+    }
+
+    ~mk6headerreader_type() {
+        // The file will be read sequentially after this
+#ifdef POSIX_FADV_NORMAL
+        if( randomAccess )
+            ::posix_fadvise(fileDes, 0, 0, POSIX_FADV_NORMAL);
+#endif
+    }
+
+    int                         fileDes;
+    std::vector<unsigned char>  buffer;
+    off_t                       bufPos;
+    size_t                      bufLen;
+    off_t                       lastPos;
+    bool                        randomAccess;
+    off_t                       adviseStride;
+    off_t                       adviseEnd;      // last header read ahead
+
+    private:
+        mk6headerreader_type();
+        mk6headerreader_type(mk6headerreader_type const&);
+        mk6headerreader_type const& operator=(mk6headerreader_type const&);
+};
+
 // Note! Upon succesfull exit, we do NOT close 'fd'!
 // So the caller must make sure to always account for
 // the file descriptors!
-#define MYMAX_Local(a, b) ((a>b)?(a):(b))
 void scanMk6RecordingFile(string const& /*recname*/, string const& file, filechunks_type& rv) {
     int               fd;
     off_t             fpos;
+    struct stat       fst;
+    mk6layout_type    layout;
     const size_t      fh_size = sizeof(mk6_file_header);
     const size_t      wb_size = sizeof(mk6_wb_header_v2);
-    unsigned char     buf[ fh_size+wb_size /*MYMAX_Local(fh_size, wb_size)*/ ];
+    unsigned char     buf[ fh_size+wb_size ];
     mk6_file_header*  fh6  = (mk6_file_header*)&buf[0];
     mk6_wb_header_v2* wbh  = (mk6_wb_header_v2*)&buf[0];
 
     // File existence has been checked before so now we MUST be able to open it
     ASSERT2_POS( fd=::open(file.c_str(), O_RDONLY), SCINFO(" failed to open file " << file) );
+    ASSERT2_ZERO( ::fstat(fd, &fst), SCINFO(" failed to stat file " << file); ::close(fd) );
 
-    // It may well not be a Mk6 recording, for all we know
-    if( ::read(fd, fh6, sizeof(mk6_file_header))!=sizeof(mk6_file_header) ) {
-        DEBUG(4, "scanMk6RecordingFile[" << file << "]: fail to read mk6 header - " << evlbi5a::strerror(errno) << endl);
-        ::close(fd);
-        return;
-    }
+    bool        cached    = getMk6Layout(file, fst, layout);
+    const bool  unchanged = cached && layout.fileSize==fst.st_size;
 
-    if( fh6->sync_word!=MARK6_SG_SYNC_WORD ) {
-        DEBUG(4, "scanMk6RecordingFile[" << file << "]: did not find mk6 sync word in header" << endl);
-        ::close(fd);
-        return;
+    // If the file grew, check that it is still the file we scanned: the
+    // last block we know of must still be there
+    if( cached && !unchanged && !layout.blocks.empty() ) {
+        mk6block_type const&  last( layout.blocks.back() );
+
+        if( ::pread(fd, wbh, wb_size, last.blockPos - wb_size)!=(ssize_t)wb_size ||
+            wbh->blocknum!=(int32_t)last.blockNumber || wbh->wb_size!=(int32_t)(last.blockSize + wb_size) ) {
+            DEBUG(4, "scanMk6RecordingFile[" << file << "]: file changed, rescanning" << endl);
+            layout = mk6layout_type();
+            cached = false;
+        }
     }
-    if( fh6->version!=2 ) {
-        DEBUG(4, "scanMk6RecordingFile[" << file << "]: we don't support mk6 file version " << fh6->version << endl);
-        ::close(fd);
-        return;
+
+    if( !cached ) {
+        // It may well not be a Mk6 recording, for all we know
+        if( ::pread(fd, fh6, fh_size, 0)!=(ssize_t)fh_size ) {
+            DEBUG(4, "scanMk6RecordingFile[" << file << "]: fail to read mk6 header - " << evlbi5a::strerror(errno) << endl);
+            ::close(fd);
+            return;
+        }
+
+        if( fh6->sync_word!=MARK6_SG_SYNC_WORD ) {
+            DEBUG(4, "scanMk6RecordingFile[" << file << "]: did not find mk6 sync word in header" << endl);
+            ::close(fd);
+            return;
+        }
+        if( fh6->version!=2 ) {
+            DEBUG(4, "scanMk6RecordingFile[" << file << "]: we don't support mk6 file version " << fh6->version << endl);
+            ::close(fd);
+            return;
+        }
+        layout.nextHeader = fh_size;
     }
+    layout.fileDev   = fst.st_dev;
+    layout.fileIno   = fst.st_ino;
+    layout.fileSize  = fst.st_size;
+    layout.fileMtime = fst.st_mtime;
+
     // Extract the data stream tag (just a unique number for each data
     // stream label)
     size_t const datastreamid = filechunk_type::getDataStreamId( file );
 
-    DEBUG(4, "scanMk6RecordingFile[" << file << "]: starting" << endl);
-    // Ok. Now we should just read all the blocks in this file!
-    fpos = fh_size;
-    while( ::read(fd, wbh, wb_size)==(ssize_t)wb_size ) {
+    DEBUG(4, "scanMk6RecordingFile[" << file << "]: starting, " << layout.blocks.size() << " blocks known" << (unchanged ? " (unchanged)" : "") << endl);
+    // Ok. Now we should just read all the (new) blocks in this file!
+    mk6headerreader_type  reader( fd );
+
+    fpos = layout.nextHeader;
+    while( !unchanged && reader.read(fpos, wbh, wb_size) ) {
         // Don't forget that the block sizes written in the Mark6 files are
         // including the write-block-header size! (Guess how I found out
         // that I'd forgotten just that ...)
 
         // Make sure there's sense in the block number and size, otherwise better give up
-        EZASSERT2(wbh->blocknum>=0 && wbh->wb_size>0, vbs_except,
+        EZASSERT2(wbh->blocknum>=0 && wbh->wb_size>=(int32_t)wb_size, vbs_except,
                   EZINFO(" found bogus stuff in write block header @" << fpos << " in " << file <<
                          ", block# " << wbh->blocknum << ", sz=" << wbh->wb_size);
                   ::close(fd));
 
         // Ok, found another block!
-        fpos += wb_size;
-
-        // We cannot tolerate duplicate inserts
-        EZASSERT2(rv.insert(filechunk_type((unsigned int)wbh->blocknum, fpos, wbh->wb_size-wb_size, fd, datastreamid)).second, vbs_except,
-                  EZINFO(" duplicate insert for chunk " << wbh->blocknum); ::close(fd) );
+        layout.blocks.push_back( mk6block_type((unsigned int)wbh->blocknum, fpos + wb_size, wbh->wb_size - wb_size) );
 
         // Advance file pointer
-        fpos += (wbh->wb_size - wb_size);
-        if( ::lseek(fd, fpos, SEEK_SET)==(off_t)-1 ) {
-            DEBUG(4, "scanMk6RecordingFile[" << file << "]: failed to seek to next block @" <<
-                     fpos << " - " << evlbi5a::strerror(errno) << endl);
-            break;
-        }
+        fpos += wbh->wb_size;
     }
-    DEBUG(4, "scanMk6RecordingFile[" << file << "]: done" << endl);
+    layout.nextHeader = fpos;
+
+    // We cannot tolerate duplicate inserts
+    for(mk6blocks_type::const_iterator p=layout.blocks.begin(); p!=layout.blocks.end(); p++)
+        EZASSERT2(rv.insert(filechunk_type(p->blockNumber, p->blockPos, p->blockSize, fd, datastreamid)).second, vbs_except,
+                  EZINFO(" duplicate insert for chunk " << p->blockNumber); ::close(fd) );
+
+    putMk6Layout(file, layout);
+    DEBUG(4, "scanMk6RecordingFile[" << file << "]: done, " << layout.blocks.size() << " blocks" << endl);
 }
@@ -60,6 +60,11 @@ ssize_t vbs_read(int fd, void* buf, size_t count);
 off_t   vbs_lseek(int fd, off_t offset, int whence);
 int     vbs_close(int fd);
 
+/* Like pread(2): read at 'offset' without using or changing the file
+ * pointer. Safe to call from several threads at the same time on the same
+ * file descriptor, as long as no-one closes it. */
+ssize_t vbs_pread(int fd, void* buf, size_t count, off_t offset);
+
 #if 0
 /* Set library debug level. Higher, positive, numbers produce more output. Returns
  * previous level, default is "0", no output. */
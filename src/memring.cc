@@ -0,0 +1,272 @@
+// implementation of the memory ring
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <memring.h>
+#include <mutex_locker.h>
+#include <evlbidebug.h>
+#include <sciprint.h>
+#include <pthreadcall.h>
+
+#include <algorithm>
+
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(memringexception)
+
+namespace {
+    struct slot_type {
+        // 0 whilst being written
+        volatile uint64_t  seq;
+        unsigned int       len;
+        double             t;
+    };
+
+    // The control plane (configure, attach, readers) is serialized by the
+    // mutex; memring_put() and memring_get() don't lock
+    pthread_mutex_t    memring_mutex = PTHREAD_MUTEX_INITIALIZER;
+    // Readers waiting for new data. memring_put() only takes the mutex to
+    // signal the condition if nwaiting says there's someone waiting
+    pthread_mutex_t    wait_mutex    = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t     wait_cond     = PTHREAD_COND_INITIALIZER;
+    volatile unsigned  nwaiting      = 0;
+    uint64_t           ringsize      = 0;
+    unsigned char*     ringdata      = 0;
+    slot_type*         slots         = 0;
+    unsigned int       nslot         = 0;
+    unsigned int       slotsize      = 0;
+    unsigned int       nreader       = 0;
+    uint64_t           nput          = 0;
+    volatile bool      attached      = false;
+    volatile uint64_t  head          = 0;
+
+    double wallclock( void ) {
+        struct timespec  now;
+
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        return now.tv_sec + now.tv_nsec/1.0e9;
+    }
+
+    void release( void ) {
+        ::free( ringdata );
+        delete [] slots;
+        ringdata = 0;
+        slots    = 0;
+        nslot    = 0;
+        slotsize = 0;
+        head     = 0;
+    }
+
+    void wakeup_waiters( void ) {
+        mutex_locker  locker( wait_mutex );
+        PTHREAD_CALL( ::pthread_cond_broadcast(&wait_cond) );
+    }
+}
+
+
+memring_status_type::memring_status_type():
+    size( 0 ), nslot( 0 ), slotsize( 0 ), attached( false ),
+    nput( 0 ), oldest( 0 ), newest( 0 )
+{}
+
+void memring_configure(uint64_t nbytes) {
+    mutex_locker  locker( memring_mutex );
+
+    EZASSERT2(!attached && nreader==0, memringexception,
+              EZINFO("cannot resize the memory ring whilst it is being written or read"));
+    release();
+    ringsize = nbytes;
+}
+
+bool memring_attach(unsigned int blocksize) {
+    mutex_locker  locker( memring_mutex );
+
+    EZASSERT2(!attached, memringexception, EZINFO("the memory ring can only have one writer"));
+    if( ringsize==0 )
+        return false;
+
+    // Reuse the memory, and the data still in there, if we can
+    if( blocksize!=slotsize ) {
+        const uint64_t  n = ringsize / blocksize;
+
+        EZASSERT2(nreader==0, memringexception,
+                  EZINFO("cannot change the memory ring's block size whilst it is being read"));
+        EZASSERT2(blocksize>0 && n>=2 && n<=UINT_MAX, memringexception,
+                  EZINFO("memory ring of " << ringsize << " bytes cannot hold enough blocks of " << blocksize << " bytes"));
+        release();
+        ringdata = (unsigned char*)::malloc( n * blocksize );
+        EZASSERT2(ringdata, memringexception, EZINFO("failed to allocate " << byteprint((double)(n * blocksize), "byte") << " for the memory ring"));
+        slots    = new slot_type[ n ];
+        nslot    = (unsigned int)n;
+        slotsize = blocksize;
+        // Fault in all the pages now rather than whilst capturing
+        ::memset(ringdata, 0, n * blocksize);
+        for(unsigned int i=0; i<nslot; i++) {
+            slots[i].seq = 0;
+            slots[i].len = 0;
+            slots[i].t   = 0;
+        }
+        DEBUG(2, "memring_attach: allocated " << nslot << " x " << byteprint(slotsize, "byte") << endl);
+    }
+    nput     = 0;
+    attached = true;
+    return true;
+}
+
+void memring_detach( void ) {
+    {
+        mutex_locker  locker( memring_mutex );
+        attached = false;
+    }
+    // Readers waiting for more data must learn there won't be any
+    wakeup_waiters();
+}
+
+void memring_put(const block& b) {
+    const uint64_t  s = head + 1;
+    slot_type&      slot( slots[(s - 1) % nslot] );
+    const size_t    n = std::min(b.iov_len, (size_t)slotsize);
+
+    slot.seq = 0;
+    __sync_synchronize();
+    ::memcpy(ringdata + ((s - 1) % nslot) * (uint64_t)slotsize, b.iov_base, n);
+    slot.len = (unsigned int)n;
+    slot.t   = wallclock();
+    __sync_synchronize();
+    slot.seq = s;
+    __sync_synchronize();
+    head     = s;
+    nput++;
+    __sync_synchronize();
+    if( nwaiting )
+        wakeup_waiters();
+}
+
+void memring_open_reader( void ) {
+    mutex_locker  locker( memring_mutex );
+
+    EZASSERT2(nslot>0, memringexception, EZINFO("no data was captured into the memory ring"));
+    nreader++;
+}
+
+void memring_close_reader( void ) {
+    mutex_locker  locker( memring_mutex );
+
+    if( nreader )
+        nreader--;
+}
+
+uint64_t memring_head( void ) {
+    return head;
+}
+
+unsigned int memring_slotsize( void ) {
+    return slotsize;
+}
+
+uint64_t memring_find(double t) {
+    const uint64_t  h = head;
+    uint64_t        s = (h>=nslot ? h - nslot + 1 : 1);
+
+    // Arrival times only increase so we can stop at the first one
+    for( ; s<=h; s++) {
+        const slot_type&  slot( slots[(s - 1) % nslot] );
+
+        if( slot.seq==s && slot.t>=t )
+            break;
+    }
+    return s;
+}
+
+memring_get_result memring_get(uint64_t seq, void* dst, unsigned int& n, double& t) {
+    // The writer detaches after its last put so look at that first
+    const bool      writing = attached;
+    __sync_synchronize();
+    const uint64_t  h = head;
+
+    if( seq>h )
+        return (writing ? memring_notyet : memring_ended);
+    if( h - seq>=nslot )
+        return memring_overwritten;
+
+    const slot_type&  slot( slots[(seq - 1) % nslot] );
+
+    if( slot.seq!=seq )
+        return memring_overwritten;
+    __sync_synchronize();
+    n = slot.len;
+    t = slot.t;
+    ::memcpy(dst, ringdata + ((seq - 1) % nslot) * (uint64_t)slotsize, n);
+    __sync_synchronize();
+    return (slot.seq==seq ? memring_ok : memring_overwritten);
+}
+
+bool memring_wait(uint64_t seq, double until, bool const& stop) {
+    struct timespec  ts;
+    mutex_locker     locker( wait_mutex );
+
+    ts.tv_sec  = (time_t)until;
+    ts.tv_nsec = (long)((until - (double)ts.tv_sec) * 1.0e9);
+    if( ts.tv_nsec>999999999 )
+        ts.tv_nsec = 999999999;
+
+    // Announce ourselves before looking at head: either memring_put()
+    // sees us waiting or we see the new head
+    nwaiting++;
+    __sync_synchronize();
+    while( !stop && attached && seq>head && wallclock()<until ) {
+        int  rv;
+
+        PTHREAD_TIMEDWAIT( (rv=::pthread_cond_timedwait(&wait_cond, &wait_mutex, &ts)), nwaiting-- );
+        if( rv==ETIMEDOUT )
+            break;
+    }
+    nwaiting--;
+    return stop;
+}
+
+void memring_wakeup(bool& stop) {
+    mutex_locker  locker( wait_mutex );
+
+    stop = true;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&wait_cond) );
+}
+
+memring_status_type memring_status( void ) {
+    mutex_locker         locker( memring_mutex );
+    memring_status_type  rv;
+    const uint64_t       h = head;
+
+    rv.size     = ringsize;
+    rv.nslot    = nslot;
+    rv.slotsize = slotsize;
+    rv.attached = attached;
+    rv.nput     = nput;
+    if( h>0 ) {
+        rv.newest = slots[(h - 1) % nslot].t;
+        rv.oldest = slots[(h>=nslot ? h - nslot : 0) % nslot].t;
+    }
+    return rv;
+}
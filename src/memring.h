@@ -0,0 +1,95 @@
+// fixed size ring buffer holding the most recent data captured into memory
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_MEMRING_H
+#define JIVE5A_MEMRING_H
+
+#include <block.h>
+#include <ezexcept.h>
+
+#include <stdint.h>
+
+DECLARE_EZEXCEPT(memringexception)
+
+// The memory ring keeps a copy of the last <size> bytes written by the
+// queue_writer (in2mem, net2mem), each block stamped with its time of
+// arrival. Memory is allocated when the capture starts and is never
+// allocated or freed whilst capturing; the oldest data is overwritten.
+//
+// There is one writer (the queue_writer) and any number of readers. The
+// writer never waits for readers: each slot carries a sequence number
+// which readers check before and after copying the data out, so they
+// detect data being overwritten underneath them. Only to wake up readers
+// waiting for new data it briefly takes a mutex.
+
+// Set the ring size. 0 = no ring. Fails whilst a writer or reader is
+// attached. The memory is (re)allocated on the next memring_attach().
+void     memring_configure(uint64_t nbytes);
+
+// Called by the writer before it starts. Returns false if no ring is
+// configured. Allocates + pre-faults the memory if not done yet or the
+// block size changed.
+bool     memring_attach(unsigned int blocksize);
+void     memring_detach( void );
+
+// Only by the attached writer. Copies at most blocksize bytes of 'b'
+void     memring_put(const block& b);
+
+// Readers must register, it prevents the memory from being resized
+void     memring_open_reader( void );
+void     memring_close_reader( void );
+
+enum memring_get_result {
+    memring_ok, memring_notyet, memring_overwritten, memring_ended
+};
+
+// Sequence numbers count from 1, head() is the last one written
+uint64_t memring_head( void );
+unsigned int memring_slotsize( void );
+
+// Sequence number of the oldest block still in the ring that arrived at or
+// after time 't' (wall clock seconds); head()+1 if there is none yet
+uint64_t memring_find(double t);
+
+// Copy the data of block 'seq' to 'dst' (which must be large enough),
+// returns the number of bytes and the arrival time of the block.
+// memring_ended is returned if the writer detached and 'seq' will never
+// be written
+memring_get_result memring_get(uint64_t seq, void* dst, unsigned int& n, double& t);
+
+// Wait until block 'seq' was written, the writer detached, the wall clock
+// passed 'until' or 'stop' was set by memring_wakeup(). Returns 'stop'.
+bool     memring_wait(uint64_t seq, double until, bool const& stop);
+// Set 'stop' and wake up all memring_wait()ers
+void     memring_wakeup(bool& stop);
+
+struct memring_status_type {
+    uint64_t      size;        // as configured
+    unsigned int  nslot;       // 0 if not allocated yet
+    unsigned int  slotsize;
+    bool          attached;
+    uint64_t      nput;        // total blocks written since attach
+    double        oldest;      // arrival time of oldest, newest block;
+    double        newest;      //  0 if nothing in the ring
+
+    memring_status_type();
+};
+memring_status_type memring_status( void );
+
+#endif
@@ -124,6 +124,9 @@ const mk5commandmap_type& make_mk5a_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("net2sfxc", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2sfxcfork", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2mem", net2mem_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("mem_ring", mem_ring_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_read", vbs_read_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vdif_filter", vdif_filter_fn)).second );
 
     // mem2*
     ASSERT_COND( mk5.insert(make_pair("mem2sfxc", mem2sfxc_fn)).second );
@@ -154,6 +157,9 @@ const mk5commandmap_type& make_mk5a_commandmap( bool buffering ) {
 
     // network stuff
     ASSERT_COND( mk5.insert(make_pair("net_protocol", net_protocol_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_timestamp", net_timestamp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_xdp", net_xdp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("latency_budget", latency_budget_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net_port", net_port_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("mtu", mtu_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("ipd", interpacketdelay_fn)).second );
@@ -272,6 +278,9 @@ const mk5commandmap_type& make_dim_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("net2sfxc", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2sfxcfork", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2mem", net2mem_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("mem_ring", mem_ring_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_read", vbs_read_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vdif_filter", vdif_filter_fn)).second );
 
     // mem2*
     ASSERT_COND( mk5.insert(make_pair("mem2sfxc", mem2sfxc_fn)).second );
@@ -305,6 +314,9 @@ const mk5commandmap_type& make_dim_commandmap( bool buffering ) {
 
     // network stuff
     ASSERT_COND( mk5.insert(make_pair("net_protocol", net_protocol_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_timestamp", net_timestamp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_xdp", net_xdp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("latency_budget", latency_budget_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net_port", net_port_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("mtu", mtu_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("ipd", interpacketdelay_fn)).second );
@@ -394,6 +406,9 @@ const mk5commandmap_type& make_dom_commandmap( bool ) {
 
     // network stuff
     ASSERT_COND( mk5.insert(make_pair("net_protocol", net_protocol_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_timestamp", net_timestamp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_xdp", net_xdp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("latency_budget", latency_budget_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net_port", net_port_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("mtu", mtu_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("ipd", interpacketdelay_fn)).second );
@@ -421,6 +436,9 @@ const mk5commandmap_type& make_dom_commandmap( bool ) {
     ASSERT_COND( mk5.insert(make_pair("net2sfxc", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2sfxcfork", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2mem", net2mem_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("mem_ring", mem_ring_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_read", vbs_read_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vdif_filter", vdif_filter_fn)).second );
 
     // mem2*
     ASSERT_COND( mk5.insert(make_pair("mem2sfxc", mem2sfxc_fn)).second );
@@ -514,6 +532,9 @@ const mk5commandmap_type& make_mk5c_commandmap( bool buffering, bool have_daught
 
     // network stuff
     ASSERT_COND( mk5.insert(make_pair("net_protocol", net_protocol_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_timestamp", net_timestamp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_xdp", net_xdp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("latency_budget", latency_budget_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net_port", net_port_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("mtu", mtu_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("ipd", interpacketdelay_fn)).second );
@@ -540,6 +561,9 @@ const mk5commandmap_type& make_mk5c_commandmap( bool buffering, bool have_daught
     ASSERT_COND( mk5.insert(make_pair("net2sfxc", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2sfxcfork", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2mem", net2mem_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("mem_ring", mem_ring_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_read", vbs_read_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vdif_filter", vdif_filter_fn)).second );
 
     if( have_daughterboard ) {
         // in2*
@@ -631,6 +655,9 @@ const mk5commandmap_type& make_generic_commandmap( bool buffering ) {
 
     // network stuff
     ASSERT_COND( mk5.insert(make_pair("net_protocol", net_protocol_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_timestamp", net_timestamp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("net_xdp", net_xdp_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("latency_budget", latency_budget_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net_port", net_port_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("mtu", mtu_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("ipd", interpacketdelay_fn)).second );
@@ -649,6 +676,9 @@ const mk5commandmap_type& make_generic_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("net2sfxc", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2sfxcfork", net2sfxc_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("net2mem", net2mem_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("mem_ring", mem_ring_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vbs_read", vbs_read_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("vdif_filter", vdif_filter_fn)).second );
 
     ASSERT_COND( mk5.insert(make_pair("mem2sfxc", mem2sfxc_fn)).second );
     
@@ -676,18 +706,21 @@ const mk5commandmap_type& make_generic_commandmap( bool buffering ) {
     ASSERT_COND( mk5.insert(make_pair("net2vbs", net2vbs_wrapped)).second );
     ASSERT_COND( mk5.insert(make_pair("record", net2vbs_wrapped)).second );
     ASSERT_COND( mk5.insert(make_pair("mem2vbs", net2vbs_wrapped)).second );
+    ASSERT_COND( mk5.insert(make_pair("trigger", net2vbs_wrapped)).second );
     // with datastream support
     ASSERT_COND( mk5.insert(make_pair("datastream", datastream_fn)).second );
 
     // Mark6-like
     ASSERT_COND( mk5.insert(make_pair("group_def",  group_def_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("set_disks",  set_disks_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("disk_stats", disk_stats_fn)).second );
 
     ASSERT_COND( mk5.insert(make_pair("transfermode", transfermode_fn)).second );
 
     // Very useful Mark5-like interface to FlexBuf recordings
     ASSERT_COND( mk5.insert(make_pair("file_check",  scan_check_vbs_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("scan_check",  scan_check_vbs_fn)).second );
+    ASSERT_COND( mk5.insert(make_pair("fill_report", fill_report_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("scan_set",    scan_set_vbs_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("disk2file",   disk2file_vbs_fn)).second );
     ASSERT_COND( mk5.insert(make_pair("disk2net",    disk2net_vbs_fn)).second );
@@ -19,6 +19,7 @@
 #include <mk5_exception.h>
 #include <data_check.h>
 #include <mk5command/mk5.h>
+#include <mutex_locker.h>
 #include <iostream>
 
 using namespace std;
@@ -71,8 +72,11 @@ string data_check_5a_fn(bool q, const vector<string>& args, runtime& rte ) {
     data_check_type found_data_type;
 
     // static variables to be able to compute "missing bytes"
+    // data_check may execute on several runtimes at the same time (see
+    // cmdpool.h) so they're only touched whilst holding prev_lock
     static data_check_type prev_data_type;
     static playpointer prev_play_pointer;
+    static pthread_mutex_t prev_lock = PTHREAD_MUTEX_INITIALIZER;
 
     unsigned int first_valid;
     unsigned int first_invalid;
@@ -125,6 +129,7 @@ string data_check_5a_fn(bool q, const vector<string>& args, runtime& rte ) {
         
         unsigned int vdif_threads = (is_vdif(found_data_type.format) ? found_data_type.vdif_threads.size() : 1);
         samplerate_type   track_frame_period = header_format.get_state().frametime;
+        mutex_locker      locker( prev_lock );
         highresdelta_type time_diff          = found_data_type.time - prev_data_type.time;
         int64_t  expected_bytes_diff = boost::rational_cast<int64_t>( (time_diff * header_format.framesize * vdif_threads)/
                                                                       track_frame_period.as<highresdelta_type>() );
@@ -18,6 +18,7 @@
 //          7990 AA Dwingeloo
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
+#include <mutex_locker.h>
 #include <data_check.h>
 #include <iostream>
 
@@ -71,8 +72,11 @@ string data_check_dim_fn(bool q, const vector<string>& args, runtime& rte ) {
     data_check_type found_data_type;
 
     // static variables to be able to compute "missing bytes"
+    // data_check may execute on several runtimes at the same time (see
+    // cmdpool.h) so they're only touched whilst holding prev_lock
     static data_check_type prev_data_type;
     static playpointer prev_play_pointer;
+    static pthread_mutex_t prev_lock = PTHREAD_MUTEX_INITIALIZER;
 
     bool strict = true;
     string strict_arg = OPTARG(1, args);
@@ -134,6 +138,7 @@ string data_check_dim_fn(bool q, const vector<string>& args, runtime& rte ) {
         samplerate_type   frame_period = header_format.get_state().frametime;
         unsigned int      vdif_thread_multiplier = is_vdif(found_data_type.format) ? found_data_type.vdif_threads.size() : 1;
         samplerate_type   data_rate_mbps = found_data_type.trackbitrate * found_data_type.ntrack * vdif_thread_multiplier / 1000000;
+        mutex_locker      locker( prev_lock );
         highresdelta_type time_diff = found_data_type.time - prev_data_type.time;
         int64_t           expected_bytes_diff = boost::rational_cast<int64_t>(
                                 time_diff * header_format.framesize * vdif_thread_multiplier / frame_period.as<highresdelta_type>()
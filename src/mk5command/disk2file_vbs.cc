@@ -21,6 +21,7 @@
 #include <countedpointer.h>
 #include <threadfns.h>
 #include <tthreadfns.h>
+#include <threadfns/parallelvbsreader.h>
 #include <data_check.h>
 #include <iostream>
 #include <sys/types.h>
@@ -227,7 +228,7 @@ string disk2file_vbs_fn(bool qry, const vector<string>& args, runtime& rte ) {
 
     // Almost there!
     chain  c;
-    d2f->vbs_stepid  = c.add(vbsreader_c, 10, d2f->disk_args);
+    d2f->vbs_stepid  = c.add(vbsreader_for(rte), 10, d2f->disk_args);
     d2f->file_stepid = c.add(&fdwriter<block>, &open_file, d2f->file_name + "," + d2f->open_mode, &rte); 
 
     // 22/Feb/2023 MV/BE Don't do this anymore b/c open recording is cached
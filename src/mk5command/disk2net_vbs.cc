@@ -20,6 +20,7 @@
 #include <mk5command/mk5.h>
 #include <threadfns.h>    // for all the processing steps + argument structs
 #include <tthreadfns.h>
+#include <threadfns/parallelvbsreader.h>
 #include <countedpointer.h>
 #include <inttypes.h>     // For SCNu64 and friends
 #include <limits.h>
@@ -194,7 +195,7 @@ string disk2net_vbs_fn( bool qry, const vector<string>& args, runtime& rte) {
             d2n_ptr->disk_args->set_variable_block_size( !(dataformat.valid() && rte.solution) );
             d2n_ptr->disk_args->set_run( false );
 
-            d2n_ptr->vbsstep = c.add(&vbsreader_c, 10, d2n_ptr->disk_args);
+            d2n_ptr->vbsstep = c.add(vbsreader_for(rte), 10, d2n_ptr->disk_args);
             // 22/Feb/2023 MV/BE Don't do this anymore
             //c.register_cancel(d2n_ptr->vbsstep, &close_vbs_c);
 
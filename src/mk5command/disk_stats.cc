@@ -0,0 +1,75 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <diskstats.h>
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+
+// Expect:
+// disk_stats = reset
+// disk_stats?
+//
+// The query returns, for each of the currently selected mountpoints (see
+// "set_disks"), the write statistics collected by recordings:
+//   <mountpoint> : <#chunks> : <rate MB/s> : <latency ms> : <free bytes> :
+//   <#failed> : <#blacklisted> : ok|slow
+string disk_stats_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    if( qry ) {
+        double                      now;
+        const diskstatsmap_type     stats( diskstats_get(now) );
+        mountpointlist_type const&  mps( rte.mk6info.mountpoints );
+
+        reply << "0 : " << mps.size();
+        for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+            diskstatsmap_type::const_iterator  p = stats.find(*mp);
+            const diskstats_type               ds( p==stats.end() ? diskstats_type() : p->second );
+
+            reply << " : " << *mp << " : " << ds.nchunk << " : "
+                  << fixed << setprecision(1) << ds.rate/1.0e6 << " : " << ds.latency*1.0e3 << " : ";
+            if( ds.freeknown )
+                reply << ds.freebytes;
+            else
+                reply << "-";
+            reply << " : " << ds.nfail << " : " << ds.nblacklist << " : " << (ds.until>now ? "slow" : "ok");
+        }
+        reply << " ;";
+        return reply.str();
+    }
+
+    const string  what( OPTARG(1, args) );
+
+    if( what!="reset" ) {
+        reply << "8 : expect 'reset' ;";
+        return reply.str();
+    }
+    // Don't pull the rug from under a recording
+    INPROGRESS(rte, reply, rte.transfermode!=no_transfer)
+
+    diskstats_reset();
+    reply << "0 ;";
+    return reply.str();
+}
@@ -0,0 +1,167 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <countedpointer.h>
+#include <scan_check.h>
+#include <per_runtime.h>
+#include <mutex_locker.h>
+#include <iostream>
+
+#include <errno.h>
+#include <stdlib.h>
+
+using namespace std;
+
+typedef countedpointer<fill_report_type>  fill_report_ptr_type;
+typedef per_runtime<fill_report_ptr_type> fill_report_map_type;
+
+// fill_report may execute on several runtimes at the same time (see
+// cmdpool.h) so only access the map through get_report()/set_report()
+static fill_report_map_type   fill_reports;
+static pthread_mutex_t        fill_reports_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static fill_report_ptr_type get_report(runtime* rteptr) {
+    mutex_locker                    locker( fill_reports_lock );
+    fill_report_map_type::iterator  frptr = fill_reports.find( rteptr );
+
+    return (frptr==fill_reports.end() ? fill_report_ptr_type() : frptr->second);
+}
+
+static void set_report(runtime* rteptr, fill_report_ptr_type const& report) {
+    // The previous report, if this was the last reference, is deleted -
+    // which waits for its threads - after the lock is released
+    fill_report_ptr_type  previous;
+
+    mutex_locker          locker( fill_reports_lock );
+    fill_report_ptr_type& current( fill_reports[rteptr] );
+
+    previous = current;
+    current  = report;
+}
+
+// Default number of threads reading the recording
+static const unsigned int     default_fill_threads = 4;
+// Max number of runs returned per query
+static const size_t           runs_per_reply = 16;
+
+// Expect:
+// fill_report = on [ : <nthread> [ : <pattern> ] ]
+//   Start looking for fill pattern in the recording selected with
+//   "scan_set=" (within its start/end byte range)
+//   !fill_report = 1 : <recording> : <number of bytes> ;
+// fill_report = off
+//   Stop and forget
+// fill_report ?
+//   !fill_report ? <code> : <recording> : <bytes scanned> : <bytes total> :
+//                  <bytes fill> : <number of runs> [ : truncated ] ;
+//   code 1 = still busy, 0 = done; or, if it failed:
+//   !fill_report ? 4 : <recording> : <reason> ;
+// fill_report ? <first>
+//   Byte ranges of fill pattern, at most 16 starting from run # <first>:
+//   !fill_report ? 0 : <first> : <n> [ : <start> : <end> ]* ;
+string fill_report_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    if( qry ) {
+        const string          first_s( OPTARG(1, args) );
+        fill_report_ptr_type  frptr = get_report( &rte );
+
+        if( !frptr ) {
+            reply << "6 : no fill report started ;";
+            return reply.str();
+        }
+        fill_report_type&                    fr( *frptr );
+        const fill_report_type::status_type  st( fr.status() );
+
+        if( first_s.empty() ) {
+            if( st.code ) {
+                reply << st.code << " : " << fr.recname << " : " << st.error << " ;";
+                return reply.str();
+            }
+            reply << (st.done ? 0 : 1) << " : " << fr.recname << " : " << st.nByte << " : " << st.total << " : "
+                  << st.nFill << " : " << st.nRun;
+            if( st.truncated )
+                reply << " : truncated";
+            reply << " ;";
+            return reply.str();
+        }
+        char*              eocptr;
+        unsigned long int  first;
+
+        errno = 0;
+        first = ::strtoul(first_s.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=first_s.c_str() && *eocptr=='\0' && errno!=ERANGE, cmdexception,
+                  EZINFO("run number '" << first_s << "' not a number/out of range"));
+
+        const fillrunlist_type  runs( fr.runs(first, runs_per_reply) );
+
+        reply << "0 : " << first << " : " << runs.size();
+        for(fillrunlist_type::const_iterator run=runs.begin(); run!=runs.end(); run++)
+            reply << " : " << run->start << " : " << run->end;
+        reply << " ;";
+        return reply.str();
+    }
+
+    const string  what( OPTARG(1, args) );
+
+    if( what=="off" ) {
+        set_report( &rte, fill_report_ptr_type() );
+        reply << "0 ;";
+        return reply.str();
+    }
+    if( what!="on" ) {
+        reply << "8 : expect 'on' or 'off' ;";
+        return reply.str();
+    }
+
+    const mk6info_type& mk6info( rte.mk6info );
+    const string        nthread_s( OPTARG(2, args) );
+    const string        pattern_s( OPTARG(3, args) );
+    unsigned long int   nthread = default_fill_threads;
+    uint64_t            pattern = default_fillpattern;
+    char*               eocptr;
+
+    if( mk6info.scanName.empty() ) {
+        reply << "6 : no scan set ;";
+        return reply.str();
+    }
+    if( !nthread_s.empty() ) {
+        errno   = 0;
+        nthread = ::strtoul(nthread_s.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=nthread_s.c_str() && *eocptr=='\0' && errno!=ERANGE && nthread>0 && nthread<=64, cmdexception,
+                  EZINFO("number of threads '" << nthread_s << "' not a number or out of range [1, 64]"));
+    }
+    if( !pattern_s.empty() ) {
+        errno   = 0;
+        pattern = ::strtoull(pattern_s.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=pattern_s.c_str() && *eocptr=='\0' && errno!=ERANGE, cmdexception,
+                  EZINFO("pattern '" << pattern_s << "' not a number/out of range"));
+    }
+    // Stop a previous one before starting to read again
+    set_report( &rte, fill_report_ptr_type() );
+
+    fill_report_ptr_type  fr( new fill_report_type(mk6info.scanName, mk6info.mountpoints, mk6info.tryFormat,
+                                                   mk6info.fpStart, mk6info.fpEnd, pattern, (unsigned int)nthread) );
+    set_report( &rte, fr );
+    reply << "1 : " << fr->recname << " : " << fr->status().total << " ;";
+    return reply.str();
+}
@@ -25,6 +25,7 @@
 #include <mk5command/in2netsupport.h>
 #include <threadfns.h>
 #include <tthreadfns.h>
+#include <threadfns/deadline.h>
 #include <carrayutil.h>
 #include <interchainfns.h>
 #include <dotzooi.h>
@@ -445,6 +446,10 @@ std::string in2net_fn( bool qry, const std::vector<std::string>& args, runtime&
             if( toqueue(rtm) ) {
                 c.add(&queue_writer, queue_writer_args(&rte));
             } else {
+                // Keep the FIFO drained if the network can't keep up
+                if( rte.netparms.latency_budget_ms )
+                    c.add(&latency_budget<block>, 4, deadlineargs(&rte));
+
                 // If compression requested then insert that step now
                 if( rte.solution ) {
                     // In order to prevent bitshift (when the datastream
@@ -0,0 +1,95 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <iostream>
+
+#include <errno.h>
+#include <stdlib.h>
+
+using namespace std;
+
+
+// Expect:
+// latency_budget = off | <ms> [ : drop|fill [ : arrival|frametime ] ]
+//
+// Real-time transfers started after this (in2net, net2out, net2file,
+// net2vbs, ...) hand data on from the reader to the rest of the chain
+// within <ms> milliseconds or not at all; late data is replaced by fill
+// pattern or dropped. The query also returns the number of late items,
+// and of those, how many were filled or dropped in the current/last
+// transfer.
+string latency_budget_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+    netparms_type& np( rte.netparms );
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    // Query available always, command only when doing nothing
+    INPROGRESS(rte, reply, !(qry || rte.transfermode==no_transfer))
+
+    if( qry ) {
+        const latency_stats_type&  ls( rte.latency_stats );
+
+        reply << "0 : ";
+        if( np.latency_budget_ms==0 )
+            reply << "off";
+        else
+            reply << np.latency_budget_ms;
+        reply << " : " << (np.latency_fill ? "fill" : "drop")
+              << " : " << (np.latency_frametime ? "frametime" : "arrival")
+              << " : " << ls.late << " : " << ls.filled << " : " << ls.dropped << " ;";
+        return reply.str();
+    }
+
+    const string  budget( OPTARG(1, args) );
+    const string  policy( OPTARG(2, args) );
+    const string  clock( OPTARG(3, args) );
+
+    if( budget.empty() ) {
+        reply << "8 : Command must have argument ;";
+        return reply.str();
+    }
+
+    if( budget=="off" ) {
+        EZASSERT2(policy.empty() && clock.empty(), cmdexception, EZINFO("'off' takes no further arguments"));
+        RTEEXEC(rte, np.latency_budget_ms = 0);
+        reply << "0 ;";
+        return reply.str();
+    }
+
+    char*              eocptr;
+    unsigned long int  ms;
+
+    errno = 0;
+    ms    = ::strtoul(budget.c_str(), &eocptr, 0);
+    EZASSERT2(eocptr!=budget.c_str() && *eocptr=='\0' && errno!=ERANGE && ms>0 && ms<=60000, cmdexception,
+              EZINFO("budget '" << budget << "' not a number/out of range (1-60000 ms)"));
+    EZASSERT2(policy.empty() || policy=="drop" || policy=="fill", cmdexception,
+              EZINFO("policy '" << policy << "' is not one of drop or fill"));
+    EZASSERT2(clock.empty() || clock=="arrival" || clock=="frametime", cmdexception,
+              EZINFO("clock '" << clock << "' is not one of arrival or frametime"));
+
+    RTEEXEC(rte,
+            np.latency_budget_ms = (unsigned int)ms;
+            np.latency_fill      = (policy=="fill");
+            np.latency_frametime = (clock=="frametime"));
+    reply << "0 ;";
+    return reply.str();
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <memring.h>
+#include <highrestime.h>
+#include <iostream>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+
+static string ring_time(double t) {
+    struct timeval  tv;
+
+    tv.tv_sec  = (time_t)t;
+    tv.tv_usec = (suseconds_t)((t - tv.tv_sec) * 1.0e6);
+    return tm2vex( highrestime_type(tv) );
+}
+
+// Expect:
+// mem_ring = off | <size>[k|M|G]
+//
+// Besides the interchain queue, in2mem and net2mem then keep a copy of
+// the last <size> bytes of data in a fixed size ring in memory, from which
+// "trigger = on : ..." can save a time window.
+// The query returns the size, the number and size of blocks in the ring,
+// wether data is being captured into it and the time range it holds.
+string mem_ring_fn( bool qry, const vector<string>& args, runtime& ) {
+    ostringstream  reply;
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    if( qry ) {
+        const memring_status_type  st( memring_status() );
+
+        reply << "0 : ";
+        if( st.size==0 ) {
+            reply << "off ;";
+            return reply.str();
+        }
+        reply << st.size << " : " << st.nslot << " : " << st.slotsize << " : "
+              << (st.attached ? "active" : "inactive");
+        if( st.newest>0 )
+            reply << " : " << ring_time(st.oldest) << " : " << ring_time(st.newest);
+        reply << " ;";
+        return reply.str();
+    }
+
+    const string  size_s( OPTARG(1, args) );
+
+    if( size_s.empty() ) {
+        reply << "8 : Command must have argument ;";
+        return reply.str();
+    }
+
+    uint64_t  nbytes = 0;
+
+    if( size_s!="off" ) {
+        char*  eocptr;
+
+        errno  = 0;
+        nbytes = ::strtoull(size_s.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=size_s.c_str() && ::strchr("kMG", *eocptr) && errno!=ERANGE && nbytes>0, cmdexception,
+                  EZINFO("size '" << size_s << "' not a number/out of range"));
+        nbytes *= (*eocptr=='k' ? KB : (*eocptr=='M' ? MB : (*eocptr=='G' ? (uint64_t)MB*KB : 1)));
+    }
+    memring_configure( nbytes );
+    reply << "0 ;";
+    return reply.str();
+}
@@ -234,3 +234,8 @@ void throw_on_insane_netprotocol(runtime& rte) {
               EZINFO("Check net_protocol - more than 128MB requested"));
 }
 
+void throw_on_unapplied_vdif_filter(runtime& rte, bool applied) {
+    EZASSERT2(applied || !rte.vdif_filter.active(), cmdexception,
+              EZINFO("vdif_filter is set but this transfer cannot apply it - use vdif_filter = off"));
+}
+
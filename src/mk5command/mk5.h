@@ -95,4 +95,8 @@ unsigned int                register2track( mk5areg::regtype::base_type reg );
 //       a constrain() before calling this one!
 void throw_on_insane_netprotocol(runtime& rte);
 
+// Refuse to set up a transfer that would ignore the VDIF filter
+// ("vdif_filter="). 'applied' tells wether the transfer selects frames.
+void throw_on_unapplied_vdif_filter(runtime& rte, bool applied);
+
 #endif
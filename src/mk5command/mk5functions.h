@@ -78,6 +78,12 @@ std::string clock_set_fn(bool qry, const std::vector<std::string>& args, runtime
 std::string mk5c_playrate_clockset_fn(bool qry, const std::vector<std::string>& args, runtime& rte);
 std::string mk5c_packet_fn(bool qry, const std::vector<std::string>& args, runtime& rte);
 std::string net_protocol_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string net_timestamp_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string net_xdp_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string latency_budget_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string mem_ring_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string vbs_read_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string vdif_filter_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
 std::string status_fn(bool q, const std::vector<std::string>&, runtime& rte);
 std::string debug_fn( bool q, const std::vector<std::string>& args, runtime& rte );
 std::string diag_fn(bool qry, const std::vector<std::string>& args, runtime& rte);
@@ -126,6 +132,8 @@ std::string datastream_fn(bool q, const std::vector<std::string>& args, runtime&
 
 std::string group_def_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string set_disks_fn(bool q, const std::vector<std::string>& args, runtime& rte);
+std::string disk_stats_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
+std::string fill_report_fn( bool qry, const std::vector<std::string>& args, runtime& rte );
 std::string scan_check_vbs_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string scan_set_vbs_fn(bool q, const std::vector<std::string>& args, runtime& rte);
 std::string disk2file_vbs_fn(bool qry, const std::vector<std::string>& args, runtime& rte );
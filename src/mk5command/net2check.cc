@@ -103,6 +103,7 @@ string net2check_fn(bool qry, const vector<string>& args, runtime& rte ) {
             // set read/write and blocksizes based on parameters,
             // dataformats and compression
             rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
+            throw_on_unapplied_vdif_filter(rte, false);
 
             // Start building the chain
             // clear lasthost so it won't bother the "getsok()" which
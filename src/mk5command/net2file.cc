@@ -21,6 +21,7 @@
 #include <threadfns.h>
 #include <tthreadfns.h>
 #include <threadfns/netreader.h>
+#include <threadfns/deadline.h>
 #include <iostream>
 #include <unistd.h>   // for unlink(2)
 
@@ -194,6 +195,10 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
             // dataformats and compression
             rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
 
+            // Only the frames found in strict mode are filtered
+            throw_on_unapplied_vdif_filter(rte, strict && dataformat.valid() && !rte.netparms.latency_budget_ms &&
+                                                is_vdif(dataformat.frameformat));
+
             // Start building the chain
             // Also register cancellationfunctions that will close the
             // network and file filedescriptors and notify the threads
@@ -224,10 +229,22 @@ string net2file_fn(bool qry, const vector<string>& args, runtime& rte ) {
 
             // Insert a framesearcher, if strict mode is requested
             // AND there is a dataformat to look for ...
+            // With a latency budget, age by frame time can only be done
+            // on frames
             if( strict && dataformat.valid() ) {
-                c.add(&framer<frame>, 10, framerargs(dataformat, &rte, strict>1));
-                // only pass on the binary form of the frame
-                c.add(&frame2block, 3);
+                if( rte.netparms.latency_budget_ms ) {
+                    c.add(&framer<frame>, 10, framerargs(dataformat, &rte, strict>1));
+                    c.add(&latency_budget<frame>, 4, deadlineargs(&rte));
+                    // only pass on the binary form of the frame
+                    c.add(&frame2block, 3);
+                } else {
+                    c.add(&framer<framebatch>, 10, framerargs(dataformat, &rte, strict>1));
+                    if( is_vdif(dataformat.frameformat) && rte.vdif_filter.active() )
+                        c.add(&vdiffilter, 4, &rte);
+                    c.add(&framebatch2block, 3);
+                }
+            } else if( rte.netparms.latency_budget_ms ) {
+                c.add(&latency_budget<block>, 4, deadlineargs(&rte));
             }
 
             // And write into a file
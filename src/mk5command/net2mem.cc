@@ -93,6 +93,7 @@ string net2mem_fn(bool qry, const vector<string>& args, runtime& rte ) {
                                            rte.trackbitrate(),
                                            rte.vdifframesize());
         rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
+        throw_on_unapplied_vdif_filter(rte, false);
 
         // Start building the chain
         // clear lasthost so it won't bother the "getsok()" which
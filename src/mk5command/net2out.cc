@@ -21,6 +21,7 @@
 #include <scan_label.h>
 #include <threadfns.h>
 #include <threadfns/netreader.h>
+#include <threadfns/deadline.h>
 #include <limits.h>
 #include <iostream>
 
@@ -269,6 +270,7 @@ string net2out_fn(bool qry, const vector<string>& args, runtime& rte ) {
             rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
 
             throw_on_insane_netprotocol(rte);
+            throw_on_unapplied_vdif_filter(rte, false);
 
             // depending on disk or out, the 2nd arg is optional or not
             if( disk && (args.size()<3 || args[2].empty()) )
@@ -323,6 +325,10 @@ string net2out_fn(bool qry, const vector<string>& args, runtime& rte ) {
             if( rte.solution )
                 c.add(&blockdecompressor, 10, &rte);
 
+            // Keep the network drained if the output can't keep up
+            if( rte.netparms.latency_budget_ms )
+                c.add(&latency_budget<block>, 4, deadlineargs(&rte));
+
             // optionally buffer
             // for net2out we may optionally have to buffer 
             // an amount of bytes. Check if <nbytes> is
@@ -140,6 +140,7 @@ string net2sfxc_fn(bool qry, const vector<string>& args, runtime& rte ) {
             rte.sizes = constrain(rte.netparms, dataformat, rte.solution);
 
             throw_on_insane_netprotocol(rte);
+            throw_on_unapplied_vdif_filter(rte, false);
 
             // Start building the chain
             // clear lasthost so it won't bother the "getsok()" which
@@ -164,9 +165,9 @@ string net2sfxc_fn(bool qry, const vector<string>& args, runtime& rte ) {
             // Insert a framesearcher, if strict mode is requested
             // AND there is a dataformat to look for ...
             if( strict && dataformat.valid() ) {
-                c.add(&framer<frame>, 10, framerargs(dataformat, &rte));
-                // only pass on the binary form of the frame
-                c.add(&frame2block, 3);
+                c.add(&framer<framebatch>, 10, framerargs(dataformat, &rte));
+                // only pass on the binary form of the frames
+                c.add(&framebatch2block, 3);
             }
 
             if ( rtm == net2sfxcfork ) {
@@ -24,6 +24,7 @@
 #include <threadfns/multisend.h>
 #include <threadfns/chunkmakers.h>
 #include <threadfns/multifdreader.h>
+#include <threadfns/deadline.h>
 #include <headersearch.h>
 #include <directory_helper_templates.h>
 #include <regular_expression.h>
@@ -31,12 +32,14 @@
 #include <mountpoint.h>   // for mp_thread_create
 #include <sciprint.h>
 #include <libvbs.h>
+#include <memring.h>
 
 #include <inttypes.h>     // For SCNu64 and friends
 #include <limits.h>
 //#include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <sys/time.h>
 //   #include <ifaddrs.h>
 //   #include <stdio.h>
 //   #include <stdlib.h>
@@ -277,13 +280,14 @@ void restore_blocksize(runtime* rteptr, unsigned int obs) {
 ///////////////////////////////////////////////////////////////////////////////////
 string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool forking) {
     ostringstream                     reply;
-    const transfer_type               rtm( args[0]=="record" ? vbsrecord : string2transfermode(args[0]) ); // requested transfer mode
+    const transfer_type               rtm( args[0]=="record" ? vbsrecord :
+                                           (args[0]=="trigger" ? ring2vbs : string2transfermode(args[0])) ); // requested transfer mode
     const transfer_type               ctm( rte.transfermode ); // current transfer mode
     static per_runtime<nthread_type>  nthread;
     static per_runtime<chain::stepid> use_closefd;
 
     // Assert that the requested transfermode is one that we support
-    EZASSERT2(rtm==net2vbs || rtm==fill2vbs || rtm==vbsrecord || rtm==mem2vbs, cmdexception,
+    EZASSERT2(rtm==net2vbs || rtm==fill2vbs || rtm==vbsrecord || rtm==mem2vbs || rtm==ring2vbs, cmdexception,
               EZINFO("This implementation of net2vbs_fn does not support '" << args[0] << "'"));
 
     // we can already form *this* part of the reply
@@ -310,6 +314,12 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
             reply << rte.mk6info.mk6;
         } else if( what=="check_unique_recording_names" ) {
             reply << rte.mk6info.unique_recording_names;
+        } else if( what=="align_frames" ) {
+            reply << rte.mk6info.align_frames;
+        } else if( what=="stream_pipelines" ) {
+            reply << rte.mk6info.stream_pipelines;
+            for(size_t i=0; i<rte.mk6info.stream_cpus.size(); i++)
+                reply << (i ? "," : " : ") << rte.mk6info.stream_cpus[i];
         } else {
             if( ctm==no_transfer || rtm!=ctm ) {
                 // GiuseppeM suggests to return "on/off" for record?
@@ -320,7 +330,7 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                 reply << (ctm==vbsrecord ? "on" : "active");
                 // If we are doing something that behaves like 'record=on'
                 // insert the recording name in the query reply
-                if( rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs )
+                if( rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs || rtm==ring2vbs )
                     reply << " : " << rte.mk6info.dirList.size() << " : " << *rte.mk6info.dirList.begin();
                 // And add the byte counter
                 reply << " : " << rte.statistics.counter(0);
@@ -344,8 +354,9 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
     //                                                 it was "open/close" ...
     // record   = on : <scan name>
     // mem2vbs  = on : <scan name>
+    // trigger  = on : <scan name> [ : <pre trigger s> [ : <post trigger s> ] ]
     if( (rtm==net2vbs && args[1]=="open") ||
-        ((rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs) && args[1]=="on") ) {
+        ((rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs || rtm==ring2vbs) && args[1]=="on") ) {
         recognized = true;
         // if transfermode is not no_transfer, we ARE already doing stuff
         if( rte.transfermode==no_transfer ) {
@@ -461,6 +472,23 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                 //bool useStreams = false;
                 bool haveTags   = false;
                 string suffixSource; // "net_port" or "datastream"
+                // Per stream pipelines: the readers make the chunks
+                bool haveChunks = false;
+
+                // For the step(s) which transform block => chunk_type,
+                // i.e. count the chunks and generate filenames:
+                // Set number of buffer positions to number of mountpoints+1 
+                // such that there's always enough positions free to be
+                // writing to each mountpoint in parallel - or - should
+                // there be less mountpoints than parallel writers, use that
+                unsigned int const   nMountpoints = 1 + std::max(SAFE_UINT_CAST(rte.mk6info.mountpoints.size()),
+                                                                 SAFE_UINT_CAST(nthreadref.nParallelWriter));
+                // Optionally cut the chunks at frame boundaries
+                chunkmakerargs_type  chunkmakerargs( mk6info.align_frames ?
+                                                     chunkmakerargs_type(&rte, scanname,
+                                                                         headersearch_type(rte.trackformat(), rte.ntrack(),
+                                                                                           rte.trackbitrate(), rte.vdifframesize())) :
+                                                     chunkmakerargs_type(&rte, scanname) );
 
                 if( rtm==mem2vbs ) {
                     // Add a queue reader
@@ -468,6 +496,33 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                     qra.run = true;
                     c.register_cancel(c.add(&queue_reader, 4, qra), &cancel_queue_reader);
                     c.register_final(&finalize_queue_reader, &rte);
+                } else if( rtm==ring2vbs ) {
+                    // Save what's in the memory ring from <pre> seconds
+                    // before now until <post> seconds after
+                    const string         pre_s( OPTARG(3, args) );
+                    const string         post_s( OPTARG(4, args) );
+                    double               pre = -1, post = 0;
+                    char*                eocptr;
+                    struct timeval       now;
+
+                    EZASSERT2( memring_status().nslot>0, cmdexception,
+                               EZINFO("nothing was captured into the memory ring (see mem_ring)") );
+                    if( !pre_s.empty() ) {
+                        pre = ::strtod(pre_s.c_str(), &eocptr);
+                        EZASSERT2( eocptr!=pre_s.c_str() && *eocptr=='\0' && pre>=0, cmdexception,
+                                   EZINFO("pre trigger time '" << pre_s << "' is not a number of seconds >= 0") );
+                    }
+                    if( !post_s.empty() ) {
+                        post = ::strtod(post_s.c_str(), &eocptr);
+                        EZASSERT2( eocptr!=post_s.c_str() && *eocptr=='\0' && post>=0, cmdexception,
+                                   EZINFO("post trigger time '" << post_s << "' is not a number of seconds >= 0") );
+                    }
+                    ::gettimeofday(&now, 0);
+                    const double  t_trigger = now.tv_sec + now.tv_usec/1.0e6;
+
+                    // no pre trigger time = everything in the ring
+                    c.register_cancel(c.add(&ring_reader, 4, ring_reader_args(&rte, (pre<0 ? 0.0 : t_trigger - pre), t_trigger + post)),
+                                      &cancel_ring_reader);
                 } else {
                     // This is not mem2vbs so has to be net2* so when the
                     // recording is to be shut off, we first close the
@@ -477,6 +532,9 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                     bool const     datastreams_defined = !mk6info.datastreams.empty();
                     chain::stepid  readstep = chain::invalid_stepid;
 
+                    // Only the data stream readers select VDIF frames
+                    throw_on_unapplied_vdif_filter(rte, datastreams_defined);
+
                     DEBUG(1, "net2vbs/recording: suffixes_on_ports=" << suffixes_on_ports <<
                              " (n_non_empty_suffixes=" << rte.netparms.n_non_empty_suffixes() << ")" <<
                              " datastreams_defined=" << datastreams_defined << std::endl)
@@ -523,8 +581,23 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                         // AND n_non_empty_suffixes > 0
                         if( (haveTags = (rte.netparms.n_port()>1 && suffixes_on_ports)) )
                             suffixSource = "net_port";
+                        // Each port can have its own reader -> chunkmaker
+                        // pipeline. The shared forker/latency budget steps
+                        // can't be done that way
+                        if( mk6info.stream_pipelines ) {
+                            haveChunks = (haveTags && !forking && rte.netparms.latency_budget_ms==0);
+                            DEBUG(1, "net2vbs/recording: per stream pipelines " << (haveChunks ? "" : "NOT ") << "used" <<
+                                     (haveTags ? "" : " (need > 1 net_port with suffixes)") <<
+                                     (forking ? " (forking)" : "") <<
+                                     (rte.netparms.latency_budget_ms ? " (latency budget)" : "") << std::endl);
+                        }
                         //readstep = c.add(&netreader, 4, &net_server, networkargs(&rte, true));
-                        if( haveTags )
+                        if( haveChunks ) {
+                            if( mk6info.mk6 )
+                                readstep = c.add(&multifdchunker<MK6Namer>, nMountpoints, &multinetchunkopener, &rte, chunkmakerargs);
+                            else
+                                readstep = c.add(&multifdchunker<VBSNamer>, nMountpoints, &multinetchunkopener, &rte, chunkmakerargs);
+                        } else if( haveTags )
                             readstep = c.add(&multifdreader< tagged<block> > , 4, &multinetopener, &rte);
                         else
                             readstep = c.add(&multifdreader< block >         , 4, &multinetopener, &rte);
@@ -556,16 +629,19 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                         use_closefd[ &rte ] = readstep;
                 }
 
+                // Stop a slow disk from blocking the reader
+                if( rte.netparms.latency_budget_ms && rtm!=ring2vbs ) {
+                    if( haveTags )
+                        c.add(&latency_budget< tagged<block> >, 4, deadlineargs(&rte));
+                    else
+                        c.add(&latency_budget<block>, 4, deadlineargs(&rte));
+                }
+
                 // Must add a step which transforms block => chunk_type,
                 // i.e. count the chunks and generate filenames
-                // Set number of buffer positions to number of mountpoints+1 
-                // such that there's always enough positions free to be
-                // writing to each mountpoint in parallel - or - should
-                // there be less mountpoints than parallel writers, use that
-                unsigned int const   nMountpoints = 1 + std::max(SAFE_UINT_CAST(rte.mk6info.mountpoints.size()),
-                                                                 SAFE_UINT_CAST(nthreadref.nParallelWriter));
-                chunkmakerargs_type  chunkmakerargs(&rte, scanname);
-                if( haveTags ) {
+                if( haveChunks ) {
+                    // the readers did it already
+                } else if( haveTags ) {
                     EZASSERT2(suffixSource=="datastreams" || suffixSource=="net_port", cmdexception,
                               EZINFO("Unknown suffix source '" << suffixSource << "'"));
                     if( mk6info.mk6 ) {
@@ -648,8 +724,9 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
     //                                                 it was "open/close" ...
     // record   = off
     // mem2vbs  = off
+    // trigger  = off
     if( (rtm==net2vbs && args[1]=="close") ||
-        ((rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs) && args[1]=="off") ) {
+        ((rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs || rtm==ring2vbs) && args[1]=="off") ) {
             recognized = true;
             // Only allow if we're doing net2vbs
             // Don't care if we were running or not
@@ -711,7 +788,7 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
                 //             so we must invalidate the cache such that
                 //             a subsequent scan_check? or scan_set= or disk2*
                 //             open the new recording
-                if( rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs ) {
+                if( rtm==vbsrecord || rtm==mem2vbs || rtm==fill2vbs || rtm==ring2vbs ) {
                     rte.mk6info.scanName = *rte.mk6info.dirList.begin();
                     rte.mk6info.fpStart  = 0;
                     rte.mk6info.fpEnd    = 0;
@@ -819,6 +896,67 @@ string net2vbs_fn( bool qry, const vector<string>& args, runtime& rte, bool fork
         // Fine. We don't look at the actual value
         rte.mk6info.unique_recording_names = (urn!=0);
     }
+    if( args[1]=="align_frames" ) {
+        char*             eocptr;
+        const string      align_s( OPTARG(2, args) );
+
+        // this command _requires_ an argument
+        EZASSERT2(align_s.empty()==false, cmdexception, EZINFO("this command requires a parameter"));
+
+        recognized = true;
+        reply << " 0 ;";
+
+        long int af;
+
+        errno = 0;
+        af    = ::strtol(align_s.c_str(), &eocptr, 0);
+
+        // Check if it's a number
+        EZASSERT2(eocptr!=align_s.c_str() && *eocptr=='\0' && errno!=ERANGE,
+                  cmdexception,
+                  EZINFO("align_frames '" << align_s << "' out of range") );
+
+        rte.mk6info.align_frames = (af!=0);
+    }
+    if( args[1]=="stream_pipelines" ) {
+        char*                 eocptr;
+        const string          sp_s( OPTARG(2, args) );
+        const string          cpus_s( OPTARG(3, args) );
+        vector<unsigned int>  cpus;
+
+        // this command _requires_ an argument
+        EZASSERT2(sp_s.empty()==false, cmdexception, EZINFO("this command requires a parameter"));
+
+        long int sp;
+
+        errno = 0;
+        sp    = ::strtol(sp_s.c_str(), &eocptr, 0);
+
+        // Check if it's a number
+        EZASSERT2(eocptr!=sp_s.c_str() && *eocptr=='\0' && errno!=ERANGE,
+                  cmdexception,
+                  EZINFO("stream_pipelines '" << sp_s << "' out of range") );
+
+        // Optional comma separated list of CPUs to run stream #0, #1, ... on
+        if( !cpus_s.empty() ) {
+            const vector<string>  cpu_l( ::split(cpus_s, ',') );
+
+            for(vector<string>::const_iterator cpu=cpu_l.begin(); cpu!=cpu_l.end(); cpu++) {
+                unsigned long int  c;
+
+                errno = 0;
+                c     = ::strtoul(cpu->c_str(), &eocptr, 0);
+                EZASSERT2(eocptr!=cpu->c_str() && *eocptr=='\0' && errno!=ERANGE && c<1024, cmdexception,
+                          EZINFO("CPU '" << *cpu << "' not a number/out of range (0-1023)"));
+                cpus.push_back( (unsigned int)c );
+            }
+        }
+        recognized = true;
+        reply << " 0 ;";
+
+        rte.mk6info.stream_pipelines = (sp!=0);
+        rte.mk6info.stream_cpus      = cpus;
+    }
     if( !recognized )
         reply << " 2 : " << args[1] << " does not apply to " << args[0] << " ;";
 
@@ -27,13 +27,15 @@ using namespace std;
 
 
 // Expect:
-// net_protcol=<protocol>[:<socbufsize>[:<blocksize>[:<nblock>]]
+// net_protcol=<protocol>[:<socbufsize>[:<blocksize>[:<nblock>[:<nstripe>]]]]
 // 
 // Note: existing uses of eVLBI protocolvalues mean that when "they" say
 //       'netprotcol=udp' they *actually* mean 'netprotocol=udps'
 //       (see netparms.h for details). We will transform this silently and
 //       add another value, "pudp" which will get translated into plain udp.
 // Note: socbufsize will set BOTH send and RECV bufsize
+// Note: nstripe is only meaningful for protocol "mtcp"; the number of
+//       parallel TCP connections the data is striped over
 string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
     ostringstream  reply;
     netparms_type& np( rte.netparms );
@@ -63,8 +65,10 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
         else
             reply << "Rx " << np.rcvbufsize << ", Tx " << np.sndbufsize;
         reply << " : " << np.get_blocksize()
-              << " : " << np.nblock 
-              << " ;";
+              << " : " << np.nblock;
+        if( proto_cp=="mtcp" )
+            reply << " : " << np.nstripe;
+        reply << " ;";
         return reply.str();
     }
 
@@ -81,6 +85,7 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
     const string sokbufsz( OPTARG(2, args) );
     const string workbufsz( OPTARG(3, args) );
     const string nbuf( OPTARG(4, args) );
+    const string nstripe( OPTARG(5, args) );
 
     // See which arguments we got
     // #1 : <protocol>
@@ -89,7 +94,8 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
     //               protect against typos. It's a simple thing to add.
     if( proto.empty()==false ) {
         static string const recognized[] = { "udp", "pudp", "udps", "udpsnor", "udt",
-                                             "vtp", "tcp", "rtcp", "itcp", /*"iudt",*/ "unix" };
+                                             "vtp", "tcp", "rtcp", "itcp", /*"iudt",*/ "unix",
+                                             "mtcp" };
 
         // For now remain case-sensitive; the code in jive5ab only checks
         // agains lower case net_protocols. So better to check here against
@@ -166,8 +172,20 @@ string net_protocol_fn( bool qry, const vector<string>& args, runtime& rte ) {
         else
             reply << "!" << args[0] << " = 8 : <nbuf> out of range - 0 or too large ;";
     }
-    if( args.size()>5 )
-        DEBUG(1,"Extra arguments (>5) ignored" << endl);
+
+    // #5 : <nstripe>
+    if( nstripe.empty()==false ) {
+        unsigned long int   v = ::strtoul(nstripe.c_str(), 0, 0);
+
+        // The receiver keeps one reader thread per stripe; a (very) large
+        // number of those is not going to help anyone
+        if( v>0 && v<=64 )
+            np.nstripe = (unsigned int)v;
+        else
+            reply << "!" << args[0] << " = 8 : <nstripe> out of range - 0 or > 64 ;";
+    }
+    if( args.size()>6 )
+        DEBUG(1,"Extra arguments (>6) ignored" << endl);
 
     // If reply is still empty, the command was executed succesfully - indicate so
     if( reply.str().empty() )
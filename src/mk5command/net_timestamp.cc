@@ -0,0 +1,57 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <iostream>
+
+using namespace std;
+
+
+// Expect:
+// net_timestamp = on | off
+//
+// Time stamp each datagram received by the udps and udpsnor network
+// readers and collect the inter-arrival times and, for VDIF, the arrival
+// time w.r.t. the frame time stamp, per stream. See evlbi? for the output.
+string net_timestamp_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+    netparms_type& np( rte.netparms );
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    // Query available always, command only when doing nothing
+    INPROGRESS(rte, reply, !(qry || rte.transfermode==no_transfer))
+
+    if( qry ) {
+        reply << "0 : " << (np.rx_timestamp ? "on" : "off") << " ;";
+        return reply.str();
+    }
+
+    const string  onoff( OPTARG(1, args) );
+
+    if( onoff.empty() ) {
+        reply << "8 : Command must have argument ;";
+        return reply.str();
+    }
+    EZASSERT2(onoff=="on" || onoff=="off", cmdexception, EZINFO("argument must be 'on' or 'off'"));
+
+    RTEEXEC(rte, np.rx_timestamp = (onoff=="on"));
+    reply << "0 ;";
+    return reply.str();
+}
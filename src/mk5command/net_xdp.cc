@@ -0,0 +1,97 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <carrayutil.h>
+#include <iostream>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <net/if.h>
+
+using namespace std;
+
+
+// Expect:
+// net_xdp = off | <interface> [ : <queue> [ : auto|copy|zerocopy ] ]
+//
+// Selects kernel-bypass (AF_XDP) capture for the udps and udpsnor network
+// readers. UDP datagrams for the data port arriving on <queue> of
+// <interface> are taken straight from the NIC; everything else is left to
+// the kernel. Query returns "off" or the interface : queue : mode.
+string net_xdp_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+    netparms_type& np( rte.netparms );
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    // Query available always, command only when doing nothing
+    INPROGRESS(rte, reply, !(qry || rte.transfermode==no_transfer))
+
+    if( qry ) {
+        if( np.xdp_interface.empty() )
+            reply << "0 : off ;";
+        else
+            reply << "0 : " << np.xdp_interface << " : " << np.xdp_queue << " : " << np.xdp_mode << " ;";
+        return reply.str();
+    }
+
+    const string  iface( OPTARG(1, args) );
+    const string  queue( OPTARG(2, args) );
+    const string  mode( OPTARG(3, args) );
+
+    if( iface.empty() ) {
+        reply << "8 : Command must have argument ;";
+        return reply.str();
+    }
+
+    if( iface=="off" ) {
+        EZASSERT2(queue.empty() && mode.empty(), cmdexception, EZINFO("'off' takes no further arguments"));
+        RTEEXEC(rte, np.xdp_interface.clear());
+        reply << "0 ;";
+        return reply.str();
+    }
+
+#if HAVE_AFXDP
+    EZASSERT2(::if_nametoindex(iface.c_str())>0, cmdexception, EZINFO("no such interface '" << iface << "'"));
+
+    unsigned long int  q = 0;
+    if( queue.empty()==false ) {
+        char*  eocptr;
+
+        errno = 0;
+        q     = ::strtoul(queue.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=queue.c_str() && *eocptr=='\0' && errno!=ERANGE && q<1024, cmdexception,
+                  EZINFO("queue '" << queue << "' not a number/out of range (0-1023)"));
+    }
+
+    static string const  modes[] = { "auto", "copy", "zerocopy" };
+    EZASSERT2(mode.empty() || find_element(mode, modes), cmdexception,
+              EZINFO("mode '" << mode << "' is not one of auto, copy or zerocopy"));
+
+    RTEEXEC(rte,
+            np.xdp_interface = iface;
+            np.xdp_queue     = (unsigned int)q;
+            np.xdp_mode      = (mode.empty() ? string("auto") : mode));
+    reply << "0 ;";
+#else
+    reply << "4 : AF_XDP support was not compiled in ;";
+#endif
+    return reply.str();
+}
@@ -21,10 +21,86 @@
 #include <data_check.h>
 #include <countedpointer.h>
 #include <scan_check.h>
+#include <per_runtime.h>
+#include <mutex_locker.h>
 #include <iostream>
 
 using namespace std;
 
+typedef countedpointer<scan_check_batch_type>  batch_ptr_type;
+typedef per_runtime<batch_ptr_type>            batch_map_type;
+
+// scan_check may execute on several runtimes at the same time (see
+// cmdpool.h) so only access the map through get_batch()/set_batch()
+static batch_map_type   scan_check_batches;
+static pthread_mutex_t  scan_check_batches_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static batch_ptr_type get_batch(runtime* rteptr) {
+    mutex_locker              locker( scan_check_batches_lock );
+    batch_map_type::iterator  bptr = scan_check_batches.find( rteptr );
+
+    return (bptr==scan_check_batches.end() ? batch_ptr_type() : bptr->second);
+}
+
+static void set_batch(runtime* rteptr, batch_ptr_type const& batch) {
+    // The previous batch, if this was the last reference, is deleted -
+    // which waits for its threads - after the lock is released
+    batch_ptr_type  previous;
+
+    mutex_locker    locker( scan_check_batches_lock );
+    batch_ptr_type& current( scan_check_batches[rteptr] );
+
+    previous = current;
+    current  = batch;
+}
+
+// Default number of recordings checked in parallel by "scan_check=batch"
+static const unsigned int default_batch_threads = 8;
+
+// Parse the optional "bytes to read" argument. Returns the error part of
+// the reply (" <code> : <reason> ;") if the argument is unacceptable,
+// empty string otherwise
+static string parse_bytes_to_read(string const& bytes_to_read_arg, uint64_t& bytes_to_read) {
+    ostringstream  err;
+
+    bytes_to_read = 1000000;  // read 1MB by default
+    if ( !bytes_to_read_arg.empty() ) {
+        char*             eptr;
+        unsigned long int v = ::strtoull(bytes_to_read_arg.c_str(), &eptr, 0);
+
+        // was a unit given? [note: all whitespace has already been stripped
+        // by the main commandloop]
+        EZASSERT2( eptr!=bytes_to_read_arg.c_str() && ::strchr("kM\0", *eptr),
+                   cmdexception,
+                   EZINFO("invalid number of bytes to read '" << bytes_to_read_arg << "'") );
+
+        // Now we can do this
+        bytes_to_read = v * ((*eptr=='k')?KB:(*eptr=='M'?MB:1));
+        if ( bytes_to_read > 2ull * KB * KB * KB ) {
+            err << " 8 : maximum value for bytes to read is 2 GB ;";
+            return err.str();
+        }
+    }
+    bytes_to_read &= ~0x7; // be sure it's a multiple of 8
+    if ( bytes_to_read == 0 )
+        err << " 8 : need to read more than 0 bytes to detect anything ;";
+    return err.str();
+}
+
+// Id. for the "strict" argument
+static string parse_strict(string const& strict_arg, bool& strict) {
+    strict = true;
+    if ( !strict_arg.empty() ) {
+        if (strict_arg == "0" ) {
+            strict = false;
+        }
+        else if (strict_arg != "1" ) {
+            return " 8 : strict argument has to be 0 or 1 ;";
+        }
+    }
+    return string();
+}
+
 //
 // Usage:
 // (scan|file)_check ? verbose
@@ -36,6 +112,18 @@ using namespace std;
 // Set verbose to an explicit value in the current runtime
 // (scan|file)_check = verbose : (true|1|false|0)
 //
+// Check all FlexBuff/Mark6 recordings on the current set of disks whose
+// name matches the shell wildcard <pattern>, <nthread> at a time
+// (default 8):
+// scan_check = batch : <pattern> [ : strictness [ : number of bytes to read [ : nthread ] ] ]
+//   !scan_check = 1 : <number of recordings found> ;
+// Retrieve the results in alphabetical order of recording name, one per
+// query:
+// scan_check ? batch
+//   !scan_check ? 0 : <n> : <recording> : <scan check result> ;   (next result)
+//   !scan_check ? 1 : batch : <n checked> : <n recordings> ;      (next one not done yet)
+//   !scan_check ? 0 : batch : done : <n recordings> ;             (all results returned)
+//
 
 string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     const bool    from_file       = ( args[0] == "file_check" );
@@ -66,6 +154,46 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
             reply << " 0 ;";
             return reply.str();
         }
+        if( verbose_s=="batch" && !from_file ) {
+            const mk6info_type& mk6info( rte.mk6info );
+            const string        pattern( OPTARG(2, args) );
+            const string        nthread_arg( OPTARG(5, args) );
+            bool                strict;
+            string              err;
+            uint64_t            bytes_to_read;
+            unsigned long int   nthread = default_batch_threads;
+
+            if( pattern.empty() ) {
+                reply << " 8 : batch needs a pattern of recording names ;";
+                return reply.str();
+            }
+            if( mk6info.mountpoints.empty() || is_null_diskset(mk6info.mountpoints) ) {
+                reply << " 6 : no disks selected to find recordings on ;";
+                return reply.str();
+            }
+            if( !(err=parse_strict(OPTARG(3, args), strict)).empty() ||
+                !(err=parse_bytes_to_read(OPTARG(4, args), bytes_to_read)).empty() ) {
+                reply << err;
+                return reply.str();
+            }
+            if( !nthread_arg.empty() ) {
+                char*  eptr;
+
+                nthread = ::strtoul(nthread_arg.c_str(), &eptr, 0);
+                EZASSERT2( eptr!=nthread_arg.c_str() && *eptr=='\0' && nthread>0 && nthread<=64, cmdexception,
+                           EZINFO("number of threads '" << nthread_arg << "' not a number or out of range [1, 64]") );
+            }
+            // A previous batch, if any, must be stopped before we start
+            // listing the disks again
+            set_batch( &rte, batch_ptr_type() );
+
+            batch_ptr_type  batch( new scan_check_batch_type(pattern, mk6info.mountpoints, mk6info.tryFormat,
+                                                             bytes_to_read, strict, rte.verbose_scancheck,
+                                                             (unsigned int)nthread) );
+            set_batch( &rte, batch );
+            reply << " " << (batch->size() ? 1 : 0) << " : " << batch->size() << " ;";
+            return reply.str();
+        }
         reply << " 2 : only available as query ;";
         return reply.str();
     }
@@ -93,6 +221,34 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
         return reply.str();
     }
 
+    // Next result of "scan_check = batch : ..."
+    if( arg1=="batch" && !from_file ) {
+        unsigned int                       idx;
+        batch_ptr_type                     bptr = get_batch( &rte );
+        scan_check_batch_type::result_type result( "" );
+
+        if( !bptr ) {
+            reply << " 6 : no batch scan check started ;";
+            return reply.str();
+        }
+        scan_check_batch_type&  batch( *bptr );
+
+        if( batch.next_result(idx, result) ) {
+            ostringstream  id;
+
+            id << " : " << (idx + 1) << " : " << result.recname;
+            if( result.code==0 )
+                reply << " 0" << id.str() << vsi_format(result.sct, is_dim ? vsi_format::VSI_S_TOTALDATARATE : vsi_format::VSI_S_NONE);
+            else
+                reply << " " << result.code << id.str() << " : " << result.error << " ;";
+        } else if( batch.exhausted() ) {
+            reply << " 0 : batch : done : " << batch.size() << " ;";
+        } else {
+            reply << " 1 : batch : " << batch.nDone() << " : " << batch.size() << " ;";
+        }
+        return reply.str();
+    }
+
     // Query is only available if disks are available/not busy
     INPROGRESS(rte, reply, have_streamstor && streamstorbusy(rte.transfermode))
 
@@ -140,29 +296,11 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     //
     // Handle the "bytes to read" argument, if given
     //
-    string   bytes_to_read_arg = OPTARG(2, args);
-    uint64_t bytes_to_read = 1000000;  // read 1MB by default
-
-    if ( !bytes_to_read_arg.empty() ) {
-        char*             eptr;
-        unsigned long int v = ::strtoull(bytes_to_read_arg.c_str(), &eptr, 0);
+    string    err;
+    uint64_t  bytes_to_read;
 
-        // was a unit given? [note: all whitespace has already been stripped
-        // by the main commandloop]
-        EZASSERT2( eptr!=bytes_to_read_arg.c_str() && ::strchr("kM\0", *eptr),
-                   cmdexception,
-                   EZINFO("invalid number of bytes to read '" << bytes_to_read_arg << "'") );
-
-        // Now we can do this
-        bytes_to_read = v * ((*eptr=='k')?KB:(*eptr=='M'?MB:1));
-        if ( bytes_to_read > 2ull * KB * KB * KB ) {
-            reply << " 8 : maximum value for bytes to read is 2 GB ;";
-            return reply.str();
-        }
-    }
-    bytes_to_read &= ~0x7; // be sure it's a multiple of 8
-    if ( bytes_to_read == 0 ) {
-        reply << " 8 : need to read more than 0 bytes to detect anything ;";
+    if( !(err=parse_bytes_to_read(OPTARG(2, args), bytes_to_read)).empty() ) {
+        reply << err;
         return reply.str();
     }
 
@@ -174,17 +312,11 @@ string scan_check_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     //
     // Handle the "strict" argument, if given
     //
-    bool   strict = true;
-    string strict_arg = OPTARG(1, args);
+    bool   strict;
 
-    if ( !strict_arg.empty() ) {
-        if (strict_arg == "0" ) {
-            strict = false;
-        }
-        else if (strict_arg != "1" ) {
-            reply << " 8 : strict argument has to be 0 or 1 ;";
-            return reply.str();
-        }
+    if( !(err=parse_strict(OPTARG(1, args), strict)).empty() ) {
+        reply << err;
+        return reply.str();
     }
     // Actually perform the analysis/algorithm
     // By saving the result we can output it as debug info in full and not
@@ -18,6 +18,7 @@
 //          7990 AA Dwingeloo
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
+#include <mutex_locker.h>
 #include <data_check.h>
 #include <dotzooi.h>
 #include <iostream>
@@ -30,7 +31,10 @@ string scan_set_fn(bool q, const vector<string>& args, runtime& rte) {
     // but user communication is one based
     ostringstream              reply;
     const transfer_type        ctm( rte.transfermode );
+    // scan_set may execute on several runtimes at the same time (see
+    // cmdpool.h) so the map is only accessed whilst holding the lock
     static per_runtime<string> previous_search_string;
+    static pthread_mutex_t     previous_search_lock = PTHREAD_MUTEX_INITIALIZER;
 
     reply << "!" << args[0] << (q?('?'):('='));
 
@@ -118,6 +122,8 @@ string scan_set_fn(bool q, const vector<string>& args, runtime& rte) {
             string search_string = args[1];
             unsigned int next_scan = 0;
             if ( args[1] == "next" ) {
+                mutex_locker  locker( previous_search_lock );
+
                 if ( previous_search_string.find(&rte) == previous_search_string.end() ) {
                     reply << " 4 : no search string given yet ;";
                     return reply.str();
@@ -126,7 +132,10 @@ string scan_set_fn(bool q, const vector<string>& args, runtime& rte) {
                 next_scan = rte.current_scan + 1;
             }
             unsigned int end_scan = next_scan + nScans;
-            previous_search_string[&rte] = search_string;
+            {
+                mutex_locker  locker( previous_search_lock );
+                previous_search_string[&rte] = search_string;
+            }
             // search string is case insensitive, convert both to uppercase
             search_string = toupper(search_string);
             
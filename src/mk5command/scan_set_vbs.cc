@@ -18,6 +18,7 @@
 //          7990 AA Dwingeloo
 #include <mk5_exception.h>
 #include <mk5command/mk5.h>
+#include <mutex_locker.h>
 #include <scan_check.h>
 #include <dotzooi.h>
 #include <countedpointer.h>
@@ -37,7 +38,10 @@ string scan_set_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
     scanlist_type&             dirList = mk6info.dirList;
     const transfer_type        ctm( rte.transfermode );
     const bool                 isRecording( ctm==vbsrecord || ctm==fill2vbs || ctm==mem2vbs );
+    // scan_set may execute on several runtimes at the same time (see
+    // cmdpool.h) so the map is only accessed whilst holding the lock
     static per_runtime<string> previous_search_string;
+    static pthread_mutex_t     previous_search_lock = PTHREAD_MUTEX_INITIALIZER;
 
     // The new scan settings
     string                           scanName = mk6info.scanName;
@@ -159,6 +163,8 @@ string scan_set_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
             // 'next_scan' already points at the scan in dirList with the
             // last found scan in that case.
             if ( search_string == "next" ) {
+                mutex_locker  locker( previous_search_lock );
+
                 if ( previous_search_string.find(&rte) == previous_search_string.end() ) {
                     reply << " 4 : no search string given yet ;";
                     return reply.str();
@@ -173,7 +179,11 @@ string scan_set_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
             }
 
             // remember search string
-            previous_search_string[&rte] = search_string;
+            const string  user_search_string( search_string );
+            {
+                mutex_locker  locker( previous_search_lock );
+                previous_search_string[&rte] = search_string;
+            }
 
             // search string is case insensitive, convert both to uppercase
             search_string = toupper(search_string);
@@ -197,7 +207,7 @@ string scan_set_vbs_fn(bool q, const vector<string>& args, runtime& rte) {
                 // the user entered (searching in the list is done case
                 // insensitive) so we must revert to the original
                 // spelling
-                search_string = previous_search_string[&rte];
+                search_string = user_search_string;
 
 //                // 'vbsrec' is a counted pointer which will be
 //                // checked later, below. If we have the recording
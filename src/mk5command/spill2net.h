@@ -30,6 +30,7 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <threadfns/netreader.h>
+#include <threadfns/parallelvbsreader.h>
 
 // spill = split-fill [generate fillpattern and split/dechannelize it]
 // spid  = split-disk [read data from StreamStor and split/dechannelize it]
@@ -45,12 +46,15 @@ struct splitsettings_type {
     unsigned int     qdepth;
     netparms_type    netparms;
     chain::stepid    framerstep;
+    chain::stepid    writerstep;
     tagremapper_type tagremapper;
+    fanout_type      fanout;
 
     splitsettings_type():
         strict( false ), station( 0 ),
         vdifsize( (unsigned int)-1 ),
-        bitsperchannel(0), bitspersample(0), qdepth( 32 )
+        bitsperchannel(0), bitspersample(0), qdepth( 32 ),
+        writerstep( chain::invalid_stepid )
     {}
 };
 
@@ -255,6 +259,12 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
             reply << settings[&rte].bitspersample;
         } else if( what=="qdepth" ) {
             reply << settings[&rte].qdepth;
+        } else if( what=="fanout" ) {
+            const fanout_type&  fo( settings[&rte].fanout );
+
+            reply << fo.qdepth << " : " << (fo.drop ? "drop" : "block");
+            if( ctm==rtm && settings[&rte].writerstep!=chain::invalid_stepid )
+                reply << " : " << rte.processingchain.communicate(settings[&rte].writerstep, &multifdargs::get_dropped);
         } else if( what=="tagmap" ) {
             tagremapper_type::const_iterator p; 
             tagremapper_type::const_iterator start = settings[&rte].tagremapper.begin();
@@ -329,6 +339,7 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
     //                            assumed scattered over FlexBuff or Mark6 disks
     //    destN = <host|ip>[@<port>]    (for *2net)
     //             default port is 2630
+    //            <path>            (for *2net with net_protocol unix)
     //            <filename>,[nwa]  (for *2file)
     //              w = (over)write; empty file before writing
     //              a = append-to-file 
@@ -404,6 +415,7 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
 
             // Check for sane net_protocol
             throw_on_insane_netprotocol(rte);
+            throw_on_unapplied_vdif_filter(rte, is_vdif(dataformat.frameformat));
 
             // Look at requested transfermode
             // to see where the heck we should get the
@@ -486,7 +498,7 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
                 vbs_ptr->disk_args->set_variable_block_size( !(dataformat.valid() && rte.solution) );
                 vbs_ptr->disk_args->set_run( false );
 
-                vbs_ptr->vbsstep = c.add(&vbsreader_c, 10, vbs_ptr->disk_args);
+                vbs_ptr->vbsstep = c.add(vbsreader_for(rte), 10, vbs_ptr->disk_args);
                 c.register_cancel(vbs_ptr->vbsstep, &close_vbs_c);
 
                 // place it into our per-runtime bookkeeping 
@@ -503,10 +515,15 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
                 c.register_final(&spbs_guard_fun<Mark5>, mapentry);
             }
 
-            // The rest of the processing chain is media independent
-            settings[&rte].framerstep = c.add( &framer<tagged<frame> >, qdepth,
+            // The rest of the processing chain is media independent.
+            // Up to the median filter the frames travel in batches
+            settings[&rte].framerstep = c.add( &framer<framebatch>, qdepth,
                                                framerargs(dataformat, &rte, settings[&rte].strict) );
 
+            // Select VDIF frames as early as possible
+            if( is_vdif(dataformat.frameformat) && rte.vdif_filter.active() )
+                c.add(&vdiffilter, 4, &rte);
+
             // Do we need to twiddle with the time stamp?
             per_runtime<struct timespec>::iterator timeoffptr = timedelta.find( &rte );
             if( timeoffptr!=timedelta.end() )
@@ -641,25 +658,27 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
 
             // Based on where the output should go, add a final stage to
             // the processing
+            const fanout_type&  fanout( settings[&rte].fanout );
+            chain::stepid&      writerstep( settings[&rte].writerstep );
+
             if( tofile(rtm) ) {
-                c.register_cancel( c.add( &multiwriter<miniblocklist_type, fdwriterfunctor>,
-                                          &multifileopener,
-                                          multidestparms(&rte, cdm)), 
-                                   &multicloser );
+                writerstep = c.add( &multiwriter<miniblocklist_type, fdwriterfunctor>,
+                                    &multifileopener,
+                                    multidestparms(&rte, cdm, fanout) );
+                c.register_cancel( writerstep, &multicloser );
             } else if( tonet(rtm) ) {
                 // if we need to write to upds we silently call upon the vtpwriter in
                 // stead of the networkwriter
                 if( dstnet.get_protocol().find("udps")!=std::string::npos ) {
-                    c.register_cancel( c.add( &multiwriter<miniblocklist_type, vtpwriterfunctor>,
-                                              &multiopener,
-                                              multidestparms(&rte, cdm, dstnet) ),
-                                       &multicloser );
+                    writerstep = c.add( &multiwriter<miniblocklist_type, vtpwriterfunctor>,
+                                        &multiopener,
+                                        multidestparms(&rte, cdm, dstnet, fanout) );
                 } else {
-                    c.register_cancel( c.add( &multiwriter<miniblocklist_type, netwriterfunctor>,
-                                              &multiopener,
-                                              multidestparms(&rte, cdm, dstnet) ),
-                                       &multicloser );
+                    writerstep = c.add( &multiwriter<miniblocklist_type, netwriterfunctor>,
+                                        &multiopener,
+                                        multidestparms(&rte, cdm, dstnet, fanout) );
                 }
+                c.register_cancel( writerstep, &multicloser );
             } else {
                 EZASSERT2(false, cmdexception, EZINFO(rtm << ": is not 'tonet()' nor 'tofile()'?!!"));
             }
@@ -889,6 +908,36 @@ std::string spill2net_fn(bool qry, const std::vector<std::string>& args, runtime
         settings[&rte].qdepth = qd;
         reply << " 0 ;";
     //
+    // How the split data is handed to the destinations:
+    //   fanout = <qdepth> [ : block | drop ]
+    // each destination gets a queue of <qdepth> VDIF frames. With 'drop'
+    // a destination that cannot keep up loses frames in stead of holding
+    // up all of them.
+    //
+    } else if( args[1]=="fanout" ) {
+        char*             eocptr;
+        const std::string qdstr( OPTARG(2, args) );
+        const std::string policy( OPTARG(3, args) );
+        unsigned long int qd;
+
+        NOTWHILSTTRANSFER;
+
+        recognized = true;
+        EZASSERT2(qdstr.empty()==false, cmdexception, EZINFO("fanout needs a parameter"));
+        EZASSERT2(policy.empty() || policy=="block" || policy=="drop", cmdexception,
+                  EZINFO("fanout policy '" << policy << "' is not one of block, drop"));
+
+        errno = 0;
+        qd    = ::strtoul(qdstr.c_str(), &eocptr, 0);
+
+        EZASSERT2( eocptr!=qdstr.c_str() && *eocptr=='\0' && errno!=ERANGE && qd>0 && qd<=UINT_MAX,
+                cmdexception,
+                EZINFO("fanout qdepth '" << qdstr << "' NaN/out of range (range: [1," << UINT_MAX << "])") );
+        settings[&rte].fanout.qdepth = qd;
+        if( policy.empty()==false )
+            settings[&rte].fanout.drop = (policy=="drop");
+        reply << " 0 ;";
+    //
     // "spill2*" can be made to go as fast as it can or
     // sort of realtime
     //
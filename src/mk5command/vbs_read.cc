@@ -0,0 +1,80 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <iostream>
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+
+// Expect:
+// vbs_read = <nthread> [ : <bufsize>[k|M|G] ]
+//
+// Playback of FlexBuff/Mark6 recordings (disk2net, disk2file, vbs2net, ...)
+// then uses <nthread> threads to read blocks in parallel, at most <bufsize>
+// bytes ahead of what has been sent on. 0 threads = read sequentially.
+string vbs_read_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+    mk6info_type&  mk6info( rte.mk6info );
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    if( qry ) {
+        reply << "0 : " << mk6info.playbackThreads << " : " << mk6info.playbackBufsize << " ;";
+        return reply.str();
+    }
+
+    // Don't change settings underneath a running transfer
+    INPROGRESS(rte, reply, rte.transfermode!=no_transfer)
+
+    const string  nthread_s( OPTARG(1, args) );
+    const string  bufsize_s( OPTARG(2, args) );
+    char*         eocptr;
+
+    if( nthread_s.empty() ) {
+        reply << "8 : Command must have argument ;";
+        return reply.str();
+    }
+
+    unsigned long int  nthread;
+
+    errno   = 0;
+    nthread = ::strtoul(nthread_s.c_str(), &eocptr, 0);
+    EZASSERT2(eocptr!=nthread_s.c_str() && *eocptr=='\0' && errno!=ERANGE && nthread<=256, cmdexception,
+              EZINFO("number of threads '" << nthread_s << "' not a number/out of range"));
+
+    if( !bufsize_s.empty() ) {
+        uint64_t  nbytes;
+
+        errno  = 0;
+        nbytes = ::strtoull(bufsize_s.c_str(), &eocptr, 0);
+        EZASSERT2(eocptr!=bufsize_s.c_str() && ::strchr("kMG", *eocptr) && errno!=ERANGE && nbytes>0, cmdexception,
+                  EZINFO("bufsize '" << bufsize_s << "' not a number/out of range"));
+        nbytes *= (*eocptr=='k' ? KB : (*eocptr=='M' ? MB : (*eocptr=='G' ? (uint64_t)MB*KB : 1)));
+        mk6info.playbackBufsize = nbytes;
+    }
+    mk6info.playbackThreads = (unsigned int)nthread;
+    reply << "0 ;";
+    return reply.str();
+}
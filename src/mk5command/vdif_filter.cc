@@ -0,0 +1,84 @@
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <mk5_exception.h>
+#include <mk5command/mk5.h>
+#include <iostream>
+
+using namespace std;
+
+
+// Expect:
+// vdif_filter = off | <threads> [ : <station> [ : <start> [ : <end> ] ] ]
+//
+// Transfers started after this only keep the VDIF frames that match.
+// net2vbs/record with data streams defined drop unwanted frames in the
+// network reader (udpsnorreader_stream) before storing them, transfers
+// that search for frames (sp*2*, net2file in strict mode) right after the
+// frames were found. Other network transfers refuse to start whilst a
+// filter is set (see throw_on_unapplied_vdif_filter()). The query also
+// returns how many frames were kept and, per reason, how many were
+// dropped in the current/last transfer.
+string vdif_filter_fn( bool qry, const vector<string>& args, runtime& rte ) {
+    ostringstream  reply;
+
+    reply << "!" << args[0] << (qry?('?'):('=')) << " ";
+
+    // Query available always, command only when doing nothing
+    INPROGRESS(rte, reply, !(qry || rte.transfermode==no_transfer))
+
+    if( qry ) {
+        const vdiffilter_type&        vf( rte.vdif_filter );
+        const vdiffilter_stats_type&  vs( rte.vdif_filter_stats );
+
+        reply << "0 : ";
+        if( !vf.active() )
+            reply << "off";
+        else
+            reply << (vf.threads_text().empty() ? "*" : vf.threads_text()) << " : "
+                  << (vf.station_text().empty() ? "*" : vf.station_text()) << " : "
+                  << vf.start_text() << " : " << vf.end_text();
+        reply << " : " << vs.pass << " : " << vs.thread << " : " << vs.station << " : " << vs.time << " ;";
+        return reply.str();
+    }
+
+    const string  threads( OPTARG(1, args) );
+    const string  station( OPTARG(2, args) );
+    const string  start( OPTARG(3, args) );
+    const string  end( OPTARG(4, args) );
+
+    if( threads.empty() ) {
+        reply << "8 : Command must have argument ;";
+        return reply.str();
+    }
+
+    if( threads=="off" ) {
+        EZASSERT2(station.empty() && start.empty() && end.empty(), cmdexception,
+                  EZINFO("'off' takes no further arguments"));
+        RTEEXEC(rte, rte.vdif_filter = vdiffilter_type());
+        reply << "0 ;";
+        return reply.str();
+    }
+
+    // Compile outside the lock; throws on invalid input
+    const vdiffilter_type  vf(threads, station, start, end);
+
+    RTEEXEC(rte, rte.vdif_filter = vf);
+    reply << "0 ;";
+    return reply.str();
+}
@@ -275,6 +275,12 @@ std::ostream& operator<<(std::ostream& os, vdif_key const& vk) {
 }
 
 // datastream management is encapsulated in one class
+const datastream_id datastream_mgmt_type::noStream;
+
+datastream_mgmt_type::datastream_mgmt_type() {
+    this->flush_lut();
+}
+
 void datastream_mgmt_type::add(std::string const& nm, filterlist_type const& mc) {
     // check if not already defined
     if( defined_datastreams.find(nm)!=defined_datastreams.end() )
@@ -283,6 +289,7 @@ void datastream_mgmt_type::add(std::string const& nm, filterlist_type const& mc)
     std::pair<datastreamlist_type::iterator, bool> insres = defined_datastreams.insert( std::make_pair(nm, datastream_type(mc)) );
     if( !insres.second )
         THROW_EZEXCEPT(datastreamexception_type, "Failed to insert he data stream '" << nm << "' ??? (internal error in std::map?)");
+    this->flush_lut();
 }
 
 
@@ -292,12 +299,14 @@ void datastream_mgmt_type::remove(std::string const& nm) {
     if( ptr==defined_datastreams.end() )
         THROW_EZEXCEPT(datastreamexception_type, "The data stream '" << nm << "' was not defined so cannot remove it");
     defined_datastreams.erase( ptr );
+    this->flush_lut();
 }
 
 void datastream_mgmt_type::reset( void ) {
     vdif2tag.clear();
     tag2name.clear();
     name2tag.clear();
+    this->flush_lut();
 }
 
 void datastream_mgmt_type::clear( void ) {
@@ -339,8 +348,58 @@ datastream_id datastream_mgmt_type::vdif2stream_id(uint16_t station_id, uint16_t
 }
 
 datastream_id datastream_mgmt_type::vdif2stream_id(uint16_t station_id, uint16_t thread_id, struct sockaddr_in const& sender) {
+    // Fast path: we've seen this one before
+    unsigned int  row = (thread_id<nThreadId ? this->lut_row(station_id, sender, false) : noRow);
+
+    if( row!=noRow && thread_lut[row*nThreadId + thread_id]!=noStream )
+        return thread_lut[row*nThreadId + thread_id];
+
+    // Nope. Do it the hard way and remember the result, if there's room
+    const datastream_id  dsid = this->lookup( vdif_key(station_id, thread_id, sender) );
+
+    if( thread_id<nThreadId && (row=this->lut_row(station_id, sender, true))!=noRow )
+        thread_lut[row*nThreadId + thread_id] = dsid;
+    return dsid;
+}
+
+void datastream_mgmt_type::flush_lut( void ) {
+    for(unsigned int i=0; i<nOrigin; i++)
+        origin_hash[i].row = noRow;
+    nRow = 0;
+    thread_lut.clear();
+}
+
+// Return the row in the thread_lut for station + sender or noRow if there
+// isn't one. If 'create' is true, try to add a new row
+unsigned int datastream_mgmt_type::lut_row(uint16_t station_id, struct sockaddr_in const& sender, bool create) {
+    const uint32_t  addr = sender.sin_addr.s_addr;
+    const uint16_t  port = sender.sin_port;
+    uint32_t        h    = addr ^ ((uint32_t)port << 16) ^ station_id;
+
+    h ^= (h >> 16);
+    h *= 0x45d9f3b;
+    h ^= (h >> 16);
+    for(unsigned int i=0; i<nOrigin; i++, h++) {
+        origin_slot_type&  slot( origin_hash[h & (nOrigin-1)] );
+
+        if( slot.row==noRow ) {
+            if( !create || nRow>=maxRow )
+                return noRow;
+            slot.addr       = addr;
+            slot.port       = port;
+            slot.station_id = station_id;
+            slot.row        = nRow++;
+            thread_lut.resize(nRow * nThreadId, noStream);
+            return slot.row;
+        }
+        if( slot.addr==addr && slot.port==port && slot.station_id==station_id )
+            return slot.row;
+    }
+    return noRow;
+}
+
+datastream_id datastream_mgmt_type::lookup(vdif_key const& key) {
     size_t                        n;
-    vdif_key const                key(station_id, thread_id, sender);
     vdif2tagmap_type::iterator    ptr = vdif2tag.find( key );
     datastreamlist_type::iterator dsptr;
 
@@ -350,7 +409,7 @@ datastream_id datastream_mgmt_type::vdif2stream_id(uint16_t station_id, uint16_t
     // Crap, haven't seen this one before. Go find which datastream this'un
     // belongs to
     for( dsptr=defined_datastreams.begin(); dsptr!=defined_datastreams.end(); dsptr++ ) {
-        datastream_type const      ds( dsptr->second );
+        datastream_type const&     ds( dsptr->second );
         match_criteria_type const& match( ds.match_criteria );
         // Brute force loop - simplest nd (hopefully) fastest
         // note: we don't call member functions here - so 
@@ -410,6 +469,8 @@ open_vbs_rv::open_vbs_rv(int fd, open_vbs_fmt f):
 mk6info_type::mk6info_type():
     mk6( mk6info_type::defaultMk6Format ),
     unique_recording_names( mk6info_type::defaultUniqueRecordingNames ),
+    align_frames( false ), stream_pipelines( false ),
+    playbackThreads( 0 ), playbackBufsize( 256*1024*1024 ),
     fpStart( 0 ), fpEnd( 0 ), tryFormat( mk6info_type::defaultTryFormat )
 {
     const string                  mpString      = (mk6info_type::defaultMk6Disks ? "mk6" : "flexbuf");
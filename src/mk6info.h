@@ -218,6 +218,7 @@ typedef std::map<std::string, datastream_id> name2tagmap_type;
 class datastream_mgmt_type {
 
     public:
+        datastream_mgmt_type();
 
         void    add(std::string const& name, filterlist_type const& mc);
         void    remove(std::string const& nm);
@@ -257,6 +258,34 @@ class datastream_mgmt_type {
         vdif2tagmap_type     vdif2tag;
         tag2namemap_type     tag2name;
         name2tagmap_type     name2tag;
+
+        // vdif2stream_id() is called for each packet so it should be
+        // cheap. Resolved keys are cached in a flat table with one row
+        // of <VDIF thread id> => datastream_id per (station, sender) seen;
+        // the row for a (station, sender) is found through a small open
+        // addressing hash table. This is a cache of vdif2tag and gets
+        // flushed whenever the datastream definitions change.
+        struct origin_slot_type {
+            uint32_t      addr;
+            uint16_t      port;
+            uint16_t      station_id;
+            unsigned int  row;
+        };
+        typedef std::vector<datastream_id>  thread_lut_type;
+
+        static const unsigned int   nThreadId = 1024; // VDIF thread id is 10 bits
+        static const unsigned int   nOrigin   = 64;   // must be power of 2
+        static const unsigned int   maxRow    = nOrigin/2;
+        static const unsigned int   noRow     = (unsigned int)-1;
+        static const datastream_id  noStream  = (datastream_id)-1;
+
+        origin_slot_type     origin_hash[nOrigin];
+        unsigned int         nRow;
+        thread_lut_type      thread_lut;
+
+        void          flush_lut( void );
+        unsigned int  lut_row(uint16_t station_id, struct sockaddr_in const& sender, bool create);
+        datastream_id lookup(vdif_key const& key);
 };
 
 
@@ -316,6 +345,19 @@ struct mk6info_type {
     // default: of course not, d'oh!
     bool                    mk6;
     bool                    unique_recording_names;
+    // Cut recordings into chunks at frame boundaries + write an index
+    // of the chunks. Set by "record=align_frames:[0|1]"
+    bool                    align_frames;
+    // Multi port recordings with suffixes on net_port: each port gets its
+    // own reader -> chunkmaker pipeline and its own subset of the
+    // mountpoints, optionally pinned to a CPU. Set by
+    // "record=stream_pipelines:[0|1][:<cpu>,...]"
+    bool                      stream_pipelines;
+    std::vector<unsigned int> stream_cpus;
+    // Number of threads reading FlexBuff/Mark6 recordings for playback and
+    // how far they may read ahead. 0 = sequential. Set by "vbs_read="
+    unsigned int            playbackThreads;
+    uint64_t                playbackBufsize;
 
     // Keep a list of mountpoints that we can record onto
     // this is the global list, modified by "set_disks=".
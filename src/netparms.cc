@@ -43,6 +43,9 @@ netparms_type::netparms_type():
     , theoretical_ipd_ns( netparms_type::defIPD )
     , ackPeriod( netparms_type::defACK )
     , nblock( netparms_type::defNBlock )
+    , nstripe( netparms_type::defNStripe )
+    , xdp_queue( 0 ), xdp_mode( "auto" ), rx_timestamp( false )
+    , latency_budget_ms( 0 ), latency_fill( false ), latency_frametime( false )
     , protocol( defProtocol ), mtu( netparms_type::defMTU )
     , blocksize( netparms_type::defBlockSize )
 #if 0
@@ -78,6 +78,8 @@ struct netparms_type {
     // number of blocks + size of individual blocks
     static const unsigned int   defNBlock    = 8;
     static const unsigned int   defBlockSize = 128*1024;
+    // number of parallel TCP connections to stripe over for "mtcp"
+    static const unsigned int   defNStripe   = 4;
     // OS socket rcv/snd bufsize
     static const unsigned int   defSockbuf   = 4 * 1024 * 1024;
     static const hpslist_type   defHPS       /*= hpslist_type(1)*/;
@@ -94,6 +96,20 @@ struct netparms_type {
     int                theoretical_ipd_ns;
     int                ackPeriod;
     unsigned int       nblock;
+    unsigned int       nstripe;
+    // AF_XDP capture for udps/udpsnor readers (see net_xdp).
+    // Empty interface name means: use the normal UDP socket
+    std::string        xdp_interface;
+    unsigned int       xdp_queue;
+    std::string        xdp_mode;
+    // Software receive time stamps for udps/udpsnor readers (see
+    // net_timestamp), results in the evlbi? statistics
+    bool               rx_timestamp;
+    // Latency budget for real-time transfers (see latency_budget).
+    // 0 means no budget: a slow step makes the reader block
+    unsigned int       latency_budget_ms;
+    bool               latency_fill;       // late data -> fill pattern (or dropped)
+    bool               latency_frametime;  // age by frame time (or time of arrival)
 
     // 
     // various parts in "the system" know about the following set of
@@ -125,6 +141,12 @@ struct netparms_type {
     //              The statistics of the sequence numbers will, however, still
     //              be kept up-to-date; i.e. the "evlbi?" query will still be
     //              informative.
+    //   mtcp     - multi-stream TCP. The data is striped over "nstripe"
+    //              parallel TCP connections to the same host:port. Each
+    //              block is prefixed with a sequence number such that the
+    //              receiver can put them back in the order they were sent.
+    //              This gets around the throughput limit of a single TCP
+    //              flow on high-RTT links.
     //
     //  Some protocol names get translated to a different protocol internally.
     //  The table below lists the affected protocols. Strings not listed in the
@@ -54,6 +54,10 @@ evlbi_stats_type::evlbi_stats_type():
     discont( 0 ), discont_sz( 0 )
 {}
 
+latency_stats_type::latency_stats_type():
+    late( 0 ), filled( 0 ), dropped( 0 ), bytes_late( 0 )
+{}
+
 evlbi_stats_type& evlbi_stats_type::operator+=(evlbi_stats_type const& other) {
     if( this!=&other ) {
         ooosum   += other.ooosum;
@@ -61,6 +65,7 @@ evlbi_stats_type& evlbi_stats_type::operator+=(evlbi_stats_type const& other) {
         pkt_lost += other.pkt_lost;
         pkt_ooo  += other.pkt_ooo;
         pkt_disc += other.pkt_disc;
+        arrival  += other.arrival;
     }
     return *this;
 }
@@ -158,6 +163,26 @@ string fmt_evlbistats(const evlbi_stats_type& es, char const* const fmt) {
                         output << avg_discsz << "seqnr/discontinuity";
                         break;
 
+                    // packet arrival times (net_timestamp=on): histogram
+                    // or mean/max of the inter-arrival time and of the
+                    // arrival time w.r.t. the VDIF frame time, number of
+                    // frames that arrived before their time stamp
+                    case 'j':
+                        output << fmt_nshistogram(es.arrival.interarrival);
+                        break;
+                    case 'J':
+                        output << fmt_nsmeanmax(es.arrival.interarrival);
+                        break;
+                    case 'a':
+                        output << fmt_nshistogram(es.arrival.delay);
+                        break;
+                    case 'A':
+                        output << fmt_nsmeanmax(es.arrival.delay);
+                        break;
+                    case 'e':
+                        output << es.arrival.early;
+                        break;
+
                     // timestamp. raw unixtimestamp (+millisecond fraction
                     // or human readable timeformat
                     case 'u':
@@ -38,6 +38,9 @@
 #include <bqueue.h>
 #include <block.h>
 #include <mk6info.h>
+#include <vdiffilter.h>
+#include <interchain.h>
+#include <rxtimestamp.h>
 #include <counter.h>
 
 // c++ stuff
@@ -89,6 +92,7 @@ struct evlbi_stats_type {
                                        // was
     ucounter_type      discont;    // number of discontinuities (seqnr > expect)
     ucounter_type      discont_sz; // discontinuity size
+    arrival_stats_type arrival;    // packet arrival times, if net_timestamp=on
 
     evlbi_stats_type();
 
@@ -98,6 +102,17 @@ struct evlbi_stats_type {
 };
 
 std::string   fmt_evlbistats(const evlbi_stats_type& stats, char const*const fmt);
+
+// What the latency budget step (see "latency_budget") did to the data
+// that did not make it downstream in time
+struct latency_stats_type {
+    ucounter_type      late;         // items (blocks or frames) that missed their deadline
+    ucounter_type      filled;       // of those, the ones sent on as fill pattern
+    ucounter_type      dropped;      // the ones that were discarded
+    ucounter_type      bytes_late;   // sum of the sizes of the late items
+
+    latency_stats_type();
+};
 // Aug 2023: we can do multiple streams now and keep the stats of them
 //           individually
 typedef std::map<unsigned int, evlbi_stats_type> per_stream_stats_type;
@@ -331,7 +346,7 @@ struct runtime {
     chain                  processingchain;
 
     // the queue that can be used to communicate data between runtimes
-    bqueue<block>*         interchain_source_queue;
+    interchain_queue_type* interchain_source_queue;
 
     // The global transfermode and submode/status
     transfer_type          transfermode;
@@ -475,6 +490,14 @@ struct runtime {
     // udp is chosen as network transport
     per_stream_stats_type       evlbi_stats;
 
+    // reset by the latency budget step when it starts
+    latency_stats_type          latency_stats;
+
+    // which VDIF frames to keep ("vdif_filter="), and what happened to
+    // them in the current/last transfer
+    vdiffilter_type             vdif_filter;
+    vdiffilter_stats_type       vdif_filter_stats;
+
     // keep a mapping of jobid => rot-to-systemtime mapping
     // taskid == -1 => invalid/unknown taskid
     unsigned int                current_taskid;
@@ -0,0 +1,151 @@
+// implementation of the software receive time stamps
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <rxtimestamp.h>
+#include <runtime.h>
+#include <headersearch.h>
+#include <evlbidebug.h>
+#include <threadutil.h>
+
+#include <sstream>
+#include <errno.h>
+#include <stdio.h>
+
+using namespace std;
+
+
+namespace {
+    // print an amount of ns in the most appropriate unit
+    string fmt_ns(double ns) {
+        char  buf[32];
+
+        if( ns<1.0e3 )
+            ::snprintf(buf, sizeof(buf), "%.0fns", ns);
+        else if( ns<1.0e6 )
+            ::snprintf(buf, sizeof(buf), "%.4gus", ns/1.0e3);
+        else if( ns<1.0e9 )
+            ::snprintf(buf, sizeof(buf), "%.4gms", ns/1.0e6);
+        else
+            ::snprintf(buf, sizeof(buf), "%.4gs", ns/1.0e9);
+        return buf;
+    }
+}
+
+
+nshistogram_type::nshistogram_type():
+    n( 0 ), sum( 0 ), max( 0 )
+{
+    for( unsigned int i=0; i<nBucket; i++ )
+        bucket[i] = 0;
+}
+
+nshistogram_type& nshistogram_type::operator+=(nshistogram_type const& other) {
+    if( this!=&other ) {
+        for( unsigned int i=0; i<nBucket; i++ )
+            bucket[i] += other.bucket[i];
+        n   += other.n;
+        sum += other.sum;
+        if( (uint64_t)other.max>(uint64_t)max )
+            max = (uint64_t)other.max;
+    }
+    return *this;
+}
+
+string fmt_nshistogram(nshistogram_type const& h) {
+    bool           first = true;
+    ostringstream  oss;
+
+    for( unsigned int i=0; i<nshistogram_type::nBucket; i++ ) {
+        if( (uint64_t)h.bucket[i]==0 )
+            continue;
+        // the last one is open ended
+        oss << (first ? "" : ",")
+            << (i==nshistogram_type::nBucket-1 ? ">" : "")
+            << fmt_ns( (double)((uint64_t)1 << (i==nshistogram_type::nBucket-1 ? i-1 : i)) )
+            << "=" << h.bucket[i];
+        first = false;
+    }
+    return oss.str();
+}
+
+string fmt_nsmeanmax(nshistogram_type const& h) {
+    if( (uint64_t)h.n==0 )
+        return "-/-";
+    return fmt_ns((double)h.sum/(double)h.n) + "/" + fmt_ns((double)h.max);
+}
+
+
+arrival_stats_type::arrival_stats_type():
+    early( 0 )
+{}
+
+arrival_stats_type& arrival_stats_type::operator+=(arrival_stats_type const& other) {
+    if( this!=&other ) {
+        interarrival += other.interarrival;
+        delay        += other.delay;
+        early        += other.early;
+    }
+    return *this;
+}
+
+
+rxtimestamp_type::rxtimestamp_type(bool enable, int fd, struct msghdr& msg,
+                                   runtime const* rteptr, unsigned int pktsize):
+    enabled( enable ), use_cmsg( false ), last( 0 ), frame_ns( 0 )
+{
+    ::memset(control, 0, sizeof(control));
+    if( !enabled )
+        return;
+
+    // Without a socket (AF_XDP) no-one fills in the control buffer
+    if( fd>=0 ) {
+        int  on = 1;
+
+        // Not fatal; we'll use the time at which we see the packet
+        if( ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on))!=0 )
+            DEBUG(-1, "rxtimestamp: failed to enable SO_TIMESTAMPNS - " << evlbi5a::strerror(errno) << endl);
+        msg.msg_control    = &control[0];
+        msg.msg_controllen = sizeof(control);
+        use_cmsg           = true;
+    }
+
+    // Only if we can compute the time of each datagram
+    if( is_vdif(rteptr->trackformat()) && rteptr->trackbitrate()!=samplerate_type() ) {
+        const headersearch_type  fmt(rteptr->trackformat(), rteptr->ntrack(),
+                                     rteptr->trackbitrate(), rteptr->vdifframesize());
+        samplerate_type const&   ft = fmt.get_state().frametime;
+
+        if( fmt.framesize==pktsize && ft.numerator() ) {
+            frame_ns = ((double)ft.numerator() * 1.0e9) / (double)ft.denominator();
+
+            for( unsigned int e=0; e<64; e++ ) {
+                struct tm   tm;
+
+                ::memset(&tm, 0, sizeof(tm));
+                tm.tm_mday = 1;
+                tm.tm_year = 100 + (int)(e/2);
+                tm.tm_mon  = 6 * (int)(e%2);
+                epoch_start[e] = (int64_t)::mktime(&tm);
+            }
+        }
+    }
+    DEBUG(2, "rxtimestamp: enabled, " << (frame_ns>0 ? "" : "not ") << "checking VDIF frame times" << endl);
+}
+
+rxtimestamp_type::~rxtimestamp_type() {}
@@ -0,0 +1,156 @@
+// software receive time stamps of network packets
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_RXTIMESTAMP_H
+#define JIVE5A_RXTIMESTAMP_H
+
+#include <counter.h>
+
+#include <string>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+
+// avoid circular includes; runtime.h holds our stats
+struct runtime;
+
+// Histogram of time intervals in nanoseconds, in powers of two: bucket k
+// counts the intervals in [2^(k-1), 2^k) ns, bucket 0 the ones of 0ns.
+// The last bucket takes everything that doesn't fit.
+struct nshistogram_type {
+    static const unsigned int nBucket = 40;   // 2^39ns ~ 9 minutes
+
+    ucounter_type   bucket[ nBucket ];
+    ucounter_type   n;
+    ucounter_type   sum;       // ns
+    ucounter_type   max;       // ns
+
+    nshistogram_type();
+
+    inline void add(uint64_t ns) {
+        const unsigned int  k = (ns ? 64 - (unsigned int)__builtin_clzll(ns) : 0);
+
+        bucket[ (k<nBucket ? k : nBucket-1) ]++;
+        n++;
+        sum += ns;
+        if( ns>(uint64_t)max )
+            max = ns;
+    }
+
+    nshistogram_type& operator+=(nshistogram_type const& other);
+};
+
+// "<upper bound>=<count>" for all non-empty buckets, comma separated,
+// eg "8us=12,16us=1024,32us=3"
+std::string fmt_nshistogram(nshistogram_type const& h);
+// "<mean>/<max>", eg "15.9us/31.2us"
+std::string fmt_nsmeanmax(nshistogram_type const& h);
+
+
+// Per stream packet arrival statistics
+struct arrival_stats_type {
+    nshistogram_type    interarrival;
+    // For VDIF: arrival time minus the time stamp of the frame. Frames
+    // arriving before their own time stamp (clock offset) are only counted
+    nshistogram_type    delay;
+    ucounter_type       early;
+
+    arrival_stats_type();
+
+    arrival_stats_type& operator+=(arrival_stats_type const& other);
+};
+
+
+// Collects the arrival time of each packet a network reader receives into
+// arrival_stats_type. When enabled, the kernel is asked to time stamp
+// incoming packets (SO_TIMESTAMPNS) and the reader's msghdr gets a control
+// buffer for the time stamp. If the time stamp isn't there (no kernel
+// support, AF_XDP capture) the current time is used.
+// When disabled, nothing is changed and packet() returns immediately.
+class rxtimestamp_type {
+    public:
+        // fd < 0: there is no socket to enable time stamping on (AF_XDP);
+        //         'msg' is left alone and the time at which packet() is
+        //         called is used
+        // If the runtime's data format is VDIF and each datagram holds
+        // exactly one frame (pktsize) also the delay w.r.t. the frame time
+        // is done
+        rxtimestamp_type(bool enable, int fd, struct msghdr& msg,
+                         runtime const* rteptr, unsigned int pktsize);
+
+        // After every datagram was received with 'msg'. 'frame' points
+        // at the data part of the datagram
+        inline void packet(struct msghdr& msg, void const* frame, arrival_stats_type& stats) {
+            if( !enabled )
+                return;
+
+            struct cmsghdr const*  cmsg = ((use_cmsg && msg.msg_controllen>=sizeof(struct cmsghdr)) ? CMSG_FIRSTHDR(&msg) : 0);
+            struct timespec        ts;
+
+            if( cmsg && cmsg->cmsg_level==SOL_SOCKET && cmsg->cmsg_type==SCM_TIMESTAMPNS )
+                ::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            else
+                ::clock_gettime(CLOCK_REALTIME, &ts);
+            // it's a value-return field
+            if( use_cmsg )
+                msg.msg_controllen = sizeof(control);
+
+            const uint64_t  now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+
+            if( last )
+                stats.interarrival.add( now - last );
+            last = now;
+
+            if( frame_ns>0 ) {
+                // word0: epoch seconds [0:29], word1: frame number [0:23],
+                //        ref. epoch [24:29]
+                uint32_t        w[2];
+
+                ::memcpy(&w[0], frame, sizeof(w));
+
+                const int64_t   t = (epoch_start[ (w[1]>>24) & 0x3f ] + (int64_t)(w[0] & 0x3fffffff)) * 1000000000ll +
+                                    (int64_t)((w[1] & 0xffffff) * frame_ns);
+
+                if( (int64_t)now>=t )
+                    stats.delay.add( now - (uint64_t)t );
+                else
+                    stats.early++;
+            }
+        }
+
+        ~rxtimestamp_type();
+
+    private:
+        bool        enabled;
+        bool        use_cmsg;       // msg carries our control buffer
+        uint64_t    last;           // arrival time of previous packet, ns
+        double      frame_ns;       // VDIF frame length, 0 if not doing VDIF
+        int64_t     epoch_start[ 64 ];
+        // Room for the SCM_TIMESTAMPNS control message, suitably aligned
+        uint64_t    control[ (CMSG_SPACE(sizeof(struct timespec)) + 7)/8 ];
+
+        rxtimestamp_type();
+        rxtimestamp_type(rxtimestamp_type const&);
+        rxtimestamp_type const& operator=(rxtimestamp_type const&);
+};
+
+#endif
@@ -20,9 +20,17 @@
 #include <scan_check.h>
 #include <stringutil.h>
 #include <mk5command/mk5.h>  // for XLR_Buffer
+#include <libvbs.h>
+#include <mutex_locker.h>
+#include <threadutil.h>
+#include <evlbidebug.h>
 #include <vector>
+#include <map>
 #include <algorithm>
 
+#include <dirent.h>
+#include <fnmatch.h>
+
 DEFINE_EZEXCEPT(scan_check_except)
 
 // See comment in scan_check_type.h ...
@@ -149,6 +157,7 @@ std::ostream& operator<<(std::ostream& os, scan_check_type const& sct) {
         else
             os << sct.missing_bytes;
     }
+    os << " fill=" << sct.fill_bytes << "/" << sct.sampled_bytes;
     return os;
 }
 
@@ -165,7 +174,7 @@ scan_check_type::_m_mark5b_t::_m_mark5b_t() :
 scan_check_type::scan_check_type() :
     format( fmt_none ), ntrack( 0 ), trackbitrate( headersearch_type::UNKNOWN_TRACKBITRATE ),
     start_byte_offset( UNKNOWN_BYTE_OFFSET ), end_byte_offset( UNKNOWN_BYTE_OFFSET ),
-    missing_bytes( UNKNOWN_MISSING_BYTES )
+    missing_bytes( UNKNOWN_MISSING_BYTES ), sampled_bytes( 0 ), fill_bytes( 0 )
 {}
 
 scan_check_type::operator bool( void ) const {
@@ -201,6 +210,8 @@ scan_check_type scan_check_fn(countedpointer<data_reader_type> data_reader, uint
     //     Nothing recognizable is not an option, really - well, that is,
     //     find_data_format() does not look for mark5a_tvg nor ss_test_pattern.
     data_reader->read_into( (unsigned char*)buffer->data, 0, bytes_to_read );
+    rv.sampled_bytes += bytes_to_read;
+    rv.fill_bytes    += ::fill_count(buffer->data, bytes_to_read, default_fillpattern);
     const bool found_a_format = find_data_format((unsigned char*)buffer->data, bytes_to_read, track, strict, verbose, checklist[0]);
     const bool vdif = is_vdif( checklist[0].format );
 
@@ -242,6 +253,8 @@ scan_check_type scan_check_fn(countedpointer<data_reader_type> data_reader, uint
 
         // Read in next hump of data
         data_reader->read_into( (unsigned char*)buffer->data, read_offset, bytes_to_read );
+        rv.sampled_bytes += bytes_to_read;
+        rv.fill_bytes    += ::fill_count(buffer->data, bytes_to_read, default_fillpattern);
         DEBUG(4, "scan_check[" << s+1 << "/" << nSample << "] read " << bytes_to_read << "b from offset = " << read_offset << "b" << " (" << fSize-read_offset << " to EOF)" << std::endl);
 
         // And check we find the same stuff as before
@@ -364,3 +377,410 @@ scan_check_type scan_check_fn(countedpointer<data_reader_type> data_reader, uint
     // could still be fmt_unknown ... let caller handle this
     return rv;
 }
+
+
+///////////////////////////////////////////////////////////////////////
+//
+//  Batch scan check
+//
+///////////////////////////////////////////////////////////////////////
+
+typedef std::map<std::string, mountpointlist_type>  recordinglist_type;
+
+// "<recording>_ds<label>" => "<recording>"
+static std::string strip_datastream(std::string const& entry) {
+    const std::string::size_type  ds = entry.rfind("_ds");
+
+    if( ds==std::string::npos || ds==0 || ds+3==entry.size() ||
+        entry.find_first_of("_.", ds+3)!=std::string::npos )
+        return entry;
+    return entry.substr(0, ds);
+}
+
+struct list_mountpoint_args {
+    list_mountpoint_args(std::string const& mountpoint, std::string const& pat,
+                         recordinglist_type* rl, pthread_mutex_t* m):
+        mp( mountpoint ), pattern( pat ), recordings( rl ), mtx( m )
+    {}
+
+    const std::string    mp;
+    const std::string    pattern;
+    recordinglist_type*  recordings;
+    pthread_mutex_t*     mtx;
+};
+
+// Find entries matching the pattern in one mountpoint. Whether it's a
+// FlexBuff or Mark6 recording is left to open_vbs()
+void* list_mountpoint_thrd(void* args) {
+    DIR*                   dirp;
+    struct dirent*         entry;
+    list_mountpoint_args*  lma = (list_mountpoint_args*)args;
+    recordinglist_type     lcl;
+
+    if( (dirp=::opendir(lma->mp.c_str()))==0 ) {
+        DEBUG(2, "scan_check_batch/list_mountpoint(" << lma->mp << ")/::opendir fails - " << evlbi5a::strerror(errno) << std::endl);
+        delete lma;
+        return (void*)0;
+    }
+    while( (entry=::readdir(dirp))!=0 ) {
+        const std::string  name( entry->d_name );
+
+        if( name=="." || name==".." )
+            continue;
+        // The chunk index of a Mark6 recording, "<recording>.index", lives
+        // next to the recording itself; it is not a recording of its own
+        if( name.size()>6 && name.compare(name.size()-6, 6, ".index")==0 )
+            continue;
+        const std::string  recname( strip_datastream(name) );
+
+        if( ::fnmatch(lma->pattern.c_str(), recname.c_str(), 0)==0 )
+            lcl[ recname ].insert( lma->mp );
+    }
+    ::closedir(dirp);
+
+    // Merge our findings into the global list
+    ::pthread_mutex_lock( lma->mtx );
+    for(recordinglist_type::const_iterator p=lcl.begin(); p!=lcl.end(); p++)
+        (*lma->recordings)[ p->first ].insert( p->second.begin(), p->second.end() );
+    ::pthread_mutex_unlock( lma->mtx );
+    delete lma;
+    return (void*)0;
+}
+
+
+scan_check_batch_type::result_type::result_type(std::string const& rec):
+    recname( rec ), done( false ), code( 0 )
+{}
+
+scan_check_batch_type::scan_check_batch_type(std::string const& pattern, mountpointlist_type const& mps,
+                                             mk6info_type::try_format fmt, uint64_t bytes_to_read,
+                                             bool s, bool v, unsigned int nthread):
+    tryFormat( fmt ), bytesToRead( bytes_to_read ), strict( s ), verbose( v ),
+    nextTodo( 0 ), nextReport( 0 ), nChecked( 0 ), cancel( false )
+{
+    int                  create_error = 0;
+    threads_type         listers;
+    recordinglist_type   recordings;
+
+    EZASSERT2(nthread>0, scan_check_except, EZINFO("need at least one thread to check recordings"));
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+
+    // List all mountpoints in parallel
+    for(mountpointlist_type::const_iterator mp=mps.begin(); mp!=mps.end(); mp++) {
+        pthread_t              tid;
+        list_mountpoint_args*  lma = new list_mountpoint_args(*mp, pattern, &recordings, &mutex);
+
+        if( (create_error=::mp_pthread_create(&tid, &list_mountpoint_thrd, lma))!=0 ) {
+            delete lma;
+            break;
+        }
+        listers.push_back( tid );
+    }
+    for(threads_type::iterator tidptr=listers.begin(); tidptr!=listers.end(); tidptr++)
+        ::pthread_join(*tidptr, 0);
+
+    if( create_error ) {
+        ::pthread_mutex_destroy(&mutex);
+        throw scan_check_except(std::string("failed to start listing mountpoints - ")+evlbi5a::strerror(create_error));
+    }
+
+    // std::map is sorted by key so that's our reporting order
+    for(recordinglist_type::const_iterator p=recordings.begin(); p!=recordings.end(); p++) {
+        results.push_back( result_type(p->first) );
+        recMountpoints.push_back( p->second );
+    }
+    DEBUG(3, "scan_check_batch: " << results.size() << " recordings match '" << pattern << "' on " << mps.size() << " mountpoints" << std::endl);
+
+    // No point in starting more threads than there are recordings
+    nthread = std::min(nthread, (unsigned int)results.size());
+    for(unsigned int i=0; i<nthread; i++) {
+        pthread_t  tid;
+
+        if( (create_error=::mp_pthread_create(&tid, &scan_check_batch_type::worker, this))!=0 )
+            break;
+        threads.push_back( tid );
+    }
+    if( create_error ) {
+        this->stop();
+        ::pthread_mutex_destroy(&mutex);
+        throw scan_check_except(std::string("failed to start scan check threads - ")+evlbi5a::strerror(create_error));
+    }
+}
+
+unsigned int scan_check_batch_type::size( void ) const {
+    return (unsigned int)results.size();
+}
+
+unsigned int scan_check_batch_type::nDone( void ) const {
+    mutex_locker  locker( mutex );
+    return nChecked;
+}
+
+bool scan_check_batch_type::next_result(unsigned int& idx, result_type& r) {
+    mutex_locker  locker( mutex );
+
+    if( nextReport>=results.size() || !results[nextReport].done )
+        return false;
+    idx = nextReport++;
+    r   = results[idx];
+    return true;
+}
+
+bool scan_check_batch_type::exhausted( void ) const {
+    mutex_locker  locker( mutex );
+    return nextReport>=results.size();
+}
+
+void scan_check_batch_type::stop( void ) {
+    {
+        mutex_locker  locker( mutex );
+        cancel = true;
+    }
+    for(threads_type::iterator tidptr=threads.begin(); tidptr!=threads.end(); tidptr++)
+        ::pthread_join(*tidptr, 0);
+    threads.clear();
+}
+
+scan_check_batch_type::~scan_check_batch_type() {
+    this->stop();
+    ::pthread_mutex_destroy(&mutex);
+}
+
+// Executed without the lock held; only this thread touches results[idx]
+// until 'done' is set
+void scan_check_batch_type::check(unsigned int idx) {
+    int          code = 0;
+    std::string  error;
+    open_vbs_rv  recording;
+    result_type& result( results[idx] );
+
+    try {
+        recording = ::open_vbs(result.recname, recMountpoints[idx], tryFormat);
+
+        if( !recording ) {
+            code  = 4;
+            error = "failed to open recording";
+        } else {
+            countedpointer<data_reader_type> data_reader( new vbs_reader_base(recording.__m_fd) );
+
+            if( data_reader->length() < (int64_t)bytesToRead ) {
+                std::ostringstream  oss;
+                oss << "scan too short to check, need " << bytesToRead << "bytes have " << data_reader->length();
+                code  = 6;
+                error = oss.str();
+            } else {
+                result.sct = scan_check_fn(data_reader, bytesToRead, strict, verbose);
+                DEBUG(4, "scan_check_batch[" << result.recname << "]: " << result.sct << std::endl);
+            }
+        }
+    }
+    catch( std::exception const& e ) {
+        code  = 4;
+        error = e.what();
+    }
+    catch( ... ) {
+        code  = 4;
+        error = "unknown exception";
+    }
+    if( recording )
+        ::vbs_close( recording.__m_fd );
+
+    mutex_locker  locker( mutex );
+    result.code  = code;
+    result.error = error;
+    result.done  = true;
+    nChecked++;
+}
+
+void* scan_check_batch_type::worker(void* self) {
+    scan_check_batch_type*  batch = (scan_check_batch_type*)self;
+
+    while( true ) {
+        unsigned int  idx;
+        {
+            mutex_locker  locker( batch->mutex );
+
+            if( batch->cancel || batch->nextTodo>=batch->results.size() )
+                break;
+            idx = batch->nextTodo++;
+        }
+        batch->check( idx );
+    }
+    return (void*)0;
+}
+
+
+///////////////////////////////////////////////////////////////////
+//          fill_report_type
+///////////////////////////////////////////////////////////////////
+
+// Each thread reads a region of this size in pieces of readSize
+static const uint64_t  fillRegionSize = 64 * MB;
+static const size_t    fillReadSize   = 8 * MB;
+
+fill_report_type::status_type::status_type():
+    done( false ), code( 0 ), total( 0 ), nByte( 0 ), nFill( 0 ), nRun( 0 ), truncated( false )
+{}
+
+fill_report_type::fill_report_type(std::string const& rec, mountpointlist_type const& mps,
+                                   mk6info_type::try_format fmt, off_t s, off_t e,
+                                   uint64_t pat, unsigned int nthread, size_t maxr):
+    recname( rec ), pattern( pat ), maxrun( maxr ), fd( -1 ), start( s ), end( e ),
+    nRegion( 0 ), nextRegion( 0 ), nextMerge( 0 ), cancel( false ), nRunning( 0 ), lastEnd( 0 )
+{
+    int          create_error = 0;
+    open_vbs_rv  recording( ::open_vbs(recname, mps, fmt) );
+
+    EZASSERT2(nthread>0, scan_check_except, EZINFO("need at least one thread to scan for fill pattern"));
+    EZASSERT2(recording, scan_check_except, EZINFO("failed to open recording '" << recname << "'"));
+    fd = recording.__m_fd;
+
+    if( end==0 )
+        end = ::vbs_lseek(fd, 0, SEEK_END);
+    if( end<0 || end<start ) {
+        ::vbs_close( fd );
+        THROW_EZEXCEPT(scan_check_except, "invalid byte range " << start << " => " << end << " in '" << recname << "'");
+    }
+    stat.total = (uint64_t)(end - start);
+    nRegion    = (stat.total + fillRegionSize - 1) / fillRegionSize;
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+
+    nthread = (unsigned int)std::min((uint64_t)nthread, std::max(nRegion, (uint64_t)1));
+    for(unsigned int i=0; i<nthread; i++) {
+        pthread_t  tid;
+
+        {
+            mutex_locker  locker( mutex );
+            nRunning++;
+        }
+        if( (create_error=::mp_pthread_create(&tid, &fill_report_type::worker, this))!=0 ) {
+            mutex_locker  locker( mutex );
+            nRunning--;
+            break;
+        }
+        threads.push_back( tid );
+    }
+    if( threads.empty() ) {
+        ::pthread_mutex_destroy(&mutex);
+        ::vbs_close( fd );
+        throw scan_check_except(std::string("failed to start fill pattern scan threads - ")+evlbi5a::strerror(create_error));
+    }
+    DEBUG(3, "fill_report[" << recname << "]: scanning " << start << " => " << end << " in " << nRegion <<
+             " regions using " << threads.size() << " threads" << std::endl);
+}
+
+fill_report_type::status_type fill_report_type::status( void ) const {
+    mutex_locker  locker( mutex );
+    return stat;
+}
+
+fillrunlist_type fill_report_type::runs(size_t first, size_t n) const {
+    mutex_locker  locker( mutex );
+
+    if( first>=allRuns.size() )
+        return fillrunlist_type();
+    return fillrunlist_type(allRuns.begin() + first, allRuns.begin() + std::min(allRuns.size(), first + n));
+}
+
+fill_report_type::~fill_report_type() {
+    {
+        mutex_locker  locker( mutex );
+        cancel = true;
+    }
+    for(threads_type::iterator tidptr=threads.begin(); tidptr!=threads.end(); tidptr++)
+        ::pthread_join(*tidptr, 0);
+    ::vbs_close( fd );
+    ::pthread_mutex_destroy(&mutex);
+}
+
+// Call with the lock held. Regions are merged in order
+void fill_report_type::merge(fillmap_type const& fm) {
+    fillrunlist_type::const_iterator  run = fm.runs.begin();
+    uint64_t                          nRun = fm.nRun;
+
+    // Does the first run continue the last one of the previous region?
+    if( stat.nRun>0 && nRun>0 && run->start==lastEnd ) {
+        if( allRuns.size()==stat.nRun )
+            allRuns.back().end = run->end;
+        run++;
+        nRun--;
+    }
+    // Only append whilst no runs were dropped, otherwise there'd be gaps
+    for(uint64_t nAppend=0; run!=fm.runs.end() && allRuns.size()<maxrun && allRuns.size()==stat.nRun+nAppend; run++, nAppend++)
+        allRuns.push_back( *run );
+    if( fm.nRun>0 )
+        lastEnd = fm.lastEnd;
+    stat.nRun     += nRun;
+    stat.nByte    += fm.nByte;
+    stat.nFill    += fm.nFill;
+    stat.truncated = (allRuns.size()<stat.nRun);
+}
+
+// Executed without the lock held
+void fill_report_type::scan(uint64_t region) {
+    const off_t                 rstart = start + (off_t)(region * fillRegionSize);
+    const off_t                 rend   = std::min(end, rstart + (off_t)fillRegionSize);
+    std::vector<unsigned char>  buf( fillReadSize );
+    fillmap_type                fm( (uint64_t)rstart, pattern, maxrun );
+    std::string                 error;
+
+    for(off_t pos=rstart; pos<rend; ) {
+        const size_t   n = (size_t)std::min((off_t)fillReadSize, rend - pos);
+        const ssize_t  r = ::vbs_pread(fd, &buf[0], n, pos);
+
+        if( r!=(ssize_t)n ) {
+            std::ostringstream  oss;
+
+            oss << "read " << r << " bytes in stead of " << n << " at " << pos;
+            if( r<0 )
+                oss << " - " << evlbi5a::strerror(errno);
+            error = oss.str();
+            break;
+        }
+        fm.add(&buf[0], n);
+        pos += n;
+
+        mutex_locker  locker( mutex );
+        if( cancel )
+            return;
+    }
+
+    mutex_locker  locker( mutex );
+
+    if( !error.empty() ) {
+        DEBUG(-1, "fill_report[" << recname << "]: " << error << std::endl);
+        stat.code  = 4;
+        stat.error = error;
+        cancel     = true;
+        return;
+    }
+    pending.insert( std::make_pair(region, fm) );
+    for(pending_type::iterator p=pending.find(nextMerge); p!=pending.end(); p=pending.find(nextMerge)) {
+        this->merge( p->second );
+        pending.erase( p );
+        nextMerge++;
+    }
+}
+
+void* fill_report_type::worker(void* self) {
+    fill_report_type*  fr = (fill_report_type*)self;
+
+    while( true ) {
+        uint64_t  region;
+        {
+            mutex_locker  locker( fr->mutex );
+
+            if( fr->cancel || fr->nextRegion>=fr->nRegion )
+                break;
+            region = fr->nextRegion++;
+        }
+        fr->scan( region );
+    }
+    mutex_locker  locker( fr->mutex );
+    if( --fr->nRunning==0 ) {
+        fr->stat.done = true;
+        DEBUG(3, "fill_report[" << fr->recname << "]: done, " << fr->stat.nFill << " of " << fr->stat.nByte <<
+                 " bytes fill pattern in " << fr->stat.nRun << " runs" << std::endl);
+    }
+    return (void*)0;
+}
@@ -22,10 +22,18 @@
 
 #include <countedpointer.h>  // ...
 #include <data_check.h>      // data_reader_type, data_check_type, &cet.
+#include <mk6info.h>         // mk6info_type::try_format
+#include <mountpoint.h>
+#include <fillpattern.h>
 #include <ezexcept.h>
 #include <limits>
+#include <string>
+#include <vector>
+#include <map>
 #include <iostream>
 
+#include <pthread.h>
+
 DECLARE_EZEXCEPT(scan_check_except)
 
 
@@ -55,6 +63,9 @@ struct scan_check_type {
     highrestime_type start_time, end_time;
     uint64_t         start_byte_offset, end_byte_offset;
     int64_t          missing_bytes;
+    // How much of the data that was looked at was fill pattern
+    uint64_t         sampled_bytes;
+    uint64_t         fill_bytes;
     // iff is_vdif(format)
     struct _m_vdif_t {
         unsigned int    frame_size; // only filled in for VDIF
@@ -133,4 +144,139 @@ std::ostream& operator<<(std::ostream& os, scan_check_type const& sct);
 // verifying that at least bytes_to_read bytes are available
 scan_check_type scan_check_fn(countedpointer<data_reader_type> data_reader, uint64_t bytes_to_read, bool strict, bool verbose, unsigned int track=4);
 
+
+// Scan check many FlexBuff/Mark6 recordings in one go.
+//
+// First all mountpoints are listed in parallel, one thread per mountpoint,
+// for entries matching the shell wildcard 'pattern'. The datastream suffix
+// ("_ds<label>") is stripped so that, like with "scan_set=", all streams of
+// a recording are checked as one.
+// Then 'nthread' threads open, read and classify the recordings. A
+// recording is opened using only the mountpoints where the listing found
+// it, which saves a directory scan of all mountpoints per recording. The
+// chunks of a recording are typically spread over all mountpoints so
+// 'nthread' is also the bound on concurrent I/O per mountpoint.
+//
+// Results are reported in alphabetical order of recording name.
+class scan_check_batch_type {
+    public:
+        struct result_type {
+            std::string      recname;
+            bool             done;
+            // 0 => 'sct' is valid, otherwise the VSI/S error code and
+            //      'error' says what went wrong
+            int              code;
+            std::string      error;
+            scan_check_type  sct;
+
+            result_type(std::string const& rec);
+        };
+
+        scan_check_batch_type(std::string const& pattern, mountpointlist_type const& mps,
+                              mk6info_type::try_format fmt, uint64_t bytes_to_read,
+                              bool strict, bool verbose, unsigned int nthread);
+
+        // number of recordings found and checked so far
+        unsigned int size( void ) const;
+        unsigned int nDone( void ) const;
+
+        // If the next recording in line has been checked, return true,
+        // its index and result, and move on to the one after that.
+        bool         next_result(unsigned int& idx, result_type& r);
+        // All results have been returned
+        bool         exhausted( void ) const;
+
+        // Recordings not yet started are skipped, waits for the
+        // ones being checked
+        ~scan_check_batch_type();
+
+    private:
+        typedef std::vector<result_type>          results_type;
+        typedef std::vector<mountpointlist_type>  recmountpoints_type;
+        typedef std::vector<pthread_t>            threads_type;
+
+        const mk6info_type::try_format  tryFormat;
+        const uint64_t                  bytesToRead;
+        const bool                      strict, verbose;
+        results_type                    results;
+        recmountpoints_type             recMountpoints;
+        unsigned int                    nextTodo, nextReport, nChecked;
+        bool                            cancel;
+        mutable pthread_mutex_t         mutex;
+        threads_type                    threads;
+
+        void         check(unsigned int idx);
+        void         stop( void );
+        static void* worker(void* self);
+
+        // no copy or assignment
+        scan_check_batch_type(scan_check_batch_type const&);
+        scan_check_batch_type const& operator=(scan_check_batch_type const&);
+};
+
+
+// Find where the fill pattern is in (a part of) a FlexBuff/Mark6 recording.
+//
+// The recording is opened once and divided into regions, which 'nthread'
+// threads read (using vbs_pread()) and scan for fill pattern concurrently.
+// The results per region are merged, in order, into one list of byte
+// ranges: runs of fill pattern that continue into the next region are
+// joined. At most 'maxrun' runs are kept, the counts are always complete.
+class fill_report_type {
+    public:
+        struct status_type {
+            bool         done;
+            // !=0 => the VSI/S error code, 'error' says what went wrong
+            int          code;
+            std::string  error;
+            uint64_t     total;      // bytes to scan
+            uint64_t     nByte;      // bytes scanned
+            uint64_t     nFill;      // of which fill pattern
+            uint64_t     nRun;
+            bool         truncated;  // not all runs were kept
+
+            status_type();
+        };
+
+        const std::string  recname;
+
+        // 'end'==0 => until the end of the recording
+        fill_report_type(std::string const& rec, mountpointlist_type const& mps,
+                         mk6info_type::try_format fmt, off_t start, off_t end,
+                         uint64_t pattern, unsigned int nthread, size_t maxrun = 100000);
+
+        status_type       status( void ) const;
+        // Copy of at most 'n' runs, starting from run 'first'
+        fillrunlist_type  runs(size_t first, size_t n) const;
+
+        // Stops and waits for the threads
+        ~fill_report_type();
+
+    private:
+        typedef std::vector<pthread_t>          threads_type;
+        typedef std::map<uint64_t, fillmap_type> pending_type;
+
+        const uint64_t           pattern;
+        const size_t             maxrun;
+        int                      fd;
+        off_t                    start, end;
+        uint64_t                 nRegion, nextRegion, nextMerge;
+        bool                     cancel;
+        unsigned int             nRunning;
+        status_type              stat;
+        fillrunlist_type         allRuns;
+        uint64_t                 lastEnd;
+        pending_type             pending;
+        mutable pthread_mutex_t  mutex;
+        threads_type             threads;
+
+        void         scan(uint64_t region);
+        void         merge(fillmap_type const& fm);
+        static void* worker(void* self);
+
+        // no copy or assignment
+        fill_report_type(fill_report_type const&);
+        fill_report_type const& operator=(fill_report_type const&);
+};
+
 #endif
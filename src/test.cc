@@ -24,6 +24,7 @@
 #include <exception>
 #include <map>
 #include <set>
+#include <deque>
 #include <vector>
 #include <algorithm>
 #include <locale>
@@ -52,6 +53,7 @@
 #include <mk6info.h>
 #include <sciprint.h>
 #include <sfxc_binary_command.h>
+#include <cmdpool.h>
 
 // system headers (for sockets and, basically, everything else :))
 #include <time.h>
@@ -87,29 +89,38 @@ bool is_member(int fd, const fdset_type& fds) {
     return fds.find(fd)!=fds.end();
 }
 
+// Command lines that need to be executed by the command pool are queued
+// per runtime such that only one at a time is executing commands on it;
+// jobs.front() is the one being executed.
+typedef std::deque<cmdjob_type*>  jobqueue_type;
+
 struct per_rt_data {
-    int         owner;     // fd of owner if >=0. If owner goes, then also the runtime
-    runtime*    rteptr;
-    fdset_type  observers;
+    int           owner;     // fd of owner if >=0. If owner goes, then also the runtime
+    bool          orphaned;  // owner went whilst jobs were queued: delete when idle
+    runtime*      rteptr;
+    fdset_type    observers;
+    jobqueue_type jobs;
 
     per_rt_data(runtime* r):
-        owner( -1 ), rteptr( r )
+        owner( -1 ), orphaned( false ), rteptr( r )
     {}
     per_rt_data(runtime* r, int o):
-        owner( o ), rteptr( r )
+        owner( o ), orphaned( false ), rteptr( r )
     {}
 };
 
 typedef map<string, per_rt_data> runtimemap_type;
 
 // Per connection (file descriptor) keep track of the echo setting and which
-// runtime it referred to
+// runtime it referred to. Whilst a command line from this connection is
+// with the command pool, it is 'busy' and we do not read from it.
 struct per_fd_data {
     bool    echo;
+    bool    busy;
     string  runtime;
 
     per_fd_data(bool e):
-        echo( e )
+        echo( e ), busy( false )
     {}
 };
 
@@ -187,6 +198,13 @@ void unobserve(int fd, fdmap_type& fdm, runtimemap_type& rtm) {
         if( currtm->second.owner==fd )
             rts_to_erase.push_back( currtm );
     for(erase_type::iterator eraseptr=rts_to_erase.begin(); eraseptr!=rts_to_erase.end(); eraseptr++) {
+        // Cannot pull the runtime from under a command pool thread
+        if( !(*eraseptr)->second.jobs.empty() ) {
+            DEBUG(4, "unobserve: delete runtime " << (*eraseptr)->first << " when its commands are done because fd#" << fd << " is gone" << endl);
+            (*eraseptr)->second.owner    = -1;
+            (*eraseptr)->second.orphaned = true;
+            continue;
+        }
         DEBUG(4, "unobserve: delete runtime " << (*eraseptr)->first << " because fd#" << fd << " is gone" << endl);
         delete (*eraseptr)->second.rteptr;
         rtm.erase( *eraseptr );
@@ -404,7 +422,7 @@ void Usage( const char* name ) {
                                      mk6_bs(mk6info_type::minBlockSizeMap[true]);
     cout <<
 "Usage: " << name << " [-hned6*UD] [-m <level>] [-c <card>] [-p <port>] [-S <where>]\n"
-"              [-S <where>] [-f <fmt>] [-B <size>]\n\n"
+"              [-S <where>] [-f <fmt>] [-B <size>] [-j <n>]\n\n"
 "   -h, --help this message\n"
 "   -v, --version\n"
 "              display version information and exit succesfully\n"
@@ -462,7 +480,14 @@ void Usage( const char* name ) {
 "              *significant* and/or unspecified problems in case a\n"
 "              recording by the same name already exists.\n"
 "              Use at own risk.\n"
-"              Can be overridden on a per-runtime basis during program execution.\n";
+"              Can be overridden on a per-runtime basis during program execution.\n"
+"  -j, --command-threads <n>\n"
+"              Execute slow commands (scan_check, data_check, dir_info, mount,\n"
+"              set_disks, scan_set, ...) on a pool of <n> threads such that\n"
+"              other control connections are not held up. Commands on a\n"
+"              runtime are queued behind those, except \"evlbi?\" which\n"
+"              is answered immediately.\n"
+"              Default: 0 - execute all commands in the main thread\n";
     return;
 }
 
@@ -594,6 +619,10 @@ string process_runtime_command( bool qry,
             return string("!runtime = 6 : no active runtime '") + rt_name + "' ;";
         }
 
+        if ( !rt_iter->second.jobs.empty() ) {
+            return string("!runtime = 5 : runtime '") + rt_name + "' is busy executing commands ;";
+        }
+
         if ( fdmptr->second.runtime == rt_name ) {
             // if the runtime to delete is the current one, 
             // reset it to the default
@@ -606,6 +635,132 @@ string process_runtime_command( bool qry,
     return string("!runtime = 0 : ") + fdmptr->second.runtime + " ;"; 
 }
 
+// Execute the commands of 'job', starting at job->next, on behalf of the
+// connection 'fdmptr'.
+// Returns true if all commands were done and the reply can be sent.
+// Returns false if the job was queued for the command pool - the main loop
+// will call this function again when the pool is done with it.
+// Slow commands always go to the pool (if enabled). Whilst a runtime has
+// jobs in the pool, other commands on that runtime are queued behind them
+// except for a few queries that are safe to execute concurrently (see
+// is_busy_query()), such that e.g. "evlbi?" is answered whilst a
+// "scan_check?" is running.
+bool process_commands( cmdjob_type* job,
+                       fdmap_type::iterator fdmptr,
+                       runtimemap_type& rtm,
+                       const mk5commandmap_type& rt0_mk5cmds,
+                       const mk5commandmap_type& generic_mk5cmds,
+                       cmdpool_type& cmdpool ) {
+    for( ; job->next<job->commands.size(); job->next++ ) {
+        bool            qry;
+        vector<string>  args;
+        const string&   cmd( job->commands[job->next] );
+
+        if( cmd.empty() )
+            continue;
+        DEBUG((fdmptr->second.echo?2:10000), "Processing command '" << cmd << "'" << endl);
+
+        if( !::parse_command(cmd, qry, args, job->reply) )
+            continue;
+
+        const string&   keyword( args[0] );
+
+        // see if we know about this specific command
+        try {
+            if( keyword == "runtime" ) {
+                // select a runtime to pass to the functions
+                job->reply += process_runtime_command( qry, args, fdmptr, rtm);
+            } else if( keyword=="echo" ) {
+                // turn command echoing on or off
+                if( qry ) {
+                    ostringstream tmp;
+                    tmp << "!echo? 0 : " << (fdmptr->second.echo?"on":"off") << " ;";
+                    job->reply += tmp.str();
+                } else if( args.size()!=2 || !(args[1]=="on" || args[1]=="off") ) {
+                    job->reply += string("!echo= 8 : expects exactly one parameter 'on' or 'off';") ;
+                } else {
+                    // already verified we have 'on' or 'off'
+                    fdmptr->second.echo = (args[1]=="on");
+                    job->reply += string("!echo= 0 ;");
+                }
+            } else {
+                const mk5commandmap_type& mk5cmds = ( fdmptr->second.runtime==default_runtime ? rt0_mk5cmds : generic_mk5cmds );
+
+                // Check if the runtime we are observing is
+                // still the one when we started observing
+                runtimemap_type::iterator   rt_iter = current_runtime(fdmptr, rtm);
+
+                if ( rt_iter == rtm.end() ) {
+                    job->reply += string("!")+keyword+" " + QRY(qry) + " 4 : current runtime ('" + fdmptr->second.runtime + "') has been deleted;";
+                    continue;
+                }
+                per_rt_data&  rtdata( rt_iter->second );
+
+                if( cmdpool.enabled() && (::is_slow_command(keyword) || (!rtdata.jobs.empty() && !(qry && ::is_busy_query(keyword)))) ) {
+                    job->echo    = fdmptr->second.echo;
+                    job->rtname  = rt_iter->first;
+                    job->rteptr  = rtdata.rteptr;
+                    job->mk5cmds = &mk5cmds;
+
+                    rtdata.jobs.push_back( job );
+                    if( rtdata.jobs.size()==1 )
+                        cmdpool.submit( job );
+                    fdmptr->second.busy = true;
+                    DEBUG(4, "fd#" << fdmptr->first << " '" << keyword << "' on runtime '" << job->rtname << "' queued for cmdpool, "
+                             << rtdata.jobs.size() << " job" << (rtdata.jobs.size()==1 ? "" : "s") << " queued" << endl);
+                    return false;
+                }
+                job->reply += ::execute_command(mk5cmds, qry, args, *rtdata.rteptr);
+            }
+        }
+        catch( ... ) {
+            job->reply += ::exception_reply(keyword, qry);
+        }
+    }
+    return true;
+}
+
+// Send the reply for a fully processed command line back to the client.
+// If that fails, the connection is closed and removed from the
+// administration
+void send_reply( cmdjob_type* job,
+                 fdprops_type& fdprops,
+                 fdmap_type& fdmap,
+                 runtimemap_type& rtm ) {
+    ssize_t                 nwrite;
+    fdmap_type::iterator    fdmptr = fdmap.find( job->fd );
+    fdprops_type::iterator  fdptr  = fdprops.find( job->fd );
+
+    EZASSERT2(fdmptr!=fdmap.end() && fdptr!=fdprops.end(), bookkeeping,
+              EZINFO("fd#" << job->fd << " to send reply to not in administration"));
+
+    if( job->reply.empty() ) {
+        DEBUG(4, "No command(s) found, no reply sent" << endl);
+        return;
+    }
+    // processed all commands in the string. send the reply
+    DEBUG((fdmptr->second.echo?2:10000), "Reply: " << job->reply << endl);
+    // do *not* forget the \r\n ...!
+    // HV: 18-nov-2011 see main() near 'const bool crlf =...';
+    if( job->crlf )
+        job->reply += "\r\n";
+    else
+        job->reply += "\n";
+
+    nwrite = ::write(job->fd, job->reply.c_str(), job->reply.size());
+    // if <=0, socket was closed, remove it from the list
+    if( nwrite<=0 ) {
+        if( nwrite<0 ) {
+            lastsyserror_type lse;
+            DEBUG(0, "Error on fd#" << fdptr->first << " ["
+                  << fdptr->second << "] - " << lse << endl);
+        }
+        ::close( fdptr->first );
+        ::unobserve(fdptr->first, fdmap, rtm);
+        fdprops.erase( fdptr );
+    }
+}
+
 typedef enum { no_sfxc = 0, lissen_tcp, lissen_unix } sfxc_lissen_type;
 
 // main!
@@ -658,6 +813,7 @@ int main(int argc, char** argv) {
         long int     v;
         S_BANKMODE   bankmode = SS_BANKMODE_NORMAL;
         unsigned int minimum_bs = 0;
+        unsigned int ncmdthreads = 0;
 
         struct option  longopts[] = {
             { "echo",          no_argument,       NULL, 'e' },
@@ -677,11 +833,12 @@ int main(int argc, char** argv) {
             { "version",       no_argument,       NULL, 'v' },
             { "check-unique-recording-names",    no_argument, NULL, 'U'},
             { "no-check-unique-recording-names", no_argument, NULL, 'D'},
+            { "command-threads", required_argument, NULL, 'j' },
             // Leave this one as last
             { NULL,            0,                 NULL, 0   }
         };
 
-        while( (option=::getopt_long(argc, argv, "nbehdm:c:p:r:6*f:S:B:vUD", longopts, NULL))>=0 ) {
+        while( (option=::getopt_long(argc, argv, "nbehdm:c:p:r:6*f:S:B:vUDj:", longopts, NULL))>=0 ) {
             switch( option ) {
                 case '*':
                     // ok .. someone might allow us to run with root privilege!
@@ -845,6 +1002,16 @@ int main(int argc, char** argv) {
                 case 'D':
                     mk6info_type::defaultUniqueRecordingNames = false;
                     break;
+                case 'j':
+                    v = ::strtol(optarg, 0, 0);
+                    // a handful will do
+                    if( v<0 || v>64 ) {
+                        cerr << "Value for number of command threads out-of-range.\n"
+                            << "Useful range is: [0, 64] (inclusive)" << endl;
+                        return -1;
+                    }
+                    ncmdthreads = (unsigned int)v;
+                    break;
                 default:
                    cerr << "Unknown option '" << option << "'" << endl;
                    return -1;
@@ -1142,6 +1309,9 @@ int main(int argc, char** argv) {
         // for the other runtimes we always use the generic command map
         generic_mk5cmds = make_generic_commandmap( do_buffering_mapping );
 
+        // Threads for executing slow commands, if requested
+        cmdpool_type       cmdpool( ncmdthreads );
+
 
         // Goodie! Now set up for accepting incoming command-connections!
         // getsok() will throw if no socket can be created
@@ -1173,6 +1343,8 @@ int main(int argc, char** argv) {
             //      mainly used at correlator(s). Maps 'task_id'
             //      to rot-to-systemtime mapping
             //    * 'sfxc' => listens for incoming SFXC DataReader connections
+            //    * 'cmdpool' => the command pool threads write the
+            //      command lines they're done with to this fd
             //    * 'commandfds' => accepted commandclients send
             //      commands over these fd's and we reply to them
             //      over the same fd. 
@@ -1187,14 +1359,15 @@ int main(int argc, char** argv) {
             const unsigned int           signalidx    = 1;
             const unsigned int           rotidx       = 2;
             const unsigned int           sfxcidx      = 3;
-            const unsigned int           cmdsockoffs  = 4;
+            const unsigned int           cmdpoolidx   = 4;
+            const unsigned int           cmdsockoffs  = 5;
             // we need to fix those values here because the
             // acceptedfds/acceptedsfxcfds may change size below - e.g. if
             // clients made a connection. But those (new) fd's won't be in
             // the current list of fd's
             const unsigned int           n_jive5ab    = acceptedfds.size();
             const unsigned int           n_sfxc       = acceptedsfxcfds.size(); 
-            const unsigned int           nrfds        = 4 + n_jive5ab/*acceptedfds.size()*/ + n_sfxc/*acceptedsfxcfds.size()*/;
+            const unsigned int           nrfds        = cmdsockoffs + n_jive5ab/*acceptedfds.size()*/ + n_sfxc/*acceptedsfxcfds.size()*/;
             const unsigned int           nrlistenfd   = 2;
             const unsigned int           listenfds[2] = {listenidx, sfxcidx};
             char const * const           names[2]     = {"jive5ab", "sfxc"};
@@ -1224,10 +1397,21 @@ int main(int argc, char** argv) {
             fds[sfxcidx].fd        = sfxcsok;
             fds[sfxcidx].events    = POLLIN|POLLPRI|POLLERR|POLLHUP;
 
+            // Position 'cmdpoolidx' is where the command pool tells us it's
+            // done with a command line. If no pool, the fd is -1 and
+            // poll(2) ignores it
+            fds[cmdpoolidx].fd     = cmdpool.donefd();
+            fds[cmdpoolidx].events = POLLIN|POLLPRI|POLLERR|POLLHUP;
+
             // Loop over the accepted connections
             for(idx=cmdsockoffs, curfd=acceptedfds.begin();
                 curfd!=acceptedfds.end(); idx++, curfd++ ) {
-                fds[idx].fd     = curfd->first;
+                // Don't read from connections that have a command line
+                // being executed by the command pool; a negative fd is
+                // ignored by poll(2)
+                const fdmap_type::const_iterator  fdmptr = fdmap.find( curfd->first );
+
+                fds[idx].fd     = ((fdmptr!=fdmap.end() && fdmptr->second.busy) ? -1 : curfd->first);
                 fds[idx].events = POLLIN|POLLPRI|POLLERR|POLLHUP;
             }
             // And append the accepted SFXC client connections
@@ -1285,6 +1469,41 @@ int main(int argc, char** argv) {
                 break;
             }
 
+            // The command pool is done with a command line. Start the next
+            // one queued on the same runtime, then continue processing this
+            // command line - it may not have been complete.
+            if( (events=fds[cmdpoolidx].revents)!=0 ) {
+                if( events&POLLIN ) {
+                    cmdjob_type*               job    = cmdpool.completed();
+                    runtimemap_type::iterator  rtmptr = runtimes.find( job->rtname );
+                    fdmap_type::iterator       fdmptr = fdmap.find( job->fd );
+
+                    EZASSERT2(rtmptr!=runtimes.end() && !rtmptr->second.jobs.empty() && rtmptr->second.jobs.front()==job, bookkeeping,
+                              EZINFO("cmdpool returned job for fd#" << job->fd << " which is not current on runtime '" << job->rtname << "'"));
+                    EZASSERT2(fdmptr!=fdmap.end(), bookkeeping,
+                              EZINFO("cmdpool returned job for fd#" << job->fd << " which is not in fdmap"));
+
+                    per_rt_data&  rtdata( rtmptr->second );
+
+                    rtdata.jobs.pop_front();
+                    if( !rtdata.jobs.empty() )
+                        cmdpool.submit( rtdata.jobs.front() );
+                    else if( rtdata.orphaned ) {
+                        DEBUG(4, "main: delete runtime " << rtmptr->first << " now that its commands are done" << endl);
+                        delete rtdata.rteptr;
+                        runtimes.erase( rtmptr );
+                    }
+                    fdmptr->second.busy = false;
+
+                    if( process_commands(job, fdmptr, runtimes, rt0_mk5cmds, generic_mk5cmds, cmdpool) ) {
+                        send_reply(job, acceptedfds, fdmap, runtimes);
+                        delete job;
+                    }
+                }
+                if( events&POLLHUP || events&POLLERR )
+                    DEBUG(-1, "main: cmdpool pipe got " << eventor(events) << endl);
+            }
+
             // check for new incoming connections
             for(unsigned int itmp=0; itmp<nrlistenfd; itmp++) {
                 const unsigned int fd_idx = listenfds[itmp];
@@ -1413,7 +1632,7 @@ int main(int argc, char** argv) {
                 // if stuff may be read, see what we can make of it
                 if( events&POLLIN ) {
                     char                           linebuf[4096];
-                    ssize_t                        nread, nwrite;
+                    ssize_t                        nread;
 
                     // attempt to read a line
                     nread = ::read(fd, linebuf, sizeof(linebuf));
@@ -1469,9 +1688,7 @@ int main(int argc, char** argv) {
                     // And we need sanitizing variables ...
                     char*                          sptr;
                     char*                          eptr;
-                    string                         reply;
                     vector<string>                 commands;
-                    vector<string>::const_iterator curcmd;
 
                     // HV: 18-nov-2012
                     //     telnet sends \r\n, tstdimino sends a separate \n
@@ -1509,126 +1726,11 @@ int main(int argc, char** argv) {
                     // Even if we did receive only whitespace, we still need to
                     // send back *something*. A single ';' for an empty command should
                     // be just fine
-                    for( curcmd=commands.begin(); curcmd!=commands.end(); curcmd++ ) {
-                        bool                               qry;
-                        string                             keyword;
-                        const string&                      cmd( *curcmd );
-                        vector<string>                     args;
-                        string::size_type                  posn;
-                        mk5commandmap_type::const_iterator cmdptr;
-
-                        if( cmd.empty() )
-                            continue;
-                        DEBUG((fdmptr->second.echo?2:10000), "Processing command '" << cmd << "'" << endl);
-
-                        // find out if it was a query or not
-                        if( (posn=cmd.find_first_of("?="))==string::npos ) {
-                            reply += ("!syntax = 7 : Not a command or query;");
-                            continue;
-                        }
-                        qry     = (cmd[posn]=='?');
-                        keyword = ::tolower( cmd.substr(0, posn) );
-                        if( keyword.empty() ) {
-                            reply += "!syntax = 7 : No keyword given ;";
-                            continue;
-                        }
+                    cmdjob_type*   job = new cmdjob_type(fd, crlf, fdmptr->second.echo, commands);
 
-                        // now get the arguments, if any
-                        // (split everything after '?' or '=' at ':'s and each
-                        // element is an argument)
-                        args = ::split(cmd.substr(posn+1), ':');
-                        // stick the keyword in at the first position
-                        args.insert(args.begin(), keyword);
-
-                        // see if we know about this specific command
-                        try {
-                            if( keyword == "runtime" ) {
-                                // select a runtime to pass to the functions
-                                reply += process_runtime_command( qry, args, fdmptr, runtimes);
-                            } else if( keyword=="echo" ) {
-                                // turn command echoing on or off
-                                if( qry ) {
-                                    ostringstream tmp;
-                                    tmp << "!echo? 0 : " << (fdmptr->second.echo?"on":"off") << " ;";
-                                    reply += tmp.str();
-                                } else if( args.size()!=2 || !(args[1]=="on" || args[1]=="off") ) {
-                                    reply += string("!echo= 8 : expects exactly one parameter 'on' or 'off';") ;
-                                } else {
-                                    // already verified we have 'on' or 'off'
-                                    fdmptr->second.echo = (args[1]=="on");
-                                    reply += string("!echo= 0 ;");
-                                }
-                            } else {
-                                mk5commandmap_type& mk5cmds = ( fdmptr->second.runtime==default_runtime ? rt0_mk5cmds : generic_mk5cmds );
-                                if( (cmdptr=mk5cmds.find(keyword))==mk5cmds.end() ) {
-                                    reply += (string("!")+keyword+((qry)?('?'):('='))+" 7 : ENOSYS - not implemented ;");
-                                    continue;
-                                }
-                                
-                                // Check if the runtime we are observing is
-                                // still the one when we started observing
-                                runtimemap_type::iterator   rt_iter = current_runtime(fdmptr, runtimes);
-
-                                if ( rt_iter == runtimes.end() ) {
-                                    reply += string("!")+keyword+" " + QRY(qry) + " 4 : current runtime ('" + fdmptr->second.runtime + "') has been deleted;";
-                                }
-                                else {
-                                    runtime* rteptr = rt_iter->second.rteptr;
-
-                                    try {
-                                        reply += cmdptr->second(qry, args, *rteptr);
-                                    } 
-                                    catch (...) {
-                                        // do the protect=off bookkeeping
-                                        rteptr->protected_count = max(rteptr->protected_count, 1u) - 1;
-                                        throw;
-                                    }
-                                    // do the protect=off bookkeeping
-                                    rteptr->protected_count = max(rteptr->protected_count, 1u) - 1;
-                                }
-                            }
-                        }
-                        catch( const Error_Code_6_Exception& e) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
-                        }
-                        catch( const Error_Code_8_Exception& e) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 8 : " + e.what() + ";";
-                        }
-                        catch( const cmdexception& e ) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 6 : " + e.what() + ";";
-                        }
-                        catch( const exception& e ) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 4 : " + e.what() + ";";
-                        }
-                        catch( ... ) {
-                            reply += string("!")+keyword+" " + QRY(qry) + " 4 : unknown exception ;";
-                        }
-                    }
-
-                    if( reply.empty() ) {
-                        DEBUG(4, "No command(s) found, no reply sent" << endl);
-                        break;
-                    }
-                    // processed all commands in the string. send the reply
-                    DEBUG((fdmptr->second.echo?2:10000), "Reply: " << reply << endl);
-                    // do *not* forget the \r\n ...!
-                    // HV: 18-nov-2011 see above near 'const bool crlf =...';
-                    if( crlf )
-                        reply += "\r\n";
-                    else
-                        reply += "\n";
-
-                    nwrite = ::write(fd, reply.c_str(), reply.size());
-                    // if <=0, socket was closed, remove it from the list
-                    if( nwrite<=0 ) {
-                        if( nwrite<0 ) {
-                            lastsyserror_type lse;
-                            DEBUG(0, "Error on fd#" << fdptr->first << " ["
-                                  << fdptr->second << "] - " << lse << endl);
-                        }
-                        ::close( fdptr->first );
-                        ::unobserve(fdptr->first, fdmap, runtimes);
-                        fdprops.erase( fdptr );
+                    if( process_commands(job, fdmptr, runtimes, rt0_mk5cmds, generic_mk5cmds, cmdpool) ) {
+                        send_reply(job, fdprops, fdmap, runtimes);
+                        delete job;
                     }
                 }
                 // done with this fd
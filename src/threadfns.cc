@@ -45,6 +45,10 @@
 #include <carrayutil.h>
 #include <auto_array.h>
 #include <countedpointer.h>
+#include <fillpattern.h>
+#include <frameclock.h>
+#include <vdiffilter.h>
+#include <threadfns/chunkmakers.h>
 
 #include <sstream>
 #include <string>
@@ -52,6 +56,7 @@
 #include <fstream>
 #include <algorithm> // for std::min 
 #include <queue>
+#include <deque>
 #include <list>
 #include <map>
 #include <stdexcept>
@@ -233,8 +238,13 @@ void* delayed_play_fn( void* dplay_args_ptr ) {
 }
 
 string blockpool_memstat_fn(blockpool_type* bp) {
+    ostringstream                     oss;
+    const blockpool_type::stats_type  st = bp->get_stats();
+
     bp->show_usecnt();
-    return string("blockpool status");
+    oss << "blockpool status : " << st.nGet << " get : " << st.nHit << " from magazine : "
+        << st.nRefill << " refill : " << st.nPool << " pool";
+    return oss.str();
 }
 
 void fillpatterngenerator(outq_type<block>* outq, sync_type<fillpatargs>* args) {
@@ -2414,6 +2424,7 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
     unsigned int              nSender = 0;
     const unsigned int        maxSender( sizeof(per_sender)/sizeof(per_sender[0]) );
     per_sender_type*          endSender( &per_sender[0] );
+    vdiffilter_type           vfilter;
 
     // We really need a non-null runtime
     rteptr = network ? network->rteptr : 0;
@@ -2468,17 +2479,19 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
     // After the peek phase we can compute where the frame data should go.
     // So only the iov_base of that I/O vector element needs to change
     // and we an immediately do a full read.
+    // Frames that do not pass the VDIF filter are read with the skip
+    // message: only the sequence number, the kernel discards the rest.
     struct iovec    iov_p[2], iov_r[2]; 
-    struct msghdr   msg_p, msg_r; 
+    struct msghdr   msg_p, msg_r, msg_s; 
 
     // We'd like to know who's sending to us
-    msg_p.msg_name    = msg_r.msg_name    = (void*)&sender;
-    msg_p.msg_namelen = msg_r.msg_namelen = sizeof(sender);
+    msg_p.msg_name    = msg_r.msg_name    = msg_s.msg_name    = (void*)&sender;
+    msg_p.msg_namelen = msg_r.msg_namelen = msg_s.msg_namelen = sizeof(sender);
 
     // no control stuff, nor flags
-    msg_p.msg_control    = msg_r.msg_control    = 0;
-    msg_p.msg_controllen = msg_r.msg_controllen = 0;
-    msg_p.msg_flags      = msg_r.msg_flags      = 0;
+    msg_p.msg_control    = msg_r.msg_control    = msg_s.msg_control    = 0;
+    msg_p.msg_controllen = msg_r.msg_controllen = msg_s.msg_controllen = 0;
+    msg_p.msg_flags      = msg_r.msg_flags      = msg_s.msg_flags      = 0;
 
     // The size of the parts of the messages are known
     // and for the sequencenumber, we already know the destination address
@@ -2499,10 +2512,18 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
     msg_p.msg_iov        = &iov_p[0];
     msg_r.msg_iovlen     = 2;
     msg_r.msg_iov        = &iov_r[0];
+    msg_s.msg_iovlen     = 1;
+    msg_s.msg_iov        = &iov_r[0];
+
+    // Optionally time stamp each datagram (see net_timestamp). The peek
+    // sees the packet first so that's where the time stamp is delivered
+    rxtimestamp_type    rxts(network->netparms.rx_timestamp, network->fd, msg_p, rteptr, rd_size);
 
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
             rteptr->evlbi_stats[ network->tag ] = evlbi_stats_type();
+            rteptr->vdif_filter_stats = vdiffilter_stats_type();
+            vfilter = rteptr->vdif_filter;
             rteptr->statistics.init(args->stepid, "UdpsNorReadStream"),
             delete [] zeroes_p; delete network->threadid; network->threadid = 0;);
 
@@ -2523,6 +2544,7 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
             << " total:" << (iov_r[0].iov_len + iov_r[1].iov_len)
             << " pkts:" << n_dg_p_block 
             << " avbs: " << network->allow_variable_block_size
+            << (vfilter.active() ? " VDIF filter" : "")
             << endl);
 
     // create references to the statisticscounters -
@@ -2532,10 +2554,12 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
     ucounter_type&   loscnt( rteptr->evlbi_stats[ network->tag ].pkt_lost );
     ucounter_type&   pktcnt( rteptr->evlbi_stats[ network->tag ].pkt_in );
+    arrival_stats_type& arrival( rteptr->evlbi_stats[ network->tag ].arrival );
 //    ucounter_type&   ooocnt( rteptr->evlbi_stats.pkt_ooo );
 //    ucounter_type&   ooosum( rteptr->evlbi_stats.ooosum );
 //    ucounter_type    tmppkt, tmpooocnt, tmpooosum, tmplos;
     ucounter_type    tmplos;
+    vdiffilter_stats_type& vfstats( rteptr->vdif_filter_stats );
 
     // inner loop variables
     const ssize_t         waitpeek    = (ssize_t)(iov_p[0].iov_len + iov_p[1].iov_len);
@@ -2550,52 +2574,61 @@ void udpsnorreader_stream(outq_type< tagged<block> >* outq, sync_type<fdreaderar
     while( true ) {
         // The msg_namelen parameters are value-return fields and may be
         // modified by recvmsg(3)
-        msg_p.msg_namelen = msg_r.msg_namelen = sizeof(sender);
+        msg_p.msg_namelen = msg_r.msg_namelen = msg_s.msg_namelen = sizeof(sender);
         if( (n=::recvmsg(network->fd, &msg_p, MSG_PEEK))!=waitpeek )
             break;
-       
-        // Since we arrive here we have a VDIF header!
-        // Let's look up the destination tag for this one
-        dsid = datastreams.vdif2stream_id( vhdr.station_id, vhdr.thread_id, sender );
+        rxts.packet(msg_p, &vhdr, arrival);
 
-        // Get current buffer for that datastream id
-        curDS = datastream_state_map.find( dsid );
-
-        if( curDS==datastream_state_map.end() ) {
-           // first data for this data stream
-           pair<ds_map_type::iterator, bool> insres = datastream_state_map.insert(make_pair(dsid, dsm_entry(network->pool->get())));
-           if( insres.second==false ) {
-               delete [] zeroes_p;
-               THROW_EZEXCEPT(datastreamexception_type, "Failed to add state for newly found data stream #" << dsid);
-           }
-           curDS = insres.first;
-        }
+        // Unwanted frames never get near a block, but their sequence
+        // number still counts for the loss statistics
+        if( !vfilter.accept(vhdr, vfstats) ) {
+            if( (n=::recvmsg(network->fd, &msg_s, 0))!=(ssize_t)iov_r[0].iov_len )
+                break;
+            pktcnt++;
+        } else {
+            // Since we arrive here we have a VDIF header!
+            // Let's look up the destination tag for this one
+            dsid = datastreams.vdif2stream_id( vhdr.station_id, vhdr.thread_id, sender );
+
+            // Get current buffer for that datastream id
+            curDS = datastream_state_map.find( dsid );
+
+            if( curDS==datastream_state_map.end() ) {
+               // first data for this data stream
+               pair<ds_map_type::iterator, bool> insres = datastream_state_map.insert(make_pair(dsid, dsm_entry(network->pool->get())));
+               if( insres.second==false ) {
+                   delete [] zeroes_p;
+                   THROW_EZEXCEPT(datastreamexception_type, "Failed to add state for newly found data stream #" << dsid);
+               }
+               curDS = insres.first;
+            }
 
-        // Now we can decide where to stick the pakkit
-        dsm_entry&  ds_state( curDS->second );
+            // Now we can decide where to stick the pakkit
+            dsm_entry&  ds_state( curDS->second );
 
-        iov_r[1].iov_base = ds_state.location;
+            iov_r[1].iov_base = ds_state.location;
 
-        if( (n=::recvmsg(network->fd, &msg_r, MSG_WAITALL))!=waitallread )
-            break;
+            if( (n=::recvmsg(network->fd, &msg_r, MSG_WAITALL))!=waitallread )
+                break;
 
-        // OK. Packet reading succeeded
-        counter += waitallread;
-        pktcnt++;
+            // OK. Packet reading succeeded
+            counter += waitallread;
+            pktcnt++;
 
-        // Write zeroes if necessary
-        (void)(n_zeroes && ::memcpy(ds_state.location+rd_size, zeroes_p, n_zeroes));
+            // Write zeroes if necessary
+            (void)(n_zeroes && ::memcpy(ds_state.location+rd_size, zeroes_p, n_zeroes));
 
-        // Compute location for next pakkit.
-        // Release previous block if filled up [+get a new one to fill up]
-        // Note: we read rd_size and advance by wr_size!
-        ds_state.location += wr_size;
-        if( ds_state.location >= ds_state.end ) {
-            if( outq->push( tagged<block>(dsid, ds_state.b))==false )
-                break;
-            // Remove from the mapping; we'll insert a new one when data for
-            // that data stream next arrives
-            datastream_state_map.erase( curDS );
+            // Compute location for next pakkit.
+            // Release previous block if filled up [+get a new one to fill up]
+            // Note: we read rd_size and advance by wr_size!
+            ds_state.location += wr_size;
+            if( ds_state.location >= ds_state.end ) {
+                if( outq->push( tagged<block>(dsid, ds_state.b))==false )
+                    break;
+                // Remove from the mapping; we'll insert a new one when data for
+                // that data stream next arrives
+                datastream_state_map.erase( curDS );
+            }
         }
 
 #ifdef FILA
@@ -4707,6 +4740,23 @@ void frame2block(inq_type<frame>* inq, outq_type<block>* outq) {
     DEBUG(0, "frame2block: stopping" << endl);
 }
 
+void framebatch2block(inq_type<framebatch>* inq, outq_type<block>* outq) {
+    bool        stop = false;
+    framebatch  fb;
+
+    DEBUG(0, "framebatch2block: starting" << endl);
+    while( !stop && inq->pop(fb) ) {
+        const unsigned int  n = (unsigned int)fb.size();
+
+        // Find runs of frames that follow each other
+        for(unsigned int first=0, last; !stop && first<n; first=last) {
+            for(last=first+1; last<n && fb.entries[last].offset==fb.entries[last-1].offset+fb.framesize; last++) { }
+            stop = (outq->push(fb.data.sub(fb.entries[first].offset, (last-first)*fb.framesize))==false);
+        }
+    }
+    DEBUG(0, "framebatch2block: stopping" << endl);
+}
+
 
 
 // Buffer a number of bytes
@@ -5026,11 +5076,9 @@ void blockchecker(inq_type<block>* inq, sync_type<fillpatargs>* args) {
         
         while( start<end ) {
             uint64_t     expect = ((fpargs->fill!=fp && *start==fp)?(fp):(fpargs->fill & m));
-            unsigned int i;
+            unsigned int i = (unsigned int)(::fill_span(start, rd, expect) / sizeof(uint64_t));
 
-            for(i=0; i<n_ull_p_rd; i++, start++)
-                if( *start!=expect )
-                    break;
+            start += i;
             if( i!=n_ull_p_rd ) {
                 DEBUG(-1, "blockchecker: #FAIL at byte "
                           << i*sizeof(uint64_t) << ", expect "
@@ -5309,6 +5357,8 @@ void timechecker2(inq_type<frame>* inq, sync_type<headersearch_type>* args) {
     struct tm                       frametime_tm;
     highrestime_type                frametime;
     highrestime_type                lasttime;
+    frametime_type                  frameclk, lastclk;
+    frameclock_type                 clock;
     headersearch_type               header = *args->userdata;
     pcint::timeval_type             tt;
     const headersearch::strict_type chk = headersearch::strict_type(headersearch::chk_default)|headersearch::chk_verbose;
@@ -5349,6 +5399,13 @@ void timechecker2(inq_type<frame>* inq, sync_type<headersearch_type>* args) {
     EZASSERT2(framedelta>0, timecheckerexception,
               EZINFO("Time between frame #2 " << frametime << " and #1 " << lasttime << " is too small"));
 
+    // With an integer number of frames per second the next frame's time
+    // is just one tick of the frame clock further
+    clock = frameclock_type::from_framelength( subsecond_type((uint64_t)framedelta.numerator(),
+                                                              (uint64_t)framedelta.denominator()) );
+    if( !clock.to_frametime(frametime, lastclk) )
+        clock = frameclock_type();
+
     nframe = 2;
     lasttime = frametime;
 
@@ -5365,10 +5422,23 @@ void timechecker2(inq_type<frame>* inq, sync_type<headersearch_type>* args) {
         catch( ... ) {
             continue;
         }
-        delta = frametime - lasttime;
+        bool  wrong;
 
-        // More than 10ns difference triggers 'error'
-        if( delta!=framedelta ) {
+        if( clock.valid() && clock.to_frametime(frametime, frameclk) ) {
+            clock.advance( lastclk );
+            wrong   = (frameclk!=lastclk);
+            lastclk = frameclk;
+            // only compute the actual delta for reporting
+            if( wrong )
+                delta = frametime - lasttime;
+        } else {
+            // Not on the frame grid; from now on we can't use the clock
+            clock = frameclock_type();
+            delta = frametime - lasttime;
+            wrong = (delta!=framedelta);
+        }
+
+        if( wrong ) {
             DEBUG(-1, "timechecker2[" << pcint::timeval_type::now() << "] frame #" << nframe << " framedelta is " <<
                       delta << "s, should be " << framedelta << endl);
             ::gmtime_r(&frametime.tv_sec, &frametime_tm);
@@ -5418,23 +5488,63 @@ void timegrabber(inq_type<frame>* inq, sync_type<timegrabber_type>* args) {
     DEBUG(2, "timegrabber: done " << nFrame << " frames, " << nSec << "s" << endl);
 }
 
-void timemanipulator(inq_type<tagged<frame> >* inq,
-                     outq_type<tagged<frame> >* outq,
+void timemanipulator(inq_type<framebatch>* inq,
+                     outq_type<framebatch>* outq,
                      sync_type<timemanipulator_type>* args) {
     const highresdelta_type  dt = args->userdata->dt;
 
     while( true ) {
-        tagged<frame>    tf;
-        if( inq->pop(tf)==false )
+        framebatch    fb;
+        if( inq->pop(fb)==false )
+            break;
+
+        for(framebatch::entries_type::iterator e=fb.entries.begin(); e!=fb.entries.end(); e++)
+            e->frametime += dt;
+
+        if( outq->push(fb)==false )
             break;
+    }
+}
+
+
+void vdiffilter(inq_type<framebatch>* inq, outq_type<framebatch>* outq, sync_type<runtime*>* args) {
+    runtime*               rteptr = *args->userdata;
+    framebatch             fb;
+    vdiffilter_type        vfilter;
+    vector<unsigned char>  verdicts;
 
-        highrestime_type& ts = tf.item.frametime;
+    RTEEXEC(*rteptr,
+            rteptr->vdif_filter_stats = vdiffilter_stats_type();
+            vfilter = rteptr->vdif_filter);
+
+    vdiffilter_stats_type& vfstats( rteptr->vdif_filter_stats );
 
-        ts += dt;
+    DEBUG(-1, "vdiffilter: starting." << endl);
+    while( inq->pop(fb) ) {
+        if( fb.entries.empty() )
+            continue;
 
-        if( outq->push(tf)==false )
+        // First decide on all frames in the batch, then only keep the
+        // accepted ones
+        verdicts.resize( fb.size() );
+
+        const size_t  npass = vfilter.verdict((const unsigned char*)fb.data.iov_base,
+                                              fb.entries.begin(), fb.entries.end(),
+                                              &verdicts[0], vfstats);
+        if( npass==0 )
+            continue;
+        if( npass<fb.size() ) {
+            size_t  j = 0;
+            for(size_t i=0; i<fb.size(); i++)
+                if( verdicts[i]==vdiffilter_type::pass_reason )
+                    fb.entries[j++] = fb.entries[i];
+            fb.entries.resize( j );
+        }
+        if( outq->push(fb)==false )
             break;
     }
+    DEBUG(-1, "vdiffilter: done. Passed " << vfstats.pass << ", dropped on thread/station/time " <<
+              vfstats.thread << "/" << vfstats.station << "/" << vfstats.time << endl);
 }
 
 
@@ -5467,7 +5577,12 @@ struct tagstate_type {
 void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq, sync_type<framefilterargs_type*>* args) {
     uint64_t                    dropcount = 0;
     tagged<frame>               tf;
+    frametime_type              ft;
     const framefilterargs_type& ffargs( **args->userdata );
+    // Checking if a time stamp is a multiple of the output frame length
+    // is an integer operation if there are an integer number of output
+    // frames per second
+    const frameclock_type       outclock( frameclock_type::from_framelength(ffargs.framelength) );
 
     DEBUG(-1, "framefilter: starting." << 
               " naccumulate=" << ffargs.naccumulate << " VDIF framelen=" << ffargs.framelength << "s" << endl);
@@ -5489,7 +5604,11 @@ void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq,
                 // need to resync. Check if the frame for the current tag's
                 // time stamp is an integer multiple of the output frame
                 // duration
-                if( (tf.item.frametime.tv_subsecond / ffargs.framelength).denominator()!=1 ) {
+                const bool  multiple = (outclock.valid() ?
+                                        outclock.to_frametime(tf.item.frametime, ft) :
+                                        (tf.item.frametime.tv_subsecond / ffargs.framelength).denominator()==1);
+
+                if( !multiple ) {
                     // If we are synced, this is bad news because apparently
                     // we lost a (couple of) frame(s) because we end up at
                     // an incompatible time stamp [not multiple of VDIF
@@ -5540,15 +5659,10 @@ void framefilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq,
 }
 
 // A median filter to throw out frames with erroneous time stamps
-struct extract_time_stamp {
-    time_t operator()( const tagged<frame>& tf ) const {
-        return tf.item.frametime.tv_sec;
-    }
-};
-
-void medianfilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq) {
-    typedef tagged<frame>       tf_type;
-    typedef std::list<tf_type>  framebuf_type;
+void medianfilter(inq_type<framebatch>* inq, outq_type<tagged<frame> >* outq) {
+    typedef std::deque<framebatch>      batchbuf_type;
+    typedef std::deque<time_t>          window_type;
+    typedef std::vector<tagged<frame> > framebuf_type;
 
     bool               quit = false;
     // Allocate one array of time stamps. Note that the code below
@@ -5557,50 +5671,55 @@ void medianfilter(inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq
     time_t             tsbuf[ 5 ];
     const size_t       n = sizeof(tsbuf)/sizeof(tsbuf[0]);
     uint64_t           dropped = 0, total = 0;
+    framebatch         fb;
+    // The batches that hold frames not decided upon yet, the first of
+    // those is batchbuf.front().entries[cur]. The time stamps of those
+    // frames are in the window.
+    batchbuf_type      batchbuf;
+    size_t             cur = 0;
+    window_type        window;
     framebuf_type      framebuf;
-    extract_time_stamp ts_extractor;
 
     DEBUG(-1, "medianfilter: starting." << endl);
 
-    while( !quit ) {
-        tf_type     frm;
-
-        if( inq->pop(frm)==false )
-            break;
-
-        // Here is where we assume 'n' > 1: we can always push first
-        // and *then* check for "have we got 'n' frames already?"
-        framebuf.push_back( frm );
-        total++;
-
-        // If not enough frames in buffer yet, nothing to do
-        if( framebuf.size()<n )
-            continue;
-
-        // Ok - transform the frame's time stamps into a vector
-        // such that they can be sorted
-
-        // Extract all the time stamps
-        std::transform(framebuf.begin(), framebuf.end(), &tsbuf[0], ts_extractor);
-
-        // Sort them
-        std::sort(&tsbuf[0], &tsbuf[n]);
+    while( !quit && inq->pop(fb) ) {
+        for(framebatch::entries_type::const_iterator e=fb.entries.begin(); e!=fb.entries.end(); e++)
+            window.push_back( e->frametime.tv_sec );
+        total += fb.size();
+        batchbuf.push_back( fb );
+
+        // Decide on each frame that has (n-1) frames following it
+        framebuf.clear();
+        while( window.size()>=n ) {
+            while( cur==batchbuf.front().size() ) {
+                batchbuf.pop_front();
+                cur = 0;
+            }
+            // Sort the time stamps
+            std::copy(window.begin(), window.begin()+n, &tsbuf[0]);
+            std::sort(&tsbuf[0], &tsbuf[n]);
 
-        // Let the first frame pass if it's within +/-1 of the median value
-        if( ::labs((long)(framebuf.front().item.frametime.tv_sec - tsbuf[ n/2 ])) <= 1 )
-            quit = (outq->push( framebuf.front() )==false);
-        else
-            dropped++;
-        // Ok, frame was dropped or pushed on; it can go from our list now
-        framebuf.pop_front();
+            // Let the first frame pass if it's within +/-1 of the median value
+            if( ::labs((long)(window.front() - tsbuf[ n/2 ])) <= 1 )
+                framebuf.push_back( batchbuf.front().get_tagged(cur) );
+            else
+                dropped++;
+            window.pop_front();
+            cur++;
+        }
+        quit = (framebuf.size() && outq->push_n(framebuf)==false);
     }
     
     // If we weren't quitting (quit == true => failed to push downstream),
     // we should pass on as many frames as we can. Unfiltered?
-    for(framebuf_type::iterator curf=framebuf.begin(); !(quit || curf==framebuf.end()); curf++)
-        quit = (outq->push( *curf )==false);
-    // Ok, clear the buffer
     framebuf.clear();
+    for( ; !quit && batchbuf.size(); batchbuf.pop_front(), cur=0)
+        for( ; cur<batchbuf.front().size(); cur++)
+            framebuf.push_back( batchbuf.front().get_tagged(cur) );
+    if( !quit && framebuf.size() )
+        outq->push_n(framebuf);
+    // Ok, clear the buffer
+    batchbuf.clear();
 
     DEBUG(-1, "medianfilter: done. Dropped " << dropped << ", total " << total << " (" <<
               format("%.2lf%%", (total>0) ? ((double)dropped / (double)total)*100.0 : (double)0) << ")" << endl);
@@ -6240,6 +6359,35 @@ frame::frame(format_type tp, unsigned int n, const highrestime_type& ft, block d
     frametype( tp ), ntrack( n ), frametime( ft ), framedata( data )
 {}
 
+framebatch::entry_type::entry_type():
+    offset( 0 ), tag( 0 )
+{}
+
+framebatch::entry_type::entry_type(unsigned int o, unsigned int t, const highrestime_type& ft):
+    offset( o ), tag( t ), frametime( ft )
+{}
+
+framebatch::framebatch():
+    frametype( fmt_unknown ), ntrack( 0 ), framesize( 0 )
+{}
+
+framebatch::framebatch(format_type tp, unsigned int n, unsigned int fs, const block& d):
+    frametype( tp ), ntrack( n ), framesize( fs ), data( d )
+{}
+
+framebatch framebatch::empty_copy( void ) const {
+    return framebatch(frametype, ntrack, framesize, data);
+}
+
+frame framebatch::get_frame(size_t i) const {
+    const entry_type&  e( entries[i] );
+    return frame(frametype, ntrack, e.frametime, data.sub(e.offset, framesize));
+}
+
+tagged<frame> framebatch::get_tagged(size_t i) const {
+    return tagged<frame>(entries[i].tag, get_frame(i));
+}
+
 
 
 framerargs::framerargs(headersearch_type h, runtime* rte, bool s) :
@@ -6577,17 +6725,26 @@ reframe_args::~reframe_args() {
 
 
 
-multidestparms::multidestparms(runtime* rte, const chunkdestmap_type& cdm) :
-    rteptr( rte ), chunkdestmap( cdm )
+fanout_type::fanout_type():
+    qdepth( 10 ), drop( false )
+{}
+
+multidestparms::multidestparms(runtime* rte, const chunkdestmap_type& cdm, const fanout_type& fo) :
+    rteptr( rte ), chunkdestmap( cdm ), fanout( fo )
 { ASSERT_NZERO(rteptr); netparms = rteptr->netparms; }
-multidestparms::multidestparms(runtime* rte, const chunkdestmap_type& cdm, const netparms_type& np) :
-    rteptr( rte ), netparms( np ), chunkdestmap( cdm )
+multidestparms::multidestparms(runtime* rte, const chunkdestmap_type& cdm, const netparms_type& np,
+                               const fanout_type& fo) :
+    rteptr( rte ), netparms( np ), chunkdestmap( cdm ), fanout( fo )
 { ASSERT_NZERO(rteptr); }
 
 multifdargs::multifdargs(runtime* rte, const netparms_type& np) :
-    rteptr( rte ), netparms( np )
+    rteptr( rte ), netparms( np ), ndropped( 0 )
 { ASSERT_NZERO(rteptr); }
 
+uint64_t multifdargs::get_dropped( void ) {
+    return ndropped;
+}
+
 multifdargs::~multifdargs() {
     fdreaderlist_type::iterator curfd;
 
@@ -6608,13 +6765,23 @@ multifdrdargs* multinetopener(runtime* rte/*, unsigned int n*/) {
     return new multifdrdargs(rte);
 }
 
+multifdrdargs* multinetchunkopener(runtime* rte, chunkmakerargs_type cma) {
+    multifdrdargs*  mfd = new multifdrdargs(rte);
+
+    mfd->chunkmaker = new chunkmakerargs_type(cma);
+    mfd->cpus       = rte->mk6info.stream_cpus;
+    return mfd;
+}
+
 multifdrdargs::multifdrdargs(runtime* rte/*, fdqueue_type const& fdq*/):
     multifdargs(rte, rte->netparms)
     /*, fdqueue( fdq )*/
     , curHPS( 0 )
     , nFinished( 0 )
+    , chunkmaker( 0 )
 {}
 multifdrdargs::~multifdrdargs() {
+    delete chunkmaker;
 #if 0
     // any fdreaderargs* still left in the stack are unaccounted for;
     // the others have been added to our base class' fdreaderlist
@@ -6784,10 +6951,18 @@ multifdargs* multiopener( multidestparms mdp ) {
     const std::string                 proto( mdp.netparms.get_protocol() );
     chunkdestmap_type::const_iterator curchunk;
 
+    rv->fanout = mdp.fanout;
+
     for(curchunk=mdp.chunkdestmap.begin(); curchunk!=mdp.chunkdestmap.end(); curchunk++) {
         // check if we already have this destination
         destfdmap_type::iterator  chunkdestfdptr = destfdmap.find( curchunk->second );
 
+        if( chunkdestfdptr==destfdmap.end() && proto=="unix" ) {
+            // The destination is the path of the socket, which may well
+            // contain '@'s
+            chunkdestfdptr = destfdmap.insert( make_pair(curchunk->second, ::getsok_unix_client(curchunk->second)) ).first;
+            DEBUG(3," multiopener: opened destination " << curchunk->second << " as fd #" << chunkdestfdptr->second << endl);
+        }
         if( chunkdestfdptr==destfdmap.end() ) {
             unsigned short                            port  = mdp.netparms.get_port();
             std::vector<std::string>                  parts = ::split(curchunk->second, '@');
@@ -6833,6 +7008,8 @@ multifdargs* multifileopener( multidestparms mdp ) {
     destfdmap_type                    destfdmap;
     chunkdestmap_type::const_iterator curchunk;
 
+    rv->fanout = mdp.fanout;
+
     for(curchunk=mdp.chunkdestmap.begin(); curchunk!=mdp.chunkdestmap.end(); curchunk++) {
         // check if we already have this destination
         destfdmap_type::iterator  chunkdestfdptr = destfdmap.find( curchunk->second );
@@ -6866,21 +7043,21 @@ void tagger( inq_type<frame>* inq, outq_type<tagged<frame> >* outq, sync_type<un
 }
 
 void header_stripper( inq_type<tagged<frame> >* inq, outq_type<tagged<frame> >* outq, sync_type<headersearch_type>* args) {
-    const headersearch_type& hdr = *args->userdata;
+    const headersearch_type&    hdr = *args->userdata;
+    std::vector<tagged<frame> > batch;
     
-    while( true ) {
-        tagged<frame>  tf;
-        if( inq->pop(tf)==false )
-            break;
-        frame&  iframe( tf.item );
-
-        ASSERT2_COND( iframe.frametype==hdr.frameformat && iframe.framedata.iov_len==hdr.framesize,
-                      SCINFO("expected " << hdr << " got " << iframe.frametype << 
-                             "/" << iframe.ntrack << " tracks" ));
-        iframe.framedata = iframe.framedata.sub(hdr.payloadoffset, hdr.payloadsize);
-        // pass on only the payload
-        //tagged<frame> tfout(tf.tag, frame(iframe.frametype, iframe));
-        if( outq->push(tf)==false )
+    // Take whatever frames are available, up to the downstream queue depth
+    while( inq->pop_n(batch, std::max(args->qdepth, 1u)) ) {
+        for(std::vector<tagged<frame> >::iterator tf=batch.begin(); tf!=batch.end(); tf++) {
+            frame&  iframe( tf->item );
+
+            ASSERT2_COND( iframe.frametype==hdr.frameformat && iframe.framedata.iov_len==hdr.framesize,
+                          SCINFO("expected " << hdr << " got " << iframe.frametype << 
+                                 "/" << iframe.ntrack << " tracks" ));
+            // pass on only the payload
+            iframe.framedata = iframe.framedata.sub(hdr.payloadoffset, hdr.payloadsize);
+        }
+        if( outq->push_n(batch)==false )
             break;
     }
 }
@@ -7042,18 +7219,38 @@ void coalescing_splitter( inq_type<tagged<frame> >* inq, outq_type<tagged<frame>
 }
 
 
+// Everything reframe_to_vdif needs to know about an input tag, set up
+// the first time the tag is seen. Cannot be a local type, see tagstate_type
+struct reframe_tag_type {
+    bool                    known;         // entry has been filled in
+    bool                    discard;       // not in the tagremapper
+    unsigned int            ntrack;        // hdr.log2nchans is for this many tracks
+    unsigned int            datathreadid;
+    non_legacy_vdif_header  hdr;
+
+    reframe_tag_type():
+        known( false ), discard( false ), ntrack( 0 ), datathreadid( 0 )
+    {}
+};
+
 // Reframe to vdif - output the new frame as a blocklist:
 // first the new header (VDIF) and then the datablock
 // Assume all the samples in all channels have the same time stamp
 // (would be nonsense if this wouldn't hold, but still, it IS an
 //  assumption)
 void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblocklist_type> >* outq, sync_type<reframe_args>* args) {
-    typedef std::map<unsigned int, non_legacy_vdif_header>  tagheadermap_type;
+    typedef std::vector<reframe_tag_type>               densetag_type;
+    typedef std::map<unsigned int, reframe_tag_type>    sparsetag_type;
+    // Tags (as output by the splitters) are small numbers; they index
+    // straight into a table. Just in case, larger ones go into a map.
+    const unsigned int      maxdensetag = 4096;
     bool                    stop              = false;
     uint64_t                done              = 0;
     reframe_args*           reframe = args->userdata;
     tagged<frame>           tf;
-    tagheadermap_type       tagheader;
+    densetag_type           densetag;
+    sparsetag_type          sparsetag;
+    std::vector<tagged<miniblocklist_type> >  batch;
     const bool              cmplx_flag  = reframe->complex_vdif;
     const unsigned int      bits_p_chan = reframe->bits_per_channel;
     const samplerate_type   bitrate     = reframe->bitrate;
@@ -7061,15 +7258,22 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
     const unsigned int      output_size = reframe->output_size;
     const tagremapper_type& tagremapper = reframe->tagremapper;
     const bool              doremap     = (tagremapper.size()>0);
-    const tagremapper_type::const_iterator  endptr = tagremapper.end();
-    tagheadermap_type::iterator             hdrptr;
+    const unsigned int      hdrsize     = (unsigned int)sizeof(non_legacy_vdif_header);
+    // Each input frame yields this many VDIF frames. Their headers are
+    // taken from one block
+    const unsigned int      nout        = (output_size ? input_size/output_size : 0);
+    // The VDIF frame length depends on the number of tracks in the input
+    // frame; only recompute it (and the clock) when that changes
+    unsigned int            clock_ntrack = 0;
+    subsecond_type          vdif_framelen;
+    frameclock_type         vdifclock;
 
     EZASSERT2(bits_p_chan>0, reframeexception,
               EZINFO("The number of bits per channel cannot be 0"));
 
     // The blockpool only has to deliver the VDIF headers
     SYNCEXEC(args,
-             reframe->pool = new blockpool_type(sizeof(non_legacy_vdif_header), 16));
+             reframe->pool = new blockpool_type(std::max(nout, 1u)*hdrsize, 16));
     blockpool_type* pool = reframe->pool;
 
     DEBUG(-1, "reframe_to_vdif: VDIF output_size = " << output_size << " input_size = " << input_size << endl <<
@@ -7102,21 +7306,14 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
     // By having waited for the first frame for setting up our timing,
     // our fast inner loop can be way cleanur!
     do {
-        const block                      data( tf.item.framedata );
-        unsigned int                     datathreadid;
-        const unsigned int               last = data.iov_len;
-        const highrestime_type           time = tf.item.frametime;
-        tagremapper_type::const_iterator tagptr = tagremapper.find(tf.tag);
+        const block             data( tf.item.framedata );
+        const unsigned int      last = data.iov_len;
+        const highrestime_type  time = tf.item.frametime;
 
         if( last!=input_size ) {
             DEBUG(-1, "reframe_to_vdif: got inputsize " << last << ", expected " << input_size << endl);
             continue;
         }
-        // Deal with tag -> datathreadid mapping
-        if( doremap && tagptr==endptr ) {
-            // no entry for the current tag - discard data
-            continue;
-        }
         // In order to correctly do time calculations we cannot accept
         // frames with no tracks ...
         if( tf.item.ntrack==0 ) {
@@ -7124,78 +7321,98 @@ void reframe_to_vdif(inq_type<tagged<frame> >* inq, outq_type<tagged<miniblockli
             continue;
         }
 
-        datathreadid = (doremap?tagptr->second:tf.tag);
+        if( tf.tag<maxdensetag && tf.tag>=densetag.size() )
+            densetag.resize( tf.tag+1 );
+        reframe_tag_type&  tagentry( tf.tag<maxdensetag ? densetag[tf.tag] : sparsetag[tf.tag] );
 
-        if( (hdrptr=tagheader.find(datathreadid))==tagheader.end() ) {
-            pair<tagheadermap_type::iterator,bool> insres = tagheader.insert( make_pair(datathreadid,non_legacy_vdif_header()) );
-            EZASSERT2( insres.second, reframeexception,
-                       EZINFO("Failed to insert new VDIF header for datathread #" << datathreadid
-                              << " (tag:" << tf.tag << ")"));
-            hdrptr = insres.first;
+        if( !tagentry.known ) {
+            // haven't seen this tag before. Deal with tag -> datathreadid
+            // mapping and initialize the VDIF header
+            tagremapper_type::const_iterator tagptr = tagremapper.find(tf.tag);
+            non_legacy_vdif_header&          hdr( tagentry.hdr );
 
-            // haven't seen this datathreadid before, must initialize VDIF
-            // header
-            non_legacy_vdif_header&  hdr( hdrptr->second /*tagheader[t]*/ );
+            tagentry.known        = true;
+            // no entry for the current tag - discard data
+            tagentry.discard      = (doremap && tagptr==tagremapper.end());
+            tagentry.datathreadid = (doremap && !tagentry.discard ? tagptr->second : tf.tag);
 
             hdr.station_id      = reframe->station_id;
-            hdr.thread_id       = (short unsigned int)(hdrptr->first & 0x3ff);
+            hdr.thread_id       = (short unsigned int)(tagentry.datathreadid & 0x3ff);
             hdr.data_frame_len8 = (unsigned int)(((output_size+sizeof(non_legacy_vdif_header))/8) & 0x00ffffff);
             hdr.bits_per_sample = (unsigned char)((reframe->bits_per_sample - 1) & 0x1f);
             hdr.ref_epoch       = (unsigned char)(epoch & 0x3f);
             hdr.complex         = cmplx_flag;
         }
+        if( tagentry.discard )
+            continue;
 
         // break up the frame into smaller bits?
-        non_legacy_vdif_header&    hdr = hdrptr->second;
-
-        // dataframes cannot span second boundaries so this can be done
-        // easily outside the breaking-up loop
-        // HV: 12 sep 2014 - Actually, in case a source data frame gets
-        //                   lost, sometimes the end of a cornerturned
-        //                   data frame may extend into the next UT second,
-        //                   but we take care of that in the 
-        //                   breaking-up-into-vdif-frames-loop below
-        hdr.epoch_seconds   = (unsigned int)((time.tv_sec - tm_epoch) & 0x3fffffff);
-        hdr.log2nchans      = ((unsigned int)(::log2f((float)tf.item.ntrack/bits_p_chan)) & 0x1f);
+        non_legacy_vdif_header&    hdr = tagentry.hdr;
 
+        if( tf.item.ntrack!=tagentry.ntrack ) {
+            hdr.log2nchans  = ((unsigned int)(::log2f((float)tf.item.ntrack/bits_p_chan)) & 0x1f);
+            tagentry.ntrack = tf.item.ntrack;
+        }
 
         // vdif frame rate:
         // Update: 27 Oct 2015 with high resolution time stamps and frame rates that
         //         are rationals, frame number computation becomes:
         //         (t_frame - t_0) / frame_len 
         //         This would support "x samples per y second" where y != 1
-        const subsecond_type vdif_framelen   = 8*output_size / (tf.item.ntrack * bitrate);
-        const subsecond_type vdif_framerate  = 1/vdif_framelen;
-        const subsecond_type first_fn        = time.tv_subsecond / vdif_framelen;
-
-        EZASSERT2(first_fn.denominator()==1, reframeexception,
-             EZINFO("data time stamp " << time << " not representable as frame number using frame length " << vdif_framelen));
-
-        for(uint64_t dfn=first_fn.numerator(), pos=0;
-                !stop && (pos+output_size)<=last;
-                dfn++, pos+=output_size) {
-            block          vdifh( pool->get() );
-
-            // Fix up the integer second in case this particular frame
-            // extends into the next UT second
-            // Update 09 Nov 2015 - it may extend into the next *period* which may not
-            //                      necessarily be 1 second
-            if( dfn>=vdif_framerate.numerator() ) {
-                ((struct vdif_header*)vdifh.iov_base)->epoch_seconds+=(time_t)vdif_framerate.denominator();
-                dfn -= vdif_framerate.numerator();
-            }
+        // The usual case is an integer number of VDIF frames per second;
+        // then the frame clock does this in integer arithmetic.
+        if( tf.item.ntrack!=clock_ntrack ) {
+            vdif_framelen = 8*output_size / (tf.item.ntrack * bitrate);
+            vdifclock     = frameclock_type::from_framelength( vdif_framelen );
+            clock_ntrack  = tf.item.ntrack;
+        }
+
+        // After 'rollover' frames the time stamp moves on by 'period' seconds
+        frametime_type  vdiftime;
+        uint64_t        rollover = vdifclock.fps;
+        time_t          period   = 1;
+
+        if( vdifclock.valid() ) {
+            EZASSERT2(vdifclock.to_frametime(time, vdiftime), reframeexception,
+                 EZINFO("data time stamp " << time << " not representable as frame number using frame length " << vdif_framelen));
+        } else {
+            const subsecond_type vdif_framerate  = 1/vdif_framelen;
+            const subsecond_type first_fn        = time.tv_subsecond / vdif_framelen;
+
+            EZASSERT2(first_fn.denominator()==1, reframeexception,
+                 EZINFO("data time stamp " << time << " not representable as frame number using frame length " << vdif_framelen));
+            vdiftime = frametime_type(time.tv_sec, first_fn.numerator());
+            rollover = vdif_framerate.numerator();
+            period   = (time_t)vdif_framerate.denominator();
+        }
+
+        // All the headers for this input frame go in one block, the VDIF
+        // frames are pushed downstream in one go
+        const block                    arena( pool->get() );
+        non_legacy_vdif_header* const  vdifhdr0 = (non_legacy_vdif_header*)arena.iov_base;
+
+        batch.clear();
+        for(unsigned int i=0, pos=0; i<nout; i++, pos+=output_size) {
+            non_legacy_vdif_header*  vdifhdr = vdifhdr0 + i;
 
             // copy vdif header 
-            ::memcpy(vdifh.iov_base, &hdr, sizeof(non_legacy_vdif_header));
+            ::memcpy(vdifhdr, &hdr, sizeof(non_legacy_vdif_header));
 
-            // Truncate data frame number to framerate (not truncate, but modulo, of course)
-            // In case the frame number goes >= to frame rate, this part of the frame extends
-            // into the next UT second
-            ((struct non_legacy_vdif_header*)vdifh.iov_base)->data_frame_num = (unsigned int)(dfn & 0x00ffffff);
+            // In case a source data frame got lost, the end of a
+            // cornerturned data frame may extend into the next UT second
+            // (or period) so the time goes into every VDIF frame
+            vdifhdr->epoch_seconds  = (unsigned int)((vdiftime.tv_sec - tm_epoch) & 0x3fffffff);
+            vdifhdr->data_frame_num = (unsigned int)(vdiftime.frameno & 0x00ffffff);
 
-            stop = (outq->push(tagged<miniblocklist_type>(hdrptr->first/*tf.tag*/,
-                               miniblocklist_type(vdifh, data.sub(pos, output_size))))==false);
+            batch.push_back( tagged<miniblocklist_type>(tagentry.datathreadid,
+                             miniblocklist_type(arena.sub(i*hdrsize, hdrsize), data.sub(pos, output_size))) );
+
+            if( ++vdiftime.frameno>=rollover ) {
+                vdiftime.tv_sec  += period;
+                vdiftime.frameno -= rollover;
+            }
         }
+        stop = (outq->push_n(batch)==false);
         done++;
     } while( !stop && inq->pop(tf) );
     DEBUG(1, "reframe_to_vdif: done " << done << " frames " << endl);
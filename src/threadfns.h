@@ -22,6 +22,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <runtime.h>
 #include <chain.h>
 #include <block.h>
@@ -108,6 +109,44 @@ struct tagged {
     {}
 };
 
+// All dataframes found in one block of data. Copying a frame (or
+// tagged<frame>) copies a block, i.e. an atomic reference count update,
+// and that happens at least twice per frame per queue. A framebatch holds
+// one reference to the block the frames are in and, per frame, where it
+// is, its time stamp and tag.
+// Steps that only look at or drop frames can work on the entries; the
+// get_frame()/get_tagged() adapters make a frame out of an entry for
+// those that need one.
+struct framebatch {
+    struct entry_type {
+        unsigned int      offset;
+        unsigned int      tag;
+        highrestime_type  frametime;
+
+        entry_type();
+        entry_type(unsigned int o, unsigned int t, const highrestime_type& ft);
+    };
+    typedef std::vector<entry_type>  entries_type;
+
+    format_type   frametype;
+    unsigned int  ntrack;
+    unsigned int  framesize;
+    block         data;
+    entries_type  entries;
+
+    framebatch();
+    framebatch(format_type tp, unsigned int n, unsigned int fs, const block& d);
+
+    inline size_t size( void ) const {
+        return entries.size();
+    }
+    // An empty copy: same block, no frames
+    framebatch empty_copy( void ) const;
+
+    frame          get_frame(size_t i) const;
+    tagged<frame>  get_tagged(size_t i) const;
+};
+
 // generic tagged item
 template <typename Tag, typename Item>
 struct taggeditem {
@@ -156,6 +195,9 @@ void timedecoder(inq_type<frame>*, outq_type<frame>*, sync_type<headersearch_typ
 // inputs full dataframes and outputs only the binary frame
 //    you lose knowledge of the actual type of frame
 void frame2block(inq_type<frame>*, outq_type<block>*);
+// Id. for batches of frames. Frames that follow each other in memory are
+// passed on as one block
+void framebatch2block(inq_type<framebatch>*, outq_type<block>*);
 
 // these two do "blind" compression and decompression
 void blockcompressor(inq_type<block>*, outq_type<block>*, sync_type<runtime*>*);
@@ -192,7 +234,11 @@ void timegrabber(inq_type<frame>*, sync_type<timegrabber_type>*);
 
 // Modify the time stamp of a frame by adding the specified
 // time offset
-void timemanipulator(inq_type<tagged<frame> >*, outq_type<tagged<frame> >*, sync_type<timemanipulator_type>*);
+void timemanipulator(inq_type<framebatch>*, outq_type<framebatch>*, sync_type<timemanipulator_type>*);
+
+// Only let VDIF frames pass that match the runtime's VDIF filter
+// ("vdif_filter="); the filter's statistics are kept in the runtime.
+void vdiffilter(inq_type<framebatch>*, outq_type<framebatch>*, sync_type<runtime*>*);
 
 // Filters frames per tag: wait for a frame with a time stamp which is an
 // integer multiple of the output frame duration and then let pass
@@ -205,7 +251,9 @@ void framefilter(inq_type<tagged<frame> >*, outq_type<tagged<frame> >*, sync_typ
 // we add a 5-step deep median filter. Frames with their integer time stamps
 // that are more than one second off with respect to the median of 5 are
 // filtered out.
-void medianfilter(inq_type<tagged<frame> >*, outq_type<tagged<frame> >*);
+// It takes the batches of frames from the framer and passes on individual
+// tagged frames.
+void medianfilter(inq_type<framebatch>*, outq_type<tagged<frame> >*);
 
 // information for the framer - it must know which
 // kind of frames to look for ... 
@@ -553,15 +601,31 @@ typedef std::map<unsigned int, int> dest_fd_map_type;
 // tag -> destination (string) mapping 
 typedef std::map<unsigned int, std::string> chunkdestmap_type;
 
+// How the multiwriter hands the data to the per-destination writers.
+// Each destination has its own queue of 'qdepth' entries. By default a full
+// queue holds up the multiwriter, and thus all destinations. With 'drop'
+// set, data for a destination that cannot keep up is dropped (and counted)
+// and a destination that went away is forgotten, such that the other
+// destinations keep on being served.
+struct fanout_type {
+    unsigned int  qdepth;
+    bool          drop;
+
+    fanout_type();
+};
+
 struct multidestparms {
     runtime*          rteptr;
     netparms_type     netparms;
     chunkdestmap_type chunkdestmap;
+    fanout_type       fanout;
 
     // copy network parms out of rte
-    multidestparms(runtime* rte, const chunkdestmap_type& cdm);
+    multidestparms(runtime* rte, const chunkdestmap_type& cdm,
+                   const fanout_type& fo = fanout_type());
     // use the passed networkargs i.s.o. those from rte
-    multidestparms(runtime* rte, const chunkdestmap_type& cdm, const netparms_type& np);
+    multidestparms(runtime* rte, const chunkdestmap_type& cdm, const netparms_type& np,
+                   const fanout_type& fo = fanout_type());
 };
 
 // Reserve room for all the fdreaderargs in multifdargs.
@@ -582,18 +646,28 @@ struct multifdargs {
     // can easily re-use the ::close_filedescriptor()
     // function
     fdreaderlist_type fdreaders;
+    fanout_type       fanout;
+    // number of entries dropped because of fanout.drop
+    uint64_t          ndropped;
 
     multifdargs( runtime* rte, const netparms_type& np );
+
+    uint64_t get_dropped( void );
     virtual ~multifdargs();
 };
 
 // When doing multiple fd readers we have a stack of fdreaderargs*
 // and each reader pops one off and adds to base class' fdreaders list
 typedef std::queue<fdreaderargs*> fdqueue_type;
+struct chunkmakerargs_type;
 struct multifdrdargs: public multifdargs {
     //fdqueue_type   fdqueue;
     hpslist_type::size_type      curHPS;
     fdreaderlist_type::size_type nFinished;
+    // Only for per stream pipelines (see multifdchunker): what the reader
+    // threads need to make chunks and the CPUs to run the streams on
+    chunkmakerargs_type*         chunkmaker;
+    std::vector<unsigned int>    cpus;
 
     multifdrdargs(runtime* rte/*, fdqueue_type const& fdq*/);
     virtual ~multifdrdargs();
@@ -643,6 +717,8 @@ multifdargs*   multiopener( multidestparms mdp );
 multifdargs*   multifileopener( multidestparms mdp );
 // Opens n identical sockets based on rte->netparms
 multifdrdargs* multinetopener( runtime* rte/*, unsigned int n*/);
+// id. for per stream pipelines
+multifdrdargs* multinetchunkopener( runtime* rte, chunkmakerargs_type cma );
 void           multicloser( multifdargs* );
 void           multirdcloser( multifdrdargs* );
 
@@ -24,10 +24,10 @@
 //          filemetadata
 ///////////////////////////////////////////////////////////////////
 filemetadata::filemetadata():
-    fileSize( (off_t)0 )
+    fileSize( (off_t)0 ), stream( 0 ), nStream( 0 )
 {}
 
 filemetadata::filemetadata(const std::string& fn, off_t sz, uint32_t csn):
-    fileSize( sz ), chunkSequenceNr( csn ), fileName( fn )
+    fileSize( sz ), chunkSequenceNr( csn ), fileName( fn ), stream( 0 ), nStream( 0 )
 {}
 
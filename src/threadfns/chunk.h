@@ -33,6 +33,11 @@ struct filemetadata {
     off_t        fileSize;
     uint32_t     chunkSequenceNr;
     std::string  fileName;
+    // Per stream pipelines: the chunk belongs to stream 'stream' out of
+    // 'nStream' and is written to that stream's mountpoints only.
+    // nStream==0 means any mountpoint will do
+    unsigned int stream;
+    unsigned int nStream;
 
     filemetadata();
     filemetadata(const std::string& fn, off_t sz, uint32_t csn);
@@ -19,13 +19,31 @@
 //          7990 AA Dwingeloo
 //
 #include <threadfns/chunkmakers.h>
+#include <threadfns/multisend.h>  // for mkpath()
+#include <mk6info.h>
+#include <evlbidebug.h>
+#include <threadutil.h>
+
+#include <set>
+
+#include <errno.h>
+#include <string.h>
 
 chunkmakerargs_type::chunkmakerargs_type(runtime* rte, std::string const& rec):
-    rteptr( rte ), recording_name( rec )
+    rteptr( rte ), recording_name( rec ), stream( 0 ), nStream( 0 )
+{
+    EZASSERT2( rteptr && !recording_name.empty(), std::runtime_error,
+               EZINFO("Do not pass NULL runtime pointer (" << (void*)rte << ") " <<
+                      "or empty recording name ('" << recording_name << "') ") );
+}
+
+chunkmakerargs_type::chunkmakerargs_type(runtime* rte, std::string const& rec, headersearch_type const& fmt):
+    rteptr( rte ), recording_name( rec ), frameformat( new headersearch_type(fmt) ), stream( 0 ), nStream( 0 )
 {
     EZASSERT2( rteptr && !recording_name.empty(), std::runtime_error,
                EZINFO("Do not pass NULL runtime pointer (" << (void*)rte << ") " <<
                       "or empty recording name ('" << recording_name << "') ") );
+    EZASSERT2( fmt.valid(), std::runtime_error, EZINFO("Cannot align chunks to frames of unknown format") );
 }
 
 bsn_entry::bsn_entry(std::string const& basename, uint32_t n):
@@ -67,3 +85,139 @@ NetPortSuffix::NetPortSuffix( chunkmakerargs_type const& cma ):
 std::string NetPortSuffix::operator()( unsigned int t) const {
     return "_ds"+__m_netparms.stream2suffix( t );
 }
+
+
+////////////////////////////////////////////////
+/// Cutting chunks at frame boundaries
+////////////////////////////////////////////////
+
+chunkaligner_type::stream_type::stream_type():
+    nskip( 0 ), idxfile( 0 ), noindex( false )
+{}
+
+chunkaligner_type::chunkaligner_type(chunkmakerargs_type const& cma):
+    format( *cma.frameformat ),
+    mountpoint( cma.rteptr->mk6info.mountpoints.empty() ? std::string() : *cma.rteptr->mk6info.mountpoints.begin() ),
+    maxsize( cma.rteptr->netparms.get_blocksize() + format.framesize ),
+    pool( 0 )
+{
+    // Blocks that need completing from the previous block's left overs
+    // are assembled in here
+    pool = new blockpool_type(maxsize, 16);
+    DEBUG(2, "chunkaligner: cutting chunks at " << format.frameformat << " frame boundaries (" <<
+             format.framesize << " bytes), index on " << (mountpoint.empty() ? "<none>" : mountpoint) << std::endl);
+}
+
+chunkaligner_type::~chunkaligner_type() {
+    for(stream_map::iterator s=streams.begin(); s!=streams.end(); s++) {
+        if( s->second.idxfile )
+            ::fclose( s->second.idxfile );
+        if( s->second.nskip || s->second.carry.iov_len )
+            DEBUG(-1, "chunkaligner: stream #" << s->first << " skipped " << s->second.nskip << " bytes not in a frame, " <<
+                      s->second.carry.iov_len << " bytes of incomplete last frame" << std::endl);
+    }
+    delete pool;
+}
+
+unsigned int chunkaligner_type::find_frame(unsigned char const* p, unsigned int n) const {
+    const headersearch::strict_type  chk( headersearch::chk_default );
+
+    for(unsigned int o=0; o+format.headersize<=n; o++) {
+        if( format.syncwordsize ) {
+            if( ::memcmp(p+o+format.syncwordoffset, format.syncword, format.syncwordsize)==0 &&
+                format.check(p+o, chk, 5) )
+                return o;
+        } else if( is_vdif(format.frameformat) ) {
+            // No syncword but at least the frame size must be right
+            vdif_header const*  vh = (vdif_header const*)(p+o);
+
+            if( vh->data_frame_len8*8==format.framesize )
+                return o;
+        } else {
+            return o;
+        }
+    }
+    // The last few bytes could still be the start of a frame
+    return (n<format.headersize ? 0 : n - format.headersize + 1);
+}
+
+block chunkaligner_type::align(unsigned int tag, block const& b) {
+    stream_type&  stream( streams[tag] );
+    block         data( b );
+
+    // Complete the partial frame left over from the previous block
+    if( stream.carry.iov_len ) {
+        const size_t  n = stream.carry.iov_len + b.iov_len;
+
+        data = (n<=maxsize ? pool->get() : block(n));
+        ::memcpy(data.iov_base, stream.carry.iov_base, stream.carry.iov_len);
+        ::memcpy((unsigned char*)data.iov_base + stream.carry.iov_len, b.iov_base, b.iov_len);
+        data         = data.sub(0, n);
+        stream.carry = block();
+    }
+
+    // Normally the data starts with a frame; if it doesn't (start of
+    // a TCP stream, data loss) skip to the first one
+    const unsigned int  off    = find_frame((unsigned char const*)data.iov_base, (unsigned int)data.iov_len);
+    const size_t        nframe = (data.iov_len - off) / format.framesize;
+    const size_t        used   = off + nframe * format.framesize;
+
+    stream.nskip += off;
+    if( used<data.iov_len )
+        stream.carry = data.sub(used, data.iov_len - used);
+    if( nframe==0 )
+        return block();
+    // Only create a new block if we have to
+    return (off==0 && used==data.iov_len) ? data : data.sub(off, nframe * format.framesize);
+}
+
+void chunkaligner_type::index(unsigned int tag, filemetadata const& fmd, block const& b) {
+    stream_type&  stream( streams[tag] );
+
+    if( stream.idxfile==0 ) {
+        if( stream.noindex || mountpoint.empty() || mountpoint==noMountpoint )
+            return;
+
+        // VBS chunk names are "<name>/<name>.XXXXXXXX", Mark6 just "<name>"
+        const std::string::size_type  dot = fmd.fileName.rfind('.');
+        const std::string             base( (fmd.fileName.find('/')!=std::string::npos && dot!=std::string::npos) ?
+                                            fmd.fileName.substr(0, dot) : fmd.fileName );
+        const std::string             fn( mountpoint + "/" + base + ".index" );
+
+        if( ::mkpath(fn.c_str(), 0755)!=0 || (stream.idxfile=::fopen(fn.c_str(), "w"))==0 ) {
+            DEBUG(-1, "chunkaligner: failed to create index " << fn << " - " << evlbi5a::strerror(errno) << std::endl);
+            stream.noindex = true;
+            return;
+        }
+        mk6info_type::fchown_fn(::fileno(stream.idxfile), mk6info_type::real_user_id, -1);
+        ::fprintf(stream.idxfile, "# chunk name size nframe first_frame_time threads\n");
+        DEBUG(3, "chunkaligner: indexing chunks in " << fn << std::endl);
+    }
+
+    unsigned char const* const  p = (unsigned char const*)b.iov_base;
+    std::ostringstream          line;
+
+    line << fmd.chunkSequenceNr << " " << fmd.fileName << " " << b.iov_len << " " << (b.iov_len / format.framesize) << " ";
+    try {
+        line << tm2vex( format.decode_timestamp(p, headersearch::strict_type(headersearch::chk_nodebug)) );
+    }
+    catch( std::exception const& ) {
+        line << "-";
+    }
+
+    // VDIF: which threads are in this chunk
+    line << " ";
+    if( is_vdif(format.frameformat) ) {
+        std::set<unsigned int>  threads;
+
+        for(size_t o=0; o<b.iov_len; o+=format.framesize)
+            threads.insert( ((vdif_header const*)(p + o))->thread_id );
+        for(std::set<unsigned int>::const_iterator t=threads.begin(); t!=threads.end(); t++)
+            line << (t==threads.begin() ? "" : ",") << *t;
+    } else {
+        line << "-";
+    }
+    line << "\n";
+    ::fputs(line.str().c_str(), stream.idxfile);
+    ::fflush(stream.idxfile);
+}
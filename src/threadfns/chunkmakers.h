@@ -27,7 +27,10 @@
 
 #include <chain.h>
 #include <block.h>
+#include <blockpool.h>
 #include <threadfns.h>
+#include <headersearch.h>
+#include <countedpointer.h>
 #include <threadfns/chunk.h>
 //#include <threadfns/per_sender.h>
 //#include <threadfns/do_push_block.h>
@@ -39,6 +42,8 @@
 #include <sstream>
 //#include <iostream>
 
+#include <stdio.h>
+
 
 //////////////////////////////////////////////////////////
 /// transparently support tagged/untagged blocks
@@ -66,6 +71,14 @@ inline unsigned int get_tag(tagged<block> const& b) {
     return b.tag;
 }
 
+// replace the contents, keeping the tag
+inline block with_block(block const&, block const& nb) {
+    return nb;
+}
+inline tagged<block> with_block(tagged<block> const& b, block const& nb) {
+    return tagged<block>(b.tag, nb);
+}
+
 ///////////////////////////////////////////////////////////////////
 //          chunkmakerargs_type
 ///////////////////////////////////////////////////////////////////
@@ -73,9 +86,17 @@ struct chunkmakerargs_type {
 
     runtime*    rteptr;
     std::string recording_name;
+    // If set, chunks are cut at frame boundaries of this format
+    countedpointer<headersearch_type> frameformat;
+    // Per stream pipelines: the chunks made are for stream 'stream' out of
+    // 'nStream' (see filemetadata). Default 0, 0
+    unsigned int                      stream;
+    unsigned int                      nStream;
 
     // asserts that rte != null && rec != empty 
     chunkmakerargs_type(runtime* rte, std::string const& rec);
+    // id. + asserts that fmt is valid
+    chunkmakerargs_type(runtime* rte, std::string const& rec, headersearch_type const& fmt);
 
     private:
 #if __cplusplus >= 201103L
@@ -280,13 +301,79 @@ struct MK6Namer {
 };
 
 
+///////////////////////////////////////////////////////////////////
+//          chunkaligner_type
+///////////////////////////////////////////////////////////////////
+// Cuts each stream at frame boundaries such that chunks start with a frame
+// and contain an integral number of frames. Bytes before the first frame
+// are skipped; a partial frame at the end of a block is carried over to
+// the next chunk of the same stream - only then is data copied.
+// For each stream an index is written on the first mountpoint, one line
+// per chunk, such that readers can access chunks by time or process them
+// independently:
+//      <chunk#> <chunk name> <size> <#frames> <first frame time> <VDIF threads>
+// For VBS the index is "<recording>[_dsSUFFIX]/<recording>[_dsSUFFIX].index",
+// for Mark6 "<recording>[_dsSUFFIX].index"
+struct chunkaligner_type {
+    chunkaligner_type(chunkmakerargs_type const& cma);
+    ~chunkaligner_type();
+
+    // Returns the frame aligned part of 'b' - may be empty
+    block align(unsigned int tag, block const& b);
+
+    // Enter chunk 'fmd', holding 'b' as returned by align(), in the index
+    void  index(unsigned int tag, filemetadata const& fmd, block const& b);
+
+    private:
+        struct stream_type {
+            block     carry;
+            uint64_t  nskip;
+            FILE*     idxfile;
+            bool      noindex;  // failed to create it
+
+            stream_type();
+        };
+        typedef std::map<unsigned int, stream_type>  stream_map;
+
+        const headersearch_type  format;
+        const std::string        mountpoint;
+        const unsigned int       maxsize;
+        blockpool_type*          pool;
+        stream_map               streams;
+
+        // Offset of the first frame in [p, p+n). If none found, the offset
+        // of the first byte that could still start a frame whose header
+        // is cut off by the end: n - headersize + 1, or 0 if n < headersize
+        unsigned int find_frame(unsigned char const* p, unsigned int n) const;
+
+        chunkaligner_type();
+        chunkaligner_type(chunkaligner_type const&);
+        chunkaligner_type const& operator=(chunkaligner_type const&);
+};
+
+
 template <typename Item, template<typename> class Namer, typename SuffixSource>
 void chunkmakert(inq_type<Item>* inq, outq_type<chunk_type>* outq, sync_type<chunkmakerargs_type>* args) {
-    Item                b;
-    Namer<SuffixSource> n( *(args->userdata) );
+    Item                              b;
+    Namer<SuffixSource>               n( *(args->userdata) );
+    countedpointer<chunkaligner_type> aligner;
+
+    if( args->userdata->frameformat )
+        aligner = new chunkaligner_type( *(args->userdata) );
 
     while( inq->pop(b) ) {
-        if( outq->push(chunk_type(n(b), strip_tag(b)))==false )
+        if( aligner ) {
+            b = with_block(b, aligner->align(get_tag(b), strip_tag(b)));
+            if( block_size(b)==0 )
+                continue;
+        }
+        filemetadata  fmd( n(b) );
+
+        fmd.stream  = args->userdata->stream;
+        fmd.nStream = args->userdata->nStream;
+        if( aligner )
+            aligner->index(get_tag(b), fmd, strip_tag(b));
+        if( outq->push(chunk_type(fmd, strip_tag(b)))==false )
             break;
         // release block immediately
         b = Item();
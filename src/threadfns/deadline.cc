@@ -0,0 +1,56 @@
+// implementation of the non-template parts of the latency budget step
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+//
+#include <threadfns/deadline.h>
+
+#include <string.h>
+
+
+deadlineargs::deadlineargs(runtime* rte):
+    rteptr( rte ), budget_ms( 0 ), fill( false ), frametime( false ), maxPendingBytes( 0 )
+{
+    EZASSERT2( rteptr, std::runtime_error, EZINFO("Do not pass NULL runtime pointer") );
+    budget_ms = rteptr->netparms.latency_budget_ms;
+    fill      = rteptr->netparms.latency_fill;
+    frametime = rteptr->netparms.latency_frametime;
+    maxPendingBytes = (uint64_t)rteptr->netparms.get_blocksize() * rteptr->netparms.nblock;
+}
+
+block deadlineargs::fill_block(size_t sz) {
+    // The same fill pattern the udps reader puts in place of lost packets
+    if( fillpattern.iov_len<sz ) {
+        const uint64_t  fillpat = ((uint64_t)0x11223344 << 32) + 0x11223344;
+        uint64_t*       wptr;
+
+        fillpattern = block( sz );
+        wptr        = (uint64_t*)fillpattern.iov_base;
+        for(size_t i=0; i<sz/sizeof(fillpat); i++)
+            wptr[i] = fillpat;
+        ::memcpy(wptr + sz/sizeof(fillpat), &fillpat, sz % sizeof(fillpat));
+    }
+    return fillpattern.sub(0, (unsigned int)sz);
+}
+
+double deadline_now( void ) {
+    struct timespec  now;
+
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec + now.tv_nsec/1.0e9;
+}
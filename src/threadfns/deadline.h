@@ -0,0 +1,246 @@
+// latency budget step: hand data on within a deadline or not at all
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+//
+#ifndef JIVE5A_THREADFNS_DEADLINE_H
+#define JIVE5A_THREADFNS_DEADLINE_H
+
+#include <chain.h>
+#include <block.h>
+#include <runtime.h>
+#include <threadfns.h>
+#include <evlbidebug.h>
+
+#include <deque>
+#include <iostream>
+
+#include <time.h>
+
+
+// In real-time transfers a step that cannot keep up makes the queues fill
+// up until the reader blocks; the data then gets lost in bursts, in the
+// kernel or the NIC, where we have no control over it.
+// Inserted directly after the reader, this step never blocks on its
+// downstream queue. Everything it cannot hand on before its deadline is
+// either replaced by fill pattern (all references to the original data
+// are released, the fill pattern is shared) or discarded. The deadline is
+// <budget> after the item was received or, for frames, optionally
+// <budget> after the frame's time stamp.
+struct deadlineargs {
+    runtime*      rteptr;
+    unsigned int  budget_ms;
+    bool          fill;
+    bool          frametime;
+
+    // Upper limit on the number of items waiting to be handed on
+    static const unsigned int  maxPending = 16384;
+    // Upper limit on the amount of data waiting to be handed on; the
+    // size of one network reader's blockpool (net_protocol's
+    // <blocksize> x <nblock>). Fill pattern is shared so doesn't count.
+    uint64_t      maxPendingBytes;
+
+    // Copies the latency_* settings from rte->netparms
+    deadlineargs(runtime* rte);
+
+    // Returns 'sz' bytes of fill pattern
+    block fill_block(size_t sz);
+
+    private:
+        block   fillpattern;
+
+        deadlineargs();
+};
+
+// wall clock in seconds
+double deadline_now( void );
+
+
+// Transparently support blocks, tagged blocks and frames
+inline block& deadline_payload(block& b) {
+    return b;
+}
+inline block& deadline_payload(tagged<block>& b) {
+    return b.item;
+}
+inline block& deadline_payload(frame& f) {
+    return f.framedata;
+}
+
+// Only frames carry a time stamp; the others are aged by arrival
+inline bool deadline_frametime(block const&, double&) {
+    return false;
+}
+inline bool deadline_frametime(tagged<block> const&, double&) {
+    return false;
+}
+inline bool deadline_frametime(frame const& f, double& t) {
+    t = f.frametime.as_double();
+    return true;
+}
+
+
+template <typename T>
+struct pending_item {
+    double  deadline;
+    T       item;
+
+    pending_item(double d, T const& i):
+        deadline( d ), item( i )
+    {}
+};
+
+
+template <typename T>
+void latency_budget(inq_type<T>* inq, outq_type<T>* outq, sync_type<deadlineargs>* args) {
+    typedef std::deque< pending_item<T> >  pending_type;
+
+    T                   item;
+    bool                running = true;
+    double              t_item;
+    pending_type        pending;
+    // bytes of data (not fill pattern) in pending
+    uint64_t            pending_bytes = 0;
+    // Items are handed on in order of arrival, so the ones that were
+    // turned into fill pattern are always at the front
+    size_t              nfilled = 0;
+    deadlineargs*       dlargs = args->userdata;
+    runtime*            rteptr = dlargs->rteptr;
+    const double        budget = dlargs->budget_ms / 1000.0;
+    latency_stats_type& stats( rteptr->latency_stats );
+
+    RTEEXEC(*rteptr,
+            rteptr->statistics.init(args->stepid, "LatencyBudget");
+            rteptr->latency_stats = latency_stats_type());
+    counter_type&   counter( rteptr->statistics.counter(args->stepid) );
+
+    DEBUG(2, "latency_budget: starting, budget " << dlargs->budget_ms << "ms, late data is " <<
+             (dlargs->fill ? "filled" : "dropped") << ", " << (dlargs->frametime ? "frame time" : "arrival time") <<
+             " based" << std::endl);
+
+    while( running ) {
+        // Hand on as much as downstream will take without blocking
+        while( !pending.empty() ) {
+            const push_result_type  pr = outq->try_push( pending.front().item );
+
+            if( pr==push_overflow )
+                break;
+            if( pr==push_disabled ) {
+                running = false;
+                pending.clear();
+                pending_bytes = 0;
+                break;
+            }
+            counter += deadline_payload(pending.front().item).iov_len;
+            if( nfilled )
+                nfilled--;
+            else
+                pending_bytes -= deadline_payload(pending.front().item).iov_len;
+            pending.pop_front();
+        }
+
+        // Whatever missed its deadline goes out as fill pattern or not at all.
+        // Fill items keep their place until downstream has room again.
+        // Deadlines are assumed to increase in order of arrival.
+        const double                    now = deadline_now();
+        typename pending_type::iterator p   = pending.begin() + nfilled;
+
+        while( p!=pending.end() && p->deadline<=now ) {
+            block&  data( deadline_payload(p->item) );
+
+            stats.late++;
+            stats.bytes_late += data.iov_len;
+            pending_bytes    -= data.iov_len;
+            if( dlargs->fill ) {
+                data = dlargs->fill_block( data.iov_len );
+                stats.filled++;
+                nfilled++;
+                p++;
+            } else {
+                stats.dropped++;
+                p = pending.erase( p );
+            }
+        }
+
+        // Get more data. Only wait for it indefinitely if nothing's
+        // waiting to be handed on
+        pop_result_type  pr;
+
+        if( pending.empty() ) {
+            pr = (inq->pop(item) ? pop_success : pop_disabled);
+        } else {
+            struct timespec  until;
+
+            ::clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 1000000;
+            if( until.tv_nsec>=1000000000 ) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000;
+            }
+            pr = inq->pop(item, until);
+        }
+        if( pr==pop_timeout )
+            continue;
+        if( pr==pop_disabled )
+            break;
+
+        if( !(dlargs->frametime && deadline_frametime(item, t_item)) )
+            t_item = deadline_now();
+
+        // Keep the backlog bounded, in number of items as well as in
+        // bytes of data. Late data was counted already when it was turned
+        // into fill pattern. Dropping fill items does not free any data
+        // so the byte limit makes the oldest real data go.
+        const uint64_t  sz = deadline_payload(item).iov_len;
+
+        if( pending.size()>=deadlineargs::maxPending ) {
+            if( nfilled ) {
+                stats.filled--;
+                nfilled--;
+            } else {
+                stats.late++;
+                stats.bytes_late += deadline_payload(pending.front().item).iov_len;
+                pending_bytes    -= deadline_payload(pending.front().item).iov_len;
+            }
+            stats.dropped++;
+            pending.pop_front();
+        }
+        while( pending.size()>nfilled && pending_bytes+sz>dlargs->maxPendingBytes ) {
+            typename pending_type::iterator  oldest = pending.begin() + nfilled;
+            const uint64_t                   len    = deadline_payload(oldest->item).iov_len;
+
+            stats.late++;
+            stats.bytes_late += len;
+            stats.dropped++;
+            pending_bytes    -= len;
+            pending.erase( oldest );
+        }
+        pending.push_back( pending_item<T>(t_item + budget, item) );
+        pending_bytes += sz;
+    }
+
+    // No more input - no reason to be in a hurry anymore
+    while( !pending.empty() && outq->push(pending.front().item) ) {
+        counter += deadline_payload(pending.front().item).iov_len;
+        pending.pop_front();
+    }
+    DEBUG(2, "latency_budget: done. " << stats.late << " late items (" << stats.bytes_late << " bytes), " <<
+             stats.filled << " filled, " << stats.dropped << " dropped" << std::endl);
+}
+
+#endif
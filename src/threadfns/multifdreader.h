@@ -31,12 +31,14 @@
 //#include <threadfns/per_sender.h>
 //#include <threadfns/do_push_block.h>
 #include <threadfns/netreader.h>
+#include <threadfns/chunkmakers.h>
 
 //#include <list>
 //#include <string>
 //#include <sstream>
 //#include <iostream>
 #include <pthread.h>
+#include <sched.h>
 
 // Can produce tagged or untagged blocks
 template <typename Item>
@@ -87,4 +89,129 @@ void multifdreader(outq_type<Item>* oq, sync_type<multifdrdargs>* args) {
     DEBUG(1, "multifdreader[" << ::pthread_self() << "]: terminating" << std::endl);
 }
 
+
+// Per stream pipelines.
+// As multifdreader but each thread, i.e. each net_port, also makes the
+// chunks of its own stream: the reader hands its blocks to a chunkmaker
+// thread of its own through a private queue, the chunks carry the stream
+// index so the parallelwriter()s write them to this stream's subset of
+// the mountpoints. Nothing is shared between the streams but the output
+// queue, which sees one push per chunk.
+// If CPUs were configured, stream #i runs on cpus[i % cpus.size()].
+// Only for tagged blocks with the suffix from the net_port.
+struct streamchunker_args {
+    bqueue< tagged<block> >*           queue;
+    outq_type<chunk_type>*             outq;
+    sync_type<chunkmakerargs_type>*    sync;
+};
+
+template <template<typename> class Namer>
+void* streamchunker(void* ptr) {
+    streamchunker_args*              sca( (streamchunker_args*)ptr );
+    inq_type< tagged<block> >        inq( sca->queue );
+
+    try {
+        ::chunkmakert<tagged<block>, Namer, NetPortSuffix>(&inq, sca->outq, sca->sync);
+    }
+    catch( std::exception const& e ) {
+        DEBUG(-1, "streamchunker[" << ::pthread_self() << "]: error - " << e.what() << std::endl);
+    }
+    catch( ... ) {
+        DEBUG(-1, "streamchunker[" << ::pthread_self() << "]: caught unknown exception" << std::endl);
+    }
+    // Whatever the reason we stopped, the reader should not wait for us
+    sca->queue->disable();
+    return (void*)0;
+}
+
+template <template<typename> class Namer>
+void multifdchunker(outq_type<chunk_type>* oq, sync_type<multifdrdargs>* args) {
+    DEBUG(1, "multifdchunker[" << ::pthread_self() << "]: starting" << std::endl);
+    bool                    stop;
+    unsigned int            myTag( 0 ), nStream( 0 );
+    fdreaderargs*           myFD( 0 );
+    multifdrdargs*          mfd( args->userdata );
+
+    EZASSERT2(mfd->chunkmaker, std::runtime_error, EZINFO("multifdchunker: no chunkmaker arguments"));
+
+    SYNCEXEC(args, stop = args->cancelled;
+                   if( !stop && mfd->curHPS<mfd->netparms.n_port() ) {
+                        myFD    = net_server(networkargs(mfd->rteptr, mfd->netparms, true));
+                        myTag   = mfd->curHPS++;
+                        nStream = mfd->netparms.n_port();
+                        mfd->netparms.rotate();
+                        mfd->fdreaders.push_back( myFD );
+                    });
+    if( stop || myFD==0 ) {
+        DEBUG(1, "multifdchunker[" << ::pthread_self() << "]: terminating before begin - "
+                 << (stop ? "cancelled" : (myFD==0 ? "no more filedescriptors" : "WUT?")));
+        return;
+    }
+
+    // Move to our CPU before starting the chunkmaker; it inherits it
+    if( !mfd->cpus.empty() ) {
+        const unsigned int  cpu = mfd->cpus[ myTag % mfd->cpus.size() ];
+#if defined(__linux__)
+        cpu_set_t           cpuset;
+        int                 rv;
+
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        if( (rv=::pthread_setaffinity_np(::pthread_self(), sizeof(cpuset), &cpuset))!=0 )
+            DEBUG(-1, "multifdchunker[" << ::pthread_self() << "]: failed to move stream #" << myTag
+                      << " to CPU " << cpu << " - " << evlbi5a::strerror(rv) << std::endl);
+#else
+        DEBUG(-1, "multifdchunker[" << ::pthread_self() << "]: no CPU pinning on this platform, ignoring CPU "
+                  << cpu << std::endl);
+#endif
+    }
+
+    // The reader thread's and chunkmaker thread's sync_types and the queue
+    // between them
+    pthread_cond_t                  lclCondition = PTHREAD_COND_INITIALIZER;
+    pthread_mutex_t                 lclMutex     = PTHREAD_MUTEX_INITIALIZER;
+    sync_type<fdreaderargs>         lclST(&lclCondition, &lclMutex);
+    pthread_cond_t                  cmCondition = PTHREAD_COND_INITIALIZER;
+    pthread_mutex_t                 cmMutex     = PTHREAD_MUTEX_INITIALIZER;
+    sync_type<chunkmakerargs_type>  cmST(&cmCondition, &cmMutex);
+    chunkmakerargs_type             cma( *mfd->chunkmaker );
+    bqueue< tagged<block> >         queue( args->qdepth );
+    outq_type< tagged<block> >      lclOQ( &queue );
+    streamchunker_args              sca;
+    pthread_t                       chunker;
+
+    myFD->tag   = myTag;
+    cma.stream  = myTag;
+    cma.nStream = nStream;
+    lclST.setqdepth( args->qdepth );
+    lclST.setstepid( args->stepid );
+    lclST.setuserdata( myFD );
+    cmST.setqdepth( args->qdepth );
+    cmST.setstepid( args->stepid );
+    cmST.setuserdata( &cma );
+    sca.queue = &queue;
+    sca.outq  = oq;
+    sca.sync  = &cmST;
+
+    queue.enable();
+    PTHREAD_CALL( ::pthread_create(&chunker, 0, &streamchunker<Namer>, (void*)&sca) );
+    try {
+        DEBUG(1, "multifdchunker[" << ::pthread_self() << "]: fd=" << myFD->fd << " streamID=" << myTag << std::endl);
+        ::netreader< tagged<block> >(&lclOQ, &lclST);
+    }
+    catch( std::exception const& e ) {
+        DEBUG(-1, "multifdchunker[" << ::pthread_self() << "]: error - " << e.what() << std::endl);
+    }
+    catch( ... ) {
+        DEBUG(-1, "multifdchunker[" << ::pthread_self() << "]: caught unknown exception" << std::endl);
+    }
+    // Let the chunkmaker finish what we read
+    queue.delayed_disable();
+    PTHREAD_CALL( ::pthread_join(chunker, 0) );
+
+    // Signal that we stopped
+    SYNCEXEC(args, args->userdata->nFinished++);
+    DEBUG(1, "multifdchunker[" << ::pthread_self() << "]: terminating" << std::endl);
+}
+
 #endif
@@ -23,6 +23,7 @@
 #include <sciprint.h>
 #include <getsok.h>
 #include <mk6info.h>
+#include <diskstats.h>
 #include <getsok_udt.h>
 #include <threadutil.h>
 #include <auto_array.h>
@@ -39,6 +40,7 @@
 #include <pthread.h>
 #include <signal.h>
 #include <dirent.h>
+#include <time.h>
 #include <stdlib.h>   // for random
 
 using namespace std;
@@ -129,7 +131,12 @@ multireadargs::~multireadargs() {
 
 multifileargs::multifileargs(runtime* ptr, filelist_type fl, mark6_vars_type mk6):
     listlength( fl.size() ), rteptr( ptr ), filelist( fl ), mk6vars( mk6 )
-{ EZASSERT2_NZERO(rteptr, cmdexception, EZINFO("null pointer runtime!")) }
+{
+    EZASSERT2_NZERO(rteptr, cmdexception, EZINFO("null pointer runtime!"))
+    ::diskstats_start( filelist );
+    for(filelist_type::const_iterator mp=filelist.begin(); mp!=filelist.end(); mp++)
+        mountpointIndex.insert( make_pair(*mp, (unsigned int)mountpointIndex.size()) );
+}
 
 multifileargs::~multifileargs() {
     // delete all memory pools
@@ -1227,7 +1234,64 @@ int mkpath(const char* file_path_in, mode_t mode) {
               msg << \
               "  removing it from list!" << endl << \
               "#################################################" << endl) ; \
-    SYNCEXEC(args, mfaptr->listlength -= 1; args->cond_broadcast());
+    ::diskstats_failed( mountpoint ); \
+    SYNCEXEC(args, mfaptr->listlength -= 1; mfaptr->busy.erase(mountpoint); args->cond_broadcast());
+
+// Per stream pipelines: may the chunk go to mount point 'mp'? Stream #i
+// gets the mount points at i, i+nStream, ... of the original list; with
+// fewer mount points than streams, streams share them.
+static bool stream_mountpoint(multifileargs const* mfaptr, filemetadata const& fmd, string const& mp) {
+    if( fmd.nStream==0 )
+        return true;
+
+    const unsigned int                         nmp = (unsigned int)mfaptr->mountpointIndex.size();
+    map<string, unsigned int>::const_iterator  idx = mfaptr->mountpointIndex.find( mp );
+
+    if( idx==mfaptr->mountpointIndex.end() )
+        return true;
+    return (fmd.nStream<=nmp ? (idx->second % fmd.nStream)==fmd.stream : idx->second==(fmd.stream % nmp));
+}
+
+// The number of usable (available or busy) mount points for the chunk.
+// Call with the args locked.
+static size_t n_stream_mountpoints(multifileargs const* mfaptr, filemetadata const& fmd) {
+    size_t  n = 0;
+
+    for(filelist_type::const_iterator mp=mfaptr->filelist.begin(); mp!=mfaptr->filelist.end(); mp++)
+        n += (stream_mountpoint(mfaptr, fmd, *mp) ? 1 : 0);
+    for(mountpointlist_type::const_iterator mp=mfaptr->busy.begin(); mp!=mfaptr->busy.end(); mp++)
+        n += (stream_mountpoint(mfaptr, fmd, *mp) ? 1 : 0);
+    return n;
+}
+
+// Only worth waiting for one of the busy mount points if the available ones
+// are all unusable and at least one of the busy ones is usable.
+// Only the mount points the chunk may go to are considered.
+// Call with the args locked.
+static bool wait_for_busy(multifileargs const* mfaptr, filemetadata const& fmd, uint64_t chunksize) {
+    bool  available = false;
+
+    for(filelist_type::const_iterator mp=mfaptr->filelist.begin(); mp!=mfaptr->filelist.end(); mp++) {
+        if( !stream_mountpoint(mfaptr, fmd, *mp) )
+            continue;
+        if( ::diskstats_usable(*mp, chunksize) )
+            return false;
+        available = true;
+    }
+    if( !available )
+        return true;
+    for(mountpointlist_type::const_iterator mp=mfaptr->busy.begin(); mp!=mfaptr->busy.end(); mp++)
+        if( stream_mountpoint(mfaptr, fmd, *mp) && ::diskstats_usable(*mp, chunksize) )
+            return true;
+    return false;
+}
+
+static double monotonic_now( void ) {
+    struct timespec  now;
+
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec/1.0e9;
+}
 
 
 void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
@@ -1253,19 +1317,42 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
         // Note to self: MAKE SURE NOT TO THROW INSIDE OF THIS LOOP!
         //               (We must put back the mountpoint right?!)
         while( !written ) {
-            size_t    listlength = 0;
-            string    mountpoint;
+            size_t        listlength = 0;
+            string        mountpoint;
+            filelist_type candidates;
+            filemetadata  where;
 
             // We need to wait for the filelist (i.e. mount point-list) to
-            // become non-empty so 's we can pop an entry from it
+            // become non-empty so 's we can pop an entry from it. If only
+            // slow or full ones are available, wait for a better one.
+            // Chunks of per stream pipelines wait for their own stream's
+            // mount points, unless none of those is left
             args->lock();
 
-            while( (listlength=mfaptr->listlength)>0 && mfaptr->filelist.empty() )
+            while( true ) {
+                where = chunk.tag;
+                if( where.nStream && n_stream_mountpoints(mfaptr, where)==0 )
+                    where.nStream = 0;
+                if( (listlength=mfaptr->listlength)==0 || !wait_for_busy(mfaptr, where, chunk.item.iov_len) )
+                    break;
                 args->cond_wait();
-
-            if( mfaptr->filelist.size()>0 ) {
-                mountpoint = mfaptr->filelist.front();
-                mfaptr->filelist.pop_front();
+            }
+            if( where.nStream )
+                listlength = n_stream_mountpoints(mfaptr, where);
+
+            for(filelist_type::const_iterator mp=mfaptr->filelist.begin(); mp!=mfaptr->filelist.end(); mp++)
+                if( stream_mountpoint(mfaptr, where, *mp) )
+                    candidates.push_back( *mp );
+
+            if( candidates.size()>0 ) {
+                filelist_type::iterator  mpptr = ::diskstats_select(candidates, chunk.item.iov_len);
+
+                // None of them usable? Better than not writing at all
+                if( mpptr==candidates.end() )
+                    mpptr = candidates.begin();
+                mountpoint = *mpptr;
+                mfaptr->filelist.remove( mountpoint );
+                mfaptr->busy.insert( mountpoint );
             }
             args->unlock();
 
@@ -1289,7 +1376,7 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
                 // we may continue.
                 // In both cases we return the mount point to the stack of
                 // mount points.
-                SYNCEXEC(args, mfaptr->filelist.push_back(mountpoint); args->cond_signal());
+                SYNCEXEC(args, mfaptr->filelist.push_back(mountpoint); mfaptr->busy.erase(mountpoint); args->cond_broadcast());
                 if( mp_seen.size()>=listlength )
                     break;
                 else
@@ -1302,13 +1389,15 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
             ssize_t              rv;
             uint64_t             bytes_written = 0;
             const string         fn = mountpoint + "/" + chunk.tag.fileName;
+            const double         t_start = monotonic_now();
+            int64_t              freebytes = -1;
             fdmap_type::iterator fdptr;
 
             // When doing mk6 emulation, check if the file descriptor for
             // the current mountpoint is already open
             if( mk6 ) {
                 SYNCEXEC(args,
-                        if( (fdptr = mfaptr->fdmap.find(mountpoint))!=mfaptr->fdmap.end() )
+                        if( (fdptr = mfaptr->fdmap.find(fn))!=mfaptr->fdmap.end() )
                             fd = fdptr->second;
                         )
             }
@@ -1371,6 +1460,12 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
                 }
             }
             DEBUG(4, "    parallelwriter[" << ::pthread_self() << "] result " << (bytes_written==(uint64_t)chunk.item.iov_len) << endl);
+            // Space left, for the statistics
+            struct statvfs  fsinfo;
+
+            if( ::fstatvfs(fd, &fsinfo)==0 )
+                freebytes = (int64_t)fsinfo.f_bavail * (int64_t)fsinfo.f_frsize;
+
             // close file already [unless we're emulating Mark6 mode]
             if( !mk6 ) {
                 ::close( fd );
@@ -1389,10 +1484,12 @@ void parallelwriter(inq_type<chunk_type>* inq, sync_type<multifileargs>* args) {
                 }
             } else {
                 // Writing to file finished succesfully, now put back
-                // mountpoint on the list and wake up only one waiter
+                // mountpoint on the list and wake up the waiters; they
+                // decide wether it's good enough for them
+                ::diskstats_written(mountpoint, bytes_written, monotonic_now() - t_start, freebytes);
                 SYNCEXEC(args,
-                    mfaptr->filelist.push_back(mountpoint); args->cond_signal();
-                    mfaptr->fdmap.insert(make_pair(mountpoint, fd)) );
+                    mfaptr->filelist.push_back(mountpoint); mfaptr->busy.erase(mountpoint); args->cond_broadcast();
+                    mfaptr->fdmap.insert(make_pair(fn, fd)) );
             }
         }
         // If we did not manage to write this chunk anywhere, we might as
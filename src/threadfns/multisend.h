@@ -118,7 +118,7 @@ struct multireadargs {
     ~multireadargs();
 };
 
-// Map from mountpoint => file descriptor
+// Map from file (mountpoint + "/" + Mark6 file name) => file descriptor
 typedef std::map<std::string, int> fdmap_type;
 
 // Mark6 info
@@ -167,6 +167,13 @@ struct multifileargs {
     filelist_type     filelist;
     mark6_vars_type   mk6vars;
     threadfdlist_type threadlist;
+    // the parallelwriter()s keep track of which mount points are being
+    // written to, to decide if it's worth waiting for one of those
+    // rather than writing to a slow one that's available now
+    mountpointlist_type busy;
+    // position of each mount point in the original list; per stream
+    // pipelines write stream #i to the mount points at i, i+nStream, ...
+    std::map<std::string, unsigned int> mountpointIndex;
 
     ~multifileargs();
 };
@@ -263,10 +270,17 @@ void parallelsender(inq_type<chunk_type>*, sync_type<networkargs>*);
 // the server and sucks the data out of the listen socket.
 void parallelnetreader(outq_type<chunk_type>*, sync_type<multinetargs>*);
 
+// Create all directories leading up to 'file_path' (the last path
+// component is not created). Returns 0 on success, -1 + errno otherwise
+int mkpath(const char* file_path, mode_t mode);
+
 // For each popped item, open a new file and dump the contents.
 // Wait until an item in the file list becomes available; the file list
 // now is a list of mount points "/mnt/diskN" where we can write to.
 // As soon as we're finished writing we put it back onto the list.
+// Of the available mount points, the one to write to is selected using
+// the write statistics (see diskstats.h); slow or full mount points are
+// skipped, if another one is (or will be) available.
 void parallelwriter(inq_type<chunk_type>*, sync_type<multifileargs>*);
 void parallelsink(inq_type<chunk_type>*, sync_type<multifileargs>*);
 
@@ -31,6 +31,7 @@
 #include <threadfns/udtreader.h>
 #include <threadfns/udpsreader.h>
 #include <threadfns/socketreader.h>
+#include <threadfns/stripedreader.h>
 #include <threadfns/udpsnorreader.h>
 #include <threadfns/do_push_block.h>
 //#include <threadfns.h>
@@ -211,12 +212,17 @@ void netreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
         delete incoming;
     }
 
-    // update submode flags
-    RTEEXEC(*network->rteptr, 
-            network->rteptr->transfersubmode.clr( wait_flag ).set( connected_flag ));
+    // update submode flags. "mtcp" accepts its connections itself so it
+    // will do this when it's ready
+    if( proto!="mtcp" ) {
+        RTEEXEC(*network->rteptr, 
+                network->rteptr->transfersubmode.clr( wait_flag ).set( connected_flag ));
+    }
 
     // and delegate to appropriate reader
-    if( proto=="udps" )
+    if( proto=="mtcp" )
+        stripedreader(outq, args);
+    else if( proto=="udps" )
         udpsreader(outq, args);
     else if( proto=="udpsnor" )
         udpsnorreader(outq, args);
@@ -0,0 +1,239 @@
+// read FlexBuff/Mark6 recordings with several threads in parallel
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+//
+#include <threadfns/parallelvbsreader.h>
+#include <libvbs.h>
+#include <runtime.h>
+#include <mountpoint.h>    // for mp_pthread_create()
+#include <mutex_locker.h>
+#include <evlbidebug.h>
+#include <sciprint.h>
+#include <threadutil.h>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+using namespace std;
+
+
+namespace {
+    // Shared between the reading threads and the step, which hands on the
+    // blocks in order
+    struct readahead_type {
+        typedef std::map<uint64_t, block>  done_type;
+
+        pthread_mutex_t  mutex;
+        pthread_cond_t   condition;
+        int              fd;
+        off_t            start, end;
+        unsigned int     blocksize;
+        unsigned int     maxahead;     // in blocks
+        bool             partial_ok;
+        blockpool_type*  pool;
+        uint64_t         nblock;       // may be lowered on EOF/error
+        uint64_t         next_read;    // next block to claim
+        uint64_t         next_push;    // next block to hand on
+        done_type        done;
+        bool             stop;
+
+        readahead_type(int f, off_t s, off_t e, unsigned int bs, unsigned int ahead, bool partial):
+            fd( f ), start( s ), end( e ), blocksize( bs ), maxahead( ahead ), partial_ok( partial ),
+            pool( new blockpool_type(bs, ahead) ),
+            nblock( (uint64_t)((e - s + bs - 1) / bs) ), next_read( 0 ), next_push( 0 ), stop( false )
+        {
+            PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+            PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+        }
+
+        ~readahead_type() {
+            done.clear();
+            delete pool;
+            ::pthread_cond_destroy(&condition);
+            ::pthread_mutex_destroy(&mutex);
+        }
+
+        private:
+            readahead_type();
+            readahead_type(readahead_type const&);
+            readahead_type const& operator=(readahead_type const&);
+    };
+
+    void* readahead_thread(void* arg) {
+        readahead_type*  ra = (readahead_type*)arg;
+        mutex_locker     locker( ra->mutex );
+
+        while( true ) {
+            // Don't get too far ahead of what's been handed on
+            while( !ra->stop && ra->next_read<ra->nblock && ra->next_read>=ra->next_push+ra->maxahead )
+                PTHREAD_CALL( ::pthread_cond_wait(&ra->condition, &ra->mutex) );
+            if( ra->stop || ra->next_read>=ra->nblock )
+                break;
+
+            const uint64_t  k   = ra->next_read++;
+            const off_t     pos = ra->start + (off_t)(k * ra->blocksize);
+            const size_t    n   = (size_t)std::min((off_t)ra->blocksize, ra->end - pos);
+            block           b( ra->pool->get() );
+            ssize_t         r;
+
+            // The actual reading is done unlocked
+            PTHREAD_CALL( ::pthread_mutex_unlock(&ra->mutex) );
+            r = ::vbs_pread(ra->fd, b.iov_base, n, pos);
+            PTHREAD_CALL( ::pthread_mutex_lock(&ra->mutex) );
+
+            if( r!=(ssize_t)ra->blocksize ) {
+                // Nothing after this block can be read. Like vbsreader_c(),
+                // a short block - also the final one - is only handed on if
+                // variable block sizes are allowed
+                if( r>0 && ra->partial_ok ) {
+                    ra->nblock = std::min(ra->nblock, k + 1);
+                } else {
+                    DEBUG(-1, "parallelvbsreader: read of block #" << k << " at " << pos << " returned " << r << " bytes in stead of " << ra->blocksize <<
+                              (r<0 ? string(" - ")+evlbi5a::strerror(errno) : string()) << endl);
+                    ra->nblock = std::min(ra->nblock, k);
+                }
+            }
+            if( k<ra->nblock )
+                ra->done[k] = b.sub(0, (size_t)r);
+            PTHREAD_CALL( ::pthread_cond_broadcast(&ra->condition) );
+        }
+        return (void*)0;
+    }
+}
+
+void parallelvbsreader_c(outq_type<block>* outq, sync_type<cfdreaderargs>* args) {
+    bool                   stop;
+    runtime*               rteptr;
+    cfdreaderargs          file = *args->userdata;
+
+    rteptr = file->rteptr;
+    RTEEXEC(*rteptr, rteptr->sizes.validate());
+    const unsigned int     blocksize = rteptr->sizes[constraints::blocksize];
+    unsigned int           nthread;
+    uint64_t               bufsize;
+
+    RTEEXEC(*rteptr,
+            nthread = rteptr->mk6info.playbackThreads;
+            bufsize = rteptr->mk6info.playbackBufsize);
+
+    // wait for the "GO" signal
+    args->lock();
+    while( !args->cancelled && !file->run ) {
+        args->cond_wait();
+    }
+    stop = args->cancelled;
+    args->unlock();
+
+    if( stop ) {
+        DEBUG(0, "parallelvbsreader: stopsignal caught before actual start" << endl);
+        return;
+    }
+
+    off_t  start, end;
+    bool   partial_ok;
+
+    SYNCEXEC(args,
+             start      = file->start;
+             end        = file->end;
+             partial_ok = file->allow_variable_block_size);
+    if( end==0 )
+        ASSERT_POS( end=::vbs_lseek(file->fd, 0, SEEK_END) );
+
+    RTEEXEC(*rteptr,
+            rteptr->statistics.init(args->stepid, "VBSReadPar"));
+    counter_type&   counter( rteptr->statistics.counter(args->stepid) );
+
+    // update submode flags
+    RTEEXEC(*rteptr,
+            rteptr->transfersubmode.set(connected_flag).set(run_flag));
+
+    // Read ahead at least two blocks per thread
+    const unsigned int  maxahead = (unsigned int)std::max((uint64_t)(2 * nthread), bufsize / blocksize);
+    readahead_type      ra(file->fd, start, std::max(start, end), blocksize, maxahead, partial_ok);
+    vector<pthread_t>   tids;
+
+    DEBUG(0, "parallelvbsreader: start reading fd#" << file->fd << ", " << start << " => " << end << " using " <<
+             nthread << " threads, " << maxahead << " x " << byteprint(blocksize, "byte") << " read ahead" << endl);
+
+    for(unsigned int i=0; i<nthread; i++) {
+        pthread_t  tid;
+        int        create_error;
+
+        if( (create_error=::mp_pthread_create(&tid, &readahead_thread, &ra))!=0 ) {
+            DEBUG(-1, "parallelvbsreader: failed to create thread #" << i << " - " << evlbi5a::strerror(create_error) << endl);
+            continue;
+        }
+        tids.push_back( tid );
+    }
+
+    // Hand on the blocks in order, as they come in
+    if( !tids.empty() ) {
+        mutex_locker  locker( ra.mutex );
+
+        while( true ) {
+            readahead_type::done_type::iterator  p;
+
+            while( !ra.stop && ra.next_push<ra.nblock && (p=ra.done.find(ra.next_push))==ra.done.end() ) {
+                // Wake up every now and then to see if we were cancelled
+                struct timespec  until;
+
+                ::clock_gettime(CLOCK_REALTIME, &until);
+                until.tv_nsec += 100000000;
+                if( until.tv_nsec>=1000000000 ) {
+                    until.tv_sec++;
+                    until.tv_nsec -= 1000000000;
+                }
+                ::pthread_cond_timedwait(&ra.condition, &ra.mutex, &until);
+                SYNCEXEC(args, ra.stop = ra.stop || args->cancelled);
+            }
+            if( ra.stop || ra.next_push>=ra.nblock )
+                break;
+
+            block  b( p->second );
+
+            ra.done.erase( p );
+            ra.next_push++;
+            PTHREAD_CALL( ::pthread_cond_broadcast(&ra.condition) );
+
+            PTHREAD_CALL( ::pthread_mutex_unlock(&ra.mutex) );
+            const bool  pushed = outq->push(b);
+            PTHREAD_CALL( ::pthread_mutex_lock(&ra.mutex) );
+
+            if( !pushed )
+                break;
+            counter += b.iov_len;
+        }
+        ra.stop = true;
+        PTHREAD_CALL( ::pthread_cond_broadcast(&ra.condition) );
+    }
+    for(vector<pthread_t>::iterator t=tids.begin(); t!=tids.end(); t++)
+        ::pthread_join(*t, 0);
+
+    DEBUG(0, "parallelvbsreader: done " << byteprint((double)counter, "byte") << endl);
+    file->finished = true;
+}
+
+vbsreader_fn vbsreader_for(runtime const& rte) {
+    return (rte.mk6info.playbackThreads>0 ? &parallelvbsreader_c : &vbsreader_c);
+}
@@ -0,0 +1,44 @@
+// read FlexBuff/Mark6 recordings with several threads in parallel
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+//
+#ifndef JIVE5A_THREADFNS_PARALLELVBSREADER_H
+#define JIVE5A_THREADFNS_PARALLELVBSREADER_H
+
+#include <chain.h>
+#include <threadfns.h>
+
+
+// Drop-in replacement for vbsreader_c(): same arguments, same output.
+// vbsreader_c() reads the recording block by block, so a single slow disk
+// holds up the whole playback. This one has rte->mk6info.playbackThreads
+// threads reading the next blocks concurrently, from whichever disks they
+// happen to be on. The blocks are handed on in order; at most
+// rte->mk6info.playbackBufsize bytes are read ahead. As with vbsreader_c()
+// a short final block is dropped unless the reader args'
+// allow_variable_block_size is set.
+void parallelvbsreader_c(outq_type<block>* outq, sync_type<cfdreaderargs>* args);
+
+// Returns vbsreader_c or parallelvbsreader_c, depending on the runtime's
+// playback settings
+typedef void (*vbsreader_fn)(outq_type<block>*, sync_type<cfdreaderargs>*);
+
+vbsreader_fn vbsreader_for(runtime const& rte);
+
+#endif
@@ -0,0 +1,176 @@
+// read a block stream striped over multiple TCP connections ("mtcp")
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_THREADFNS_STRIPEDREADER_H
+#define JIVE5A_THREADFNS_STRIPEDREADER_H
+
+#include <chain.h>
+#include <block.h>
+#include <getsok.h>
+#include <sciprint.h>
+#include <threadfns.h>
+#include <threadutil.h>
+#include <threadfns/striping.h>
+#include <threadfns/do_push_block.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+// network->fd is the listening socket. Accept connections until all
+// stripes announced by the sender have checked in, then start one
+// receiver thread per connection (see threadfns/striping.h) and output the
+// blocks in the order in which they were sent.
+template <typename Item>
+void stripedreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
+    typedef std::vector<int>                   fd_list_type;
+    typedef std::vector<pthread_t>             thread_list_type;
+    typedef std::vector<stripe_receiver_args>  receiver_list_type;
+
+    bool                  stop;
+    block                 b;
+    runtime*              rteptr;
+    uint64_t              nblock = 0, nbyte = 0;
+    fd_list_type          fds;
+    fdreaderargs*         network = args->userdata;
+    thread_list_type      tids;
+    receiver_list_type    receivers;
+
+    rteptr = network->rteptr;
+    ASSERT_COND(rteptr!=0);
+
+    RTEEXEC(*rteptr,
+            rteptr->sizes.validate();
+            rteptr->statistics.init(args->stepid, "StripedRead"));
+
+    counter_type&        counter( rteptr->statistics.counter(args->stepid) );
+    const unsigned int   bl_size = rteptr->sizes[constraints::blocksize];
+    const unsigned int   tag     = network->tag;
+
+    install_zig_for_this_thread(SIGUSR1);
+    SYNCEXEC(args,
+             stop = args->cancelled;
+             delete network->threadid;
+             network->threadid = new pthread_t( ::pthread_self() ));
+
+    if( stop ) {
+        DEBUG(0, "stripedreader: stop signalled before we actually started" << std::endl);
+        SYNCEXEC(args, delete network->threadid; network->threadid = 0);
+        return;
+    }
+
+    RTEEXEC(*rteptr, rteptr->transfersubmode.set( wait_flag ));
+    DEBUG(0, "stripedreader: waiting for incoming connections" << std::endl);
+
+    // The first valid hello tells us how many connections to expect.
+    // "do_accept_incoming" throws on wonky (e.g. when we're cancelled)
+    try {
+        unsigned int  naccepted = 0;
+
+        do {
+            stripe_hello_type         hello;
+            fdprops_type::value_type  incoming( do_accept_incoming(network->fd) );
+
+            if( !stripe_read(incoming.first, &hello, sizeof(hello)) ||
+                hello.magic!=stripe_hello_type::hello_magic || hello.nstripe==0 ) {
+                DEBUG(-1, "stripedreader: ignoring connection from " << incoming.second << " - not an mtcp sender" << std::endl);
+                ::close(incoming.first);
+                continue;
+            }
+            if( fds.empty() )
+                fds.resize(hello.nstripe, -1);
+            if( hello.nstripe!=fds.size() || hello.stripe>=fds.size() || fds[hello.stripe]!=-1 ) {
+                DEBUG(-1, "stripedreader: ignoring connection from " << incoming.second << " - stripe "
+                          << hello.stripe << "/" << hello.nstripe << " does not fit in " << fds.size() << std::endl);
+                ::close(incoming.first);
+                continue;
+            }
+            fds[hello.stripe] = incoming.first;
+            naccepted++;
+            DEBUG(1, "stripedreader: stripe " << hello.stripe << "/" << hello.nstripe << " from " << incoming.second << std::endl);
+        } while( fds.empty() || naccepted<fds.size() );
+    }
+    catch( ... ) {
+        for(fd_list_type::iterator fd=fds.begin(); fd!=fds.end(); fd++)
+            if( *fd!=-1 )
+                ::close(*fd);
+        SYNCEXEC(args, delete network->threadid; network->threadid = 0);
+        throw;
+    }
+    DEBUG(0, "stripedreader: accepted " << fds.size() << " connections" << std::endl);
+
+    // Give the reorder buffer room for at least two rounds of blocks
+    const unsigned int   nstripe = (unsigned int)fds.size();
+    stripe_reorder_type  reorder(std::max(2*nstripe, network->netparms.nblock), nstripe);
+
+    RTEEXEC(*rteptr,
+            rteptr->transfersubmode.clr( wait_flag ).set( connected_flag ));
+
+    receivers.resize( nstripe );
+    for(unsigned int s=0; s<nstripe; s++) {
+        pthread_t  tid;
+
+        receivers[s].fd        = fds[s];
+        receivers[s].blocksize = bl_size;
+        receivers[s].nblock    = network->netparms.nblock;
+        receivers[s].rteptr    = rteptr;
+        receivers[s].counter   = &counter;
+        receivers[s].reorder   = &reorder;
+        PTHREAD_CALL( ::pthread_create(&tid, 0, &stripe_receiver, (void*)&receivers[s]) );
+        tids.push_back( tid );
+    }
+    SYNCEXEC(args,
+             stop = args->cancelled;
+             network->threads.insert(tids.begin(), tids.end()));
+
+    while( !stop && reorder.pop(b) ) {
+        nblock++;
+        if( do_push_block(outq, b, tag)==false )
+            break;
+    }
+
+    // Wake up receivers that are still blocked and wait for them to finish
+    reorder.cancel();
+    for(unsigned int s=0; s<nstripe; s++)
+        ::shutdown(fds[s], SHUT_RDWR);
+    for(unsigned int s=0; s<nstripe; s++) {
+        PTHREAD_CALL( ::pthread_join(tids[s], 0) );
+        nbyte += receivers[s].nbyte;
+        ::close(fds[s]);
+    }
+    SYNCEXEC(args,
+             for(unsigned int s=0; s<nstripe; s++)
+                network->threads.erase(tids[s]);
+             delete network->threadid;
+             network->threadid = 0);
+
+    if( reorder.n_skipped() ) {
+        DEBUG(-1, "stripedreader: " << reorder.n_skipped() << " blocks were lost" << std::endl);
+    }
+    DEBUG(0, "stripedreader: stopping. read " << nblock << " blocks, " << nbyte << " (" <<
+            byteprint((double)nbyte,"byte") << ")" << std::endl);
+    network->finished = true;
+}
+
+#endif
@@ -0,0 +1,338 @@
+// implementation of the "mtcp" striping support
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <threadfns/striping.h>
+#include <getsok.h>
+#include <runtime.h>
+#include <blockpool.h>
+#include <dosyscall.h>
+#include <evlbidebug.h>
+#include <pthreadcall.h>
+#include <threadutil.h>
+
+#include <limits>
+#include <exception>
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(stripeexception)
+
+
+stripe_hello_type::stripe_hello_type():
+    magic( 0 ), nstripe( 0 ), stripe( 0 )
+{}
+
+stripe_hello_type::stripe_hello_type(uint16_t n, uint16_t s):
+    magic( stripe_hello_type::hello_magic ), nstripe( n ), stripe( s )
+{}
+
+stripe_header_type::stripe_header_type():
+    seqnr( 0 ), length( 0 ), magic( 0 )
+{}
+
+stripe_header_type::stripe_header_type(uint64_t s, uint32_t l):
+    seqnr( s ), length( l ), magic( stripe_header_type::header_magic )
+{}
+
+
+bool stripe_writev(int fd, struct iovec* iov, int niov) {
+    size_t  n = 0;
+
+    for(int i=0; i<niov; i++)
+        n += iov[i].iov_len;
+    return ::writev(fd, iov, niov)==(ssize_t)n;
+}
+
+bool stripe_read(int fd, void* buf, size_t n) {
+    const ssize_t  r = ::recv(fd, buf, n, MSG_WAITALL);
+
+    if( r==0 )
+        errno = 0;
+    return r==(ssize_t)n;
+}
+
+int stripe_connect(const netparms_type& np, uint16_t n, uint16_t s) {
+    int                fd = getsok(np.get_host(), np.get_port(), "tcp");
+    unsigned int       olen( sizeof(np.sndbufsize) );
+    struct iovec       iov;
+    stripe_hello_type  hello(n, s);
+
+    if( np.sndbufsize>0 ) {
+        ASSERT2_ZERO( ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &np.sndbufsize, olen), ::close(fd) );
+    }
+    if( np.rcvbufsize>0 ) {
+        ASSERT2_ZERO( ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &np.rcvbufsize, olen), ::close(fd) );
+    }
+    iov.iov_base = &hello;
+    iov.iov_len  = sizeof(hello);
+    ASSERT2_COND( stripe_writev(fd, &iov, 1), ::close(fd); SCINFO("stripe " << s << "/" << n << " failed to send hello") );
+    return fd;
+}
+
+
+/////////////////////////////////////////////////////////////
+//                  stripe_reorder_type
+/////////////////////////////////////////////////////////////
+
+stripe_reorder_type::stripe_reorder_type(unsigned int w, unsigned int nreader):
+    window( w ), cancelled( false ), next( 0 ), nskipped( 0 ),
+    ncached( 0 ), nlive( nreader ), nwaiting( 0 ),
+    slots( w ), present( w, false )
+{
+    EZASSERT2(window>0 && nreader>0, stripeexception,
+              EZINFO("window (" << window << ") and number of readers (" << nreader << ") must be >0"));
+    PTHREAD_CALL( ::pthread_mutex_init(&mutex, 0) );
+    PTHREAD_CALL( ::pthread_cond_init(&condition, 0) );
+}
+
+bool stripe_reorder_type::wait_for_room(uint64_t seqnr) {
+    bool  rv;
+
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    if( !cancelled && seqnr>=next+window ) {
+        // Announce that we're blocked: if the consumer is waiting for a
+        // sequence number that will never arrive, it needs to know
+        nwaiting++;
+        PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+        while( !cancelled && seqnr>=next+window )
+            PTHREAD_CALL( ::pthread_cond_wait(&condition, &mutex) );
+        nwaiting--;
+    }
+    rv = !cancelled;
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+    return rv;
+}
+
+void stripe_reorder_type::insert(uint64_t seqnr, block b) {
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    // Only sequence numbers inside the window are acceptable; anything
+    // before it was already skipped (and thus lost)
+    if( seqnr>=next && seqnr<next+window ) {
+        const unsigned int  slot = (unsigned int)(seqnr % window);
+
+        if( !present[slot] ) {
+            slots[slot]   = b;
+            present[slot] = true;
+            ncached++;
+            PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+        }
+    }
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+}
+
+void stripe_reorder_type::reader_done( void ) {
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    nlive--;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+}
+
+bool stripe_reorder_type::pop(block& b) {
+    bool  rv = false;
+
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    while( !cancelled ) {
+        const unsigned int  slot = (unsigned int)(next % window);
+
+        if( present[slot] ) {
+            b             = slots[slot];
+            slots[slot]   = block();
+            present[slot] = false;
+            ncached--;
+            next++;
+            rv            = true;
+            // there may be readers waiting for room
+            PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+            break;
+        }
+        // Not there. If nobody is alive anymore and nothing's cached,
+        // we're done
+        if( nlive==0 && ncached==0 )
+            break;
+        // If all readers that are still alive are waiting for room, the
+        // block we're waiting for is never going to arrive
+        if( nwaiting==nlive ) {
+            next++;
+            nskipped++;
+            PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+            continue;
+        }
+        PTHREAD_CALL( ::pthread_cond_wait(&condition, &mutex) );
+    }
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+    return rv;
+}
+
+void stripe_reorder_type::cancel( void ) {
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    cancelled = true;
+    PTHREAD_CALL( ::pthread_cond_broadcast(&condition) );
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+}
+
+uint64_t stripe_reorder_type::n_skipped( void ) {
+    uint64_t  rv;
+    PTHREAD_CALL( ::pthread_mutex_lock(&mutex) );
+    rv = nskipped;
+    PTHREAD_CALL( ::pthread_mutex_unlock(&mutex) );
+    return rv;
+}
+
+// Destructors must not throw so no PTHREAD_CALL() here
+stripe_reorder_type::~stripe_reorder_type() {
+    ::pthread_cond_destroy(&condition);
+    ::pthread_mutex_destroy(&mutex);
+}
+
+
+/////////////////////////////////////////////////////////////
+//           the per-connection sender and receiver
+/////////////////////////////////////////////////////////////
+
+stripe_job_type::stripe_job_type():
+    seqnr( 0 )
+{}
+
+stripe_job_type::stripe_job_type(uint64_t s):
+    seqnr( s )
+{}
+
+stripe_sender_args::stripe_sender_args():
+    fd( -1 ), rteptr( 0 ), counter( 0 ), queue( 0 ), nbyte( 0 )
+{}
+
+void* stripe_sender(void* argptr) {
+    stripe_sender_args*  ssa = (stripe_sender_args*)argptr;
+
+    install_zig_for_this_thread(SIGUSR1);
+    try {
+        stripe_job_type  job;
+        // header + at most 16 blocks per element, as fdwriter
+        struct iovec     iov[17];
+
+        while( ssa->queue->pop(job) ) {
+            int                 niov = 1;
+            uint64_t            n    = 0;
+            stripe_header_type  hdr;
+
+            for(stripe_job_type::blocks_type::const_iterator b=job.blocks.begin();
+                b!=job.blocks.end() && niov<17; b++, niov++) {
+                iov[niov].iov_base  = b->iov_base;
+                iov[niov].iov_len   = b->iov_len;
+                n                  += b->iov_len;
+            }
+            if( n>(uint64_t)std::numeric_limits<uint32_t>::max() ) {
+                DEBUG(-1, "stripe_sender[fd=" << ssa->fd << "]: element #" << job.seqnr
+                          << " too large (" << n << " bytes)" << std::endl);
+                break;
+            }
+            hdr             = stripe_header_type(job.seqnr, (uint32_t)n);
+            iov[0].iov_base = &hdr;
+            iov[0].iov_len  = sizeof(hdr);
+
+            if( !stripe_writev(ssa->fd, &iov[0], niov) ) {
+                lastsyserror_type lse;
+                DEBUG(-1, "stripe_sender[fd=" << ssa->fd << "]: failed to write element #"
+                          << job.seqnr << " " << lse << std::endl);
+                break;
+            }
+            ssa->nbyte += n;
+            RTEEXEC(*ssa->rteptr, *ssa->counter += (int64_t)n);
+        }
+    }
+    catch( const std::exception& e ) {
+        DEBUG(-1, "stripe_sender[fd=" << ssa->fd << "]: " << e.what() << std::endl);
+    }
+    catch( ... ) {
+        DEBUG(-1, "stripe_sender[fd=" << ssa->fd << "]: caught unknown exception" << std::endl);
+    }
+    // Make sure the distributor doesn't keep on pushing to us
+    ssa->queue->disable();
+    return (void*)0;
+}
+
+
+stripe_receiver_args::stripe_receiver_args():
+    fd( -1 ), blocksize( 0 ), nblock( 0 ), rteptr( 0 ), counter( 0 ),
+    reorder( 0 ), nbyte( 0 )
+{}
+
+void* stripe_receiver(void* argptr) {
+    blockpool_type*        pool = 0;
+    stripe_receiver_args*  sra  = (stripe_receiver_args*)argptr;
+
+    install_zig_for_this_thread(SIGUSR1);
+    try {
+        pool = new blockpool_type(sra->blocksize, sra->nblock);
+
+        while( true ) {
+            block               b;
+            stripe_header_type  hdr;
+
+            if( !stripe_read(sra->fd, &hdr, sizeof(hdr)) ) {
+                lastsyserror_type lse;
+                DEBUG((lse.sys_errno==0 ? 2 : -1), "stripe_receiver[fd=" << sra->fd << "]: "
+                        << (lse.sys_errno==0 ? std::string("remote side closed connection") : lse.sys_errormessage)
+                        << std::endl);
+                break;
+            }
+            EZASSERT2(hdr.magic==stripe_header_type::header_magic, stripeexception,
+                      EZINFO("fd=" << sra->fd << " header magic mismatch; got 0x" << std::hex << hdr.magic));
+
+            // Wait until the consumer has room for this sequence number;
+            // TCP will push back on the sender in the mean time
+            if( !sra->reorder->wait_for_room(hdr.seqnr) )
+                break;
+
+            // Elements larger than the configured blocksize are
+            // accepted but they cannot come from our pool
+            if( hdr.length>sra->blocksize )
+                b = block( (size_t)hdr.length );
+            else
+                b = pool->get();
+            b.iov_len = hdr.length;
+
+            if( !stripe_read(sra->fd, b.iov_base, b.iov_len) ) {
+                lastsyserror_type lse;
+                DEBUG(-1, "stripe_receiver[fd=" << sra->fd << "]: failed to read element #"
+                          << hdr.seqnr << " " << lse << std::endl);
+                break;
+            }
+            sra->reorder->insert(hdr.seqnr, b);
+            sra->nbyte += hdr.length;
+            RTEEXEC(*sra->rteptr, *sra->counter += (int64_t)hdr.length);
+        }
+    }
+    catch( const std::exception& e ) {
+        DEBUG(-1, "stripe_receiver[fd=" << sra->fd << "]: " << e.what() << std::endl);
+    }
+    catch( ... ) {
+        DEBUG(-1, "stripe_receiver[fd=" << sra->fd << "]: caught unknown exception" << std::endl);
+    }
+    sra->reorder->reader_done();
+    // blocks that are still in flight keep the pool's memory alive
+    delete pool;
+    return (void*)0;
+}
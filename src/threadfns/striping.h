@@ -0,0 +1,185 @@
+// Support for striping a block stream over multiple TCP connections ("mtcp")
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_THREADFNS_STRIPING_H
+#define JIVE5A_THREADFNS_STRIPING_H
+
+#include <block.h>
+#include <bqueue.h>
+#include <counter.h>
+#include <netparms.h>
+#include <ezexcept.h>
+
+#include <vector>
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+DECLARE_EZEXCEPT(stripeexception)
+
+struct runtime;
+
+// The "mtcp" wire protocol is deliberately simple.
+//
+// The sender opens "nstripe" TCP connections to the receiver. Immediately
+// after connecting each connection identifies itself by sending a
+// stripe_hello_type. Then, for each element sent over that connection, a
+// stripe_header_type is sent, followed by exactly .length bytes of payload.
+// Elements are dealt out round-robin over the connections, the sequence
+// number in the header allows the receiver to put them back in order.
+// All integers are in host byte order, as is the sequence number in udps.
+struct stripe_hello_type {
+    uint32_t    magic;
+    uint16_t    nstripe;  // total number of connections the sender opens
+    uint16_t    stripe;   // which one of those this is, 0 .. nstripe-1
+
+    static const uint32_t  hello_magic = 0x6d746370; // "mtcp"
+
+    stripe_hello_type();
+    stripe_hello_type(uint16_t n, uint16_t s);
+};
+
+struct stripe_header_type {
+    uint64_t    seqnr;
+    uint32_t    length;
+    uint32_t    magic;
+
+    static const uint32_t  header_magic = 0x5354524d;
+
+    stripe_header_type();
+    stripe_header_type(uint64_t s, uint32_t l);
+};
+
+// Write/read exactly the requested amount of bytes in one blocking system
+// call. Like fdwriter/socketreader a short transfer is treated as failure:
+// on a blocking TCP socket that only happens on error, remote hangup or
+// when the thread was signalled (cancelled). errno is left as set by the
+// failing system call (or 0 in case of remote hangup)
+bool stripe_writev(int fd, struct iovec* iov, int niov);
+bool stripe_read(int fd, void* buf, size_t n);
+
+// Open stripe #s to the destination found in np (host, port, socket buffer
+// sizes) and send the hello. The returned fd is connected and ready for
+// use. Throws on failure.
+int  stripe_connect(const netparms_type& np, uint16_t n, uint16_t s);
+
+// The receiving end's bounded reorder buffer. Reader threads (one per
+// connection) insert blocks by sequence number; the consumer pops them in
+// order. At most 'window' blocks are held at any time: a reader that
+// received a header for a block too far ahead of the consumer blocks until
+// there is room, so TCP flow control pushes back on the sender.
+//
+// If a connection dies, the block(s) it was carrying will never arrive.
+// Once all still-alive readers are waiting for room (or none are alive
+// anymore) the missing sequence number is skipped (and counted) such that
+// the transfer can proceed/drain.
+class stripe_reorder_type {
+    public:
+        stripe_reorder_type(unsigned int window, unsigned int nreader);
+
+        // Reader side. wait_for_room() returns false if cancelled
+        bool wait_for_room(uint64_t seqnr);
+        void insert(uint64_t seqnr, block b);
+        void reader_done( void );
+
+        // Consumer side. Returns false if there is nothing left
+        // to pop, ever, or when cancelled
+        bool pop(block& b);
+
+        // Wake up everyone and make them return false
+        void cancel( void );
+
+        uint64_t n_skipped( void );
+
+        ~stripe_reorder_type();
+
+    private:
+        typedef std::vector<block>  slots_type;
+        typedef std::vector<bool>   flags_type;
+
+        const unsigned int   window;
+        bool                 cancelled;
+        uint64_t             next;
+        uint64_t             nskipped;
+        unsigned int         ncached;
+        unsigned int         nlive;
+        unsigned int         nwaiting;
+        slots_type           slots;
+        flags_type           present;
+        pthread_mutex_t      mutex;
+        pthread_cond_t       condition;
+
+        // no copy or assignment
+        stripe_reorder_type( stripe_reorder_type const& );
+        stripe_reorder_type const& operator=( stripe_reorder_type const& );
+};
+
+
+
+// The sending side deals elements out round-robin to one thread per
+// connection. Each element is flattened into a list of blocks such that
+// the per-connection threads need not be templated on the element type
+struct stripe_job_type {
+    typedef std::vector<block>  blocks_type;
+
+    uint64_t     seqnr;
+    blocks_type  blocks;
+
+    stripe_job_type();
+    stripe_job_type(uint64_t s);
+};
+
+typedef bqueue<stripe_job_type>  stripe_queue_type;
+
+struct stripe_sender_args {
+    int                 fd;
+    runtime*            rteptr;
+    counter_type*       counter;
+    stripe_queue_type*  queue;
+    uint64_t            nbyte;
+
+    stripe_sender_args();
+};
+
+// Thread function: pops jobs from ->queue and writes them to ->fd.
+// Disables the queue upon exit so the distributing thread notices
+// if this connection failed
+void* stripe_sender(void* stripe_sender_args_ptr);
+
+
+struct stripe_receiver_args {
+    int                   fd;
+    unsigned int          blocksize;
+    unsigned int          nblock;
+    runtime*              rteptr;
+    counter_type*         counter;
+    stripe_reorder_type*  reorder;
+    uint64_t              nbyte;
+
+    stripe_receiver_args();
+};
+
+// Thread function: reads headers + payload from ->fd and inserts the
+// blocks into the reorder buffer. Each receiver uses a private blockpool
+// of ->nblock blocks of ->blocksize bytes (blockpool_type is not
+// thread-safe). Calls ->reorder->reader_done() upon exit.
+void* stripe_receiver(void* stripe_receiver_args_ptr);
+
+#endif
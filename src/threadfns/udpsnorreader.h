@@ -23,6 +23,7 @@
 #include <chain.h>
 #include <block.h>
 #include <threadfns.h>
+#include <xdpsocket.h>
 #include <threadfns/per_sender.h>
 #include <threadfns/do_push_block.h>
 
@@ -39,6 +40,7 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
     unsigned char*            location;
     unsigned char*            block_end;
     fdreaderargs*             network = args->userdata;
+    xdpsocket_type*           xsk = 0;
     struct sockaddr_in        sender;
     find_by_sender_type       find_by_sender(&sender);
     // Keep pakkit stats per sender. Keep at most 8 unique senders?
@@ -115,11 +117,28 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
     msg.msg_iovlen     = 2;
     msg.msg_iov        = &iov[0];
 
+    // Take the datagrams straight from the NIC if so configured
+    // (see udpsreader_bh)
+    if( network->netparms.xdp_interface.empty()==false ) {
+        try {
+            xsk = new xdpsocket_type(network->netparms.xdp_interface, network->netparms.xdp_queue,
+                                     network->netparms.get_port(), network->netparms.xdp_mode, network->fd);
+        }
+        catch( ... ) {
+            delete [] zeroes_p;
+            SYNCEXEC(args, delete network->threadid; network->threadid = 0);
+            throw;
+        }
+    }
+
+    // Optionally time stamp each datagram (see net_timestamp)
+    rxtimestamp_type    rxts(network->netparms.rx_timestamp, (xsk ? -1 : network->fd), msg, rteptr, rd_size);
+
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
             rteptr->evlbi_stats[ network->tag ] = evlbi_stats_type();
             rteptr->statistics.init(args->stepid, "UdpsNorRead"),
-            delete [] zeroes_p; delete network->threadid; network->threadid = 0;);
+            delete xsk; delete [] zeroes_p; delete network->threadid; network->threadid = 0;);
 
     // Great. We're done setting up. Now let's see if we weren't cancelled
     // by any chance
@@ -127,6 +146,7 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
     SYNCEXEC(args, stop = args->cancelled);
 
     if( stop ) {
+        delete xsk;
         delete [] zeroes_p;
         SYNCEXEC(args, delete network->threadid; network->threadid = 0);
         DEBUG(0, "udpsnorreader: cancelled before actual start" << std::endl);
@@ -147,6 +167,7 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
     counter_type&    counter( rteptr->statistics.counter(args->stepid) );
     ucounter_type&   loscnt( rteptr->evlbi_stats[ network->tag ].pkt_lost );
     ucounter_type&   pktcnt( rteptr->evlbi_stats[ network->tag ].pkt_in );
+    arrival_stats_type& arrival( rteptr->evlbi_stats[ network->tag ].arrival );
 //    ucounter_type&   ooocnt( rteptr->evlbi_stats.pkt_ooo );
 //    ucounter_type&   ooosum( rteptr->evlbi_stats.ooosum );
 //    ucounter_type    tmppkt, tmpooocnt, tmpooosum, tmplos;
@@ -168,7 +189,7 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
         // Wait here for packet
         iov[1].iov_base = location;
 
-        if( (n=::recvmsg(network->fd, &msg, MSG_WAITALL))!=waitallread ) {
+        if( (n=xdp_or_sok_recvmsg(xsk, network->fd, &msg, MSG_WAITALL))!=waitallread ) {
             lastsyserror_type  lse;
             std::ostringstream oss;
 
@@ -206,6 +227,7 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
             // actually doing that
             // 2.) delete local buffers. In c++11 using unique_ptr this
             // wouldnae be necessary
+            delete xsk;
             delete [] zeroes_p;
             oss << "::recvmsg(network->fd, &msg, MSG_WAITALL) fails - [" << lse << "] (ask:" << waitallread << " got:" << n << ")";
             throw syscallexception(oss.str());
@@ -214,6 +236,7 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
         // OK. Packet reading succeeded
         counter += waitallread;
         pktcnt++;
+        rxts.packet(msg, location, arrival);
 
         // Write zeroes if necessary
         (void)(n_zeroes && ::memcpy(location+rd_size, zeroes_p, n_zeroes));
@@ -275,6 +298,10 @@ void udpsnorreader(outq_type<Item>* outq, sync_type<fdreaderargs>* args) {
     SYNCEXEC(args, delete network->threadid; network->threadid = 0);
 
     // Clean up
+    if( xsk ) {
+        DEBUG(0, "udpsnorreader: AF_XDP " << xsk->mode() << " dropped " << xsk->rx_dropped() << " packets" << std::endl);
+    }
+    delete xsk;
     delete [] zeroes_p;
     DEBUG(0, "udpsnorreader: stopping" << std::endl);
 }
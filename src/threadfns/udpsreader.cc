@@ -18,6 +18,7 @@
 //          P.O. Box 2
 //          7990 AA Dwingeloo
 #include <threadfns/udpsreader.h>
+#include <xdpsocket.h>
 
 #include <list>
 #include <string>
@@ -27,7 +28,10 @@
 ////  wether or not a packet is received or not
 ////
 ////  The bottom half grabs memory and puts packets in order and sets
-////  a flag if it has written a position.
+////  a flag if it has written a position. Each packet is received only
+////  once (no MSG_PEEK for the sequence number first): directly into the
+////  position of the next expected sequence number, or in a staging
+////  buffer from which it is moved to its position.
 ////  The top half goes over the array of flags and writes fill pattern +
 ////  zeroes in the packet positions that have no data
 ////
@@ -58,12 +62,14 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
     bool                      stop;
     ssize_t                   r;
     uint64_t                  seqnr, seqoff, pktidx;
+    uint64_t                  predseqnr   = 0;
     uint64_t                  firstseqnr  = 0;
     uint64_t                  expectseqnr = 0;
     runtime*                  rteptr = 0;
     socklen_t                 slen( sizeof(struct sockaddr_in) );
     unsigned int              ack = 0;
     fdreaderargs*             network = 0;
+    xdpsocket_type*           xsk = 0;
     struct sockaddr_in        sender;
     sync_type<fdreaderargs>*  args = argsargs->userdata;
     static std::string        acks[] = {"xhg", "xybbgmnx",
@@ -156,38 +162,52 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
 
     // message 'msg': two fragments. Sequence number and datapart
     msg.msg_iov        = &iov[0];
-
-    // The iov_len's will be filled in differently between
-    // the PEEK phase and the WAITALL phase
-    msg.msg_iovlen     = 0;
+    msg.msg_iovlen     = 2;
 
     // The size of the parts of the message are known
-    // and for the sequencenumber, we already know the destination address
+    // and for the sequencenumber, we already know the destination address.
+    // Where the datapart goes is decided per packet, see below.
     iov[0].iov_base    = &seqnr;
     iov[0].iov_len     = sizeof(seqnr);
+    iov[1].iov_base    = dummybuf;
     iov[1].iov_len     = rd_size;
 
-    // Here we fix the amount of iov's and lengths of the
-    // messages for the two phases: PEEK and WAITALL
     // We should be safe for datagrams up to 2G i hope
-    //   (the casts to 'int' from iov[..].iov_len because
+    //   (the cast to 'int' from iov[..].iov_len because
     //    the .iov_len is-an unsigned)
-    const int               npeek       = 1;
-    const int               peekread    = (int)(iov[0].iov_len);
-    const int               nwaitall    = 2;
     const int               waitallread = (int)(iov[0].iov_len + iov[1].iov_len);
 
+    // If so configured, take the datagrams straight from the NIC. The
+    // UDP socket is still used for sending the ACKs and, by closing it,
+    // for telling us to stop
+    if( network->netparms.xdp_interface.empty()==false ) {
+        try {
+            xsk = new xdpsocket_type(network->netparms.xdp_interface, network->netparms.xdp_queue,
+                                     network->netparms.get_port(), network->netparms.xdp_mode, network->fd);
+        }
+        catch( ... ) {
+            delete [] dummybuf;
+            delete [] workbuf;
+            SYNCEXEC(args, delete network->threadid; network->threadid = 0);
+            throw;
+        }
+    }
+
+    // Optionally time stamp each datagram (see net_timestamp)
+    rxtimestamp_type    rxts(network->netparms.rx_timestamp, (xsk ? -1 : network->fd), msg, rteptr, rd_size);
+
     // reset statistics/chain and statistics/evlbi
     RTE3EXEC(*rteptr,
             rteptr->evlbi_stats[ network->tag ] = evlbi_stats_type();
             rteptr->statistics.init(args->stepid, "UdpsReadBH"),
-            delete [] dummybuf; delete [] workbuf; delete network->threadid; network->threadid = 0);
+            delete xsk; delete [] dummybuf; delete [] workbuf; delete network->threadid; network->threadid = 0);
 
     // Great. We're done setting up. Now let's see if we weren't cancelled
     // by any chance
     SYNCEXEC(args, stop = args->cancelled);
 
     if( stop ) {
+        delete xsk;
         delete [] dummybuf;
         delete [] workbuf;
         SYNCEXEC(args, delete network->threadid; network->threadid = 0);
@@ -212,6 +232,7 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
     ucounter_type&   ooocnt( rteptr->evlbi_stats[network->tag].pkt_ooo );
     ucounter_type&   disccnt( rteptr->evlbi_stats[network->tag].pkt_disc );
     ucounter_type&   ooosum( rteptr->evlbi_stats[network->tag].ooosum );
+    arrival_stats_type& arrival( rteptr->evlbi_stats[network->tag].arrival );
 
     // inner loop variables
     bool           done;
@@ -221,8 +242,23 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
     uint64_t       blockidx;
     uint64_t       maxseq, minseq;
     unsigned int   shiftcount;
+    unsigned int   head = 0;
     netparms_type& np( network->rteptr->netparms );
 
+    // Each datagram is received exactly once. Because the stream is
+    // mostly in order we receive the next datagram directly into the
+    // position where the next expected sequence number should go. If the
+    // datagram turns out to have another sequence number, it is moved to
+    // its correct position. When the expected position is not (yet)
+    // available the datagram is received in the staging buffer and
+    // copied from there.
+    //
+    // The workbuf is used as a ring buffer: workbuf[head] holds
+    // sequence numbers [firstseqnr, firstseqnr + n_dg_p_block) and so on.
+    // Advancing the window is pushing workbuf[head] downstream and moving
+    // 'head' - blocks are never shifted around.
+#define WORKBUF(i)  workbuf[(head + (i)) % readahead]
+
     // Our loop can be much cleaner if we wait here to receive the 
     // very first sequencenumber. We make that our current
     // first sequencenumber and then we can _finally_ drop
@@ -231,28 +267,24 @@ void udpsreader_bh(outq_type<block>* outq, sync_type< sync_type<fdreaderargs> >*
     // HV: 9 Jul 2012 - in order to prevent flooding we will
     //     have to send UDP backtraffic every now and then
     //     (such that network equipment between the scope and
-    //     us does not forget our ARP entry). So we peek at the
-    //     sequencenumber and at the same time record who's sending
-    //     to us
-#if 0
-    ssize_t   n_read;
-    while( (n_read=::recvfrom(network->fd, &seqnr, sizeof(seqnr), MSG_PEEK, (struct sockaddr*)&sender, &slen))!=sizeof(seqnr) ) {
-DEBUG(-1,"udpsreader_bh: n_read=" << n_read << std::endl);
-        ASSERT2_POS(n_read,
-                   SCINFO("udpsreader_bh: cancelled before beginning");
-                   delete[] dummybuf; delete[] workbuf; SYNCEXEC(args, delete network->threadid; network->threadid = 0));
-    }
-#endif
-#if 1
+    //     us does not forget our ARP entry). So we record who's
+    //     sending to us.
+    //     The first datagram always goes into the staging buffer
+    //     since we don't know where it should go yet.
     ssize_t nrec;
-    if( (nrec=::recvfrom(network->fd, &seqnr, sizeof(seqnr), MSG_PEEK|MSG_WAITALL, (struct sockaddr*)&sender, &slen))!=sizeof(seqnr) ) {
+    msg.msg_name    = (void*)&sender;
+    msg.msg_namelen = slen;
+    nrec            = xdp_or_sok_recvmsg(xsk, network->fd, &msg, MSG_WAITALL);
+    msg.msg_name    = 0;
+    msg.msg_namelen = 0;
+    if( nrec!=waitallread ) {
+        delete xsk;
         delete [] dummybuf;
         delete [] workbuf;
         SYNCEXEC(args, delete network->threadid; network->threadid = 0);
-        DEBUG(-1, "udpsreader_bh: cancelled waiting for first frame " << "nrec:" << nrec << " (ask:" << sizeof(seqnr) << ")" << std::endl);
+        DEBUG(-1, "udpsreader_bh: cancelled waiting for first frame " << "nrec:" << nrec << " (ask:" << waitallread << ")" << std::endl);
         return;
     }
-#endif
     lastack = 0;                    // trigger immediate ack send
     oldack  = netparms_type::defACK;// will be updated if value changed from default
 
@@ -269,6 +301,19 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
     // Drop into our tight inner loop
     done = false;
     do {
+        // The datagram we just received is at iov[1].iov_base.
+        // If that is the slot for 'predseqnr' and that's what we got,
+        // it's already where it should be.
+        // Otherwise make sure it is in the staging buffer - if the window
+        // must be advanced the block containing the predicted slot may
+        // be sent downstream before we get to copying it.
+        rxts.packet(msg, iov[1].iov_base, arrival);
+
+        const bool  inplace = (iov[1].iov_base!=dummybuf && seqnr==predseqnr);
+
+        if( !inplace && iov[1].iov_base!=dummybuf )
+            ::memcpy(dummybuf, iov[1].iov_base, rd_size);
+
         // When receiving FiLa10G data across scan boundaries the 
         // sequence number will drop back to 0. So we're going to
         // build a heuristic that sais: if we receive a sequence number
@@ -354,6 +399,7 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
                         pktidx<n_dg_p_block;
                         pktidx++, flagptr++)
                             if( *flagptr ) disccnt++, *flagptr=0;
+            flagptr = 0;
             DEBUG(-1, "udpsreader_bh: resynced data stream! " << disccnt-old_disccnt << " packets discarded" << std::endl);
         }
 
@@ -374,39 +420,45 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
         //       checked that seqnr >= firstseqnr
         //       (a condition signalled by location==0 since
         //        location!=0 => seqnr < firstseqnr)
+        // If the datagram was received in place, we know where it is.
+        if( inplace ) {
+            seqoff   = seqnr - firstseqnr;
+            location = iov[1].iov_base;
+            flagptr  = (unsigned char*)WORKBUF(seqoff/n_dg_p_block).iov_base + blocksize + seqoff%n_dg_p_block;
+        }
         shiftcount = 0;
         while( location==0 ) {
             seqoff   = seqnr - firstseqnr;
             blockidx = seqoff/n_dg_p_block;
 
             if( blockidx<readahead ) {
+                block&  b( WORKBUF(blockidx) );
+
                 pktidx = seqoff%n_dg_p_block;
 
                 // ok we know in which block to put our datagram
                 // make sure the block is non-empty
-                if( workbuf[blockidx].empty() ) {
-                    workbuf[blockidx] = network->pool->get();
+                if( b.empty() ) {
+                    b = network->pool->get();
                     // set all flags to 0 - no pkts in buffer yet
-                    ::memset((unsigned char*)workbuf[blockidx].iov_base + blocksize, 0x0, n_dg_p_block);
+                    ::memset((unsigned char*)b.iov_base + blocksize, 0x0, n_dg_p_block);
                 }
                 // compute location inside block
-                location = (unsigned char*)workbuf[blockidx].iov_base + pktidx*wr_size;
-                flagptr  = (unsigned char*)workbuf[blockidx].iov_base + blocksize + pktidx;
+                location = (unsigned char*)b.iov_base + pktidx*wr_size;
+                flagptr  = (unsigned char*)b.iov_base + blocksize + pktidx;
                 break;
             } 
             // Crap. sequence number would fall outside workbuf!
 
             // Release the first block in our workbuf.
-            if( !workbuf[0].empty() )
-                if( outq->push(workbuf[0])==false )
+            if( !WORKBUF(0).empty() )
+                if( outq->push(WORKBUF(0))==false )
                     break;
 
-            // Then shift all blocks down by one,
-            for(unsigned int i=1; i<readahead; i++)
-                workbuf[i-1] = workbuf[i];
-
-            // do not forget to clear the last position
-            workbuf[(readahead-1)] = block();
+            // Then advance the window by one block. The now-released
+            // position becomes the last one, it must be empty
+            WORKBUF(0) = block();
+            head       = (head + 1) % readahead;
 
             // Update loopvariables
             firstseqnr += n_dg_p_block;
@@ -421,56 +473,12 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
         if( location==0 )
             break;
 
-        // Our primary computations have been done and, what's most
-        // important, a location for the packet has been decided upon
-        // Read the pakkit into our mem'ry space before we do anything else
-        msg.msg_iovlen  = nwaitall;
-        iov[1].iov_base = location;
-        if( (r=::recvmsg(network->fd, &msg, MSG_WAITALL))!=(ssize_t)waitallread ) {
-            lastsyserror_type  lse;
-            std::ostringstream oss;
-
-            // Fix 1. Allow partial blocks to be sent downstream. In fact,
-            //        push all blocks from our workbuff that contain data
-            //        Full blocks [we check 'maxseqnr' for that] are pushed
-            //        always, partial blocks only if the
-            //        'allow_variable_block_size' is set
-            for(uint64_t i=0, blockseqnstart=firstseqnr; i<readahead && blockseqnstart<=maxseq; i++, blockseqnstart+=n_dg_p_block) {
-                const unsigned int sz = wr_size * (unsigned int)std::min(maxseq + 1 - blockseqnstart, (uint64_t)n_dg_p_block);
-
-                if( sz==blocksize || network->allow_variable_block_size )
-                    if( (done=(outq->push(workbuf[i].sub(0, sz))==false))==true )
-                        break;
-            }
-            // 1a.) Remove ourselves from the environment - our thread is going
-            // to be dead!
-            //
-            //     28Aug2015: I did some follow up. Apparently the Linux
-            //                b*stards interpret the POSIX standards
-            //                somewhat differently - to the point where they
-            //                feel that glibc's pthread_kill() on a thread-id that
-            //                referred to a valid thread but which is not
-            //                alive any more yields a SEGFAULT is
-            //                acceptable. Cf:
-            //                https://sourceware.org/bugzilla/show_bug.cgi?id=4509
-            //                Un-fucking-believable.
-            SYNCEXEC(args, delete network->threadid; network->threadid = 0);
-            // Fix 2. Do not throw on EINTR or EBADF; that is the normal way to
-            //        terminate the reader and should not warrant an
-            //        exception
-            if( lse.sys_errno==EINTR || lse.sys_errno==EBADF )
-                break;
-            // Wasn't EINTR/EBADF so now we must throw. Prepare stuff before
-            // actually doing that
-            // 2.) delete local buffers. In c++11 using unique_ptr this
-            // wouldnae be necessary
-            delete [] dummybuf;
-            delete [] workbuf;
-            oss << "::recvmsg(network->fd, &msg, MSG_WAITALL) fails - [" << lse << "] (ask:" << waitallread << " got:" << r << ")";
-            throw syscallexception(oss.str());
-        }
+        // Put the datagram where it belongs, if it isn't there already.
+        // Discarded datagrams stay in the staging buffer.
+        if( location!=iov[1].iov_base && location!=dummybuf )
+            ::memcpy(location, dummybuf, rd_size);
 
-        // Now that we've *really* read the pakkit we may update our
+        // Now the datagram is in our mem'ry space we may update our
         // read statistics 
         *flagptr       = 1;
         counter       += waitallread;
@@ -498,10 +506,27 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
             lastack--;
         }
 
+        // Predict where the next datagram should go: the position of the
+        // next expected sequence number, if that is inside the window
+        // [and we haven't got that one already - possible after a resync
+        // which doesn't reset 'expectseqnr' to a position we've seen].
+        // Otherwise receive it in the staging buffer.
+        predseqnr       = expectseqnr;
+        iov[1].iov_base = dummybuf;
+        if( predseqnr>=firstseqnr && (predseqnr-firstseqnr)/n_dg_p_block<readahead ) {
+            block&  b( WORKBUF((predseqnr-firstseqnr)/n_dg_p_block) );
+
+            pktidx = (predseqnr-firstseqnr)%n_dg_p_block;
+            if( b.empty() ) {
+                b = network->pool->get();
+                ::memset((unsigned char*)b.iov_base + blocksize, 0x0, n_dg_p_block);
+            }
+            if( ((unsigned char*)b.iov_base)[blocksize + pktidx]==0 )
+                iov[1].iov_base = (unsigned char*)b.iov_base + pktidx*wr_size;
+        }
+
         // Wait for another pakkit to come in. 
-        // When it does, take a peak at the sequencenr
-        msg.msg_iovlen = npeek;
-        if( (r=::recvmsg(network->fd, &msg, MSG_PEEK))!=peekread ) {
+        if( (r=xdp_or_sok_recvmsg(xsk, network->fd, &msg, MSG_WAITALL))!=(ssize_t)waitallread ) {
             lastsyserror_type  lse;
             std::ostringstream oss;
 
@@ -513,12 +538,15 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
             for(uint64_t i=0, blockseqnstart=firstseqnr; i<readahead && blockseqnstart<=maxseq; i++, blockseqnstart+=n_dg_p_block) {
                 const unsigned int sz = wr_size * (unsigned int)std::min(maxseq + 1 - blockseqnstart, (uint64_t)n_dg_p_block);
 
+                if( WORKBUF(i).empty() )
+                    continue;
                 if( sz==blocksize || network->allow_variable_block_size )
-                    if( (done=(outq->push(workbuf[i].sub(0, sz))==false))==true )
+                    if( (done=(outq->push(WORKBUF(i).sub(0, sz))==false))==true )
                         break;
             }
             // 1a.) Remove ourselves from the environment - our thread is going
             // to be dead!
+            //
             //     28Aug2015: I did some follow up. Apparently the Linux
             //                b*stards interpret the POSIX standards
             //                somewhat differently - to the point where they
@@ -538,9 +566,10 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
             // actually doing that
             // 2.) delete local buffers. In c++11 using unique_ptr this
             // wouldnae be necessary
+            delete xsk;
             delete [] dummybuf;
             delete [] workbuf;
-            oss << "::recvmsg(network->fd, &msg, MSG_PEEK) fails - [" << lse << "] (ask:" << peekread << " got:" << r << ")";;
+            oss << "::recvmsg(network->fd, &msg, MSG_WAITALL) fails - [" << lse << "] (ask:" << waitallread << " got:" << r << ")";
             throw syscallexception(oss.str());
         }
 #ifdef FILA
@@ -548,8 +577,13 @@ seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
 seqnr = (uint64_t)(*((uint32_t*)(((unsigned char*)iov[0].iov_base)+4)));
 #endif
     } while( !done );
+#undef WORKBUF
 
     // Clean up
+    if( xsk ) {
+        DEBUG(0, "udpsreader_bh: AF_XDP " << xsk->mode() << " dropped " << xsk->rx_dropped() << " packets" << std::endl);
+    }
+    delete xsk;
     delete [] dummybuf;
     delete [] workbuf;
     SYNCEXEC(args, delete network->threadid; network->threadid = 0);
@@ -38,7 +38,7 @@ bool fromfile(transfer_type tt) {
 
 bool tofile(transfer_type tt) {
     static transfer_type transfers[] = { disk2file, in2file, net2file, fill2file, spill2file, spif2file, spbs2file,
-                                         splet2file, spin2file, spid2file, mem2file, net2vbs, fill2vbs, vbsrecord, mem2vbs };
+                                         splet2file, spin2file, spid2file, mem2file, net2vbs, fill2vbs, vbsrecord, mem2vbs, ring2vbs };
     return find_element(tt, transfers);
 }
 
@@ -96,7 +96,7 @@ bool fromvbs(transfer_type tt) {
 }
 
 bool tovbs(transfer_type tt) {
-    static transfer_type transfers[] = { fill2vbs, vbsrecord, net2vbs, mem2vbs };
+    static transfer_type transfers[] = { fill2vbs, vbsrecord, net2vbs, mem2vbs, ring2vbs };
     return find_element(tt, transfers);
 }
 
@@ -175,6 +175,7 @@ transfer_type string2transfermode(const string& s ) {
         TT(net2vbs),
         TT(vbsrecord),
         TT(mem2vbs),
+        TT(ring2vbs),
         TT(tvr),
         TT(compute_trackmask),
         TT(condition),
@@ -367,6 +368,7 @@ ostream& operator<<(ostream& os, const transfer_type& tt) {
         KEES(os, net2vbs);
         KEES(os, vbsrecord);
         KEES(os, mem2vbs);
+        KEES(os, ring2vbs);
         KEES(os, tvr);
         KEES(os, compute_trackmask);
         KEES(os, condition);
@@ -58,6 +58,7 @@ enum transfer_type {
     in2mem, in2memfork, mem2net, mem2file, mem2sfxc, mem2time,
     net2mem,
     vbs2net, net2vbs, vbsrecord, mem2vbs, // vlbi_streamer mode (note: Mark5 'record' is 'in2disk')
+    ring2vbs,   // save a time window from the memory ring ("trigger")
     tvr,        // test vector recording by the Mk5B
     compute_trackmask,  // when the system is busy computing the track mask
     condition,  // when the system is conditioning
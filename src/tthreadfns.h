@@ -21,6 +21,7 @@
 #define JIVE5A_TTHREADFNS_H
 
 #include <map>
+#include <vector>
 #include <utility>
 #include <sys/uio.h>
 #include <sys/socket.h>
@@ -33,6 +34,7 @@
 #include <getsok_udt.h>
 #include <boyer_moore.h>
 #include <libudt5ab/udt.h>
+#include <threadfns/striping.h>
 
 
 
@@ -47,13 +49,23 @@
 //      "Mark IIIA/IV/VLBA Tape Formats, Recording Modes and Compatibility"
 //  * mark5b format as described in "Mark 5B User's manual", 8 August 2006 
 //      (http://www.haystack.mit.edu/tech/vlbi/mark5/docs/Mark%205B%20users%20manual.pdf)
-// Pushing tagged VDIF pushes with tag == thread_id!
-inline bool do_push(const frame& f, outq_type<tagged<frame> >* qptr) {
-    struct vdif_header const*  vhdr = reinterpret_cast<struct vdif_header const*>(f.framedata.iov_base);
-    return qptr->push( tagged<frame>( is_vdif(f.frametype) ? vhdr->thread_id : 0, f) );
+// The frame is 'h.framesize' bytes at 'offset' in 'b'.
+// Tagged VDIF frames are tagged with tag == thread_id!
+inline unsigned int frame_tag(const headersearch_type& h, const block& b, unsigned int offset) {
+    struct vdif_header const*  vhdr = reinterpret_cast<struct vdif_header const*>((unsigned char const*)b.iov_base + offset);
+    return is_vdif(h.frameformat) ? vhdr->thread_id : 0;
 }
-inline bool do_push(const frame& f, outq_type<frame>* qptr) {
-    return qptr->push( f );
+inline void do_append(std::vector<frame>& v, const headersearch_type& h, const block& b, unsigned int offset, const highrestime_type& ft) {
+    v.push_back( frame(h.frameformat, h.ntrack, ft, b.sub(offset, h.framesize)) );
+}
+inline void do_append(std::vector<tagged<frame> >& v, const headersearch_type& h, const block& b, unsigned int offset, const highrestime_type& ft) {
+    v.push_back( tagged<frame>(frame_tag(h, b, offset), frame(h.frameformat, h.ntrack, ft, b.sub(offset, h.framesize))) );
+}
+// All frames from the same block go into one batch
+inline void do_append(std::vector<framebatch>& v, const headersearch_type& h, const block& b, unsigned int offset, const highrestime_type& ft) {
+    if( v.empty() || v.back().data.iov_base!=b.iov_base )
+        v.push_back( framebatch(h.frameformat, h.ntrack, h.framesize, b) );
+    v.back().entries.push_back( framebatch::entry_type(offset, frame_tag(h, b, offset), ft) );
 }
 
 // counts how many syncwords of 0xffffff are following
@@ -67,18 +79,20 @@ inline unsigned int fpcount(void const * p, unsigned int bytes) {
 
 
 // The framer is templated on the actual output element type, it can be
-// either 'frame' or 'tagged<frame>'. The fun part is that the code can now
-// push either untagged or tagged frames.
-// It does this by delegating the actual "push()" on the outputqueue to a
-// freestanding function which looks at the type of the output queue and
+// 'frame', 'tagged<frame>' or 'framebatch'. The fun part is that the code
+// can now push untagged, tagged or batches of frames.
+// It does this by delegating the creation of the output element to a
+// freestanding function which looks at the type of the output elements and
 // does the right thing. It is a compiletime known function which is inlined
-// so it basically comes for free
+// so it basically comes for free.
+// All frames found in one input block are pushed downstream in one go.
 template <typename OutElement>
 void framer(inq_type<block>* inq, outq_type<OutElement>* outq, sync_type<framerargs>* args) {
     bool                stop;
     block               accublock;
     runtime*            rteptr;
     framerargs*         framer = args->userdata;
+    std::vector<OutElement> batch;
     headersearch_type   header         = framer->hdr;
     const unsigned int  syncword_area  = header.syncwordoffset + header.syncwordsize;
     // Searchvariables must be kept out of mainloop as we may need to
@@ -126,6 +140,13 @@ void framer(inq_type<block>* inq, outq_type<OutElement>* outq, sync_type<framera
     // off we go! 
     while( !stop ) {
         block b;
+        // Hand on the frames from the previous block before waiting for
+        // the next one
+        if( batch.size() ) {
+            if( (stop=(outq->push_n(batch)==false))==true )
+                break;
+            batch.clear();
+        }
         if ( !inq->pop(b) ) {
             break;
         }
@@ -176,13 +197,11 @@ void framer(inq_type<block>* inq, outq_type<OutElement>* outq, sync_type<framera
 
             if( bytes_to_next==0 ) {
                 // ok, we has a frames!
-                frame  f(header.frameformat, header.ntrack, accublock);
-
+                const highrestime_type  frametime = header.decode_timestamp(accubase, tm_decode_flg/*headersearch::chk_default*/, 0);
 
-                f.frametime   = header.decode_timestamp(accubase, tm_decode_flg/*headersearch::chk_default*/, 0);
-                // If valid frame, push & count it
-                if( f.frametime.tv_sec ) {
-                    stop          = (::do_push(f, outq)==false);
+                // If valid frame, queue & count it
+                if( frametime.tv_sec ) {
+                    ::do_append(batch, header, accublock, 0, frametime);
 
                     // update statistics!
                     counter      += header.framesize;
@@ -342,17 +361,11 @@ void framer(inq_type<block>* inq, outq_type<OutElement>* outq, sync_type<framera
             }
 
             // Sweet! We has a frames!
-            block   fblock = b.sub((sof - base_ptr), header.framesize);
-            frame   f(header.frameformat, header.ntrack, fblock);
-
-            f.frametime   = header.decode_timestamp(sof, tm_decode_flg/*headersearch::chk_default*/, 0);
+            const highrestime_type  frametime = header.decode_timestamp(sof, tm_decode_flg/*headersearch::chk_default*/, 0);
 
             // Only attempt to pass on valid frames
-            if( f.frametime.tv_sec ) {
-                // Fail to push downstream means: quit!
-                //if( (stop=(outq->push(f)==false))==true )
-                if( (stop=(::do_push(f, outq)==false))==true )
-                    break;
+            if( frametime.tv_sec ) {
+                ::do_append(batch, header, b, (unsigned int)(sof - base_ptr), frametime);
                 // update statistics!
                 counter += header.framesize;
                 // chalk up one more frame.
@@ -363,6 +376,9 @@ void framer(inq_type<block>* inq, outq_type<OutElement>* outq, sync_type<framera
             ptr = const_cast<unsigned char*>(sof) + header.framesize;
         } // done processing block
     }
+    // Input ended; don't forget what we found in the last block
+    if( !stop && batch.size() )
+        outq->push_n(batch);
     // we take it that if nBytes==0ULL => nFrames==0ULL (...)
     // so the fraction would come out to be 0/1.0 = 0 rather than
     // a divide-by-zero exception.
@@ -1087,6 +1103,140 @@ void udpwriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
     network->finished = true;
 }
 
+// Write elements striped over netparms.nstripe TCP connections ("mtcp").
+// The connection set up by net_client() is stripe #0, the other ones are
+// opened here. Each connection is served by its own thread, elements are
+// dealt out round-robin, tagged with a sequence number (see
+// threadfns/striping.h for the wire format). A single slow flow therefore
+// only holds up the transfer once its own queue is full.
+template <typename T>
+void stripedwriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
+    typedef std::vector<int>                 fd_list_type;
+    typedef std::vector<pthread_t>           thread_list_type;
+    typedef std::vector<stripe_queue_type*>  queue_list_type;
+    typedef std::vector<stripe_sender_args>  sender_list_type;
+
+    bool                stop = false;
+    runtime*            rteptr;
+    uint64_t            seqnr = 0, nbyte = 0;
+    fdreaderargs*       network = args->userdata;
+    const unsigned int  nstripe = network->netparms.nstripe;
+    fd_list_type        fds( nstripe, -1 );
+    queue_list_type     queues;
+    thread_list_type    tids;
+    sender_list_type    senders( nstripe );
+
+    rteptr = network->rteptr;
+    ASSERT_COND(rteptr!=0);
+    EZASSERT2(nstripe>0, stripeexception, EZINFO("cannot stripe over " << nstripe << " connections"));
+
+    install_zig_for_this_thread(SIGUSR1);
+    SYNCEXEC(args,
+             stop              = args->cancelled;
+             delete network->threadid;
+             network->threadid = new pthread_t(::pthread_self()));
+
+    RTEEXEC(*rteptr,
+            rteptr->transfersubmode.set(connected_flag);
+            rteptr->statistics.init(args->stepid, "StripedWrite"));
+    counter_type&  counter = rteptr->statistics.counter(args->stepid);
+
+    if( stop ) {
+        DEBUG(0, "stripedwriter: got stopsignal before actually starting" << std::endl);
+        SYNCEXEC(args, delete network->threadid; network->threadid=0);
+        return;
+    }
+
+    // Identify stripe #0 and open + identify the other ones
+    fds[0] = network->fd;
+    try {
+        stripe_hello_type  hello(nstripe, 0);
+        struct iovec       iov;
+
+        iov.iov_base = &hello;
+        iov.iov_len  = sizeof(hello);
+        ASSERT2_COND( stripe_writev(fds[0], &iov, 1), SCINFO("stripe 0/" << nstripe << " failed to send hello") );
+        for(unsigned int s=1; s<nstripe; s++)
+            fds[s] = stripe_connect(network->netparms, nstripe, s);
+    }
+    catch( ... ) {
+        for(unsigned int s=1; s<nstripe; s++)
+            if( fds[s]!=-1 )
+                ::close(fds[s]);
+        SYNCEXEC(args, delete network->threadid; network->threadid=0);
+        throw;
+    }
+    DEBUG(0, "stripedwriter: writing to " << network->netparms.get_host() << ":" << network->netparms.get_port()
+             << " over " << nstripe << " connections" << std::endl);
+
+    // Start the senders, make sure they get signalled when we're cancelled
+    for(unsigned int s=0; s<nstripe; s++) {
+        pthread_t  tid;
+
+        queues.push_back( new stripe_queue_type(4) );
+        senders[s].fd      = fds[s];
+        senders[s].rteptr  = rteptr;
+        senders[s].counter = &counter;
+        senders[s].queue   = queues[s];
+        PTHREAD_CALL( ::pthread_create(&tid, 0, &stripe_sender, (void*)&senders[s]) );
+        tids.push_back( tid );
+    }
+    SYNCEXEC(args,
+             stop = args->cancelled;
+             network->threads.insert(tids.begin(), tids.end()));
+
+    // Deal out the elements
+    while( !stop ) {
+        T  b;
+        if( !inq->pop(b) )
+            break;
+        stripe_job_type  job( seqnr );
+
+        for(typename T::const_iterator bptr=b.begin(); bptr!=b.end(); bptr++)
+            job.blocks.push_back( *bptr );
+        if( queues[seqnr % nstripe]->push(job)==false ) {
+            DEBUG(-1, "stripedwriter: sender for stripe " << (seqnr % nstripe) << " has stopped" << std::endl);
+            break;
+        }
+        seqnr++;
+    }
+
+    // Let the senders finish what they've got queued and wait for them
+    for(unsigned int s=0; s<nstripe; s++)
+        queues[s]->delayed_disable();
+    for(unsigned int s=0; s<nstripe; s++) {
+        PTHREAD_CALL( ::pthread_join(tids[s], 0) );
+        nbyte += senders[s].nbyte;
+        delete queues[s];
+    }
+    SYNCEXEC(args,
+             for(unsigned int s=0; s<nstripe; s++)
+                network->threads.erase(tids[s]));
+
+    // As fdwriter: signal we're done writing and wait for the remote
+    // end to close. The receiver only closes after it has seen the end of
+    // *all* stripes so first shut them all down.
+    // Stripe #0 gets closed by whoever opened it
+    std::vector<bool>  shut( nstripe, false );
+
+    for(unsigned int s=0; s<nstripe; s++)
+        shut[s] = (::shutdown(fds[s], SHUT_WR)==0);
+    for(unsigned int s=0; s<nstripe; s++) {
+        if( shut[s] ) {
+            char    c;
+            if( ::read(fds[s], &c, 1) ) {}
+        }
+        if( s>0 )
+            ::close(fds[s]);
+    }
+    SYNCEXEC(args, delete network->threadid; network->threadid = 0);
+
+    DEBUG(0, "stripedwriter: stopping. wrote " << seqnr << " elements, "
+             << nbyte << " (" << byteprint((double)nbyte,"byte") << ")"
+             << std::endl);
+    network->finished = true;
+}
+
 // Highlevel networkwriter interface. Does the accepting if necessary
 // and delegates to either the generic filedescriptorwriter or the udp-smart
 // writer, depending on the actual protocol
@@ -1187,6 +1337,8 @@ void netwriter(inq_type<T>* inq, sync_type<fdreaderargs>* args) {
         ::udpwriter<T>(inq, args);
     else if( proto=="udt" )
         ::udtwriter<T>(inq, args);
+    else if( proto=="mtcp" )
+        ::stripedwriter<T>(inq, args);
     else if( proto=="itcp" ) {
         // write the itcp id into the stream before falling to the normal
         // tcp writer
@@ -1229,12 +1381,16 @@ struct dst_state_type {
     inq_type<T>*             iq_ptr;
     outq_type<T>*            oq_ptr;
     sync_type<fdreaderargs>* st_ptr;
+    // only used by the multiwriter in fanout.drop mode
+    uint64_t                 ndrop;
+    bool                     gone;
 
     dst_state_type( unsigned int qd ) :
         actual_q_ptr( new bqueue<T>(qd) ),
         iq_ptr( new inq_type<T>(actual_q_ptr) ),
         oq_ptr( new outq_type<T>(actual_q_ptr) ),
-        st_ptr( new sync_type<fdreaderargs>(&cond, &mtx) ) {
+        st_ptr( new sync_type<fdreaderargs>(&cond, &mtx) ),
+        ndrop( 0 ), gone( false ) {
             PTHREAD_CALL( ::pthread_mutex_init(&mtx, 0) );
             PTHREAD_CALL( ::pthread_cond_init(&cond, 0) );
         }
@@ -1351,11 +1507,13 @@ void multiwriter( inq_type<tagged<T> >* inq, sync_type<multifdargs>* args) {
     fd_thread_map_type      fd_thread_map;
     tag_state_map_type      tag_state_map;
     const dest_fd_map_type& dst_fd_map( args->userdata->dstfdmap );
+    const fanout_type       fanout( args->userdata->fanout );
 
     // Make sure there are filedescriptors to write to
     ASSERT2_COND(dst_fd_map.size()>0, SCINFO("There are no destinations to send to"));
 
-    DEBUG(2, "[" << ::pthread_self() << "] " << "multiwriter starting" << std::endl);
+    DEBUG(2, "[" << ::pthread_self() << "] " << "multiwriter starting, qdepth " << fanout.qdepth
+             << (fanout.drop ? ", dropping data for slow destinations" : "") << std::endl);
 
     // So, for each destination in the destination-to-filedescriptor mapping
     // we check if we already have a netwriterthread for that
@@ -1385,7 +1543,7 @@ void multiwriter( inq_type<tagged<T> >* inq, sync_type<multifdargs>* args) {
                 fdreaderargs*                                         userdata = 0;
                 std::pair<typename fd_state_map_type::iterator, bool> insres;
 
-                insres = fd_state_map.insert( std::make_pair(cd->second, new dst_state_type<T>(10)) );
+                insres = fd_state_map.insert( std::make_pair(cd->second, new dst_state_type<T>(fanout.qdepth)) );
                 ASSERT2_COND(insres.second, SCINFO("Failed to insert fd->dst_state_type* entry into map"));
 
                 // insres->first is 'pointer to fd_state_map iterator'
@@ -1405,7 +1563,7 @@ void multiwriter( inq_type<tagged<T> >* inq, sync_type<multifdargs>* args) {
 
                 // copy pointer to the state for this thread
                 stateptr->st_ptr->userdata = userdata;
-                stateptr->st_ptr->setqdepth(10);
+                stateptr->st_ptr->setqdepth(fanout.qdepth);
                 stateptr->st_ptr->setstepid(args->stepid);
 
                 // allocate a threadid
@@ -1437,6 +1595,8 @@ void multiwriter( inq_type<tagged<T> >* inq, sync_type<multifdargs>* args) {
 
     // We have now spawned a number of threads: one per destination
     // We pop everything from our inputqueue
+    typename fd_state_map_type::size_type  nactive = fd_state_map.size();
+
     while( inq->pop(tb) ) {
         // for each tagged block find out where it has to go
         typename tag_state_map_type::const_iterator curdest = tag_state_map.find(tb.tag);
@@ -1445,10 +1605,34 @@ void multiwriter( inq_type<tagged<T> >* inq, sync_type<multifdargs>* args) {
         if( curdest==tag_state_map.end() )
             continue;
 
-        // Configured destination that we fail to send to = AAARGH!
-        if( curdest->second->oq_ptr->push(tb.item)==false ) {
-            DEBUG(-1, "multiwriter: tag " << tb.tag << " failed to push block to it!" << std::endl);
-            break;
+        dst_state_type<T>*  dst = curdest->second;
+
+        if( !fanout.drop ) {
+            // Configured destination that we fail to send to = AAARGH!
+            if( dst->oq_ptr->push(tb.item)==false ) {
+                DEBUG(-1, "multiwriter: tag " << tb.tag << " failed to push block to it!" << std::endl);
+                break;
+            }
+            continue;
+        }
+
+        // Never wait for a destination; the others would have to wait too
+        if( dst->gone )
+            continue;
+
+        const push_result_type  pr = dst->oq_ptr->try_push(tb.item);
+
+        if( pr==push_overflow ) {
+            if( dst->ndrop++==0 )
+                DEBUG(-1, "multiwriter: fd#" << dst->st_ptr->userdata->fd << " cannot keep up, dropping data for it" << std::endl);
+            SYNCEXEC(args, args->userdata->ndropped++);
+        } else if( pr==push_disabled ) {
+            DEBUG(-1, "multiwriter: fd#" << dst->st_ptr->userdata->fd << " (tag " << tb.tag << ") has gone away" << std::endl);
+            dst->gone = true;
+            if( --nactive==0 ) {
+                DEBUG(-1, "multiwriter: all destinations have gone away" << std::endl);
+                break;
+            }
         }
     }
     // Start signalling spawned threads that it's time to stop
@@ -1477,6 +1661,9 @@ void multiwriter( inq_type<tagged<T> >* inq, sync_type<multifdargs>* args) {
             // Now we can join
             PTHREAD_CALL( ::pthread_join(tidptr->second, 0) );
 
+            if( cd->second->ndrop )
+                DEBUG(-1, "multiwriter: fd#" << cd->first << " dropped " << cd->second->ndrop << " entries" << std::endl);
+
             // only now it's safe to delete resources
             delete cd->second;
     }
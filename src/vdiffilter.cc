@@ -0,0 +1,212 @@
+// select VDIF frames by thread, station and time, fast
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <vdiffilter.h>
+#include <dotzooi.h>      // parse_vex_time()
+
+#include <algorithm>
+#include <limits>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+using namespace std;
+
+DEFINE_EZEXCEPT(vdiffilterexception)
+
+
+namespace {
+    // VDIF epoch seconds are 30 bits
+    const int64_t   maxEpochSeconds = ((int64_t)1 << 30);
+
+    unsigned long int parse_thread_id(const string& s) {
+        char*              eocptr;
+        unsigned long int  tid;
+
+        errno = 0;
+        tid   = ::strtoul(s.c_str(), &eocptr, 10);
+        EZASSERT2(!s.empty() && ::isdigit(s[0]) && *eocptr=='\0' && errno!=ERANGE && tid<1024, vdiffilterexception,
+                  EZINFO("thread id '" << s << "' is not a number in the range 0-1023"));
+        return tid;
+    }
+
+    // Returns the time in seconds. Fields missing at the big end of the
+    // VEX time are taken from the current time
+    time_t parse_time(const string& s) {
+        struct tm     tm;
+        time_t        now = ::time(0);
+        unsigned int  microseconds = 0;
+
+        ::gmtime_r(&now, &tm);
+        EZASSERT2(::parse_vex_time(s, tm, microseconds)>0, vdiffilterexception,
+                  EZINFO("time '" << s << "' is not a VEX time"));
+        const time_t  t = ::mktime(&tm);
+        EZASSERT2(t!=(time_t)-1, vdiffilterexception, EZINFO("time '" << s << "' cannot be represented"));
+        return t;
+    }
+
+    // The start of VDIF reference epoch 'e'
+    time_t epoch_start(unsigned int e) {
+        struct tm   tm;
+
+        ::memset(&tm, 0, sizeof(tm));
+        tm.tm_mday = 1;
+        tm.tm_year = 100 + (int)(e/2);
+        tm.tm_mon  = 6 * (int)(e%2);
+        return ::mktime(&tm);
+    }
+}
+
+
+vdiffilter_stats_type::vdiffilter_stats_type():
+    pass( 0 ), thread( 0 ), station( 0 ), time( 0 )
+{}
+
+
+vdiffilter_type::vdiffilter_type() {
+    this->pass_all();
+}
+
+vdiffilter_type::vdiffilter_type(const string& threads, const string& station,
+                                 const string& start, const string& end) {
+    this->pass_all();
+
+    // Threads
+    if( !(threads.empty() || threads=="*") ) {
+        string::size_type  pos = 0;
+
+        std::fill(&threadbits[0], &threadbits[nThreadId/64], (uint64_t)0);
+        while( pos<=threads.size() ) {
+            const string::size_type  comma = std::min(threads.find(',', pos), threads.size());
+            const string             item( threads.substr(pos, comma-pos) );
+            const string::size_type  dash = item.find('-');
+            const unsigned long int  lo = parse_thread_id( item.substr(0, dash) );
+            const unsigned long int  hi = (dash==string::npos) ? lo : parse_thread_id( item.substr(dash+1) );
+
+            EZASSERT2(lo<=hi, vdiffilterexception, EZINFO("thread id range '" << item << "' is empty"));
+            for(unsigned long int t=lo; t<=hi; t++)
+                threadbits[t >> 6] |= ((uint64_t)1 << (t & 0x3f));
+            pos = comma + 1;
+        }
+        threadsActive = true;
+    }
+
+    // Station
+    if( !(station.empty() || station=="*") ) {
+        if( station.size()>2 && station.substr(0, 2)=="0x" ) {
+            char*              eocptr;
+            unsigned long int  id;
+
+            errno = 0;
+            id    = ::strtoul(station.c_str()+2, &eocptr, 16);
+            EZASSERT2(*eocptr=='\0' && errno!=ERANGE && id<=0xffff, vdiffilterexception,
+                      EZINFO("station id '" << station << "' is not a number in the range 0x0-0xffff"));
+            stationmask  = 0xffff;
+            stationvalue = (uint16_t)id;
+        } else {
+            EZASSERT2(station.size()<=2 && ::isalpha(station[0]) && (station.size()==1 || ::isalpha(station[1])),
+                      vdiffilterexception, EZINFO("station '" << station << "' is not a one or two character station code"));
+            // The first character of the station code is in the upper
+            // byte; a one character code only matches that one
+            stationmask  = (station.size()==1 ? 0xff00 : 0xffff);
+            stationvalue = (uint16_t)( ((unsigned int)(unsigned char)station[0] << 8) |
+                                       (station.size()==1 ? 0 : (unsigned int)(unsigned char)station[1]) );
+        }
+        stationActive = true;
+    }
+
+    // Time range
+    if( !(start.empty() && end.empty()) ) {
+        const time_t  t0 = (start.empty() ? std::numeric_limits<time_t>::min() : parse_time(start));
+        const time_t  t1 = (end.empty()   ? std::numeric_limits<time_t>::max() : parse_time(end));
+
+        EZASSERT2(t0<t1, vdiffilterexception, EZINFO("time range " << start << " - " << end << " is empty"));
+
+        // Translate into ranges of epoch seconds for each reference epoch
+        for(unsigned int e=0; e<nEpoch; e++) {
+            const time_t   te = epoch_start(e);
+            const int64_t  lo = (start.empty() ? 0 : std::max((int64_t)0, std::min((int64_t)(t0 - te), maxEpochSeconds)));
+            const int64_t  hi = (end.empty() ? maxEpochSeconds : std::max((int64_t)0, std::min((int64_t)(t1 - te), maxEpochSeconds)));
+
+            seconds_lo[e] = (uint32_t)lo;
+            seconds_n[e]  = (uint32_t)(hi - lo);
+        }
+        timeActive = true;
+    }
+
+    threadsTxt = threads;
+    stationTxt = station;
+    startTxt   = start;
+    endTxt     = end;
+}
+
+bool vdiffilter_type::active( void ) const {
+    return threadsActive || stationActive || timeActive;
+}
+
+const string& vdiffilter_type::threads_text( void ) const {
+    return threadsTxt;
+}
+const string& vdiffilter_type::station_text( void ) const {
+    return stationTxt;
+}
+const string& vdiffilter_type::start_text( void ) const {
+    return startTxt;
+}
+const string& vdiffilter_type::end_text( void ) const {
+    return endTxt;
+}
+
+size_t vdiffilter_type::tally(const unsigned char* verdicts, size_t n, vdiffilter_stats_type& stats) const {
+    // One counter per possible verdict
+    uint64_t  histogram[ (thread_reason|station_reason|time_reason) + 1 ];
+
+    std::fill(&histogram[0], &histogram[sizeof(histogram)/sizeof(histogram[0])], (uint64_t)0);
+    for(size_t i=0; i<n; i++)
+        histogram[ verdicts[i] ]++;
+
+    stats.pass += histogram[ pass_reason ];
+    for(unsigned int v=1; v<sizeof(histogram)/sizeof(histogram[0]); v++)
+        if( histogram[v] )
+            count(v, histogram[v], stats);
+    return histogram[ pass_reason ];
+}
+
+void vdiffilter_type::pass_all( void ) {
+    std::fill(&threadbits[0], &threadbits[nThreadId/64], ~(uint64_t)0);
+    stationmask  = 0;
+    stationvalue = 0;
+    std::fill(&seconds_lo[0], &seconds_lo[nEpoch], (uint32_t)0);
+    std::fill(&seconds_n[0], &seconds_n[nEpoch], (uint32_t)maxEpochSeconds);
+    threadsActive = stationActive = timeActive = false;
+}
+
+void vdiffilter_type::count(unsigned int v, uint64_t n, vdiffilter_stats_type& stats) const {
+    if( v & thread_reason )
+        stats.thread += n;
+    else if( v & station_reason )
+        stats.station += n;
+    else if( v & time_reason )
+        stats.time += n;
+    else
+        stats.pass += n;
+}
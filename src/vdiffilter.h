@@ -0,0 +1,143 @@
+// select VDIF frames by thread, station and time, fast
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_VDIFFILTER_H
+#define JIVE5A_VDIFFILTER_H
+
+#include <ezexcept.h>
+#include <counter.h>
+#include <headersearch.h>
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+DECLARE_EZEXCEPT(vdiffilterexception)
+
+
+// What the filter did; reset at the start of each transfer that uses it.
+// A frame that fails more than one test is counted under the first one
+// that it fails, in the order thread, station, time.
+struct vdiffilter_stats_type {
+    ucounter_type   pass;
+    ucounter_type   thread;
+    ucounter_type   station;
+    ucounter_type   time;
+
+    vdiffilter_stats_type();
+};
+
+
+// The filter is compiled from its text form ("vdif_filter=") into a bitset
+// over all 1024 VDIF thread ids, a mask/value pair for the station and
+// per VDIF reference epoch the accepted range of epoch seconds. Deciding on
+// a frame then is a handful of integer operations without branches, cheap
+// enough to be done on each packet as it comes in from the network.
+//
+// Tests that were not asked for always pass.
+class vdiffilter_type {
+    public:
+        // bits in the verdict
+        enum reason_type {
+            pass_reason = 0x0, thread_reason = 0x1, station_reason = 0x2, time_reason = 0x4
+        };
+
+        // Lets all frames through
+        vdiffilter_type();
+
+        // threads: "*" or comma separated list of thread ids or ranges of
+        //          thread ids, eg "0,2,4-7"
+        // station: "*" or one or two character station code or numeric
+        //          station id "0xNNNN"
+        // start, end: VEX time "[<n>y][<n>d][<n>h][<n>m]<n>s" or empty;
+        //          accept frames with start <= time < end
+        // Empty strings mean: don't test. Throws vdiffilterexception on
+        // invalid input.
+        vdiffilter_type(const std::string& threads, const std::string& station,
+                        const std::string& start, const std::string& end);
+
+        // true if any of the tests is enabled
+        bool active( void ) const;
+
+        // the text forms as given to the c'tor
+        const std::string& threads_text( void ) const;
+        const std::string& station_text( void ) const;
+        const std::string& start_text( void ) const;
+        const std::string& end_text( void ) const;
+
+        // Returns pass_reason (=0) if the frame is accepted, otherwise the
+        // bitwise OR of the reasons for rejecting it
+        inline unsigned int verdict(const struct vdif_header& h) const {
+            const unsigned int  tid = h.thread_id;
+            const unsigned int  e   = h.ref_epoch;
+            const uint32_t      s   = h.epoch_seconds;
+
+            return ((unsigned int)(~(threadbits[tid >> 6] >> (tid & 0x3f)) & 0x1) * thread_reason) |
+                   ((unsigned int)((h.station_id & stationmask)!=stationvalue) * station_reason) |
+                   // unsigned arithmetic does lo <= s < hi in one compare
+                   ((unsigned int)((uint32_t)(s - seconds_lo[e]) >= seconds_n[e]) * time_reason);
+        }
+
+        // Counts the verdict in the statistics, returns true if the frame
+        // was accepted
+        inline bool accept(const struct vdif_header& h, vdiffilter_stats_type& stats) const {
+            const unsigned int  v = verdict(h);
+
+            if( v==pass_reason )
+                stats.pass++;
+            else
+                count(v, 1, stats);
+            return v==pass_reason;
+        }
+
+        // Decide on a batch of frames, whose headers start at
+        // base + i->offset for i in [first, last). First all verdicts are
+        // computed into 'verdicts', which must have room for all of them,
+        // then they are counted. Returns the number of accepted frames.
+        template <typename Iter>
+        size_t verdict(const unsigned char* base, Iter first, Iter last,
+                       unsigned char* verdicts, vdiffilter_stats_type& stats) const {
+            unsigned char*  v = verdicts;
+
+            for( ; first!=last; first++, v++)
+                *v = (unsigned char)verdict( *(const struct vdif_header*)(base + first->offset) );
+            return tally(verdicts, (size_t)(v - verdicts), stats);
+        }
+
+    private:
+        static const unsigned int  nThreadId = 1024;  // VDIF thread id is 10 bits
+        static const unsigned int  nEpoch    = 64;    // VDIF ref epoch is 6 bits
+
+        uint64_t     threadbits[ nThreadId/64 ];
+        uint16_t     stationmask;
+        uint16_t     stationvalue;
+        // accepted epoch seconds per reference epoch are
+        // seconds_lo <= s < seconds_lo + seconds_n
+        uint32_t     seconds_lo[ nEpoch ];
+        uint32_t     seconds_n[ nEpoch ];
+        bool         threadsActive, stationActive, timeActive;
+
+        std::string  threadsTxt, stationTxt, startTxt, endTxt;
+
+        void   pass_all( void );
+        void   count(unsigned int v, uint64_t n, vdiffilter_stats_type& stats) const;
+        size_t tally(const unsigned char* verdicts, size_t n, vdiffilter_stats_type& stats) const;
+};
+
+#endif
@@ -0,0 +1,500 @@
+// kernel-bypass (AF_XDP) reception of UDP datagrams
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#include <xdpsocket.h>
+#include <evlbidebug.h>
+#include <threadutil.h>
+
+#include <sstream>
+
+#include <errno.h>
+
+DEFINE_EZEXCEPT(xdpexception)
+
+#if HAVE_AFXDP
+
+#include <dosyscall.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <string.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+
+// Older C libraries/kernel headers may not know about these yet
+#ifndef AF_XDP
+#define AF_XDP  44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+// multi-buffer (jumbo frames > one UMEM frame) support, Linux >= 6.6
+#ifndef XDP_USE_SG
+#define XDP_USE_SG    (1 << 4)
+#endif
+#ifndef XDP_PKT_CONTD
+#define XDP_PKT_CONTD (1 << 0)
+#endif
+
+using namespace std;
+
+// Ethernet + IPv4 w/o options + UDP
+static const unsigned int  udp_hdr_offset  = 14 + 20;
+static const unsigned int  udp_data_offset = udp_hdr_offset + 8;
+
+static int bpf(int cmd, union bpf_attr& attr) {
+    return (int)::syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+static struct bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    struct bpf_insn  rv;
+
+    rv.code    = code;
+    rv.dst_reg = (uint8_t)(dst & 0xf);
+    rv.src_reg = (uint8_t)(src & 0xf);
+    rv.off     = off;
+    rv.imm     = imm;
+    return rv;
+}
+
+// The XDP program. In pseudo-C:
+//
+//    if( data + 42 > data_end ||          // too short for eth + ip + udp
+//        eth->h_proto != htons(ETH_P_IP) ||
+//        ip->version_ihl != 0x45 ||         // v4, no options
+//        (ip->frag_off & htons(0x3fff)) ||  // fragments go to the kernel
+//        ip->protocol != IPPROTO_UDP ||
+//        udp->dest != htons(port) )
+//            return XDP_PASS;
+//    return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+static void xdp_program(vector<struct bpf_insn>& prog, int mapfd, unsigned short port) {
+    const int16_t  pass = 23;   // index of the "return XDP_PASS" instruction
+#define JUMP_TO_PASS(n)  (int16_t)(pass - ((n) + 1))
+
+    prog.clear();
+    /*  0 */ prog.push_back( insn(BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_6, BPF_REG_1, 0, 0) );
+    /*  1 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_2, BPF_REG_1, 0, 0) );
+    /*  2 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_3, BPF_REG_1, 4, 0) );
+    /*  3 */ prog.push_back( insn(BPF_ALU64|BPF_MOV|BPF_X, BPF_REG_4, BPF_REG_2, 0, 0) );
+    /*  4 */ prog.push_back( insn(BPF_ALU64|BPF_ADD|BPF_K, BPF_REG_4, 0, 0, (int32_t)udp_data_offset) );
+    /*  5 */ prog.push_back( insn(BPF_JMP|BPF_JGT|BPF_X, BPF_REG_4, BPF_REG_3, JUMP_TO_PASS(5), 0) );
+    /*  6 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, 12, 0) );
+    /*  7 */ prog.push_back( insn(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, JUMP_TO_PASS(7), htons(0x0800)) );
+    /*  8 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, 14, 0) );
+    /*  9 */ prog.push_back( insn(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, JUMP_TO_PASS(9), 0x45) );
+    /* 10 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, 20, 0) );
+    /* 11 */ prog.push_back( insn(BPF_ALU64|BPF_AND|BPF_K, BPF_REG_5, 0, 0, htons(0x3fff)) );
+    /* 12 */ prog.push_back( insn(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, JUMP_TO_PASS(12), 0) );
+    /* 13 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_B, BPF_REG_5, BPF_REG_2, 23, 0) );
+    /* 14 */ prog.push_back( insn(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, JUMP_TO_PASS(14), IPPROTO_UDP) );
+    /* 15 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_H, BPF_REG_5, BPF_REG_2, udp_hdr_offset + 2, 0) );
+    /* 16 */ prog.push_back( insn(BPF_JMP|BPF_JNE|BPF_K, BPF_REG_5, 0, JUMP_TO_PASS(16), htons(port)) );
+    /* 17 */ prog.push_back( insn(BPF_LDX|BPF_MEM|BPF_W, BPF_REG_2, BPF_REG_6, 16, 0) );
+    /* 18 */ prog.push_back( insn(BPF_LD|BPF_DW|BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, mapfd) );
+    /* 19 */ prog.push_back( insn(0, 0, 0, 0, 0) );
+    /* 20 */ prog.push_back( insn(BPF_ALU64|BPF_MOV|BPF_K, BPF_REG_3, 0, 0, XDP_PASS) );
+    /* 21 */ prog.push_back( insn(BPF_JMP|BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map) );
+    /* 22 */ prog.push_back( insn(BPF_JMP|BPF_EXIT, 0, 0, 0, 0) );
+    /* 23 */ prog.push_back( insn(BPF_ALU64|BPF_MOV|BPF_K, BPF_REG_0, 0, 0, XDP_PASS) );
+    /* 24 */ prog.push_back( insn(BPF_JMP|BPF_EXIT, 0, 0, 0, 0) );
+#undef JUMP_TO_PASS
+}
+
+// Memory ordering on the shared rings. The kernel side uses
+// smp_load_acquire/smp_store_release; a full barrier is more than enough
+static inline uint32_t load_acquire(uint32_t* p) {
+    const uint32_t  rv = *(volatile uint32_t*)p;
+    __sync_synchronize();
+    return rv;
+}
+static inline void store_release(uint32_t* p, uint32_t v) {
+    __sync_synchronize();
+    *(volatile uint32_t*)p = v;
+}
+
+
+xdpsocket_type::ring_type::ring_type():
+    mask( 0 ), size( 0 ), producer( 0 ), consumer( 0 ), flags( 0 ),
+    ring( 0 ), map( MAP_FAILED ), maplen( 0 )
+{}
+
+
+xdpsocket_type::xdpsocket_type(const string& ifname, unsigned int queue,
+                               unsigned short port, const string& m, int wfd):
+    xsk( -1 ), mapfd( -1 ), progfd( -1 ), linkfd( -1 ), watchfd( wfd ),
+    zerocopy( false ), skbmode( false ), multibuf( false ),
+    umem( (unsigned char*)MAP_FAILED ), umemlen( 0 ), rx_cached( 0 ), rx_avail( 0 )
+{
+    const unsigned int  ifindex = ::if_nametoindex(ifname.c_str());
+
+    EZASSERT2(ifindex>0, xdpexception, EZINFO("no such interface '" << ifname << "'"));
+    EZASSERT2(m=="auto" || m=="copy" || m=="zerocopy", xdpexception, EZINFO("unknown AF_XDP mode '" << m << "'"));
+
+    try {
+        // Our packet memory
+        umemlen = (size_t)nframe * frame_size;
+        umem    = (unsigned char*)::mmap(0, umemlen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        EZASSERT2(umem!=MAP_FAILED, xdpexception, EZINFO("failed to allocate " << umemlen << " bytes of UMEM - " << evlbi5a::strerror(errno)));
+
+        // The socket + register the memory and configure ring sizes
+        struct xdp_umem_reg  mr;
+        int                  nfill = (int)nframe, ncompl = 64, nrx = (int)(nframe/2);
+
+        ::memset(&mr, 0, sizeof(mr));
+        mr.addr       = (uint64_t)(unsigned long)umem;
+        mr.len        = umemlen;
+        mr.chunk_size = frame_size;
+
+        EZASSERT2((xsk=::socket(AF_XDP, SOCK_RAW, 0))!=-1, xdpexception,
+                  EZINFO("failed to create AF_XDP socket - " << evlbi5a::strerror(errno)));
+        EZASSERT2(::setsockopt(xsk, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr))==0, xdpexception,
+                  EZINFO("failed to register UMEM - " << evlbi5a::strerror(errno)));
+        EZASSERT2(::setsockopt(xsk, SOL_XDP, XDP_UMEM_FILL_RING, &nfill, sizeof(nfill))==0 &&
+                  ::setsockopt(xsk, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ncompl, sizeof(ncompl))==0 &&
+                  ::setsockopt(xsk, SOL_XDP, XDP_RX_RING, &nrx, sizeof(nrx))==0, xdpexception,
+                  EZINFO("failed to set ring sizes - " << evlbi5a::strerror(errno)));
+
+        // Map the rings
+        struct xdp_mmap_offsets  off;
+        socklen_t                optlen = sizeof(off);
+
+        EZASSERT2(::getsockopt(xsk, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen)==0, xdpexception,
+                  EZINFO("failed to get ring offsets - " << evlbi5a::strerror(errno)));
+
+        struct {
+            ring_type*                   ring;
+            const struct xdp_ring_offset* offset;
+            uint32_t                     n;
+            size_t                       elsize;
+            off_t                        pgoff;
+        } const rings[] = {
+            { &rx,         &off.rx, (uint32_t)nrx,    sizeof(struct xdp_desc), (off_t)XDP_PGOFF_RX_RING },
+            { &fill,       &off.fr, (uint32_t)nfill,  sizeof(uint64_t),        (off_t)XDP_UMEM_PGOFF_FILL_RING },
+            { &completion, &off.cr, (uint32_t)ncompl, sizeof(uint64_t),        (off_t)XDP_UMEM_PGOFF_COMPLETION_RING }
+        };
+        for(unsigned int i=0; i<sizeof(rings)/sizeof(rings[0]); i++) {
+            ring_type&  r( *rings[i].ring );
+
+            r.size   = rings[i].n;
+            r.mask   = r.size - 1;
+            r.maplen = rings[i].offset->desc + r.size * rings[i].elsize;
+            r.map    = ::mmap(0, r.maplen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, xsk, rings[i].pgoff);
+            EZASSERT2(r.map!=MAP_FAILED, xdpexception, EZINFO("failed to map ring #" << i << " - " << evlbi5a::strerror(errno)));
+            r.producer = (uint32_t*)((unsigned char*)r.map + rings[i].offset->producer);
+            r.consumer = (uint32_t*)((unsigned char*)r.map + rings[i].offset->consumer);
+            r.flags    = (uint32_t*)((unsigned char*)r.map + rings[i].offset->flags);
+            r.ring     = (void*)((unsigned char*)r.map + rings[i].offset->desc);
+        }
+
+        // Hand all frames to the kernel
+        for(uint32_t i=0; i<nframe; i++)
+            ((uint64_t*)fill.ring)[i & fill.mask] = (uint64_t)i * frame_size;
+        store_release(fill.producer, nframe);
+
+        // Bind to the interface's queue. Try the most capable
+        // configuration first
+        struct attempt_type {
+            uint16_t     flags;
+            bool         zc;
+        } const attempts[] = {
+            { XDP_ZEROCOPY|XDP_USE_NEED_WAKEUP|XDP_USE_SG, true },
+            { XDP_ZEROCOPY|XDP_USE_NEED_WAKEUP,            true },
+            { XDP_COPY|XDP_USE_NEED_WAKEUP|XDP_USE_SG,     false },
+            { XDP_COPY|XDP_USE_NEED_WAKEUP,                false }
+        };
+        int  bound = -1;
+
+        for(unsigned int i=0; bound==-1 && i<sizeof(attempts)/sizeof(attempts[0]); i++) {
+            struct sockaddr_xdp  sxdp;
+
+            if( (attempts[i].zc && m=="copy") || (!attempts[i].zc && m=="zerocopy") )
+                continue;
+            ::memset(&sxdp, 0, sizeof(sxdp));
+            sxdp.sxdp_family   = AF_XDP;
+            sxdp.sxdp_flags    = attempts[i].flags;
+            sxdp.sxdp_ifindex  = ifindex;
+            sxdp.sxdp_queue_id = queue;
+            if( ::bind(xsk, (const struct sockaddr*)&sxdp, sizeof(sxdp))==0 )
+                bound = (int)i;
+            else
+                DEBUG(3, "xdpsocket: bind " << ifname << "/" << queue << " flags=" << attempts[i].flags
+                         << " failed - " << evlbi5a::strerror(errno) << endl);
+        }
+        EZASSERT2(bound>=0, xdpexception, EZINFO("failed to bind AF_XDP socket to " << ifname << " queue " << queue
+                                                 << " in " << m << " mode - " << evlbi5a::strerror(errno)));
+        zerocopy = attempts[bound].zc;
+        multibuf = ((attempts[bound].flags & XDP_USE_SG)!=0);
+
+        // Create the map that the XDP program redirects through and put
+        // our socket in it
+        union bpf_attr  attr;
+        uint32_t        key = queue, value = (uint32_t)xsk;
+
+        ::memset(&attr, 0, sizeof(attr));
+        attr.map_type    = BPF_MAP_TYPE_XSKMAP;
+        attr.key_size    = sizeof(key);
+        attr.value_size  = sizeof(value);
+        attr.max_entries = queue + 1;
+        EZASSERT2((mapfd=bpf(BPF_MAP_CREATE, attr))>=0, xdpexception,
+                  EZINFO("failed to create XSKMAP - " << evlbi5a::strerror(errno)));
+
+        ::memset(&attr, 0, sizeof(attr));
+        attr.map_fd = (uint32_t)mapfd;
+        attr.key    = (uint64_t)(unsigned long)&key;
+        attr.value  = (uint64_t)(unsigned long)&value;
+        EZASSERT2(bpf(BPF_MAP_UPDATE_ELEM, attr)==0, xdpexception,
+                  EZINFO("failed to insert socket in XSKMAP - " << evlbi5a::strerror(errno)));
+
+        // Load the program
+        char                     license[] = "GPL";
+        char                     log[4096];
+        vector<struct bpf_insn>  prog;
+
+        xdp_program(prog, mapfd, port);
+        log[0] = '\0';
+        ::memset(&attr, 0, sizeof(attr));
+        attr.prog_type  = BPF_PROG_TYPE_XDP;
+        attr.insn_cnt   = (uint32_t)prog.size();
+        attr.insns      = (uint64_t)(unsigned long)&prog[0];
+        attr.license    = (uint64_t)(unsigned long)&license[0];
+        attr.log_buf    = (uint64_t)(unsigned long)&log[0];
+        attr.log_size   = sizeof(log);
+        attr.log_level  = 1;
+        attr.prog_flags = (multibuf ? BPF_F_XDP_HAS_FRAGS : 0);
+        EZASSERT2((progfd=bpf(BPF_PROG_LOAD, attr))>=0, xdpexception,
+                  EZINFO("failed to load XDP program - " << evlbi5a::strerror(errno) << " " << log));
+
+        // Attach it. Zero-copy requires the driver hook, for copy mode we
+        // fall back to the generic one
+        for(unsigned int i=0; linkfd<0 && i<2; i++) {
+            if( i==1 && zerocopy )
+                break;
+            ::memset(&attr, 0, sizeof(attr));
+            attr.link_create.prog_fd        = (uint32_t)progfd;
+            attr.link_create.target_ifindex = ifindex;
+            attr.link_create.attach_type    = BPF_XDP;
+            attr.link_create.flags          = (i==0 ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE);
+            if( (linkfd=bpf(BPF_LINK_CREATE, attr))<0 )
+                DEBUG(3, "xdpsocket: attach to " << ifname << " in " << (i==0 ? "drv" : "skb")
+                         << " mode failed - " << evlbi5a::strerror(errno) << endl);
+            skbmode = (i==1);
+        }
+        EZASSERT2(linkfd>=0, xdpexception, EZINFO("failed to attach XDP program to " << ifname << " - " << evlbi5a::strerror(errno)));
+    }
+    catch( ... ) {
+        cleanup();
+        throw;
+    }
+    DEBUG(1, "xdpsocket: " << ifname << "/" << queue << " port " << port << " mode " << this->mode() << endl);
+}
+
+string xdpsocket_type::mode( void ) const {
+    return string(zerocopy ? "zerocopy" : "copy") + (skbmode ? "/skb" : "/drv") + (multibuf ? "/sg" : "");
+}
+
+uint64_t xdpsocket_type::rx_dropped( void ) const {
+    struct xdp_statistics  st;
+    socklen_t              optlen = sizeof(st);
+
+    if( ::getsockopt(xsk, SOL_XDP, XDP_STATISTICS, &st, &optlen)!=0 )
+        return 0;
+    return st.rx_dropped + st.rx_ring_full + st.rx_invalid_descs;
+}
+
+// Make sure there is at least one complete datagram in the RX ring
+bool xdpsocket_type::wait_for_rx( void ) {
+    while( true ) {
+        struct xdp_desc const*  desc = (struct xdp_desc const*)rx.ring;
+
+        // Do we have a complete datagram? Fragments of a multi-buffer
+        // datagram are flagged with XDP_PKT_CONTD, except the last one
+        if( rx_avail ) {
+            uint32_t  i;
+            for(i=0; i<rx_avail && (desc[(rx_cached+i) & rx.mask].options & XDP_PKT_CONTD); i++) {}
+            if( i<rx_avail )
+                return true;
+        }
+        // Not yet. See if the kernel produced more
+        const uint32_t  n = load_acquire(rx.producer) - rx_cached;
+
+        if( n>rx_avail ) {
+            rx_avail = n;
+            continue;
+        }
+        // Nothing. Wait for it. Also check the watched filedescriptor
+        // such that we don't keep on waiting after the transfer was
+        // stopped (it gets closed then)
+        struct pollfd  pfd[2];
+
+        pfd[0].fd      = xsk;
+        pfd[0].events  = POLLIN;
+        pfd[0].revents = 0;
+        pfd[1].fd      = watchfd;
+        pfd[1].events  = 0;
+        pfd[1].revents = 0;
+
+        const int  r = ::poll(&pfd[0], (watchfd<0 ? 1 : 2), 1000);
+
+        if( r<0 )
+            return false;
+        if( (pfd[1].revents & POLLNVAL) || (r==0 && watchfd>=0 && ::fcntl(watchfd, F_GETFD)==-1) ) {
+            errno = EBADF;
+            return false;
+        }
+    }
+}
+
+void xdpsocket_type::recycle(uint64_t addr) {
+    const uint32_t  prod = *fill.producer;
+
+    // We own exactly as many frames as the fill ring can hold
+    // so there's always room
+    ((uint64_t*)fill.ring)[prod & fill.mask] = addr & ~((uint64_t)frame_size - 1);
+    store_release(fill.producer, prod + 1);
+}
+
+ssize_t xdpsocket_type::recvmsg(struct msghdr* msg, int flags) {
+    if( !wait_for_rx() )
+        return -1;
+
+    // Collect the datagram, possibly scattered over a number of frames
+    struct xdp_desc const*  desc = (struct xdp_desc const*)rx.ring;
+    unsigned char const*    pkt  = umem + desc[rx_cached & rx.mask].addr;
+    const uint32_t          len0 = desc[rx_cached & rx.mask].len;
+    uint32_t                nfrag, total;
+
+    for(nfrag=1, total=len0; desc[(rx_cached+nfrag-1) & rx.mask].options & XDP_PKT_CONTD; nfrag++)
+        total += desc[(rx_cached+nfrag) & rx.mask].len;
+
+    // The program guarantees eth + IPv4 w/o options + UDP are in the
+    // first fragment. The UDP length field tells us how long the
+    // payload actually is (ethernet may have padded the frame)
+    const uint16_t  udplen = ntohs(*(uint16_t const*)(pkt + udp_hdr_offset + 4));
+    size_t          payload = std::min((size_t)(udplen>=8 ? udplen-8 : 0), (size_t)(total - udp_data_offset));
+    ssize_t         rv = 0;
+
+    if( msg->msg_name && msg->msg_namelen>=sizeof(struct sockaddr_in) ) {
+        struct sockaddr_in*  sender = (struct sockaddr_in*)msg->msg_name;
+
+        ::memset(sender, 0, sizeof(struct sockaddr_in));
+        sender->sin_family = AF_INET;
+        ::memcpy(&sender->sin_addr.s_addr, pkt + 14 + 12, 4);
+        ::memcpy(&sender->sin_port, pkt + udp_hdr_offset, 2);
+        msg->msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    // Scatter the payload over the iovecs
+    uint32_t   frag    = 0;
+    uint32_t   fragoff = udp_data_offset;
+    uint32_t   fraglen = len0;
+
+    for(size_t i=0; i<(size_t)msg->msg_iovlen && payload; i++) {
+        unsigned char*  dst = (unsigned char*)msg->msg_iov[i].iov_base;
+        size_t          n   = std::min(msg->msg_iov[i].iov_len, payload);
+
+        while( n ) {
+            if( fragoff==fraglen ) {
+                frag++;
+                pkt     = umem + desc[(rx_cached+frag) & rx.mask].addr;
+                fraglen = desc[(rx_cached+frag) & rx.mask].len;
+                fragoff = 0;
+            }
+            const size_t  chunk = std::min(n, (size_t)(fraglen - fragoff));
+
+            ::memcpy(dst, pkt + fragoff, chunk);
+            dst     += chunk;
+            fragoff += (uint32_t)chunk;
+            n       -= chunk;
+            payload -= chunk;
+            rv      += (ssize_t)chunk;
+        }
+    }
+    msg->msg_flags = 0;
+
+    if( flags & MSG_PEEK )
+        return rv;
+
+    // Consume the datagram: return the frames + tell the kernel
+    // we've processed the descriptors
+    for(uint32_t i=0; i<nfrag; i++)
+        recycle( desc[(rx_cached+i) & rx.mask].addr );
+    rx_cached += nfrag;
+    rx_avail  -= nfrag;
+    store_release(rx.consumer, rx_cached);
+
+    if( *(volatile uint32_t*)fill.flags & XDP_RING_NEED_WAKEUP )
+        (void)::recvfrom(xsk, 0, 0, MSG_DONTWAIT, 0, 0);
+    return rv;
+}
+
+void xdpsocket_type::cleanup( void ) {
+    ring_type* const  rings[] = { &rx, &fill, &completion };
+
+    // Closing the link detaches the program from the interface
+    if( linkfd>=0 )
+        ::close(linkfd);
+    if( progfd>=0 )
+        ::close(progfd);
+    if( mapfd>=0 )
+        ::close(mapfd);
+    for(unsigned int i=0; i<sizeof(rings)/sizeof(rings[0]); i++)
+        if( rings[i]->map!=MAP_FAILED )
+            ::munmap(rings[i]->map, rings[i]->maplen);
+    if( xsk>=0 )
+        ::close(xsk);
+    if( umem!=MAP_FAILED )
+        ::munmap(umem, umemlen);
+    linkfd = progfd = mapfd = xsk = -1;
+    umem   = (unsigned char*)MAP_FAILED;
+}
+
+xdpsocket_type::~xdpsocket_type() {
+    cleanup();
+}
+
+#else // HAVE_AFXDP
+
+// No AF_XDP support compiled in; this'un only throws
+
+xdpsocket_type::xdpsocket_type(const std::string&, unsigned int, unsigned short, const std::string&, int) {
+    THROW_EZEXCEPT(xdpexception, "AF_XDP support was not compiled in");
+}
+ssize_t xdpsocket_type::recvmsg(struct msghdr*, int) {
+    errno = ENOSYS;
+    return -1;
+}
+std::string xdpsocket_type::mode( void ) const {
+    return "none";
+}
+uint64_t xdpsocket_type::rx_dropped( void ) const {
+    return 0;
+}
+xdpsocket_type::~xdpsocket_type() {}
+
+#endif // HAVE_AFXDP
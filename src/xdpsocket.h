@@ -0,0 +1,125 @@
+// kernel-bypass (AF_XDP) reception of UDP datagrams
+// Copyright (C) 2007-2024 Marjolein Verkouter
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// Author:  Marjolein Verkouter - verkouter@jive.eu
+//          Joint Institute for VLBI in Europe
+//          P.O. Box 2
+//          7990 AA Dwingeloo
+#ifndef JIVE5A_XDPSOCKET_H
+#define JIVE5A_XDPSOCKET_H
+
+#include <ezexcept.h>
+
+#include <string>
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+DECLARE_EZEXCEPT(xdpexception)
+
+// An AF_XDP socket bound to one receive queue of one network interface.
+//
+// Upon construction a tiny XDP program is attached to the interface which
+// redirects IPv4/UDP packets addressed to 'port' into this socket; all
+// other traffic is passed on to the kernel as usual. So the control
+// connection and e.g. the ACKs sent back over the normal UDP socket are
+// unaffected. Detaching happens automatically when the object is destroyed.
+//
+// 'mode' is one of:
+//    "zerocopy" - NIC DMAs straight into our memory; requires driver support
+//    "copy"     - the driver (or, failing that, the generic XDP layer)
+//                 copies into our memory. Works on every interface
+//                 including veth
+//    "auto"     - try zerocopy first, fall back to copy
+//
+// Constraints: IP fragments are not recognized so the MTU must be large
+// enough to hold the datagrams unfragmented. Only one AF_XDP reader per
+// interface is possible.
+//
+// Datagrams are received in batches from the RX ring; only if that ring is
+// empty a system call (poll) is made. recvmsg() is modelled after
+// recvmsg(2) such that the existing readers can use it as drop-in:
+// the UDP payload is scattered over msg->msg_iov, msg->msg_name (if set)
+// receives the sender's sockaddr_in. With MSG_PEEK the datagram is
+// not consumed. Returns the number of bytes copied or -1 and errno set
+// (EINTR if signalled, EBADF if 'watchfd' was closed).
+class xdpsocket_type {
+    public:
+        xdpsocket_type(const std::string& ifname, unsigned int queue,
+                       unsigned short port, const std::string& mode,
+                       int watchfd);
+
+        ssize_t recvmsg(struct msghdr* msg, int flags);
+
+        // what we actually ended up with, e.g. "zerocopy/drv", "copy/skb"
+        std::string  mode( void ) const;
+
+        // kernel side statistics
+        uint64_t     rx_dropped( void ) const;
+
+        ~xdpsocket_type();
+
+        static const unsigned int  frame_size = 4096;
+        static const unsigned int  nframe     = 4096;
+
+    private:
+        struct ring_type {
+            uint32_t  mask;
+            uint32_t  size;
+            uint32_t* producer;
+            uint32_t* consumer;
+            uint32_t* flags;
+            void*     ring;
+            void*     map;
+            size_t    maplen;
+
+            ring_type();
+        };
+
+        int            xsk;
+        int            mapfd;
+        int            progfd;
+        int            linkfd;
+        int            watchfd;
+        bool           zerocopy;
+        bool           skbmode;
+        bool           multibuf;
+        unsigned char* umem;
+        size_t         umemlen;
+        ring_type      rx;
+        ring_type      fill;
+        ring_type      completion;
+        // RX descriptors seen but not yet handed back
+        uint32_t       rx_cached;
+        uint32_t       rx_avail;
+
+        // wait for/grab the next descriptor(s)
+        bool           wait_for_rx( void );
+        void           recycle(uint64_t addr);
+        void           cleanup( void );
+
+        // no copy or assignment
+        xdpsocket_type(xdpsocket_type const&);
+        xdpsocket_type const& operator=(xdpsocket_type const&);
+};
+
+// The readers use this to receive from the AF_XDP socket, if there is
+// one, or from the ordinary socket 'fd' if not
+inline ssize_t xdp_or_sok_recvmsg(xdpsocket_type* xsk, int fd, struct msghdr* msg, int flags) {
+    return (xsk ? xsk->recvmsg(msg, flags) : ::recvmsg(fd, msg, flags));
+}
+
+#endif